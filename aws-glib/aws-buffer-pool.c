@@ -0,0 +1,200 @@
+/* aws-buffer-pool.c
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "aws-buffer-pool.h"
+
+/*
+ * A thread-safe pool of fixed-size, page-aligned buffers. Buffers handed
+ * out keep the pool alive, so they may be released after the pool's owner
+ * has gone away. Up to max_free released buffers are kept for reuse.
+ */
+
+struct _AwsBufferPool
+{
+  volatile gint  ref_count;
+  gsize          buffer_size;
+  gsize          alignment;
+  guint          max_free;
+  GMutex         mutex;
+  GQueue         free_list;
+};
+
+static gsize
+get_page_size (void)
+{
+#ifdef _SC_PAGESIZE
+  glong page_size = sysconf (_SC_PAGESIZE);
+
+  if (page_size > 0)
+    return page_size;
+#endif
+
+  return 4096;
+}
+
+static void
+aws_pooled_buffer_free (gpointer data)
+{
+  AwsPooledBuffer *buffer = data;
+
+  if (buffer != NULL)
+    {
+#ifdef HAVE_POSIX_MEMALIGN
+      free (buffer->data);
+#else
+      g_free (buffer->data);
+#endif
+      g_slice_free (AwsPooledBuffer, buffer);
+    }
+}
+
+/*
+ * Creates a pool of @buffer_size byte buffers. The size is rounded up to
+ * a multiple of the page size for the allocation only; callers still see
+ * @buffer_size from aws_buffer_pool_get_buffer_size().
+ */
+AwsBufferPool *
+aws_buffer_pool_new (gsize buffer_size,
+                     guint max_free)
+{
+  AwsBufferPool *self;
+
+  g_return_val_if_fail (buffer_size > 0, NULL);
+
+  self = g_slice_new0 (AwsBufferPool);
+  self->ref_count = 1;
+  self->buffer_size = buffer_size;
+  self->alignment = get_page_size ();
+  self->max_free = max_free;
+  g_queue_init (&self->free_list);
+  g_mutex_init (&self->mutex);
+
+  return self;
+}
+
+AwsBufferPool *
+aws_buffer_pool_ref (AwsBufferPool *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (self->ref_count > 0, NULL);
+
+  g_atomic_int_inc (&self->ref_count);
+
+  return self;
+}
+
+void
+aws_buffer_pool_unref (AwsBufferPool *self)
+{
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (self->ref_count > 0);
+
+  if (g_atomic_int_dec_and_test (&self->ref_count))
+    {
+      g_queue_foreach (&self->free_list, (GFunc)aws_pooled_buffer_free, NULL);
+      g_queue_clear (&self->free_list);
+      g_mutex_clear (&self->mutex);
+      g_slice_free (AwsBufferPool, self);
+    }
+}
+
+gsize
+aws_buffer_pool_get_buffer_size (AwsBufferPool *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->buffer_size;
+}
+
+/*
+ * Takes a buffer from the pool, allocating one if none are free. Return
+ * it with aws_buffer_pool_release().
+ */
+AwsPooledBuffer *
+aws_buffer_pool_acquire (AwsBufferPool *self)
+{
+  AwsPooledBuffer *buffer = NULL;
+
+  g_return_val_if_fail (self != NULL, NULL);
+
+  g_mutex_lock (&self->mutex);
+  buffer = g_queue_pop_head (&self->free_list);
+  g_mutex_unlock (&self->mutex);
+
+  if (buffer == NULL)
+    {
+      gsize alloc_size = (self->buffer_size + self->alignment - 1) & ~(self->alignment - 1);
+
+      buffer = g_slice_new0 (AwsPooledBuffer);
+#ifdef HAVE_POSIX_MEMALIGN
+      if (posix_memalign ((gpointer *)&buffer->data, self->alignment, alloc_size) != 0)
+        g_error ("Failed to allocate %"G_GSIZE_FORMAT" bytes", alloc_size);
+#else
+      buffer->data = g_malloc (alloc_size);
+#endif
+    }
+
+  buffer->pool = aws_buffer_pool_ref (self);
+
+  return buffer;
+}
+
+void
+aws_buffer_pool_release (AwsPooledBuffer *buffer)
+{
+  AwsBufferPool *pool;
+
+  g_return_if_fail (buffer != NULL);
+  g_return_if_fail (buffer->pool != NULL);
+
+  pool = g_steal_pointer (&buffer->pool);
+
+  g_mutex_lock (&pool->mutex);
+  if (pool->free_list.length < pool->max_free)
+    {
+      g_queue_push_head (&pool->free_list, buffer);
+      buffer = NULL;
+    }
+  g_mutex_unlock (&pool->mutex);
+
+  aws_pooled_buffer_free (buffer);
+  aws_buffer_pool_unref (pool);
+}
+
+/*
+ * Wraps the first @length bytes of @buffer in a #SoupBuffer, transferring
+ * ownership; @buffer returns to its pool once the #SoupBuffer and any
+ * copies of it are freed.
+ */
+SoupBuffer *
+aws_pooled_buffer_to_soup (AwsPooledBuffer *buffer,
+                           gsize            length)
+{
+  g_return_val_if_fail (buffer != NULL, NULL);
+  g_return_val_if_fail (length <= buffer->pool->buffer_size, NULL);
+
+  return soup_buffer_new_with_owner (buffer->data,
+                                     length,
+                                     buffer,
+                                     (GDestroyNotify)aws_buffer_pool_release);
+}
@@ -0,0 +1,48 @@
+/* aws-buffer-pool.h
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AWS_BUFFER_POOL_H
+#define AWS_BUFFER_POOL_H
+
+#include <libsoup/soup.h>
+
+G_BEGIN_DECLS
+
+typedef struct _AwsBufferPool AwsBufferPool;
+
+typedef struct
+{
+  AwsBufferPool *pool;
+  guint8        *data;
+} AwsPooledBuffer;
+
+AwsBufferPool   *aws_buffer_pool_new             (gsize            buffer_size,
+                                                  guint            max_free);
+AwsBufferPool   *aws_buffer_pool_ref             (AwsBufferPool   *self);
+void             aws_buffer_pool_unref           (AwsBufferPool   *self);
+gsize            aws_buffer_pool_get_buffer_size (AwsBufferPool   *self);
+AwsPooledBuffer *aws_buffer_pool_acquire         (AwsBufferPool   *self);
+void             aws_buffer_pool_release         (AwsPooledBuffer *buffer);
+SoupBuffer      *aws_pooled_buffer_to_soup       (AwsPooledBuffer *buffer,
+                                                  gsize            length);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (AwsBufferPool, aws_buffer_pool_unref)
+
+G_END_DECLS
+
+#endif /* AWS_BUFFER_POOL_H */
@@ -0,0 +1,235 @@
+/* aws-credentials-provider-chain.c
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "aws-credentials-provider-chain.h"
+#include "aws-env-credentials-provider.h"
+#include "aws-metadata-credentials-provider.h"
+#include "aws-profile-credentials-provider.h"
+#include "aws-web-identity-credentials-provider.h"
+
+/*
+ * Tries each provider in turn until one yields credentials. The provider
+ * that succeeded is tried first on the next load, so refreshes do not walk
+ * the whole chain again.
+ */
+
+struct _AwsCredentialsProviderChain
+{
+  AwsCredentialsProvider  parent_instance;
+
+  GPtrArray              *providers;
+  guint                   active;
+};
+
+typedef struct
+{
+  GPtrArray *providers;
+  GString   *errors;
+  guint      index;
+  guint      first;
+} LoadState;
+
+G_DEFINE_TYPE (AwsCredentialsProviderChain, aws_credentials_provider_chain, AWS_TYPE_CREDENTIALS_PROVIDER)
+
+static void
+load_state_free (gpointer data)
+{
+  LoadState *state = data;
+
+  if (state != NULL)
+    {
+      g_ptr_array_unref (state->providers);
+      g_string_free (state->errors, TRUE);
+      g_slice_free (LoadState, state);
+    }
+}
+
+AwsCredentialsProvider *
+aws_credentials_provider_chain_new (void)
+{
+  return g_object_new (AWS_TYPE_CREDENTIALS_PROVIDER_CHAIN, NULL);
+}
+
+/**
+ * aws_credentials_provider_chain_new_default:
+ *
+ * Creates the chain used by the AWS SDKs: the environment, the shared
+ * credentials file, web identity federation and finally the container or
+ * instance metadata service.
+ *
+ * Returns: (transfer full): An #AwsCredentialsProvider.
+ */
+AwsCredentialsProvider *
+aws_credentials_provider_chain_new_default (void)
+{
+  AwsCredentialsProviderChain *self;
+  AwsCredentialsProvider *providers[4];
+  guint i;
+
+  self = g_object_new (AWS_TYPE_CREDENTIALS_PROVIDER_CHAIN, NULL);
+
+  providers [0] = aws_env_credentials_provider_new ();
+  providers [1] = aws_profile_credentials_provider_new (NULL, NULL);
+  providers [2] = aws_web_identity_credentials_provider_new ();
+  providers [3] = aws_metadata_credentials_provider_new ();
+
+  for (i = 0; i < G_N_ELEMENTS (providers); i++)
+    {
+      aws_credentials_provider_chain_append (self, providers [i]);
+      g_object_unref (providers [i]);
+    }
+
+  return AWS_CREDENTIALS_PROVIDER (self);
+}
+
+void
+aws_credentials_provider_chain_append (AwsCredentialsProviderChain *self,
+                                       AwsCredentialsProvider      *provider)
+{
+  g_return_if_fail (AWS_IS_CREDENTIALS_PROVIDER_CHAIN (self));
+  g_return_if_fail (AWS_IS_CREDENTIALS_PROVIDER (provider));
+  g_return_if_fail ((gpointer)provider != (gpointer)self);
+
+  g_ptr_array_add (self->providers, g_object_ref (provider));
+}
+
+static void aws_credentials_provider_chain_try_next (GTask *task);
+
+static void
+aws_credentials_provider_chain_load_cb (GObject      *object,
+                                        GAsyncResult *result,
+                                        gpointer      user_data)
+{
+  AwsCredentialsProvider *provider = (AwsCredentialsProvider *)object;
+  g_autoptr(GTask) task = user_data;
+  AwsCredentialsProviderChain *self;
+  AwsCredentials *credentials;
+  LoadState *state;
+  GError *error = NULL;
+
+  g_assert (AWS_IS_CREDENTIALS_PROVIDER (provider));
+  g_assert (G_IS_TASK (task));
+
+  self = g_task_get_source_object (task);
+  state = g_task_get_task_data (task);
+
+  if ((credentials = aws_credentials_provider_load_finish (provider, result, &error)))
+    {
+      self->active = (state->first + state->index) % state->providers->len;
+      g_task_return_pointer (task, credentials, g_object_unref);
+      return;
+    }
+
+  g_string_append_printf (state->errors, "\n  %s: %s", G_OBJECT_TYPE_NAME (provider), error->message);
+  g_clear_error (&error);
+
+  state->index++;
+  aws_credentials_provider_chain_try_next (g_steal_pointer (&task));
+}
+
+static void
+aws_credentials_provider_chain_try_next (GTask *task)
+{
+  AwsCredentialsProvider *provider;
+  LoadState *state;
+
+  g_assert (G_IS_TASK (task));
+
+  state = g_task_get_task_data (task);
+
+  if (state->index >= state->providers->len)
+    {
+      g_task_return_new_error (task,
+                               AWS_CREDENTIALS_PROVIDER_ERROR,
+                               AWS_CREDENTIALS_PROVIDER_ERROR_UNAVAILABLE,
+                               "No provider could load credentials:%s",
+                               state->errors->str);
+      g_object_unref (task);
+      return;
+    }
+
+  provider = g_ptr_array_index (state->providers, (state->first + state->index) % state->providers->len);
+
+  aws_credentials_provider_load_async (provider,
+                                       g_task_get_cancellable (task),
+                                       aws_credentials_provider_chain_load_cb,
+                                       task);
+}
+
+static void
+aws_credentials_provider_chain_load_async (AwsCredentialsProvider *provider,
+                                           GCancellable           *cancellable,
+                                           GAsyncReadyCallback     callback,
+                                           gpointer                user_data)
+{
+  AwsCredentialsProviderChain *self = (AwsCredentialsProviderChain *)provider;
+  GTask *task;
+  LoadState *state;
+
+  g_assert (AWS_IS_CREDENTIALS_PROVIDER_CHAIN (self));
+
+  state = g_slice_new0 (LoadState);
+  state->providers = g_ptr_array_ref (self->providers);
+  state->errors = g_string_new (NULL);
+  state->first = self->providers->len ? self->active % self->providers->len : 0;
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, aws_credentials_provider_chain_load_async);
+  g_task_set_task_data (task, state, load_state_free);
+
+  aws_credentials_provider_chain_try_next (task);
+}
+
+static AwsCredentials *
+aws_credentials_provider_chain_load_finish (AwsCredentialsProvider  *provider,
+                                            GAsyncResult            *result,
+                                            GError                 **error)
+{
+  g_assert (AWS_IS_CREDENTIALS_PROVIDER_CHAIN (provider));
+  g_assert (G_IS_TASK (result));
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+static void
+aws_credentials_provider_chain_finalize (GObject *object)
+{
+  AwsCredentialsProviderChain *self = (AwsCredentialsProviderChain *)object;
+
+  g_clear_pointer (&self->providers, g_ptr_array_unref);
+
+  G_OBJECT_CLASS (aws_credentials_provider_chain_parent_class)->finalize (object);
+}
+
+static void
+aws_credentials_provider_chain_class_init (AwsCredentialsProviderChainClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  AwsCredentialsProviderClass *provider_class = AWS_CREDENTIALS_PROVIDER_CLASS (klass);
+
+  object_class->finalize = aws_credentials_provider_chain_finalize;
+
+  provider_class->load_async = aws_credentials_provider_chain_load_async;
+  provider_class->load_finish = aws_credentials_provider_chain_load_finish;
+}
+
+static void
+aws_credentials_provider_chain_init (AwsCredentialsProviderChain *self)
+{
+  self->providers = g_ptr_array_new_with_free_func (g_object_unref);
+}
@@ -0,0 +1,37 @@
+/* aws-credentials-provider-chain.h
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AWS_CREDENTIALS_PROVIDER_CHAIN_H
+#define AWS_CREDENTIALS_PROVIDER_CHAIN_H
+
+#include "aws-credentials-provider.h"
+
+G_BEGIN_DECLS
+
+#define AWS_TYPE_CREDENTIALS_PROVIDER_CHAIN (aws_credentials_provider_chain_get_type())
+
+G_DECLARE_FINAL_TYPE (AwsCredentialsProviderChain, aws_credentials_provider_chain, AWS, CREDENTIALS_PROVIDER_CHAIN, AwsCredentialsProvider)
+
+AwsCredentialsProvider *aws_credentials_provider_chain_new         (void);
+AwsCredentialsProvider *aws_credentials_provider_chain_new_default (void);
+void                    aws_credentials_provider_chain_append      (AwsCredentialsProviderChain *self,
+                                                                    AwsCredentialsProvider      *provider);
+
+G_END_DECLS
+
+#endif /* AWS_CREDENTIALS_PROVIDER_CHAIN_H */
@@ -0,0 +1,31 @@
+/* aws-credentials-provider-private.h
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AWS_CREDENTIALS_PROVIDER_PRIVATE_H
+#define AWS_CREDENTIALS_PROVIDER_PRIVATE_H
+
+#include "aws-credentials-provider.h"
+
+G_BEGIN_DECLS
+
+gint64 aws_credentials_provider_parse_expiration (const gchar            *timestamp);
+void   aws_credentials_provider_request_refresh   (AwsCredentialsProvider *self);
+
+G_END_DECLS
+
+#endif /* AWS_CREDENTIALS_PROVIDER_PRIVATE_H */
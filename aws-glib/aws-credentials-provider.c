@@ -0,0 +1,697 @@
+/* aws-credentials-provider.c
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <libsoup/soup.h>
+
+#include "aws-credentials-provider.h"
+#include "aws-credentials-provider-private.h"
+
+/*
+ * Providers load credentials through the load_async() vfunc and publish
+ * each result as an immutable snapshot. Readers only take a reference to
+ * the current snapshot under a lock, so signing never waits for a load.
+ *
+ * Loads and the background refresh timers of every provider run on a
+ * private main context iterated by a thread of its own, so they make
+ * progress whether or not the application runs a main loop. Concurrent
+ * refresh requests share a single load.
+ */
+
+/* Failed loads, and loads returning expired credentials, back off */
+#define RETRY_MIN_INTERVAL 1
+#define RETRY_MAX_INTERVAL 300
+
+typedef struct
+{
+  GMainContext   *context;
+  GMutex          mutex;
+  AwsCredentials *snapshot;
+  GPtrArray      *waiters;
+  GSource        *refresh_source;
+  guint           refresh_margin;
+  gint64          retry_after;
+  guint           retries;
+  gint            refresh_requested;
+  guint           loading : 1;
+} AwsCredentialsProviderPrivate;
+
+G_DEFINE_ABSTRACT_TYPE_WITH_PRIVATE (AwsCredentialsProvider, aws_credentials_provider, G_TYPE_OBJECT)
+
+enum {
+  PROP_0,
+  PROP_REFRESH_MARGIN,
+  N_PROPS
+};
+
+static GParamSpec *properties [N_PROPS];
+
+static void aws_credentials_provider_begin_refresh (AwsCredentialsProvider *self,
+                                                    GTask                  *task);
+
+static gpointer
+aws_credentials_provider_thread_func (gpointer data)
+{
+  GMainLoop *main_loop = data;
+
+  g_main_context_push_thread_default (g_main_loop_get_context (main_loop));
+  g_main_loop_run (main_loop);
+
+  return NULL;
+}
+
+/*
+ * Returns the main context that loads and refresh timers run on, starting
+ * the thread that iterates it on first use.
+ */
+static GMainContext *
+aws_credentials_provider_get_context (void)
+{
+  static GMainContext *context;
+
+  if (g_once_init_enter (&context))
+    {
+      GMainContext *new_context = g_main_context_new ();
+      GMainLoop *main_loop = g_main_loop_new (new_context, FALSE);
+
+      g_thread_unref (g_thread_new ("aws-credentials",
+                                    aws_credentials_provider_thread_func,
+                                    main_loop));
+
+      g_once_init_leave (&context, new_context);
+    }
+
+  return context;
+}
+
+static void
+weak_ref_free (gpointer data)
+{
+  GWeakRef *weak_ref = data;
+
+  g_weak_ref_clear (weak_ref);
+  g_slice_free (GWeakRef, weak_ref);
+}
+
+/**
+ * aws_credentials_provider_get_credentials:
+ * @self: An #AwsCredentialsProvider.
+ *
+ * Fetches the most recently loaded credentials without waiting for any
+ * load in progress. This is safe to call from any thread.
+ *
+ * Returns: (transfer full) (nullable): An #AwsCredentials, or %NULL if
+ *   no credentials have been loaded yet.
+ */
+AwsCredentials *
+aws_credentials_provider_get_credentials (AwsCredentialsProvider *self)
+{
+  AwsCredentialsProviderPrivate *priv = aws_credentials_provider_get_instance_private (self);
+  AwsCredentials *ret = NULL;
+
+  g_return_val_if_fail (AWS_IS_CREDENTIALS_PROVIDER (self), NULL);
+
+  g_mutex_lock (&priv->mutex);
+  if (priv->snapshot != NULL)
+    ret = g_object_ref (priv->snapshot);
+  g_mutex_unlock (&priv->mutex);
+
+  return ret;
+}
+
+guint
+aws_credentials_provider_get_refresh_margin (AwsCredentialsProvider *self)
+{
+  AwsCredentialsProviderPrivate *priv = aws_credentials_provider_get_instance_private (self);
+
+  g_return_val_if_fail (AWS_IS_CREDENTIALS_PROVIDER (self), 0);
+
+  return priv->refresh_margin;
+}
+
+/**
+ * aws_credentials_provider_set_refresh_margin:
+ * @self: An #AwsCredentialsProvider.
+ * @refresh_margin: The number of seconds before expiry to refresh.
+ *
+ * Sets how long before temporary credentials expire they are refreshed
+ * in the background. Credentials with a shorter lifetime are refreshed
+ * half-way through it.
+ */
+void
+aws_credentials_provider_set_refresh_margin (AwsCredentialsProvider *self,
+                                             guint                   refresh_margin)
+{
+  AwsCredentialsProviderPrivate *priv = aws_credentials_provider_get_instance_private (self);
+
+  g_return_if_fail (AWS_IS_CREDENTIALS_PROVIDER (self));
+
+  if (priv->refresh_margin != refresh_margin)
+    {
+      priv->refresh_margin = refresh_margin;
+      g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_REFRESH_MARGIN]);
+    }
+}
+
+/**
+ * aws_credentials_provider_load_async:
+ * @self: An #AwsCredentialsProvider.
+ * @cancellable: (nullable): A #GCancellable, or %NULL.
+ * @callback: A callback to execute upon completion.
+ * @user_data: User data for @callback.
+ *
+ * Loads a fresh set of credentials from the source of @self without
+ * touching the cached snapshot. Most callers want
+ * aws_credentials_provider_refresh_async() instead.
+ */
+void
+aws_credentials_provider_load_async (AwsCredentialsProvider *self,
+                                     GCancellable           *cancellable,
+                                     GAsyncReadyCallback     callback,
+                                     gpointer                user_data)
+{
+  g_return_if_fail (AWS_IS_CREDENTIALS_PROVIDER (self));
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  AWS_CREDENTIALS_PROVIDER_GET_CLASS (self)->load_async (self, cancellable, callback, user_data);
+}
+
+/**
+ * aws_credentials_provider_load_finish:
+ * @self: An #AwsCredentialsProvider.
+ * @result: A #GAsyncResult.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Completes a request started with aws_credentials_provider_load_async().
+ *
+ * Returns: (transfer full): An #AwsCredentials or %NULL and @error is set.
+ */
+AwsCredentials *
+aws_credentials_provider_load_finish (AwsCredentialsProvider  *self,
+                                      GAsyncResult            *result,
+                                      GError                 **error)
+{
+  g_return_val_if_fail (AWS_IS_CREDENTIALS_PROVIDER (self), NULL);
+  g_return_val_if_fail (G_IS_ASYNC_RESULT (result), NULL);
+
+  return AWS_CREDENTIALS_PROVIDER_GET_CLASS (self)->load_finish (self, result, error);
+}
+
+/*
+ * The timer only holds a weak reference, so that a provider may be
+ * released from another thread while a refresh is scheduled.
+ */
+static gboolean
+aws_credentials_provider_refresh_timeout (gpointer data)
+{
+  g_autoptr(AwsCredentialsProvider) self = g_weak_ref_get (data);
+  AwsCredentialsProviderPrivate *priv;
+
+  if (self == NULL)
+    return G_SOURCE_REMOVE;
+
+  priv = aws_credentials_provider_get_instance_private (self);
+
+  g_clear_pointer (&priv->refresh_source, g_source_unref);
+  aws_credentials_provider_begin_refresh (self, NULL);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+aws_credentials_provider_schedule (AwsCredentialsProvider *self,
+                                   guint                   delay)
+{
+  AwsCredentialsProviderPrivate *priv = aws_credentials_provider_get_instance_private (self);
+  GWeakRef *weak_ref;
+
+  g_assert (AWS_IS_CREDENTIALS_PROVIDER (self));
+
+  if (priv->refresh_source != NULL)
+    {
+      g_source_destroy (priv->refresh_source);
+      g_clear_pointer (&priv->refresh_source, g_source_unref);
+    }
+
+  weak_ref = g_slice_new0 (GWeakRef);
+  g_weak_ref_init (weak_ref, self);
+
+  priv->refresh_source = g_timeout_source_new_seconds (MAX (delay, 1));
+  g_source_set_callback (priv->refresh_source,
+                         aws_credentials_provider_refresh_timeout,
+                         weak_ref,
+                         weak_ref_free);
+  g_source_attach (priv->refresh_source, priv->context);
+}
+
+/*
+ * Returns how long to wait before loading again after a failed load,
+ * doubling the delay each time up to RETRY_MAX_INTERVAL. Requests for a
+ * refresh made before then are ignored.
+ */
+static guint
+aws_credentials_provider_back_off (AwsCredentialsProvider *self)
+{
+  AwsCredentialsProviderPrivate *priv = aws_credentials_provider_get_instance_private (self);
+  guint delay;
+
+  g_assert (AWS_IS_CREDENTIALS_PROVIDER (self));
+
+  delay = MIN (RETRY_MIN_INTERVAL << MIN (priv->retries, 16), RETRY_MAX_INTERVAL);
+  priv->retries++;
+  priv->retry_after = g_get_monotonic_time () + (gint64)delay * G_USEC_PER_SEC;
+
+  return delay;
+}
+
+static void
+aws_credentials_provider_schedule_retry (AwsCredentialsProvider *self)
+{
+  g_assert (AWS_IS_CREDENTIALS_PROVIDER (self));
+
+  aws_credentials_provider_schedule (self, aws_credentials_provider_back_off (self));
+}
+
+static void
+aws_credentials_provider_schedule_refresh (AwsCredentialsProvider *self,
+                                           AwsCredentials         *credentials)
+{
+  AwsCredentialsProviderPrivate *priv = aws_credentials_provider_get_instance_private (self);
+  gint64 expiration;
+  gint64 remaining;
+  gint64 delay;
+
+  g_assert (AWS_IS_CREDENTIALS_PROVIDER (self));
+  g_assert (AWS_IS_CREDENTIALS (credentials));
+
+  if (!(expiration = aws_credentials_get_expiration (credentials)))
+    {
+      priv->retries = 0;
+      priv->retry_after = 0;
+      return;
+    }
+
+  remaining = expiration - g_get_real_time () / G_USEC_PER_SEC;
+
+  if (remaining > (gint64)priv->refresh_margin * 2)
+    delay = remaining - priv->refresh_margin;
+  else
+    delay = remaining / 2;
+
+  /* Already expired, or about to; don't poll the source every second */
+  if (delay < 1)
+    {
+      g_debug ("Loaded credentials expire in %"G_GINT64_FORMAT" seconds", remaining);
+      aws_credentials_provider_schedule_retry (self);
+      return;
+    }
+
+  priv->retries = 0;
+  priv->retry_after = 0;
+  aws_credentials_provider_schedule (self, MIN (delay, G_MAXUINT));
+}
+
+static void
+aws_credentials_provider_load_cb (GObject      *object,
+                                  GAsyncResult *result,
+                                  gpointer      user_data)
+{
+  AwsCredentialsProvider *self = (AwsCredentialsProvider *)object;
+  AwsCredentialsProviderPrivate *priv = aws_credentials_provider_get_instance_private (self);
+  g_autoptr(AwsCredentials) credentials = NULL;
+  g_autoptr(AwsCredentials) previous = NULL;
+  g_autoptr(GPtrArray) waiters = NULL;
+  GError *error = NULL;
+  guint delay;
+  guint i;
+
+  g_assert (AWS_IS_CREDENTIALS_PROVIDER (self));
+
+  credentials = aws_credentials_provider_load_finish (self, result, &error);
+
+  priv->loading = FALSE;
+  waiters = g_steal_pointer (&priv->waiters);
+  priv->waiters = g_ptr_array_new_with_free_func (g_object_unref);
+
+  if (credentials != NULL)
+    {
+      g_mutex_lock (&priv->mutex);
+      previous = g_steal_pointer (&priv->snapshot);
+      priv->snapshot = g_object_ref (credentials);
+      g_mutex_unlock (&priv->mutex);
+
+      aws_credentials_provider_schedule_refresh (self, credentials);
+    }
+  else
+    {
+      g_debug ("Failed to load credentials: %s", error->message);
+
+      delay = aws_credentials_provider_back_off (self);
+
+      /* Keep trying while there are temporary credentials to replace */
+      if ((previous = aws_credentials_provider_get_credentials (self)) &&
+          aws_credentials_get_expiration (previous) != 0)
+        aws_credentials_provider_schedule (self, delay);
+    }
+
+  for (i = 0; i < waiters->len; i++)
+    {
+      GTask *task = g_ptr_array_index (waiters, i);
+
+      if (credentials != NULL)
+        g_task_return_pointer (task, g_object_ref (credentials), g_object_unref);
+      else
+        g_task_return_error (task, g_error_copy (error));
+    }
+
+  g_clear_error (&error);
+}
+
+static void
+aws_credentials_provider_begin_refresh (AwsCredentialsProvider *self,
+                                        GTask                  *task)
+{
+  AwsCredentialsProviderPrivate *priv = aws_credentials_provider_get_instance_private (self);
+
+  g_assert (AWS_IS_CREDENTIALS_PROVIDER (self));
+  g_assert (!task || G_IS_TASK (task));
+
+  if (task != NULL)
+    g_ptr_array_add (priv->waiters, g_object_ref (task));
+
+  if (!priv->loading)
+    {
+      priv->loading = TRUE;
+      aws_credentials_provider_load_async (self,
+                                           NULL,
+                                           aws_credentials_provider_load_cb,
+                                           NULL);
+    }
+}
+
+static gboolean
+aws_credentials_provider_begin_refresh_cb (gpointer data)
+{
+  GTask *task = data;
+
+  g_assert (G_IS_TASK (task));
+
+  aws_credentials_provider_begin_refresh (g_task_get_source_object (task), task);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+aws_credentials_provider_request_refresh_cb (gpointer data)
+{
+  g_autoptr(AwsCredentialsProvider) self = g_weak_ref_get (data);
+  AwsCredentialsProviderPrivate *priv;
+
+  if (self == NULL)
+    return G_SOURCE_REMOVE;
+
+  priv = aws_credentials_provider_get_instance_private (self);
+
+  g_atomic_int_set (&priv->refresh_requested, FALSE);
+
+  if (!priv->loading && g_get_monotonic_time () >= priv->retry_after)
+    aws_credentials_provider_begin_refresh (self, NULL);
+
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * Starts a load in the background unless one is in progress, or the last
+ * one failed and its back-off has not yet elapsed. This may be called
+ * from any thread, for every request signed with a missing or expired
+ * snapshot, without piling up loads.
+ */
+void
+aws_credentials_provider_request_refresh (AwsCredentialsProvider *self)
+{
+  AwsCredentialsProviderPrivate *priv = aws_credentials_provider_get_instance_private (self);
+  GWeakRef *weak_ref;
+  GSource *source;
+
+  g_return_if_fail (AWS_IS_CREDENTIALS_PROVIDER (self));
+
+  if (!g_atomic_int_compare_and_exchange (&priv->refresh_requested, FALSE, TRUE))
+    return;
+
+  weak_ref = g_slice_new0 (GWeakRef);
+  g_weak_ref_init (weak_ref, self);
+
+  source = g_idle_source_new ();
+  g_source_set_priority (source, G_PRIORITY_DEFAULT);
+  g_source_set_callback (source,
+                         aws_credentials_provider_request_refresh_cb,
+                         weak_ref,
+                         weak_ref_free);
+  g_source_attach (source, priv->context);
+  g_source_unref (source);
+}
+
+/**
+ * aws_credentials_provider_refresh_async:
+ * @self: An #AwsCredentialsProvider.
+ * @cancellable: (nullable): A #GCancellable, or %NULL.
+ * @callback: (nullable): A callback to execute upon completion.
+ * @user_data: User data for @callback.
+ *
+ * Loads new credentials and publishes them as the snapshot returned from
+ * aws_credentials_provider_get_credentials(). Requests made while a load
+ * is in progress share its result. This may be called from any thread.
+ *
+ * Once temporary credentials have been loaded, @self refreshes them in
+ * the background ahead of their expiration. @callback is invoked on the
+ * thread-default main context of the caller.
+ */
+void
+aws_credentials_provider_refresh_async (AwsCredentialsProvider *self,
+                                        GCancellable           *cancellable,
+                                        GAsyncReadyCallback     callback,
+                                        gpointer                user_data)
+{
+  AwsCredentialsProviderPrivate *priv = aws_credentials_provider_get_instance_private (self);
+  GSource *source;
+  GTask *task;
+
+  g_return_if_fail (AWS_IS_CREDENTIALS_PROVIDER (self));
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, aws_credentials_provider_refresh_async);
+
+  /* Not g_main_context_invoke(), which may run it on this thread */
+  source = g_idle_source_new ();
+  g_source_set_priority (source, G_PRIORITY_DEFAULT);
+  g_source_set_callback (source,
+                         aws_credentials_provider_begin_refresh_cb,
+                         task,
+                         g_object_unref);
+  g_source_attach (source, priv->context);
+  g_source_unref (source);
+}
+
+/**
+ * aws_credentials_provider_refresh_finish:
+ * @self: An #AwsCredentialsProvider.
+ * @result: A #GAsyncResult.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Completes a request started with aws_credentials_provider_refresh_async().
+ *
+ * Returns: (transfer full): The new #AwsCredentials or %NULL and @error
+ *   is set.
+ */
+AwsCredentials *
+aws_credentials_provider_refresh_finish (AwsCredentialsProvider  *self,
+                                         GAsyncResult            *result,
+                                         GError                 **error)
+{
+  g_return_val_if_fail (AWS_IS_CREDENTIALS_PROVIDER (self), NULL);
+  g_return_val_if_fail (G_IS_TASK (result), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+static void
+aws_credentials_provider_refresh_sync_cb (GObject      *object,
+                                          GAsyncResult *result,
+                                          gpointer      user_data)
+{
+  GAsyncResult **ret = user_data;
+
+  *ret = g_object_ref (result);
+}
+
+/**
+ * aws_credentials_provider_refresh_sync:
+ * @self: An #AwsCredentialsProvider.
+ * @cancellable: (nullable): A #GCancellable, or %NULL.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Like aws_credentials_provider_refresh_async() but blocks the calling
+ * thread until the load completes. This may be called from any thread,
+ * whether or not it runs a main loop.
+ *
+ * Returns: (transfer full): The new #AwsCredentials or %NULL and @error
+ *   is set.
+ */
+AwsCredentials *
+aws_credentials_provider_refresh_sync (AwsCredentialsProvider  *self,
+                                       GCancellable            *cancellable,
+                                       GError                 **error)
+{
+  AwsCredentialsProviderPrivate *priv = aws_credentials_provider_get_instance_private (self);
+  g_autoptr(GMainContext) context = NULL;
+  g_autoptr(GAsyncResult) result = NULL;
+
+  g_return_val_if_fail (AWS_IS_CREDENTIALS_PROVIDER (self), NULL);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), NULL);
+  g_return_val_if_fail (!g_main_context_is_owner (priv->context), NULL);
+
+  context = g_main_context_new ();
+  g_main_context_push_thread_default (context);
+
+  aws_credentials_provider_refresh_async (self,
+                                          cancellable,
+                                          aws_credentials_provider_refresh_sync_cb,
+                                          &result);
+
+  while (result == NULL)
+    g_main_context_iteration (context, TRUE);
+
+  g_main_context_pop_thread_default (context);
+
+  return aws_credentials_provider_refresh_finish (self, result, error);
+}
+
+/*
+ * Parses the ISO 8601 timestamps used by STS and the metadata services
+ * into seconds since the Unix epoch, or 0 if @timestamp is unusable.
+ */
+gint64
+aws_credentials_provider_parse_expiration (const gchar *timestamp)
+{
+  SoupDate *date;
+  gint64 ret;
+
+  if (timestamp == NULL || !(date = soup_date_new_from_string (timestamp)))
+    return 0;
+
+  ret = soup_date_to_time_t (date);
+  soup_date_free (date);
+
+  return MAX (ret, 0);
+}
+
+static void
+aws_credentials_provider_finalize (GObject *object)
+{
+  AwsCredentialsProvider *self = (AwsCredentialsProvider *)object;
+  AwsCredentialsProviderPrivate *priv = aws_credentials_provider_get_instance_private (self);
+
+  if (priv->refresh_source != NULL)
+    {
+      g_source_destroy (priv->refresh_source);
+      g_clear_pointer (&priv->refresh_source, g_source_unref);
+    }
+
+  g_clear_pointer (&priv->waiters, g_ptr_array_unref);
+  g_clear_pointer (&priv->context, g_main_context_unref);
+  g_clear_object (&priv->snapshot);
+  g_mutex_clear (&priv->mutex);
+
+  G_OBJECT_CLASS (aws_credentials_provider_parent_class)->finalize (object);
+}
+
+static void
+aws_credentials_provider_get_property (GObject    *object,
+                                       guint       prop_id,
+                                       GValue     *value,
+                                       GParamSpec *pspec)
+{
+  AwsCredentialsProvider *self = AWS_CREDENTIALS_PROVIDER (object);
+
+  switch (prop_id)
+    {
+    case PROP_REFRESH_MARGIN:
+      g_value_set_uint (value, aws_credentials_provider_get_refresh_margin (self));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+aws_credentials_provider_set_property (GObject      *object,
+                                       guint         prop_id,
+                                       const GValue *value,
+                                       GParamSpec   *pspec)
+{
+  AwsCredentialsProvider *self = AWS_CREDENTIALS_PROVIDER (object);
+
+  switch (prop_id)
+    {
+    case PROP_REFRESH_MARGIN:
+      aws_credentials_provider_set_refresh_margin (self, g_value_get_uint (value));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+aws_credentials_provider_class_init (AwsCredentialsProviderClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = aws_credentials_provider_finalize;
+  object_class->get_property = aws_credentials_provider_get_property;
+  object_class->set_property = aws_credentials_provider_set_property;
+
+  properties [PROP_REFRESH_MARGIN] =
+    g_param_spec_uint ("refresh-margin",
+                       "Refresh Margin",
+                       "Seconds before expiry to refresh temporary credentials.",
+                       0,
+                       G_MAXUINT,
+                       300,
+                       G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties (object_class, N_PROPS, properties);
+}
+
+static void
+aws_credentials_provider_init (AwsCredentialsProvider *self)
+{
+  AwsCredentialsProviderPrivate *priv = aws_credentials_provider_get_instance_private (self);
+
+  priv->context = g_main_context_ref (aws_credentials_provider_get_context ());
+  priv->waiters = g_ptr_array_new_with_free_func (g_object_unref);
+  priv->refresh_margin = 300;
+  g_mutex_init (&priv->mutex);
+}
+
+GQuark
+aws_credentials_provider_error_quark (void)
+{
+  return g_quark_from_static_string ("aws-credentials-provider-error-quark");
+}
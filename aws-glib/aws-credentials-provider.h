@@ -0,0 +1,89 @@
+/* aws-credentials-provider.h
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AWS_CREDENTIALS_PROVIDER_H
+#define AWS_CREDENTIALS_PROVIDER_H
+
+#include <gio/gio.h>
+
+#include "aws-credentials.h"
+
+G_BEGIN_DECLS
+
+#define AWS_TYPE_CREDENTIALS_PROVIDER  (aws_credentials_provider_get_type())
+#define AWS_CREDENTIALS_PROVIDER_ERROR (aws_credentials_provider_error_quark())
+
+G_DECLARE_DERIVABLE_TYPE (AwsCredentialsProvider, aws_credentials_provider, AWS, CREDENTIALS_PROVIDER, GObject)
+
+struct _AwsCredentialsProviderClass
+{
+  GObjectClass parent_class;
+
+  void            (*load_async)  (AwsCredentialsProvider  *self,
+                                  GCancellable            *cancellable,
+                                  GAsyncReadyCallback      callback,
+                                  gpointer                 user_data);
+  AwsCredentials *(*load_finish) (AwsCredentialsProvider  *self,
+                                  GAsyncResult            *result,
+                                  GError                 **error);
+
+  gpointer _reserved1;
+  gpointer _reserved2;
+  gpointer _reserved3;
+  gpointer _reserved4;
+  gpointer _reserved5;
+  gpointer _reserved6;
+  gpointer _reserved7;
+  gpointer _reserved8;
+};
+
+typedef enum
+{
+  AWS_CREDENTIALS_PROVIDER_ERROR_UNAVAILABLE = 1,
+  AWS_CREDENTIALS_PROVIDER_ERROR_INVALID     = 2,
+  AWS_CREDENTIALS_PROVIDER_ERROR_FAILED      = 3,
+} AwsCredentialsProviderError;
+
+GQuark          aws_credentials_provider_error_quark       (void);
+AwsCredentials *aws_credentials_provider_get_credentials   (AwsCredentialsProvider  *self);
+guint           aws_credentials_provider_get_refresh_margin
+                                                           (AwsCredentialsProvider  *self);
+void            aws_credentials_provider_set_refresh_margin
+                                                           (AwsCredentialsProvider  *self,
+                                                            guint                    refresh_margin);
+void            aws_credentials_provider_load_async        (AwsCredentialsProvider  *self,
+                                                            GCancellable            *cancellable,
+                                                            GAsyncReadyCallback      callback,
+                                                            gpointer                 user_data);
+AwsCredentials *aws_credentials_provider_load_finish       (AwsCredentialsProvider  *self,
+                                                            GAsyncResult            *result,
+                                                            GError                 **error);
+void            aws_credentials_provider_refresh_async     (AwsCredentialsProvider  *self,
+                                                            GCancellable            *cancellable,
+                                                            GAsyncReadyCallback      callback,
+                                                            gpointer                 user_data);
+AwsCredentials *aws_credentials_provider_refresh_finish    (AwsCredentialsProvider  *self,
+                                                            GAsyncResult            *result,
+                                                            GError                 **error);
+AwsCredentials *aws_credentials_provider_refresh_sync      (AwsCredentialsProvider  *self,
+                                                            GCancellable            *cancellable,
+                                                            GError                 **error);
+
+G_END_DECLS
+
+#endif /* AWS_CREDENTIALS_PROVIDER_H */
@@ -26,6 +26,8 @@ struct _AwsCredentials
 
   gchar *access_key;
   gchar *secret_key;
+  gchar *session_token;
+  gint64 expiration;
 };
 
 G_DEFINE_TYPE (AwsCredentials, aws_credentials, G_TYPE_OBJECT)
@@ -33,7 +35,9 @@ G_DEFINE_TYPE (AwsCredentials, aws_credentials, G_TYPE_OBJECT)
 enum {
    PROP_0,
    PROP_ACCESS_KEY,
+   PROP_EXPIRATION,
    PROP_SECRET_KEY,
+   PROP_SESSION_TOKEN,
    N_PROPS
 };
 
@@ -62,6 +66,33 @@ aws_credentials_new (const gchar *access_key,
                        NULL);
 }
 
+/**
+ * aws_credentials_new_full:
+ * @access_key: The access key.
+ * @secret_key: The secret key.
+ * @session_token: (nullable): The session token for temporary credentials.
+ * @expiration: When the credentials expire in seconds since the Unix
+ *   epoch, or 0 if they do not expire.
+ *
+ * Creates a new set of credentials, possibly temporary ones such as
+ * those issued by STS.
+ *
+ * Returns: (transfer full): An #AwsCredentials.
+ */
+AwsCredentials *
+aws_credentials_new_full (const gchar *access_key,
+                          const gchar *secret_key,
+                          const gchar *session_token,
+                          gint64       expiration)
+{
+  return g_object_new (AWS_TYPE_CREDENTIALS,
+                       "access-key", access_key,
+                       "secret-key", secret_key,
+                       "session-token", session_token,
+                       "expiration", expiration,
+                       NULL);
+}
+
 const gchar *
 aws_credentials_get_access_key (AwsCredentials *self)
 {
@@ -87,7 +118,7 @@ aws_credentials_set_access_key (AwsCredentials *self,
   if (g_strcmp0 (self->access_key, access_key) != 0)
     {
       str_zero_and_free (self->access_key);
-      self->access_key = g_strdup (self->access_key);
+      self->access_key = g_strdup (access_key);
       g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_ACCESS_KEY]);
     }
 }
@@ -101,11 +132,71 @@ aws_credentials_set_secret_key (AwsCredentials *self,
   if (g_strcmp0 (self->secret_key, secret_key) != 0)
     {
       str_zero_and_free (self->secret_key);
-      self->secret_key = g_strdup (self->secret_key);
+      self->secret_key = g_strdup (secret_key);
       g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_SECRET_KEY]);
     }
 }
 
+const gchar *
+aws_credentials_get_session_token (AwsCredentials *self)
+{
+  g_return_val_if_fail (AWS_IS_CREDENTIALS (self), NULL);
+
+  return self->session_token;
+}
+
+void
+aws_credentials_set_session_token (AwsCredentials *self,
+                                   const gchar    *session_token)
+{
+  g_return_if_fail (AWS_IS_CREDENTIALS (self));
+
+  if (g_strcmp0 (self->session_token, session_token) != 0)
+    {
+      str_zero_and_free (self->session_token);
+      self->session_token = g_strdup (session_token);
+      g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_SESSION_TOKEN]);
+    }
+}
+
+gint64
+aws_credentials_get_expiration (AwsCredentials *self)
+{
+  g_return_val_if_fail (AWS_IS_CREDENTIALS (self), 0);
+
+  return self->expiration;
+}
+
+void
+aws_credentials_set_expiration (AwsCredentials *self,
+                                gint64          expiration)
+{
+  g_return_if_fail (AWS_IS_CREDENTIALS (self));
+  g_return_if_fail (expiration >= 0);
+
+  if (self->expiration != expiration)
+    {
+      self->expiration = expiration;
+      g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_EXPIRATION]);
+    }
+}
+
+/**
+ * aws_credentials_is_expired:
+ * @self: A #AwsCredentials.
+ *
+ * Checks if @self has an expiration that has passed.
+ *
+ * Returns: %TRUE if the credentials may no longer be used.
+ */
+gboolean
+aws_credentials_is_expired (AwsCredentials *self)
+{
+  g_return_val_if_fail (AWS_IS_CREDENTIALS (self), TRUE);
+
+  return self->expiration != 0 && self->expiration <= g_get_real_time () / G_USEC_PER_SEC;
+}
+
 /**
  * aws_credentials_sign:
  * @self: A #AwsCredentials.
@@ -160,6 +251,7 @@ aws_credentials_finalize (GObject *object)
 
   g_clear_pointer (&self->access_key, str_zero_and_free);
   g_clear_pointer (&self->secret_key, str_zero_and_free);
+  g_clear_pointer (&self->session_token, str_zero_and_free);
 
   G_OBJECT_CLASS (aws_credentials_parent_class)->finalize (object);
 }
@@ -178,10 +270,18 @@ aws_credentials_get_property (GObject    *object,
       g_value_set_string (value, aws_credentials_get_access_key (credentials));
       break;
 
+    case PROP_EXPIRATION:
+      g_value_set_int64 (value, aws_credentials_get_expiration (credentials));
+      break;
+
     case PROP_SECRET_KEY:
       g_value_set_string (value, aws_credentials_get_secret_key (credentials));
       break;
 
+    case PROP_SESSION_TOKEN:
+      g_value_set_string (value, aws_credentials_get_session_token (credentials));
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     }
@@ -201,10 +301,18 @@ aws_credentials_set_property (GObject      *object,
       aws_credentials_set_access_key (credentials, g_value_get_string (value));
       break;
 
+    case PROP_EXPIRATION:
+      aws_credentials_set_expiration (credentials, g_value_get_int64 (value));
+      break;
+
     case PROP_SECRET_KEY:
       aws_credentials_set_secret_key (credentials, g_value_get_string (value));
       break;
 
+    case PROP_SESSION_TOKEN:
+      aws_credentials_set_session_token (credentials, g_value_get_string (value));
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     }
@@ -226,6 +334,15 @@ aws_credentials_class_init (AwsCredentialsClass *klass)
                          "",
                          G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
 
+  properties [PROP_EXPIRATION] =
+    g_param_spec_int64 ("expiration",
+                        "Expiration",
+                        "When temporary credentials expire, in seconds since the Unix epoch.",
+                        0,
+                        G_MAXINT64,
+                        0,
+                        G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+
   properties [PROP_SECRET_KEY] =
     g_param_spec_string ("secret-key",
                          "Secret Key",
@@ -233,6 +350,13 @@ aws_credentials_class_init (AwsCredentialsClass *klass)
                          "",
                          G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
 
+  properties [PROP_SESSION_TOKEN] =
+    g_param_spec_string ("session-token",
+                         "Session Token",
+                         "The session token for temporary credentials.",
+                         NULL,
+                         G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (object_class, N_PROPS, properties);
 }
 
@@ -27,18 +27,29 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (AwsCredentials, aws_credentials, AWS, CREDENTIALS, GObject)
 
-AwsCredentials *aws_credentials_new            (const gchar    *access_key,
-                                                const gchar    *secret_key);
-const gchar    *aws_credentials_get_access_key (AwsCredentials *self);
-void            aws_credentials_set_access_key (AwsCredentials *self,
-                                                const gchar    *access_key);
-const gchar    *aws_credentials_get_secret_key (AwsCredentials *self);
-void            aws_credentials_set_secret_key (AwsCredentials *self,
-                                                const gchar    *secret_key);
-gchar          *aws_credentials_sign           (AwsCredentials *self,
-                                                const gchar    *text,
-                                                gssize          text_len,
-                                                GChecksumType   digest_type);
+AwsCredentials *aws_credentials_new               (const gchar    *access_key,
+                                                   const gchar    *secret_key);
+AwsCredentials *aws_credentials_new_full          (const gchar    *access_key,
+                                                   const gchar    *secret_key,
+                                                   const gchar    *session_token,
+                                                   gint64          expiration);
+const gchar    *aws_credentials_get_access_key    (AwsCredentials *self);
+void            aws_credentials_set_access_key    (AwsCredentials *self,
+                                                   const gchar    *access_key);
+gint64          aws_credentials_get_expiration    (AwsCredentials *self);
+void            aws_credentials_set_expiration    (AwsCredentials *self,
+                                                   gint64          expiration);
+const gchar    *aws_credentials_get_secret_key    (AwsCredentials *self);
+void            aws_credentials_set_secret_key    (AwsCredentials *self,
+                                                   const gchar    *secret_key);
+const gchar    *aws_credentials_get_session_token (AwsCredentials *self);
+void            aws_credentials_set_session_token (AwsCredentials *self,
+                                                   const gchar    *session_token);
+gboolean        aws_credentials_is_expired        (AwsCredentials *self);
+gchar          *aws_credentials_sign              (AwsCredentials *self,
+                                                   const gchar    *text,
+                                                   gssize          text_len,
+                                                   GChecksumType   digest_type);
 
 G_END_DECLS
 
@@ -0,0 +1,99 @@
+/* aws-env-credentials-provider.c
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "aws-env-credentials-provider.h"
+
+/*
+ * Reads AWS_ACCESS_KEY_ID, AWS_SECRET_ACCESS_KEY and the optional
+ * AWS_SESSION_TOKEN from the environment.
+ */
+
+struct _AwsEnvCredentialsProvider
+{
+  AwsCredentialsProvider parent_instance;
+};
+
+G_DEFINE_TYPE (AwsEnvCredentialsProvider, aws_env_credentials_provider, AWS_TYPE_CREDENTIALS_PROVIDER)
+
+AwsCredentialsProvider *
+aws_env_credentials_provider_new (void)
+{
+  return g_object_new (AWS_TYPE_ENV_CREDENTIALS_PROVIDER, NULL);
+}
+
+static void
+aws_env_credentials_provider_load_async (AwsCredentialsProvider *provider,
+                                         GCancellable           *cancellable,
+                                         GAsyncReadyCallback     callback,
+                                         gpointer                user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  const gchar *access_key;
+  const gchar *secret_key;
+  const gchar *session_token;
+
+  g_assert (AWS_IS_ENV_CREDENTIALS_PROVIDER (provider));
+
+  task = g_task_new (provider, cancellable, callback, user_data);
+  g_task_set_source_tag (task, aws_env_credentials_provider_load_async);
+
+  access_key = g_getenv ("AWS_ACCESS_KEY_ID");
+  secret_key = g_getenv ("AWS_SECRET_ACCESS_KEY");
+  session_token = g_getenv ("AWS_SESSION_TOKEN");
+
+  if (access_key == NULL || *access_key == '\0' || secret_key == NULL || *secret_key == '\0')
+    {
+      g_task_return_new_error (task,
+                               AWS_CREDENTIALS_PROVIDER_ERROR,
+                               AWS_CREDENTIALS_PROVIDER_ERROR_UNAVAILABLE,
+                               "AWS_ACCESS_KEY_ID and AWS_SECRET_ACCESS_KEY are not set");
+      return;
+    }
+
+  if (session_token != NULL && *session_token == '\0')
+    session_token = NULL;
+
+  g_task_return_pointer (task,
+                         aws_credentials_new_full (access_key, secret_key, session_token, 0),
+                         g_object_unref);
+}
+
+static AwsCredentials *
+aws_env_credentials_provider_load_finish (AwsCredentialsProvider  *provider,
+                                          GAsyncResult            *result,
+                                          GError                 **error)
+{
+  g_assert (AWS_IS_ENV_CREDENTIALS_PROVIDER (provider));
+  g_assert (G_IS_TASK (result));
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+static void
+aws_env_credentials_provider_class_init (AwsEnvCredentialsProviderClass *klass)
+{
+  AwsCredentialsProviderClass *provider_class = AWS_CREDENTIALS_PROVIDER_CLASS (klass);
+
+  provider_class->load_async = aws_env_credentials_provider_load_async;
+  provider_class->load_finish = aws_env_credentials_provider_load_finish;
+}
+
+static void
+aws_env_credentials_provider_init (AwsEnvCredentialsProvider *self)
+{
+}
@@ -0,0 +1,397 @@
+/* aws-event-stream.c
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gio/gio.h>
+#include <string.h>
+
+#include "aws-event-stream.h"
+
+/*
+ * Decoder for the application/vnd.amazon.eventstream framing used by
+ * S3 Select. Each message looks like:
+ *
+ *   total length (4) | headers length (4) | prelude CRC (4)
+ *   headers ...
+ *   payload ...
+ *   message CRC (4)
+ *
+ * All integers are big-endian and both CRCs are CRC-32 (IEEE).
+ */
+
+#define PRELUDE_LEN     12
+#define MIN_MESSAGE_LEN (PRELUDE_LEN + 4)
+#define MAX_MESSAGE_LEN (16 * 1024 * 1024)
+
+enum {
+  HEADER_BOOL_TRUE  = 0,
+  HEADER_BOOL_FALSE = 1,
+  HEADER_BYTE       = 2,
+  HEADER_INT16      = 3,
+  HEADER_INT32      = 4,
+  HEADER_INT64      = 5,
+  HEADER_BYTES      = 6,
+  HEADER_STRING     = 7,
+  HEADER_TIMESTAMP  = 8,
+  HEADER_UUID       = 9,
+};
+
+struct _AwsEventStreamDecoder
+{
+  AwsEventStreamFunc  func;
+  gpointer            user_data;
+
+  /* A message split across chunks is collected here */
+  GByteArray         *buffer;
+
+  /* Scratch space for the headers of the current message */
+  GString            *message_type;
+  GString            *event_type;
+  GString            *error_code;
+  GString            *error_message;
+};
+
+static guint32 crc_table [256];
+
+static void
+crc_table_init (void)
+{
+  static gsize initialized;
+
+  if (g_once_init_enter (&initialized))
+    {
+      guint32 i;
+
+      for (i = 0; i < 256; i++)
+        {
+          guint32 c = i;
+          guint k;
+
+          for (k = 0; k < 8; k++)
+            c = (c & 1) ? (0xEDB88320U ^ (c >> 1)) : (c >> 1);
+
+          crc_table [i] = c;
+        }
+
+      g_once_init_leave (&initialized, TRUE);
+    }
+}
+
+static guint32
+crc32_ieee (const guint8 *data,
+            gsize         len)
+{
+  guint32 c = 0xFFFFFFFFU;
+  gsize i;
+
+  for (i = 0; i < len; i++)
+    c = crc_table [(c ^ data [i]) & 0xFF] ^ (c >> 8);
+
+  return c ^ 0xFFFFFFFFU;
+}
+
+static inline guint32
+read_be32 (const guint8 *data)
+{
+  return ((guint32)data [0] << 24) |
+         ((guint32)data [1] << 16) |
+         ((guint32)data [2] << 8) |
+         (guint32)data [3];
+}
+
+static inline guint16
+read_be16 (const guint8 *data)
+{
+  return (guint16)(((guint16)data [0] << 8) | data [1]);
+}
+
+AwsEventStreamDecoder *
+aws_event_stream_decoder_new (AwsEventStreamFunc func,
+                              gpointer           user_data)
+{
+  AwsEventStreamDecoder *self;
+
+  g_return_val_if_fail (func != NULL, NULL);
+
+  crc_table_init ();
+
+  self = g_slice_new0 (AwsEventStreamDecoder);
+  self->func = func;
+  self->user_data = user_data;
+  self->buffer = g_byte_array_new ();
+  self->message_type = g_string_new (NULL);
+  self->event_type = g_string_new (NULL);
+  self->error_code = g_string_new (NULL);
+  self->error_message = g_string_new (NULL);
+
+  return self;
+}
+
+void
+aws_event_stream_decoder_free (AwsEventStreamDecoder *self)
+{
+  if (self != NULL)
+    {
+      g_byte_array_unref (self->buffer);
+      g_string_free (self->message_type, TRUE);
+      g_string_free (self->event_type, TRUE);
+      g_string_free (self->error_code, TRUE);
+      g_string_free (self->error_message, TRUE);
+      g_slice_free (AwsEventStreamDecoder, self);
+    }
+}
+
+static gboolean
+set_invalid (GError      **error,
+             const gchar  *reason)
+{
+  g_set_error (error,
+               G_IO_ERROR,
+               G_IO_ERROR_INVALID_DATA,
+               "Invalid event stream: %s",
+               reason);
+  return FALSE;
+}
+
+static gboolean
+aws_event_stream_decoder_parse_headers (AwsEventStreamDecoder  *self,
+                                        const guint8           *data,
+                                        gsize                   len,
+                                        GError                **error)
+{
+  const guint8 *end = data + len;
+
+  g_string_truncate (self->message_type, 0);
+  g_string_truncate (self->event_type, 0);
+  g_string_truncate (self->error_code, 0);
+  g_string_truncate (self->error_message, 0);
+
+  while (data < end)
+    {
+      const guint8 *name;
+      GString *target = NULL;
+      guint8 name_len;
+      guint8 type;
+      gsize value_len;
+
+      name_len = *data++;
+      if ((gsize)(end - data) < (gsize)name_len + 1)
+        return set_invalid (error, "truncated header name");
+
+      name = data;
+      data += name_len;
+      type = *data++;
+
+      switch (type)
+        {
+        case HEADER_BOOL_TRUE:
+        case HEADER_BOOL_FALSE:
+          value_len = 0;
+          break;
+
+        case HEADER_BYTE:
+          value_len = 1;
+          break;
+
+        case HEADER_INT16:
+          value_len = 2;
+          break;
+
+        case HEADER_INT32:
+          value_len = 4;
+          break;
+
+        case HEADER_INT64:
+        case HEADER_TIMESTAMP:
+          value_len = 8;
+          break;
+
+        case HEADER_UUID:
+          value_len = 16;
+          break;
+
+        case HEADER_BYTES:
+        case HEADER_STRING:
+          if (end - data < 2)
+            return set_invalid (error, "truncated header value");
+          value_len = read_be16 (data);
+          data += 2;
+          break;
+
+        default:
+          return set_invalid (error, "unknown header type");
+        }
+
+      if ((gsize)(end - data) < value_len)
+        return set_invalid (error, "truncated header value");
+
+      if (type == HEADER_STRING)
+        {
+#define NAME_IS(s) (name_len == strlen (s) && memcmp (name, s, name_len) == 0)
+          if (NAME_IS (":message-type"))
+            target = self->message_type;
+          else if (NAME_IS (":event-type"))
+            target = self->event_type;
+          else if (NAME_IS (":error-code"))
+            target = self->error_code;
+          else if (NAME_IS (":error-message"))
+            target = self->error_message;
+#undef NAME_IS
+
+          if (target != NULL)
+            g_string_append_len (target, (const gchar *)data, value_len);
+        }
+
+      data += value_len;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+aws_event_stream_decoder_parse (AwsEventStreamDecoder  *self,
+                                const guint8           *data,
+                                gsize                   len,
+                                GError                **error)
+{
+  AwsEventStreamMessage message = { 0 };
+  guint32 headers_len;
+
+  g_assert (len >= MIN_MESSAGE_LEN);
+  g_assert (read_be32 (data) == len);
+
+  if (crc32_ieee (data, 8) != read_be32 (data + 8))
+    return set_invalid (error, "prelude checksum mismatch");
+
+  if (crc32_ieee (data, len - 4) != read_be32 (data + len - 4))
+    return set_invalid (error, "message checksum mismatch");
+
+  headers_len = read_be32 (data + 4);
+  if (headers_len > len - MIN_MESSAGE_LEN)
+    return set_invalid (error, "headers exceed message length");
+
+  if (!aws_event_stream_decoder_parse_headers (self, data + PRELUDE_LEN, headers_len, error))
+    return FALSE;
+
+  message.message_type = self->message_type->str;
+  message.event_type = self->event_type->str;
+  message.error_code = self->error_code->str;
+  message.error_message = self->error_message->str;
+  message.payload = data + PRELUDE_LEN + headers_len;
+  message.payload_len = len - MIN_MESSAGE_LEN - headers_len;
+
+  return self->func (&message, self->user_data, error);
+}
+
+static gboolean
+check_total_len (guint32   total_len,
+                 GError  **error)
+{
+  if (total_len < MIN_MESSAGE_LEN || total_len > MAX_MESSAGE_LEN)
+    return set_invalid (error, "bad message length");
+  return TRUE;
+}
+
+/*
+ * Decodes as many messages as possible from @data, invoking the message
+ * callback for each. Messages that are wholly contained within @data are
+ * decoded in place; only a message straddling chunks is copied. Returns
+ * %FALSE if the stream is corrupt or the callback failed.
+ */
+gboolean
+aws_event_stream_decoder_feed (AwsEventStreamDecoder  *self,
+                               const guint8           *data,
+                               gsize                   len,
+                               GError                **error)
+{
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (data != NULL || len == 0, FALSE);
+
+  /*
+   * Complete any message left over from the previous chunk.
+   */
+  while (self->buffer->len > 0 && len > 0)
+    {
+      gsize want;
+
+      if (self->buffer->len < PRELUDE_LEN)
+        want = PRELUDE_LEN - self->buffer->len;
+      else
+        want = read_be32 (self->buffer->data) - self->buffer->len;
+
+      want = MIN (want, len);
+      g_byte_array_append (self->buffer, data, want);
+      data += want;
+      len -= want;
+
+      if (self->buffer->len >= PRELUDE_LEN)
+        {
+          guint32 total_len = read_be32 (self->buffer->data);
+
+          if (!check_total_len (total_len, error))
+            return FALSE;
+
+          if (self->buffer->len == total_len)
+            {
+              gboolean ret;
+
+              ret = aws_event_stream_decoder_parse (self, self->buffer->data, total_len, error);
+              g_byte_array_set_size (self->buffer, 0);
+
+              if (!ret)
+                return FALSE;
+            }
+        }
+    }
+
+  /*
+   * Decode complete messages directly from @data.
+   */
+  while (len >= PRELUDE_LEN)
+    {
+      guint32 total_len = read_be32 (data);
+
+      if (!check_total_len (total_len, error))
+        return FALSE;
+
+      if (total_len > len)
+        break;
+
+      if (!aws_event_stream_decoder_parse (self, data, total_len, error))
+        return FALSE;
+
+      data += total_len;
+      len -= total_len;
+    }
+
+  if (len > 0)
+    g_byte_array_append (self->buffer, data, len);
+
+  return TRUE;
+}
+
+/*
+ * Checks that no partial message is pending, which should be the case
+ * once the stream has ended.
+ */
+gboolean
+aws_event_stream_decoder_is_idle (AwsEventStreamDecoder *self)
+{
+  g_return_val_if_fail (self != NULL, FALSE);
+
+  return self->buffer->len == 0;
+}
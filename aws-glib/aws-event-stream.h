@@ -0,0 +1,53 @@
+/* aws-event-stream.h
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AWS_EVENT_STREAM_H
+#define AWS_EVENT_STREAM_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _AwsEventStreamDecoder AwsEventStreamDecoder;
+
+typedef struct
+{
+  const gchar  *message_type;
+  const gchar  *event_type;
+  const gchar  *error_code;
+  const gchar  *error_message;
+  const guint8 *payload;
+  gsize         payload_len;
+} AwsEventStreamMessage;
+
+typedef gboolean (*AwsEventStreamFunc) (const AwsEventStreamMessage  *message,
+                                        gpointer                      user_data,
+                                        GError                      **error);
+
+AwsEventStreamDecoder *aws_event_stream_decoder_new     (AwsEventStreamFunc      func,
+                                                         gpointer                user_data);
+void                   aws_event_stream_decoder_free    (AwsEventStreamDecoder  *self);
+gboolean               aws_event_stream_decoder_feed    (AwsEventStreamDecoder  *self,
+                                                         const guint8           *data,
+                                                         gsize                   len,
+                                                         GError                **error);
+gboolean               aws_event_stream_decoder_is_idle (AwsEventStreamDecoder  *self);
+
+G_END_DECLS
+
+#endif /* AWS_EVENT_STREAM_H */
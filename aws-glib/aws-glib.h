@@ -19,6 +19,19 @@
 #ifndef AWS_GLIB_H
 #define AWS_GLIB_H
 
+#include "aws-credentials.h"
+#include "aws-credentials-provider.h"
+#include "aws-credentials-provider-chain.h"
+#include "aws-env-credentials-provider.h"
+#include "aws-metadata-credentials-provider.h"
+#include "aws-profile-credentials-provider.h"
 #include "aws-s3-client.h"
+#include "aws-s3-client-pool.h"
+#include "aws-s3-file.h"
+#include "aws-s3-listing-index.h"
+#include "aws-s3-object-info.h"
+#include "aws-s3-pack-reader.h"
+#include "aws-s3-pack-writer.h"
+#include "aws-web-identity-credentials-provider.h"
 
 #endif /* AWS_GLIB_H */
@@ -0,0 +1,423 @@
+/* aws-metadata-credentials-provider.c
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <json-glib/json-glib.h>
+#include <libsoup/soup.h>
+#include <string.h>
+
+#include "aws-credentials-provider-private.h"
+#include "aws-metadata-credentials-provider.h"
+
+/*
+ * Fetches role credentials from the container credentials endpoint when
+ * running under ECS (AWS_CONTAINER_CREDENTIALS_RELATIVE_URI or
+ * AWS_CONTAINER_CREDENTIALS_FULL_URI), or otherwise from the EC2 instance
+ * metadata service using an IMDSv2 session token.
+ */
+
+#define DEFAULT_ENDPOINT     "http://169.254.169.254"
+#define CONTAINER_ENDPOINT   "http://169.254.170.2"
+#define IMDS_TOKEN_TTL       "21600"
+#define IMDS_CREDENTIALS_URI "/latest/meta-data/iam/security-credentials/"
+
+struct _AwsMetadataCredentialsProvider
+{
+  AwsCredentialsProvider  parent_instance;
+
+  SoupSession            *session;
+  gchar                  *endpoint;
+};
+
+G_DEFINE_TYPE (AwsMetadataCredentialsProvider, aws_metadata_credentials_provider, AWS_TYPE_CREDENTIALS_PROVIDER)
+
+enum {
+  PROP_0,
+  PROP_ENDPOINT,
+  N_PROPS
+};
+
+static GParamSpec *properties [N_PROPS];
+
+AwsCredentialsProvider *
+aws_metadata_credentials_provider_new (void)
+{
+  return g_object_new (AWS_TYPE_METADATA_CREDENTIALS_PROVIDER, NULL);
+}
+
+const gchar *
+aws_metadata_credentials_provider_get_endpoint (AwsMetadataCredentialsProvider *self)
+{
+  g_return_val_if_fail (AWS_IS_METADATA_CREDENTIALS_PROVIDER (self), NULL);
+
+  return self->endpoint;
+}
+
+/**
+ * aws_metadata_credentials_provider_set_endpoint:
+ * @self: An #AwsMetadataCredentialsProvider.
+ * @endpoint: (nullable): The base URI of the instance metadata service.
+ *
+ * Sets the instance metadata service to use. If %NULL,
+ * AWS_EC2_METADATA_SERVICE_ENDPOINT is used when set, otherwise the
+ * link-local address of the service.
+ */
+void
+aws_metadata_credentials_provider_set_endpoint (AwsMetadataCredentialsProvider *self,
+                                                const gchar                    *endpoint)
+{
+  g_return_if_fail (AWS_IS_METADATA_CREDENTIALS_PROVIDER (self));
+
+  if (endpoint == NULL && !(endpoint = g_getenv ("AWS_EC2_METADATA_SERVICE_ENDPOINT")))
+    endpoint = DEFAULT_ENDPOINT;
+
+  if (g_strcmp0 (self->endpoint, endpoint) != 0)
+    {
+      g_free (self->endpoint);
+      self->endpoint = g_strdup (endpoint);
+      g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_ENDPOINT]);
+    }
+}
+
+/*
+ * Sends a request to the metadata service and returns the body. Failing to
+ * reach the service at all means we are not on AWS infrastructure, which is
+ * reported as unavailable so that a chain moves on.
+ */
+static gchar *
+aws_metadata_credentials_provider_fetch (AwsMetadataCredentialsProvider  *self,
+                                         const gchar                     *method,
+                                         const gchar                     *uri,
+                                         const gchar                     *header,
+                                         const gchar                     *value,
+                                         GError                         **error)
+{
+  g_autoptr(SoupMessage) message = NULL;
+  guint status;
+
+  g_assert (AWS_IS_METADATA_CREDENTIALS_PROVIDER (self));
+
+  if (!(message = soup_message_new (method, uri)))
+    {
+      g_set_error (error,
+                   AWS_CREDENTIALS_PROVIDER_ERROR,
+                   AWS_CREDENTIALS_PROVIDER_ERROR_FAILED,
+                   "Invalid metadata URI \"%s\"",
+                   uri);
+      return NULL;
+    }
+
+  if (header != NULL)
+    soup_message_headers_replace (message->request_headers, header, value);
+
+  status = soup_session_send_message (self->session, message);
+
+  if (SOUP_STATUS_IS_TRANSPORT_ERROR (status))
+    {
+      g_set_error (error,
+                   AWS_CREDENTIALS_PROVIDER_ERROR,
+                   AWS_CREDENTIALS_PROVIDER_ERROR_UNAVAILABLE,
+                   "The metadata service is unavailable: %s",
+                   soup_status_get_phrase (status));
+      return NULL;
+    }
+
+  if (!SOUP_STATUS_IS_SUCCESSFUL (status))
+    {
+      g_set_error (error,
+                   AWS_CREDENTIALS_PROVIDER_ERROR,
+                   AWS_CREDENTIALS_PROVIDER_ERROR_FAILED,
+                   "Metadata request failed: %u",
+                   status);
+      return NULL;
+    }
+
+  return g_strndup (message->response_body->data, message->response_body->length);
+}
+
+static AwsCredentials *
+parse_credentials (const gchar  *json,
+                   GError      **error)
+{
+  g_autoptr(JsonParser) parser = NULL;
+  JsonObject *object;
+  const gchar *code;
+
+  parser = json_parser_new ();
+
+  if (!json_parser_load_from_data (parser, json, -1, error))
+    return NULL;
+
+  if (!JSON_NODE_HOLDS_OBJECT (json_parser_get_root (parser)))
+    goto invalid;
+
+  object = json_node_get_object (json_parser_get_root (parser));
+
+  /* The instance metadata service includes a status, containers do not */
+  if (json_object_has_member (object, "Code") &&
+      (code = json_object_get_string_member (object, "Code")) &&
+      g_strcmp0 (code, "Success") != 0)
+    {
+      g_set_error (error,
+                   AWS_CREDENTIALS_PROVIDER_ERROR,
+                   AWS_CREDENTIALS_PROVIDER_ERROR_FAILED,
+                   "The metadata service returned %s",
+                   code);
+      return NULL;
+    }
+
+  if (!json_object_has_member (object, "AccessKeyId") ||
+      !json_object_has_member (object, "SecretAccessKey"))
+    goto invalid;
+
+  return aws_credentials_new_full (json_object_get_string_member (object, "AccessKeyId"),
+                                   json_object_get_string_member (object, "SecretAccessKey"),
+                                   json_object_has_member (object, "Token")
+                                     ? json_object_get_string_member (object, "Token")
+                                     : NULL,
+                                   json_object_has_member (object, "Expiration")
+                                     ? aws_credentials_provider_parse_expiration (
+                                         json_object_get_string_member (object, "Expiration"))
+                                     : 0);
+
+invalid:
+  g_set_error (error,
+               AWS_CREDENTIALS_PROVIDER_ERROR,
+               AWS_CREDENTIALS_PROVIDER_ERROR_INVALID,
+               "The metadata service did not return credentials");
+  return NULL;
+}
+
+static gchar *
+aws_metadata_credentials_provider_fetch_container (AwsMetadataCredentialsProvider  *self,
+                                                   GError                         **error)
+{
+  g_autofree gchar *uri = NULL;
+  const gchar *relative_uri;
+  const gchar *full_uri;
+  const gchar *token;
+
+  g_assert (AWS_IS_METADATA_CREDENTIALS_PROVIDER (self));
+
+  relative_uri = g_getenv ("AWS_CONTAINER_CREDENTIALS_RELATIVE_URI");
+  full_uri = g_getenv ("AWS_CONTAINER_CREDENTIALS_FULL_URI");
+  token = g_getenv ("AWS_CONTAINER_AUTHORIZATION_TOKEN");
+
+  if (relative_uri != NULL && *relative_uri)
+    uri = g_strconcat (CONTAINER_ENDPOINT, relative_uri, NULL);
+  else
+    uri = g_strdup (full_uri);
+
+  return aws_metadata_credentials_provider_fetch (self,
+                                                  SOUP_METHOD_GET,
+                                                  uri,
+                                                  token ? "Authorization" : NULL,
+                                                  token,
+                                                  error);
+}
+
+static gchar *
+aws_metadata_credentials_provider_fetch_instance (AwsMetadataCredentialsProvider  *self,
+                                                  const gchar                     *endpoint,
+                                                  GError                         **error)
+{
+  g_autofree gchar *uri = NULL;
+  g_autofree gchar *token = NULL;
+  g_autofree gchar *roles = NULL;
+
+  g_assert (AWS_IS_METADATA_CREDENTIALS_PROVIDER (self));
+  g_assert (endpoint != NULL);
+
+  uri = g_strconcat (endpoint, "/latest/api/token", NULL);
+  token = aws_metadata_credentials_provider_fetch (self,
+                                                   SOUP_METHOD_PUT,
+                                                   uri,
+                                                   "X-aws-ec2-metadata-token-ttl-seconds",
+                                                   IMDS_TOKEN_TTL,
+                                                   error);
+  if (token == NULL)
+    return NULL;
+
+  g_free (uri);
+  uri = g_strconcat (endpoint, IMDS_CREDENTIALS_URI, NULL);
+  roles = aws_metadata_credentials_provider_fetch (self,
+                                                   SOUP_METHOD_GET,
+                                                   uri,
+                                                   "X-aws-ec2-metadata-token",
+                                                   token,
+                                                   error);
+  if (roles == NULL)
+    return NULL;
+
+  /* Only a single role may be attached to an instance profile */
+  roles [strcspn (roles, "\r\n")] = '\0';
+
+  if (*roles == '\0')
+    {
+      g_set_error (error,
+                   AWS_CREDENTIALS_PROVIDER_ERROR,
+                   AWS_CREDENTIALS_PROVIDER_ERROR_UNAVAILABLE,
+                   "No role is attached to this instance");
+      return NULL;
+    }
+
+  g_free (uri);
+  uri = g_strconcat (endpoint, IMDS_CREDENTIALS_URI, roles, NULL);
+
+  return aws_metadata_credentials_provider_fetch (self,
+                                                  SOUP_METHOD_GET,
+                                                  uri,
+                                                  "X-aws-ec2-metadata-token",
+                                                  token,
+                                                  error);
+}
+
+static void
+aws_metadata_credentials_provider_load_worker (GTask        *task,
+                                               gpointer      source_object,
+                                               gpointer      task_data,
+                                               GCancellable *cancellable)
+{
+  AwsMetadataCredentialsProvider *self = source_object;
+  const gchar *endpoint = task_data;
+  g_autofree gchar *json = NULL;
+  AwsCredentials *credentials;
+  GError *error = NULL;
+
+  g_assert (AWS_IS_METADATA_CREDENTIALS_PROVIDER (self));
+  g_assert (endpoint != NULL);
+
+  if (g_getenv ("AWS_CONTAINER_CREDENTIALS_RELATIVE_URI") ||
+      g_getenv ("AWS_CONTAINER_CREDENTIALS_FULL_URI"))
+    json = aws_metadata_credentials_provider_fetch_container (self, &error);
+  else
+    json = aws_metadata_credentials_provider_fetch_instance (self, endpoint, &error);
+
+  if (json == NULL || !(credentials = parse_credentials (json, &error)))
+    g_task_return_error (task, error);
+  else
+    g_task_return_pointer (task, credentials, g_object_unref);
+}
+
+static void
+aws_metadata_credentials_provider_load_async (AwsCredentialsProvider *provider,
+                                              GCancellable           *cancellable,
+                                              GAsyncReadyCallback     callback,
+                                              gpointer                user_data)
+{
+  AwsMetadataCredentialsProvider *self = (AwsMetadataCredentialsProvider *)provider;
+  g_autoptr(GTask) task = NULL;
+
+  g_assert (AWS_IS_METADATA_CREDENTIALS_PROVIDER (self));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, aws_metadata_credentials_provider_load_async);
+  g_task_set_task_data (task, g_strdup (self->endpoint), g_free);
+  g_task_run_in_thread (task, aws_metadata_credentials_provider_load_worker);
+}
+
+static AwsCredentials *
+aws_metadata_credentials_provider_load_finish (AwsCredentialsProvider  *provider,
+                                               GAsyncResult            *result,
+                                               GError                 **error)
+{
+  g_assert (AWS_IS_METADATA_CREDENTIALS_PROVIDER (provider));
+  g_assert (G_IS_TASK (result));
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+static void
+aws_metadata_credentials_provider_finalize (GObject *object)
+{
+  AwsMetadataCredentialsProvider *self = (AwsMetadataCredentialsProvider *)object;
+
+  g_clear_object (&self->session);
+  g_clear_pointer (&self->endpoint, g_free);
+
+  G_OBJECT_CLASS (aws_metadata_credentials_provider_parent_class)->finalize (object);
+}
+
+static void
+aws_metadata_credentials_provider_get_property (GObject    *object,
+                                                guint       prop_id,
+                                                GValue     *value,
+                                                GParamSpec *pspec)
+{
+  AwsMetadataCredentialsProvider *self = AWS_METADATA_CREDENTIALS_PROVIDER (object);
+
+  switch (prop_id)
+    {
+    case PROP_ENDPOINT:
+      g_value_set_string (value, aws_metadata_credentials_provider_get_endpoint (self));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+aws_metadata_credentials_provider_set_property (GObject      *object,
+                                                guint         prop_id,
+                                                const GValue *value,
+                                                GParamSpec   *pspec)
+{
+  AwsMetadataCredentialsProvider *self = AWS_METADATA_CREDENTIALS_PROVIDER (object);
+
+  switch (prop_id)
+    {
+    case PROP_ENDPOINT:
+      aws_metadata_credentials_provider_set_endpoint (self, g_value_get_string (value));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+aws_metadata_credentials_provider_class_init (AwsMetadataCredentialsProviderClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  AwsCredentialsProviderClass *provider_class = AWS_CREDENTIALS_PROVIDER_CLASS (klass);
+
+  object_class->finalize = aws_metadata_credentials_provider_finalize;
+  object_class->get_property = aws_metadata_credentials_provider_get_property;
+  object_class->set_property = aws_metadata_credentials_provider_set_property;
+
+  provider_class->load_async = aws_metadata_credentials_provider_load_async;
+  provider_class->load_finish = aws_metadata_credentials_provider_load_finish;
+
+  properties [PROP_ENDPOINT] =
+    g_param_spec_string ("endpoint",
+                         "Endpoint",
+                         "The base URI of the instance metadata service.",
+                         NULL,
+                         G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties (object_class, N_PROPS, properties);
+}
+
+static void
+aws_metadata_credentials_provider_init (AwsMetadataCredentialsProvider *self)
+{
+  /* The metadata services are link-local and must never be proxied */
+  self->session = soup_session_new_with_options (SOUP_SESSION_TIMEOUT, 2,
+                                                 SOUP_SESSION_PROXY_RESOLVER, NULL,
+                                                 NULL);
+}
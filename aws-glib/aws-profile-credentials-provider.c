@@ -0,0 +1,284 @@
+/* aws-profile-credentials-provider.c
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "aws-profile-credentials-provider.h"
+
+/*
+ * Reads a profile from the shared credentials file used by the AWS
+ * command line tools, ~/.aws/credentials by default.
+ */
+
+struct _AwsProfileCredentialsProvider
+{
+  AwsCredentialsProvider parent_instance;
+
+  gchar *path;
+  gchar *profile;
+};
+
+G_DEFINE_TYPE (AwsProfileCredentialsProvider, aws_profile_credentials_provider, AWS_TYPE_CREDENTIALS_PROVIDER)
+
+enum {
+  PROP_0,
+  PROP_PATH,
+  PROP_PROFILE,
+  N_PROPS
+};
+
+static GParamSpec *properties [N_PROPS];
+
+/**
+ * aws_profile_credentials_provider_new:
+ * @path: (nullable): The credentials file, or %NULL for the default.
+ * @profile: (nullable): The profile name, or %NULL for the default.
+ *
+ * Creates a provider reading @profile from @path. The defaults follow
+ * AWS_SHARED_CREDENTIALS_FILE and AWS_PROFILE, falling back to the
+ * "default" profile of ~/.aws/credentials.
+ *
+ * Returns: (transfer full): An #AwsCredentialsProvider.
+ */
+AwsCredentialsProvider *
+aws_profile_credentials_provider_new (const gchar *path,
+                                      const gchar *profile)
+{
+  return g_object_new (AWS_TYPE_PROFILE_CREDENTIALS_PROVIDER,
+                       "path", path,
+                       "profile", profile,
+                       NULL);
+}
+
+const gchar *
+aws_profile_credentials_provider_get_path (AwsProfileCredentialsProvider *self)
+{
+  g_return_val_if_fail (AWS_IS_PROFILE_CREDENTIALS_PROVIDER (self), NULL);
+
+  return self->path;
+}
+
+const gchar *
+aws_profile_credentials_provider_get_profile (AwsProfileCredentialsProvider *self)
+{
+  g_return_val_if_fail (AWS_IS_PROFILE_CREDENTIALS_PROVIDER (self), NULL);
+
+  return self->profile;
+}
+
+static void
+aws_profile_credentials_provider_load_worker (GTask        *task,
+                                              gpointer      source_object,
+                                              gpointer      task_data,
+                                              GCancellable *cancellable)
+{
+  AwsProfileCredentialsProvider *self = source_object;
+  g_autoptr(GKeyFile) key_file = NULL;
+  g_autofree gchar *access_key = NULL;
+  g_autofree gchar *secret_key = NULL;
+  g_autofree gchar *session_token = NULL;
+  GError *error = NULL;
+
+  g_assert (AWS_IS_PROFILE_CREDENTIALS_PROVIDER (self));
+
+  key_file = g_key_file_new ();
+
+  if (!g_key_file_load_from_file (key_file, self->path, G_KEY_FILE_NONE, &error))
+    {
+      g_task_return_new_error (task,
+                               AWS_CREDENTIALS_PROVIDER_ERROR,
+                               AWS_CREDENTIALS_PROVIDER_ERROR_UNAVAILABLE,
+                               "Failed to load %s: %s",
+                               self->path,
+                               error->message);
+      g_clear_error (&error);
+      return;
+    }
+
+  if (!g_key_file_has_group (key_file, self->profile))
+    {
+      g_task_return_new_error (task,
+                               AWS_CREDENTIALS_PROVIDER_ERROR,
+                               AWS_CREDENTIALS_PROVIDER_ERROR_UNAVAILABLE,
+                               "No profile named \"%s\" in %s",
+                               self->profile,
+                               self->path);
+      return;
+    }
+
+  access_key = g_key_file_get_string (key_file, self->profile, "aws_access_key_id", NULL);
+  secret_key = g_key_file_get_string (key_file, self->profile, "aws_secret_access_key", NULL);
+  session_token = g_key_file_get_string (key_file, self->profile, "aws_session_token", NULL);
+
+  if (access_key == NULL || secret_key == NULL)
+    {
+      g_task_return_new_error (task,
+                               AWS_CREDENTIALS_PROVIDER_ERROR,
+                               AWS_CREDENTIALS_PROVIDER_ERROR_INVALID,
+                               "Profile \"%s\" in %s is missing its keys",
+                               self->profile,
+                               self->path);
+      return;
+    }
+
+  g_task_return_pointer (task,
+                         aws_credentials_new_full (access_key, secret_key, session_token, 0),
+                         g_object_unref);
+}
+
+static void
+aws_profile_credentials_provider_load_async (AwsCredentialsProvider *provider,
+                                             GCancellable           *cancellable,
+                                             GAsyncReadyCallback     callback,
+                                             gpointer                user_data)
+{
+  g_autoptr(GTask) task = NULL;
+
+  g_assert (AWS_IS_PROFILE_CREDENTIALS_PROVIDER (provider));
+
+  task = g_task_new (provider, cancellable, callback, user_data);
+  g_task_set_source_tag (task, aws_profile_credentials_provider_load_async);
+  g_task_run_in_thread (task, aws_profile_credentials_provider_load_worker);
+}
+
+static AwsCredentials *
+aws_profile_credentials_provider_load_finish (AwsCredentialsProvider  *provider,
+                                              GAsyncResult            *result,
+                                              GError                 **error)
+{
+  g_assert (AWS_IS_PROFILE_CREDENTIALS_PROVIDER (provider));
+  g_assert (G_IS_TASK (result));
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+static void
+aws_profile_credentials_provider_constructed (GObject *object)
+{
+  AwsProfileCredentialsProvider *self = (AwsProfileCredentialsProvider *)object;
+  const gchar *env;
+
+  G_OBJECT_CLASS (aws_profile_credentials_provider_parent_class)->constructed (object);
+
+  if (self->path == NULL)
+    {
+      if ((env = g_getenv ("AWS_SHARED_CREDENTIALS_FILE")) && *env)
+        self->path = g_strdup (env);
+      else
+        self->path = g_build_filename (g_get_home_dir (), ".aws", "credentials", NULL);
+    }
+
+  if (self->profile == NULL)
+    {
+      if ((env = g_getenv ("AWS_PROFILE")) && *env)
+        self->profile = g_strdup (env);
+      else
+        self->profile = g_strdup ("default");
+    }
+}
+
+static void
+aws_profile_credentials_provider_finalize (GObject *object)
+{
+  AwsProfileCredentialsProvider *self = (AwsProfileCredentialsProvider *)object;
+
+  g_clear_pointer (&self->path, g_free);
+  g_clear_pointer (&self->profile, g_free);
+
+  G_OBJECT_CLASS (aws_profile_credentials_provider_parent_class)->finalize (object);
+}
+
+static void
+aws_profile_credentials_provider_get_property (GObject    *object,
+                                               guint       prop_id,
+                                               GValue     *value,
+                                               GParamSpec *pspec)
+{
+  AwsProfileCredentialsProvider *self = AWS_PROFILE_CREDENTIALS_PROVIDER (object);
+
+  switch (prop_id)
+    {
+    case PROP_PATH:
+      g_value_set_string (value, aws_profile_credentials_provider_get_path (self));
+      break;
+
+    case PROP_PROFILE:
+      g_value_set_string (value, aws_profile_credentials_provider_get_profile (self));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+aws_profile_credentials_provider_set_property (GObject      *object,
+                                               guint         prop_id,
+                                               const GValue *value,
+                                               GParamSpec   *pspec)
+{
+  AwsProfileCredentialsProvider *self = AWS_PROFILE_CREDENTIALS_PROVIDER (object);
+
+  switch (prop_id)
+    {
+    case PROP_PATH:
+      self->path = g_value_dup_string (value);
+      break;
+
+    case PROP_PROFILE:
+      self->profile = g_value_dup_string (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+aws_profile_credentials_provider_class_init (AwsProfileCredentialsProviderClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  AwsCredentialsProviderClass *provider_class = AWS_CREDENTIALS_PROVIDER_CLASS (klass);
+
+  object_class->constructed = aws_profile_credentials_provider_constructed;
+  object_class->finalize = aws_profile_credentials_provider_finalize;
+  object_class->get_property = aws_profile_credentials_provider_get_property;
+  object_class->set_property = aws_profile_credentials_provider_set_property;
+
+  provider_class->load_async = aws_profile_credentials_provider_load_async;
+  provider_class->load_finish = aws_profile_credentials_provider_load_finish;
+
+  properties [PROP_PATH] =
+    g_param_spec_string ("path",
+                         "Path",
+                         "The path of the shared credentials file.",
+                         NULL,
+                         G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+  properties [PROP_PROFILE] =
+    g_param_spec_string ("profile",
+                         "Profile",
+                         "The name of the profile to read.",
+                         NULL,
+                         G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties (object_class, N_PROPS, properties);
+}
+
+static void
+aws_profile_credentials_provider_init (AwsProfileCredentialsProvider *self)
+{
+}
@@ -0,0 +1,37 @@
+/* aws-profile-credentials-provider.h
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AWS_PROFILE_CREDENTIALS_PROVIDER_H
+#define AWS_PROFILE_CREDENTIALS_PROVIDER_H
+
+#include "aws-credentials-provider.h"
+
+G_BEGIN_DECLS
+
+#define AWS_TYPE_PROFILE_CREDENTIALS_PROVIDER (aws_profile_credentials_provider_get_type())
+
+G_DECLARE_FINAL_TYPE (AwsProfileCredentialsProvider, aws_profile_credentials_provider, AWS, PROFILE_CREDENTIALS_PROVIDER, AwsCredentialsProvider)
+
+AwsCredentialsProvider *aws_profile_credentials_provider_new          (const gchar                   *path,
+                                                                       const gchar                   *profile);
+const gchar            *aws_profile_credentials_provider_get_path     (AwsProfileCredentialsProvider *self);
+const gchar            *aws_profile_credentials_provider_get_profile  (AwsProfileCredentialsProvider *self);
+
+G_END_DECLS
+
+#endif /* AWS_PROFILE_CREDENTIALS_PROVIDER_H */
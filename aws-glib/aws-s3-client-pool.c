@@ -0,0 +1,617 @@
+/* aws-s3-client-pool.c
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "aws-s3-client-pool.h"
+
+typedef struct
+{
+  AwsS3Client  *client;
+  GMainContext *context;
+  GMainLoop    *main_loop;
+  GThread      *thread;
+  volatile gint in_flight;
+} Shard;
+
+typedef struct
+{
+  Shard                  *shard;
+  GTask                  *task;
+  gchar                  *bucket;
+  gchar                  *path;
+  AwsS3ClientDataHandler  handler;
+  gpointer                handler_data;
+  GDestroyNotify          handler_notify;
+  GInputStream           *stream;
+  GError                 *error;
+} Request;
+
+struct _AwsS3ClientPool
+{
+  GObject      parent_instance;
+
+  AwsS3Client *prototype;
+  GPtrArray   *shards;
+  guint        n_shards;
+  volatile gint next_shard;
+};
+
+G_DEFINE_TYPE (AwsS3ClientPool, aws_s3_client_pool, G_TYPE_OBJECT)
+
+enum {
+  PROP_0,
+  PROP_N_SHARDS,
+  PROP_PROTOTYPE,
+  N_PROPS
+};
+
+static GParamSpec *properties [N_PROPS];
+
+/*
+ * SoupSession tunables that are worth carrying over from the prototype.
+ * Everything else on SoupSession either conflicts with the per-shard
+ * main context or has side-effects on other properties when set.
+ */
+static const gchar *session_properties[] = {
+  "idle-timeout",
+  "max-conns",
+  "max-conns-per-host",
+  "timeout",
+  "user-agent",
+  NULL
+};
+
+static gpointer
+shard_thread_func (gpointer data)
+{
+  Shard *shard = data;
+
+  g_main_context_push_thread_default (shard->context);
+  g_main_loop_run (shard->main_loop);
+  g_main_context_pop_thread_default (shard->context);
+
+  return NULL;
+}
+
+static gboolean
+shard_shutdown (gpointer data)
+{
+  Shard *shard = data;
+
+  soup_session_abort (SOUP_SESSION (shard->client));
+  g_main_loop_quit (shard->main_loop);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+shard_free (gpointer data)
+{
+  Shard *shard = data;
+
+  if (shard != NULL)
+    {
+      g_main_context_invoke (shard->context, shard_shutdown, shard);
+      g_thread_join (shard->thread);
+
+      g_clear_object (&shard->client);
+      g_clear_pointer (&shard->main_loop, g_main_loop_unref);
+      g_clear_pointer (&shard->context, g_main_context_unref);
+      g_slice_free (Shard, shard);
+    }
+}
+
+static Shard *
+shard_new (AwsS3Client *client,
+           guint        index)
+{
+  g_autofree gchar *name = NULL;
+  Shard *shard;
+
+  shard = g_slice_new0 (Shard);
+  shard->client = client;
+  shard->context = g_main_context_new ();
+  shard->main_loop = g_main_loop_new (shard->context, FALSE);
+
+  name = g_strdup_printf ("aws-s3-shard-%u", index);
+  shard->thread = g_thread_new (name, shard_thread_func, shard);
+
+  return shard;
+}
+
+static void
+request_free (gpointer data)
+{
+  Request *request = data;
+
+  if (request != NULL)
+    {
+      if (request->handler_notify != NULL)
+        g_clear_pointer (&request->handler_data, request->handler_notify);
+      g_clear_pointer (&request->bucket, g_free);
+      g_clear_pointer (&request->path, g_free);
+      g_clear_object (&request->stream);
+      g_clear_object (&request->task);
+      g_clear_error (&request->error);
+      g_slice_free (Request, request);
+    }
+}
+
+static Request *
+request_new (GTask       *task,
+             const gchar *bucket,
+             const gchar *path)
+{
+  Request *request;
+
+  request = g_slice_new0 (Request);
+  request->task = g_object_ref (task);
+  request->bucket = g_strdup (bucket);
+  request->path = g_strdup (path);
+
+  return request;
+}
+
+static void
+aws_s3_client_pool_copy_properties (AwsS3Client *prototype,
+                                    AwsS3Client *client)
+{
+  g_autofree GParamSpec **pspecs = NULL;
+  guint n_pspecs = 0;
+  guint i;
+
+  g_assert (AWS_IS_S3_CLIENT (prototype));
+  g_assert (AWS_IS_S3_CLIENT (client));
+
+  pspecs = g_object_class_list_properties (G_OBJECT_GET_CLASS (prototype), &n_pspecs);
+
+  for (i = 0; i < n_pspecs; i++)
+    {
+      GParamSpec *pspec = pspecs [i];
+      GValue value = G_VALUE_INIT;
+
+      if ((pspec->flags & G_PARAM_READWRITE) != G_PARAM_READWRITE ||
+          (pspec->flags & G_PARAM_CONSTRUCT_ONLY) != 0)
+        continue;
+
+      if (!g_type_is_a (pspec->owner_type, AWS_TYPE_S3_CLIENT) &&
+          !g_strv_contains (session_properties, pspec->name))
+        continue;
+
+      /* An unset port means "pick from :secure", so leave it unset. */
+      if (g_str_equal (pspec->name, "port") && !aws_s3_client_get_port_set (prototype))
+        continue;
+
+      g_value_init (&value, pspec->value_type);
+      g_object_get_property (G_OBJECT (prototype), pspec->name, &value);
+      g_object_set_property (G_OBJECT (client), pspec->name, &value);
+      g_value_unset (&value);
+    }
+}
+
+/*
+ * Picks the shard with the fewest in-flight requests. The starting point
+ * rotates so that idle shards are handed work round-robin rather than the
+ * first shard always winning ties.
+ */
+static Shard *
+aws_s3_client_pool_pick_shard (AwsS3ClientPool *self)
+{
+  Shard *best = NULL;
+  gint best_load = G_MAXINT;
+  guint start;
+  guint i;
+
+  g_assert (AWS_IS_S3_CLIENT_POOL (self));
+  g_assert (self->shards->len > 0);
+
+  start = (guint)g_atomic_int_add (&self->next_shard, 1);
+
+  for (i = 0; i < self->shards->len; i++)
+    {
+      Shard *shard = g_ptr_array_index (self->shards, (start + i) % self->shards->len);
+      gint load = g_atomic_int_get (&shard->in_flight);
+
+      if (load < best_load)
+        {
+          best = shard;
+          best_load = load;
+        }
+    }
+
+  return best;
+}
+
+static gboolean
+aws_s3_client_pool_complete (gpointer data)
+{
+  Request *request = data;
+
+  g_assert (request != NULL);
+  g_assert (G_IS_TASK (request->task));
+
+  if (request->error != NULL)
+    g_task_return_error (request->task, g_steal_pointer (&request->error));
+  else
+    g_task_return_boolean (request->task, TRUE);
+
+  request_free (request);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+aws_s3_client_pool_request_cb (GObject      *object,
+                               GAsyncResult *result,
+                               gpointer      user_data)
+{
+  AwsS3Client *client = (AwsS3Client *)object;
+  Request *request = user_data;
+
+  g_assert (AWS_IS_S3_CLIENT (client));
+  g_assert (G_IS_ASYNC_RESULT (result));
+  g_assert (request != NULL);
+
+  if (g_task_get_source_tag (request->task) == aws_s3_client_pool_read_async)
+    aws_s3_client_read_finish (client, result, &request->error);
+  else
+    aws_s3_client_write_finish (client, result, &request->error);
+
+  g_atomic_int_add (&request->shard->in_flight, -1);
+
+  /*
+   * Hop back to the caller's main context before touching the task so
+   * that the final reference (and therefore the pool) is always released
+   * from the caller's thread rather than a shard thread.
+   */
+  g_main_context_invoke_full (g_task_get_context (request->task),
+                              G_PRIORITY_DEFAULT,
+                              aws_s3_client_pool_complete,
+                              request,
+                              NULL);
+}
+
+static gboolean
+aws_s3_client_pool_read_in_shard (gpointer data)
+{
+  Request *request = data;
+
+  g_assert (request != NULL);
+  g_assert (request->shard != NULL);
+
+  aws_s3_client_read_async (request->shard->client,
+                            request->bucket,
+                            request->path,
+                            request->handler,
+                            g_steal_pointer (&request->handler_data),
+                            g_steal_pointer (&request->handler_notify),
+                            g_task_get_cancellable (request->task),
+                            aws_s3_client_pool_request_cb,
+                            request);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+aws_s3_client_pool_write_in_shard (gpointer data)
+{
+  Request *request = data;
+
+  g_assert (request != NULL);
+  g_assert (request->shard != NULL);
+
+  aws_s3_client_write_async (request->shard->client,
+                             request->bucket,
+                             request->path,
+                             request->stream,
+                             g_task_get_cancellable (request->task),
+                             aws_s3_client_pool_request_cb,
+                             request);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+aws_s3_client_pool_dispatch (AwsS3ClientPool *self,
+                             Request         *request,
+                             GSourceFunc      func)
+{
+  g_assert (AWS_IS_S3_CLIENT_POOL (self));
+  g_assert (request != NULL);
+  g_assert (func != NULL);
+
+  request->shard = aws_s3_client_pool_pick_shard (self);
+  g_atomic_int_inc (&request->shard->in_flight);
+
+  g_main_context_invoke_full (request->shard->context,
+                              G_PRIORITY_DEFAULT,
+                              func,
+                              request,
+                              NULL);
+}
+
+/**
+ * aws_s3_client_pool_new:
+ * @prototype: (nullable): An #AwsS3Client to copy settings from, or %NULL.
+ * @n_shards: The number of worker threads, or 0 for one per processor.
+ *
+ * Creates a new #AwsS3ClientPool. Each shard owns an #AwsS3Client running
+ * on a dedicated thread with its own #GMainContext. The credentials, host,
+ * port and connection settings of @prototype are copied to each shard when
+ * the pool is created; later changes to @prototype are not propagated.
+ *
+ * Returns: (transfer full): An #AwsS3ClientPool.
+ */
+AwsS3ClientPool *
+aws_s3_client_pool_new (AwsS3Client *prototype,
+                        guint        n_shards)
+{
+  g_return_val_if_fail (!prototype || AWS_IS_S3_CLIENT (prototype), NULL);
+
+  return g_object_new (AWS_TYPE_S3_CLIENT_POOL,
+                       "n-shards", n_shards,
+                       "prototype", prototype,
+                       NULL);
+}
+
+guint
+aws_s3_client_pool_get_n_shards (AwsS3ClientPool *self)
+{
+  g_return_val_if_fail (AWS_IS_S3_CLIENT_POOL (self), 0);
+
+  return self->n_shards;
+}
+
+/**
+ * aws_s3_client_pool_read_async:
+ * @self: An #AwsS3ClientPool.
+ * @bucket: The bucket containing the object.
+ * @path: The path of the object within @bucket.
+ * @handler: (scope notified): A handler for incoming data.
+ * @handler_data: User data for @handler.
+ * @handler_notify: A #GDestroyNotify for @handler_data.
+ * @cancellable: (nullable): A #GCancellable, or %NULL.
+ * @callback: A callback to execute upon completion.
+ * @user_data: User data for @callback.
+ *
+ * Like aws_s3_client_read_async() but dispatched to the least busy shard.
+ *
+ * @handler is invoked from the shard's thread with the shard's
+ * #AwsS3Client, so it must not touch state owned by the caller's thread
+ * without synchronization. @callback is invoked from the thread-default
+ * main context of the caller.
+ */
+void
+aws_s3_client_pool_read_async (AwsS3ClientPool        *self,
+                               const gchar            *bucket,
+                               const gchar            *path,
+                               AwsS3ClientDataHandler  handler,
+                               gpointer                handler_data,
+                               GDestroyNotify          handler_notify,
+                               GCancellable           *cancellable,
+                               GAsyncReadyCallback     callback,
+                               gpointer                user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  Request *request;
+
+  g_return_if_fail (AWS_IS_S3_CLIENT_POOL (self));
+  g_return_if_fail (bucket != NULL);
+  g_return_if_fail (path != NULL);
+  g_return_if_fail (handler != NULL);
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, aws_s3_client_pool_read_async);
+
+  request = request_new (task, bucket, path);
+  request->handler = handler;
+  request->handler_data = handler_data;
+  request->handler_notify = handler_notify;
+
+  aws_s3_client_pool_dispatch (self, request, aws_s3_client_pool_read_in_shard);
+}
+
+gboolean
+aws_s3_client_pool_read_finish (AwsS3ClientPool  *self,
+                                GAsyncResult     *result,
+                                GError          **error)
+{
+  g_return_val_if_fail (AWS_IS_S3_CLIENT_POOL (self), FALSE);
+  g_return_val_if_fail (G_IS_TASK (result), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/**
+ * aws_s3_client_pool_write_async:
+ * @self: An #AwsS3ClientPool.
+ * @bucket: The bucket to write to.
+ * @path: The path of the object within @bucket.
+ * @stream: A #GInputStream containing the contents.
+ * @cancellable: (nullable): A #GCancellable, or %NULL.
+ * @callback: A callback to execute upon completion.
+ * @user_data: User data for @callback.
+ *
+ * Like aws_s3_client_write_async() but dispatched to the least busy shard.
+ * @stream is read from the shard's thread.
+ */
+void
+aws_s3_client_pool_write_async (AwsS3ClientPool     *self,
+                                const gchar         *bucket,
+                                const gchar         *path,
+                                GInputStream        *stream,
+                                GCancellable        *cancellable,
+                                GAsyncReadyCallback  callback,
+                                gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  Request *request;
+
+  g_return_if_fail (AWS_IS_S3_CLIENT_POOL (self));
+  g_return_if_fail (bucket != NULL);
+  g_return_if_fail (path != NULL);
+  g_return_if_fail (G_IS_INPUT_STREAM (stream));
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, aws_s3_client_pool_write_async);
+
+  request = request_new (task, bucket, path);
+  request->stream = g_object_ref (stream);
+
+  aws_s3_client_pool_dispatch (self, request, aws_s3_client_pool_write_in_shard);
+}
+
+gboolean
+aws_s3_client_pool_write_finish (AwsS3ClientPool  *self,
+                                 GAsyncResult     *result,
+                                 GError          **error)
+{
+  g_return_val_if_fail (AWS_IS_S3_CLIENT_POOL (self), FALSE);
+  g_return_val_if_fail (G_IS_TASK (result), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+static void
+aws_s3_client_pool_constructed (GObject *object)
+{
+  AwsS3ClientPool *self = (AwsS3ClientPool *)object;
+  GType client_type = AWS_TYPE_S3_CLIENT;
+  guint i;
+
+  G_OBJECT_CLASS (aws_s3_client_pool_parent_class)->constructed (object);
+
+  if (self->n_shards == 0)
+    self->n_shards = g_get_num_processors ();
+
+  if (self->prototype != NULL)
+    client_type = G_OBJECT_TYPE (self->prototype);
+
+  self->shards = g_ptr_array_new_full (self->n_shards, shard_free);
+
+  for (i = 0; i < self->n_shards; i++)
+    {
+      AwsS3Client *client;
+
+      /*
+       * Only a plain SoupSession follows the thread-default main context by
+       * default, so ask for it explicitly. Requests are always queued from
+       * the shard's thread, which means the session's I/O runs there too.
+       */
+      client = g_object_new (client_type,
+                             "use-thread-context", TRUE,
+                             NULL);
+
+      if (self->prototype != NULL)
+        aws_s3_client_pool_copy_properties (self->prototype, client);
+
+      g_ptr_array_add (self->shards, shard_new (client, i));
+    }
+}
+
+static void
+aws_s3_client_pool_finalize (GObject *object)
+{
+  AwsS3ClientPool *self = (AwsS3ClientPool *)object;
+
+  g_clear_pointer (&self->shards, g_ptr_array_unref);
+  g_clear_object (&self->prototype);
+
+  G_OBJECT_CLASS (aws_s3_client_pool_parent_class)->finalize (object);
+}
+
+static void
+aws_s3_client_pool_get_property (GObject    *object,
+                                 guint       prop_id,
+                                 GValue     *value,
+                                 GParamSpec *pspec)
+{
+  AwsS3ClientPool *self = AWS_S3_CLIENT_POOL (object);
+
+  switch (prop_id)
+    {
+    case PROP_N_SHARDS:
+      g_value_set_uint (value, self->n_shards);
+      break;
+
+    case PROP_PROTOTYPE:
+      g_value_set_object (value, self->prototype);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    }
+}
+
+static void
+aws_s3_client_pool_set_property (GObject      *object,
+                                 guint         prop_id,
+                                 const GValue *value,
+                                 GParamSpec   *pspec)
+{
+  AwsS3ClientPool *self = AWS_S3_CLIENT_POOL (object);
+
+  switch (prop_id)
+    {
+    case PROP_N_SHARDS:
+      self->n_shards = g_value_get_uint (value);
+      break;
+
+    case PROP_PROTOTYPE:
+      self->prototype = g_value_dup_object (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    }
+}
+
+static void
+aws_s3_client_pool_class_init (AwsS3ClientPoolClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->constructed = aws_s3_client_pool_constructed;
+  object_class->finalize = aws_s3_client_pool_finalize;
+  object_class->get_property = aws_s3_client_pool_get_property;
+  object_class->set_property = aws_s3_client_pool_set_property;
+
+  properties [PROP_N_SHARDS] =
+    g_param_spec_uint ("n-shards",
+                       "N Shards",
+                       "The number of client threads, or 0 for one per processor.",
+                       0,
+                       G_MAXUINT,
+                       0,
+                       G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+  properties [PROP_PROTOTYPE] =
+    g_param_spec_object ("prototype",
+                         "Prototype",
+                         "The client to copy settings from for each shard.",
+                         AWS_TYPE_S3_CLIENT,
+                         G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties (object_class, N_PROPS, properties);
+}
+
+static void
+aws_s3_client_pool_init (AwsS3ClientPool *self)
+{
+}
@@ -0,0 +1,58 @@
+/* aws-s3-client-pool.h
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AWS_S3_CLIENT_POOL_H
+#define AWS_S3_CLIENT_POOL_H
+
+#include "aws-s3-client.h"
+
+G_BEGIN_DECLS
+
+#define AWS_TYPE_S3_CLIENT_POOL (aws_s3_client_pool_get_type())
+
+G_DECLARE_FINAL_TYPE (AwsS3ClientPool, aws_s3_client_pool, AWS, S3_CLIENT_POOL, GObject)
+
+AwsS3ClientPool *aws_s3_client_pool_new          (AwsS3Client             *prototype,
+                                                  guint                    n_shards);
+guint            aws_s3_client_pool_get_n_shards (AwsS3ClientPool         *self);
+void             aws_s3_client_pool_read_async   (AwsS3ClientPool         *self,
+                                                  const gchar             *bucket,
+                                                  const gchar             *path,
+                                                  AwsS3ClientDataHandler   handler,
+                                                  gpointer                 handler_data,
+                                                  GDestroyNotify           handler_notify,
+                                                  GCancellable            *cancellable,
+                                                  GAsyncReadyCallback      callback,
+                                                  gpointer                 user_data);
+gboolean         aws_s3_client_pool_read_finish  (AwsS3ClientPool         *self,
+                                                  GAsyncResult            *result,
+                                                  GError                 **error);
+void             aws_s3_client_pool_write_async  (AwsS3ClientPool         *self,
+                                                  const gchar             *bucket,
+                                                  const gchar             *path,
+                                                  GInputStream            *stream,
+                                                  GCancellable            *cancellable,
+                                                  GAsyncReadyCallback      callback,
+                                                  gpointer                 user_data);
+gboolean         aws_s3_client_pool_write_finish (AwsS3ClientPool         *self,
+                                                  GAsyncResult            *result,
+                                                  GError                 **error);
+
+G_END_DECLS
+
+#endif /* AWS_S3_CLIENT_POOL_H */
@@ -16,36 +16,199 @@
  * with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "config.h"
+
+#include <errno.h>
+#include <gio/gfiledescriptorbased.h>
 #include <glib/gi18n.h>
 #include <libsoup/soup-date.h>
+#include <string.h>
+#include <unistd.h>
 
+#include "aws-buffer-pool.h"
+#include "aws-credentials-provider-private.h"
+#include "aws-event-stream.h"
 #include "aws-s3-client.h"
+#include "aws-s3-object-info.h"
+#include "aws-serial-executor.h"
+#include "aws-trace-private.h"
+
+#ifdef HAVE_ZSTD
+# include "aws-zstd-converter.h"
+#endif
 
 typedef struct
 {
   AwsCredentials *creds;
+  AwsCredentialsProvider *provider;
   gchar *host;
+  gchar *region;
+  GHashTable *regions;
+  GMutex regions_mutex;
+  guint region_cache_ttl;
+  GHashTable *stats;
+  GMutex stats_mutex;
+  guint stat_cache_ttl;
+  AwsS3ClientCodec read_codec;
+  AwsS3ClientCodec write_codec;
+  AwsBufferPool *pool;
+  guint delivery_size;
+  AwsSerialExecutorPool *transform_pool;
+  guint transform_threads;
   guint16 port;
   guint port_set : 1;
   guint secure : 1;
 } AwsS3ClientPrivate;
 
+typedef struct
+{
+  gchar  *region;
+  gint64  expires_at;
+} RegionEntry;
+
+typedef struct
+{
+  AwsS3ObjectInfo *info;
+  gint64           expires_at;
+} StatEntry;
+
+typedef struct
+{
+  GPtrArray *objects;
+  GString   *text;
+  gchar     *key;
+  gchar     *etag;
+  gchar     *next_token;
+  guint64    size;
+  gint64     last_modified;
+  guint      in_contents : 1;
+  guint      in_prefixes : 1;
+} ListParser;
+
 typedef struct
 {
   AwsS3ClientDataHandler handler;
   gpointer               handler_data;
   GDestroyNotify         handler_data_destroy;
+  gchar                 *bucket;
+  gchar                 *path;
+  SoupMessage           *retry;
+  AwsS3ClientCodec       codec;
+  GConverter            *decompressor;
+  AwsBufferPool         *pool;
+  AwsPooledBuffer       *pooled;
+  guint8                *block;
+  gsize                  block_len;
+  gsize                  block_size;
+  AwsSerialExecutor     *executor;
+  GPtrArray             *outputs;
+  gint64                 begin_time;
+  gboolean               paused;
+  guint                  redirected : 1;
+  guint                  decompressor_finished : 1;
+  guint                  transform_failed : 1;
 } ReadState;
 
+typedef struct
+{
+  gchar            *bucket;
+  gchar            *path;
+  AwsS3ClientCodec  codec;
+  gint64            begin_time;
+  guint             redirected : 1;
+} WriteState;
+
+typedef struct
+{
+  GTask       *task;
+  SoupMessage *message;
+  SoupBuffer  *input;
+  GPtrArray   *outputs;
+  GError      *error;
+  gboolean     at_end;
+} TransformJob;
+
+typedef struct
+{
+  GTask         *task;
+  GInputStream  *source;
+  GOutputStream *contents;
+  GError        *error;
+} CompressJob;
+
+typedef struct
+{
+  guint64 start;
+  guint64 end;
+} ByteRange;
+
+typedef struct
+{
+  GFile   *file;
+  gchar   *etag;
+  guint64  size;
+  GArray  *ranges;
+} DownloadJournal;
+
+typedef struct
+{
+  gchar *bucket;
+  gchar *path;
+  GFile *destination;
+} DownloadState;
+
+typedef struct
+{
+  AwsS3ClientDataHandler     handler;
+  AwsS3ClientSelectProgress  progress;
+  gpointer                   handler_data;
+  GDestroyNotify             handler_data_destroy;
+  AwsEventStreamDecoder     *decoder;
+  AwsS3ClientSelectStats     stats;
+  AwsS3Client               *client;
+  SoupMessage               *message;
+  GError                    *error;
+  gboolean                   ended;
+} SelectState;
+
+typedef struct
+{
+  GChecksum *canonical;
+  GHmac     *signer;
+  gchar     *url_prefix;
+  gchar     *query;
+  gchar     *suffix;
+} PresignContext;
+
+#define READ_CHUNK_SIZE     (64 * 1024)
+#define PRESIGN_MAX_EXPIRES (7 * 24 * 60 * 60)
+#define STAT_CACHE_MAX      4096
+#define POOL_MAX_FREE       16
+#define DOWNLOAD_CHUNK_SIZE (8 * 1024 * 1024)
+#define JOURNAL_GROUP       "download"
+#define JOURNAL_SUFFIX      ".s3-journal"
+
+/* Chunks a read may have waiting to be transformed before it is paused */
+#define TRANSFORM_MAX_PENDING    8
+#define TRANSFORM_RESUME_PENDING 2
+
 G_DEFINE_TYPE_WITH_PRIVATE (AwsS3Client, aws_s3_client, SOUP_TYPE_SESSION)
 
 enum {
   PROP_0,
   PROP_CREDENTIALS,
+  PROP_CREDENTIALS_PROVIDER,
+  PROP_DELIVERY_SIZE,
   PROP_HOST,
   PROP_PORT,
   PROP_PORT_SET,
+  PROP_READ_CODEC,
+  PROP_REGION,
+  PROP_REGION_CACHE_TTL,
   PROP_SECURE,
+  PROP_STAT_CACHE_TTL,
+  PROP_TRANSFORM_THREADS,
+  PROP_WRITE_CODEC,
   N_PROPS
 };
 
@@ -60,21 +223,132 @@ read_state_free (gpointer data)
     {
       if (state->handler_data_destroy != NULL)
         g_clear_pointer (&state->handler_data, state->handler_data_destroy);
+      g_clear_pointer (&state->bucket, g_free);
+      g_clear_pointer (&state->path, g_free);
+      g_clear_object (&state->retry);
+      g_clear_object (&state->decompressor);
+      if (state->pooled != NULL)
+        g_clear_pointer (&state->pooled, aws_buffer_pool_release);
+      else
+        g_free (state->block);
+      g_clear_pointer (&state->pool, aws_buffer_pool_unref);
+      g_clear_pointer (&state->executor, aws_serial_executor_unref);
       g_slice_free (ReadState, state);
     }
 }
 
 static ReadState *
-read_state_new (AwsS3ClientDataHandler handler,
-                gpointer               handler_data,
-                GDestroyNotify         handler_data_destroy)
+read_state_new (const gchar            *bucket,
+                const gchar            *path,
+                AwsS3ClientDataHandler  handler,
+                gpointer                handler_data,
+                GDestroyNotify          handler_data_destroy)
 {
   ReadState *state;
 
   state = g_slice_new0 (ReadState);
+  state->bucket = g_strdup (bucket);
+  state->path = g_strdup (path);
   state->handler = handler;
   state->handler_data = handler_data;
   state->handler_data_destroy = handler_data_destroy;
+  state->begin_time = g_get_monotonic_time ();
+
+  return state;
+}
+
+static void
+write_state_free (gpointer data)
+{
+  WriteState *state = data;
+
+  if (state != NULL)
+    {
+      g_free (state->bucket);
+      g_free (state->path);
+      g_slice_free (WriteState, state);
+    }
+}
+
+static void
+download_journal_free (DownloadJournal *journal)
+{
+  if (journal != NULL)
+    {
+      g_clear_object (&journal->file);
+      g_clear_pointer (&journal->etag, g_free);
+      g_clear_pointer (&journal->ranges, g_array_unref);
+      g_slice_free (DownloadJournal, journal);
+    }
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (DownloadJournal, download_journal_free)
+
+static void
+download_state_free (gpointer data)
+{
+  DownloadState *state = data;
+
+  if (state != NULL)
+    {
+      g_free (state->bucket);
+      g_free (state->path);
+      g_clear_object (&state->destination);
+      g_slice_free (DownloadState, state);
+    }
+}
+
+static void
+select_state_free (gpointer data)
+{
+  SelectState *state = data;
+
+  if (state != NULL)
+    {
+      if (state->handler_data_destroy != NULL)
+        g_clear_pointer (&state->handler_data, state->handler_data_destroy);
+      g_clear_pointer (&state->decoder, aws_event_stream_decoder_free);
+      g_clear_error (&state->error);
+      g_slice_free (SelectState, state);
+    }
+}
+
+static void
+region_entry_free (gpointer data)
+{
+  RegionEntry *entry = data;
+
+  if (entry != NULL)
+    {
+      g_free (entry->region);
+      g_slice_free (RegionEntry, entry);
+    }
+}
+
+static void
+stat_entry_free (gpointer data)
+{
+  StatEntry *entry = data;
+
+  if (entry != NULL)
+    {
+      g_clear_pointer (&entry->info, aws_s3_object_info_unref);
+      g_slice_free (StatEntry, entry);
+    }
+}
+
+static WriteState *
+write_state_new (const gchar      *bucket,
+                 const gchar      *path,
+                 AwsS3ClientCodec  codec)
+{
+  WriteState *state;
+
+  state = g_slice_new0 (WriteState);
+  state->bucket = g_strdup (bucket);
+  state->path = g_strdup (path);
+  state->codec = codec;
+  state->begin_time = g_get_monotonic_time ();
 
   return state;
 }
@@ -110,6 +384,98 @@ aws_s3_client_set_credentials (AwsS3Client    *client,
     g_object_notify_by_pspec (G_OBJECT (client), properties [PROP_CREDENTIALS]);
 }
 
+/**
+ * aws_s3_client_get_credentials_provider:
+ * @client: An #AwsS3Client.
+ *
+ * Fetches the #AwsCredentialsProvider for @client, if any.
+ *
+ * Returns: (transfer none) (nullable): An #AwsCredentialsProvider or %NULL.
+ */
+AwsCredentialsProvider *
+aws_s3_client_get_credentials_provider (AwsS3Client *client)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (client);
+
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), NULL);
+
+  return priv->provider;
+}
+
+/**
+ * aws_s3_client_set_credentials_provider:
+ * @client: An #AwsS3Client.
+ * @provider: (nullable): An #AwsCredentialsProvider or %NULL.
+ *
+ * Sets a provider for the credentials used to sign requests. Requests
+ * are signed with the provider's current snapshot and never wait for a
+ * load. Until the first load completes, #AwsS3Client:credentials is used
+ * instead; callers that need the provider's credentials from the first
+ * request should wait for aws_credentials_provider_refresh_async() or
+ * aws_credentials_provider_refresh_sync() beforehand.
+ */
+void
+aws_s3_client_set_credentials_provider (AwsS3Client            *client,
+                                        AwsCredentialsProvider *provider)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (client);
+
+  g_return_if_fail (AWS_IS_S3_CLIENT (client));
+  g_return_if_fail (!provider || AWS_IS_CREDENTIALS_PROVIDER (provider));
+
+  if (g_set_object (&priv->provider, provider))
+    {
+      if (provider != NULL)
+        aws_credentials_provider_request_refresh (provider);
+      g_object_notify_by_pspec (G_OBJECT (client), properties [PROP_CREDENTIALS_PROVIDER]);
+    }
+}
+
+guint
+aws_s3_client_get_delivery_size (AwsS3Client *client)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (client);
+
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), 0);
+
+  return priv->delivery_size;
+}
+
+/**
+ * aws_s3_client_set_delivery_size:
+ * @client: An #AwsS3Client.
+ * @delivery_size: The size of the blocks passed to data handlers, or 0.
+ *
+ * Sets the size of the blocks passed to data handlers while reading. When
+ * non-zero, incoming data is gathered into page-aligned buffers of this
+ * size taken from a pool, and a block is only delivered once it is full
+ * or the object has been read. Each buffer returns to the pool when its
+ * #SoupBuffer is freed, so handlers may keep it with soup_buffer_copy()
+ * instead of copying the data.
+ *
+ * When 0, data is delivered in whatever chunks it arrives.
+ */
+void
+aws_s3_client_set_delivery_size (AwsS3Client *client,
+                                 guint        delivery_size)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (client);
+
+  g_return_if_fail (AWS_IS_S3_CLIENT (client));
+
+  if (priv->delivery_size != delivery_size)
+    {
+      priv->delivery_size = delivery_size;
+
+      /* Reads in flight keep the previous pool alive */
+      g_clear_pointer (&priv->pool, aws_buffer_pool_unref);
+      if (delivery_size > 0)
+        priv->pool = aws_buffer_pool_new (delivery_size, POOL_MAX_FREE);
+
+      g_object_notify_by_pspec (G_OBJECT (client), properties [PROP_DELIVERY_SIZE]);
+    }
+}
+
 const gchar *
 aws_s3_client_get_host (AwsS3Client *client)
 {
@@ -173,6 +539,152 @@ aws_s3_client_get_port_set (AwsS3Client *client)
   return priv->port_set;
 }
 
+AwsS3ClientCodec
+aws_s3_client_get_read_codec (AwsS3Client *client)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (client);
+
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), AWS_S3_CLIENT_CODEC_NONE);
+
+  return priv->read_codec;
+}
+
+/**
+ * aws_s3_client_set_read_codec:
+ * @client: An #AwsS3Client.
+ * @read_codec: An #AwsS3ClientCodec.
+ *
+ * Sets how object contents are decoded while reading. With
+ * %AWS_S3_CLIENT_CODEC_AUTO the codec is picked from the Content-Encoding
+ * of the response. When decoding, data handlers receive decompressed
+ * blocks of a fixed size, the last of which may be shorter.
+ */
+void
+aws_s3_client_set_read_codec (AwsS3Client      *client,
+                              AwsS3ClientCodec  read_codec)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (client);
+
+  g_return_if_fail (AWS_IS_S3_CLIENT (client));
+
+  if (priv->read_codec != read_codec)
+    {
+      priv->read_codec = read_codec;
+      g_object_notify_by_pspec (G_OBJECT (client), properties [PROP_READ_CODEC]);
+    }
+}
+
+AwsS3ClientCodec
+aws_s3_client_get_write_codec (AwsS3Client *client)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (client);
+
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), AWS_S3_CLIENT_CODEC_NONE);
+
+  return priv->write_codec;
+}
+
+/**
+ * aws_s3_client_set_write_codec:
+ * @client: An #AwsS3Client.
+ * @write_codec: An #AwsS3ClientCodec.
+ *
+ * Sets how object contents are compressed while writing. The matching
+ * Content-Encoding is stored with the object so that readers using
+ * %AWS_S3_CLIENT_CODEC_AUTO decode it transparently.
+ */
+void
+aws_s3_client_set_write_codec (AwsS3Client      *client,
+                               AwsS3ClientCodec  write_codec)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (client);
+
+  g_return_if_fail (AWS_IS_S3_CLIENT (client));
+  g_return_if_fail (write_codec != AWS_S3_CLIENT_CODEC_AUTO);
+
+  if (priv->write_codec != write_codec)
+    {
+      priv->write_codec = write_codec;
+      g_object_notify_by_pspec (G_OBJECT (client), properties [PROP_WRITE_CODEC]);
+    }
+}
+
+const gchar *
+aws_s3_client_get_region (AwsS3Client *client)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (client);
+
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), NULL);
+
+  return priv->region;
+}
+
+/**
+ * aws_s3_client_set_region:
+ * @client: An #AwsS3Client.
+ * @region: The region name, such as "eu-west-1".
+ *
+ * Sets the region used when presigning URLs for a bucket whose region has
+ * not been discovered. Ordinary requests are not affected.
+ */
+void
+aws_s3_client_set_region (AwsS3Client *client,
+                          const gchar *region)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (client);
+
+  g_return_if_fail (AWS_IS_S3_CLIENT (client));
+  g_return_if_fail (region != NULL);
+
+  if (g_strcmp0 (priv->region, region) != 0)
+    {
+      g_free (priv->region);
+      priv->region = g_strdup (region);
+      g_object_notify_by_pspec (G_OBJECT (client), properties [PROP_REGION]);
+    }
+}
+
+guint
+aws_s3_client_get_region_cache_ttl (AwsS3Client *client)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (client);
+
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), 0);
+
+  return priv->region_cache_ttl;
+}
+
+/**
+ * aws_s3_client_set_region_cache_ttl:
+ * @client: An #AwsS3Client.
+ * @region_cache_ttl: The lifetime of a discovered bucket region in seconds.
+ *
+ * Sets how long the region discovered for a bucket is trusted before the
+ * global endpoint is consulted again. Use 0 to disable region discovery.
+ */
+void
+aws_s3_client_set_region_cache_ttl (AwsS3Client *client,
+                                    guint        region_cache_ttl)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (client);
+
+  g_return_if_fail (AWS_IS_S3_CLIENT (client));
+
+  if (priv->region_cache_ttl != region_cache_ttl)
+    {
+      priv->region_cache_ttl = region_cache_ttl;
+
+      if (region_cache_ttl == 0)
+        {
+          g_mutex_lock (&priv->regions_mutex);
+          g_hash_table_remove_all (priv->regions);
+          g_mutex_unlock (&priv->regions_mutex);
+        }
+
+      g_object_notify_by_pspec (G_OBJECT (client), properties [PROP_REGION_CACHE_TTL]);
+    }
+}
+
 gboolean
 aws_s3_client_get_secure (AwsS3Client *client)
 {
@@ -200,220 +712,3762 @@ aws_s3_client_set_secure (AwsS3Client *client,
     }
 }
 
-static void
-aws_s3_client_read_cb (SoupSession *session,
-                       SoupMessage *message,
-                       gpointer     user_data)
+guint
+aws_s3_client_get_stat_cache_ttl (AwsS3Client *client)
 {
-  g_autoptr(GTask) task = user_data;
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (client);
 
-  g_assert (SOUP_IS_MESSAGE (message));
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), 0);
+
+  return priv->stat_cache_ttl;
+}
+
+/**
+ * aws_s3_client_set_stat_cache_ttl:
+ * @client: An #AwsS3Client.
+ * @stat_cache_ttl: The lifetime of cached object metadata in seconds.
+ *
+ * Sets how long metadata returned by aws_s3_client_stat_sync() and
+ * aws_s3_client_list_sync() is reused before the object is looked up
+ * again. Writes through @client drop the cached entry immediately, but
+ * changes made elsewhere go unnoticed for up to @stat_cache_ttl seconds.
+ * Use 0 to disable the cache.
+ */
+void
+aws_s3_client_set_stat_cache_ttl (AwsS3Client *client,
+                                  guint        stat_cache_ttl)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (client);
+
+  g_return_if_fail (AWS_IS_S3_CLIENT (client));
+
+  if (priv->stat_cache_ttl != stat_cache_ttl)
+    {
+      priv->stat_cache_ttl = stat_cache_ttl;
+
+      g_mutex_lock (&priv->stats_mutex);
+      g_hash_table_remove_all (priv->stats);
+      g_mutex_unlock (&priv->stats_mutex);
+
+      g_object_notify_by_pspec (G_OBJECT (client), properties [PROP_STAT_CACHE_TTL]);
+    }
+}
+
+guint
+aws_s3_client_get_transform_threads (AwsS3Client *client)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (client);
+
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), 0);
+
+  return priv->transform_threads;
+}
+
+/**
+ * aws_s3_client_set_transform_threads:
+ * @client: An #AwsS3Client.
+ * @transform_threads: The maximum number of transform threads, or 0.
+ *
+ * Sets how many threads may decompress data for aws_s3_client_read_async()
+ * and compress data for aws_s3_client_write_async(). When non-zero these
+ * run on a shared thread pool rather than the main context, which is left
+ * free for network I/O. Data handlers are still called on the main context
+ * and in order, and a read is paused while too much of it is waiting to be
+ * decompressed.
+ *
+ * When 0, data is transformed on the main context as it arrives.
+ */
+void
+aws_s3_client_set_transform_threads (AwsS3Client *client,
+                                     guint        transform_threads)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (client);
+
+  g_return_if_fail (AWS_IS_S3_CLIENT (client));
+
+  if (priv->transform_threads != transform_threads)
+    {
+      priv->transform_threads = transform_threads;
+
+      /* Requests in flight may be using the pool, so it is only ever resized */
+      if (transform_threads > 0)
+        {
+          if (priv->transform_pool == NULL)
+            priv->transform_pool = aws_serial_executor_pool_new (transform_threads, NULL);
+          else
+            aws_serial_executor_pool_set_max_threads (priv->transform_pool, transform_threads);
+        }
+
+      g_object_notify_by_pspec (G_OBJECT (client), properties [PROP_TRANSFORM_THREADS]);
+    }
+}
+
+/*
+ * Returns an executor to transform a single request with, or %NULL if
+ * transforms should run on the main context.
+ */
+static AwsSerialExecutor *
+aws_s3_client_new_transform_executor (AwsS3Client *self)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (self);
+
+  if (priv->transform_threads == 0 || priv->transform_pool == NULL)
+    return NULL;
+
+  return aws_serial_executor_new (priv->transform_pool, NULL);
+}
+
+static const gchar *
+skip_leading_slashes (const gchar *path)
+{
+  while (g_utf8_get_char (path) == '/')
+    path = g_utf8_next_char (path);
+
+  return path;
+}
+
+static void
+collect_amz_header (const gchar *name,
+                    const gchar *value,
+                    gpointer     user_data)
+{
+  GPtrArray *names = user_data;
+  gchar *lower;
+
+  lower = g_ascii_strdown (name, -1);
+
+  if (g_str_has_prefix (lower, "x-amz-"))
+    g_ptr_array_add (names, lower);
+  else
+    g_free (lower);
+}
+
+static gint
+compare_strings (gconstpointer a,
+                 gconstpointer b)
+{
+  return strcmp (*(const gchar * const *)a, *(const gchar * const *)b);
+}
+
+static gboolean
+is_aws_host (const gchar *host)
+{
+  return host != NULL &&
+         g_str_has_prefix (host, "s3") &&
+         g_str_has_suffix (host, ".amazonaws.com");
+}
+
+/*
+ * Checks if @bucket may be used as a DNS label for virtual-hosted-style
+ * addressing. Dotted names break wildcard certificate matching, so they
+ * are only allowed over plain HTTP.
+ */
+static gboolean
+is_dns_compatible_bucket (const gchar *bucket,
+                          gboolean     secure)
+{
+  gsize len = strlen (bucket);
+  const gchar *p;
+
+  if (len < 3 || len > 63)
+    return FALSE;
+
+  if (!g_ascii_isalnum (bucket [0]) || !g_ascii_isalnum (bucket [len - 1]))
+    return FALSE;
+
+  for (p = bucket; *p; p++)
+    {
+      if (*p == '.')
+        {
+          if (secure || p [1] == '.')
+            return FALSE;
+        }
+      else if (!g_ascii_islower (*p) && !g_ascii_isdigit (*p) && *p != '-')
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gchar *
+aws_s3_client_lookup_region (AwsS3Client *self,
+                             const gchar *bucket)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (self);
+  RegionEntry *entry;
+  gchar *region = NULL;
+
+  g_assert (AWS_IS_S3_CLIENT (self));
+  g_assert (bucket != NULL);
+
+  g_mutex_lock (&priv->regions_mutex);
+
+  if ((entry = g_hash_table_lookup (priv->regions, bucket)))
+    {
+      if (entry->expires_at > g_get_monotonic_time ())
+        region = g_strdup (entry->region);
+      else
+        g_hash_table_remove (priv->regions, bucket);
+    }
+
+  g_mutex_unlock (&priv->regions_mutex);
+
+  return region;
+}
+
+/*
+ * Remembers the region advertised by S3 in the x-amz-bucket-region
+ * response header so that later requests go straight to the regional
+ * endpoint instead of bouncing off the global one.
+ */
+static void
+aws_s3_client_learn_region (AwsS3Client *self,
+                            const gchar *bucket,
+                            SoupMessage *message)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (self);
+  RegionEntry *entry;
+  const gchar *region;
+
+  g_assert (AWS_IS_S3_CLIENT (self));
+  g_assert (bucket != NULL);
+  g_assert (SOUP_IS_MESSAGE (message));
+
+  if (priv->region_cache_ttl == 0 || !is_aws_host (priv->host))
+    return;
+
+  region = soup_message_headers_get_one (message->response_headers, "x-amz-bucket-region");
+  if (region == NULL || *region == '\0')
+    return;
+
+  entry = g_slice_new0 (RegionEntry);
+  entry->region = g_strdup (region);
+  entry->expires_at = g_get_monotonic_time () + (gint64)priv->region_cache_ttl * G_USEC_PER_SEC;
+
+  g_mutex_lock (&priv->regions_mutex);
+  g_hash_table_insert (priv->regions, g_strdup (bucket), entry);
+  g_mutex_unlock (&priv->regions_mutex);
+}
+
+static AwsS3ObjectInfo *
+aws_s3_client_lookup_stat (AwsS3Client *self,
+                           const gchar *bucket,
+                           const gchar *path)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (self);
+  g_autofree gchar *key = NULL;
+  AwsS3ObjectInfo *info = NULL;
+  StatEntry *entry;
+
+  g_assert (AWS_IS_S3_CLIENT (self));
+  g_assert (bucket != NULL);
+  g_assert (path != NULL);
+
+  if (priv->stat_cache_ttl == 0)
+    return NULL;
+
+  key = g_strconcat (bucket, "/", path, NULL);
+
+  g_mutex_lock (&priv->stats_mutex);
+
+  if ((entry = g_hash_table_lookup (priv->stats, key)))
+    {
+      if (entry->expires_at > g_get_monotonic_time ())
+        info = aws_s3_object_info_ref (entry->info);
+      else
+        g_hash_table_remove (priv->stats, key);
+    }
+
+  g_mutex_unlock (&priv->stats_mutex);
+
+  return info;
+}
+
+static gboolean
+stat_entry_is_expired (gpointer key,
+                       gpointer value,
+                       gpointer user_data)
+{
+  StatEntry *entry = value;
+  gint64 *now = user_data;
+
+  return entry->expires_at <= *now;
+}
+
+static void
+aws_s3_client_cache_stat (AwsS3Client     *self,
+                          const gchar     *bucket,
+                          AwsS3ObjectInfo *info)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (self);
+  StatEntry *entry;
+  gint64 now;
+
+  g_assert (AWS_IS_S3_CLIENT (self));
+  g_assert (bucket != NULL);
+  g_assert (info != NULL);
+
+  if (priv->stat_cache_ttl == 0)
+    return;
+
+  now = g_get_monotonic_time ();
+
+  entry = g_slice_new0 (StatEntry);
+  entry->info = aws_s3_object_info_ref (info);
+  entry->expires_at = now + (gint64)priv->stat_cache_ttl * G_USEC_PER_SEC;
+
+  g_mutex_lock (&priv->stats_mutex);
+
+  /* Entries are only dropped when looked up, so prune when we grow too big */
+  if (g_hash_table_size (priv->stats) >= STAT_CACHE_MAX)
+    {
+      g_hash_table_foreach_remove (priv->stats, stat_entry_is_expired, &now);
+      if (g_hash_table_size (priv->stats) >= STAT_CACHE_MAX)
+        g_hash_table_remove_all (priv->stats);
+    }
+
+  g_hash_table_insert (priv->stats,
+                       g_strconcat (bucket, "/", aws_s3_object_info_get_key (info), NULL),
+                       entry);
+
+  g_mutex_unlock (&priv->stats_mutex);
+}
+
+static void
+aws_s3_client_forget_stat (AwsS3Client *self,
+                           const gchar *bucket,
+                           const gchar *path)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (self);
+  g_autofree gchar *key = NULL;
+
+  g_assert (AWS_IS_S3_CLIENT (self));
+  g_assert (bucket != NULL);
+  g_assert (path != NULL);
+
+  key = g_strconcat (bucket, "/", path, NULL);
+
+  g_mutex_lock (&priv->stats_mutex);
+  g_hash_table_remove (priv->stats, key);
+  g_mutex_unlock (&priv->stats_mutex);
+}
+
+/*
+ * Resolves the host to contact for @bucket. Requests against Amazon's own
+ * endpoints are directed to the bucket's regional endpoint once it is
+ * known and use virtual-hosted-style addressing when the bucket name
+ * permits. Any other host (such as a local S3-compatible server) is used
+ * as-is with path-style addressing.
+ */
+static gchar *
+aws_s3_client_resolve_host (AwsS3Client *self,
+                            const gchar *bucket,
+                            gboolean    *virtual_hosted)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (self);
+  g_autofree gchar *region = NULL;
+  g_autofree gchar *endpoint = NULL;
+
+  g_assert (AWS_IS_S3_CLIENT (self));
+  g_assert (bucket != NULL);
+  g_assert (virtual_hosted != NULL);
+
+  *virtual_hosted = FALSE;
+
+  if (!is_aws_host (priv->host))
+    return g_strdup (priv->host);
+
+  if (priv->region_cache_ttl > 0 && (region = aws_s3_client_lookup_region (self, bucket)))
+    endpoint = g_strdup_printf ("s3.%s.amazonaws.com", region);
+  else
+    endpoint = g_strdup (priv->host);
+
+  if (!is_dns_compatible_bucket (bucket, priv->secure))
+    return g_steal_pointer (&endpoint);
+
+  *virtual_hosted = TRUE;
+
+  return g_strdup_printf ("%s.%s", bucket, endpoint);
+}
+
+static const gchar *
+codec_to_content_encoding (AwsS3ClientCodec codec)
+{
+  switch (codec)
+    {
+    case AWS_S3_CLIENT_CODEC_GZIP:
+      return "gzip";
+
+    case AWS_S3_CLIENT_CODEC_ZSTD:
+      return "zstd";
+
+    case AWS_S3_CLIENT_CODEC_NONE:
+    case AWS_S3_CLIENT_CODEC_AUTO:
+    default:
+      return NULL;
+    }
+}
+
+static AwsS3ClientCodec
+codec_from_content_encoding (const gchar *content_encoding)
+{
+  if (content_encoding == NULL)
+    return AWS_S3_CLIENT_CODEC_NONE;
+  else if (g_ascii_strcasecmp (content_encoding, "gzip") == 0 ||
+           g_ascii_strcasecmp (content_encoding, "x-gzip") == 0)
+    return AWS_S3_CLIENT_CODEC_GZIP;
+  else if (g_ascii_strcasecmp (content_encoding, "zstd") == 0)
+    return AWS_S3_CLIENT_CODEC_ZSTD;
+  else
+    return AWS_S3_CLIENT_CODEC_NONE;
+}
+
+/*
+ * Creates the #GConverter for @codec. @converter is set to %NULL if no
+ * conversion is necessary.
+ */
+static gboolean
+aws_s3_client_create_converter (AwsS3ClientCodec   codec,
+                                gboolean           compress,
+                                GConverter       **converter,
+                                GError           **error)
+{
+  g_assert (converter != NULL);
+
+  *converter = NULL;
+
+  switch (codec)
+    {
+    case AWS_S3_CLIENT_CODEC_GZIP:
+      if (compress)
+        *converter = G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1));
+      else
+        *converter = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+      return TRUE;
+
+    case AWS_S3_CLIENT_CODEC_ZSTD:
+#ifdef HAVE_ZSTD
+      *converter = G_CONVERTER (aws_zstd_converter_new (compress));
+      return TRUE;
+#else
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_SUPPORTED,
+                   "zstd support was not enabled at build time");
+      return FALSE;
+#endif
+
+    case AWS_S3_CLIENT_CODEC_NONE:
+    case AWS_S3_CLIENT_CODEC_AUTO:
+    default:
+      return TRUE;
+    }
+}
+
+/*
+ * Creates the decompressor for a read using @codec, resolving
+ * %AWS_S3_CLIENT_CODEC_AUTO from the response headers of @message.
+ */
+static gboolean
+aws_s3_client_create_decompressor (AwsS3ClientCodec   codec,
+                                   SoupMessage       *message,
+                                   GConverter       **converter,
+                                   GError           **error)
+{
+  g_assert (SOUP_IS_MESSAGE (message));
+
+  if (codec == AWS_S3_CLIENT_CODEC_AUTO)
+    codec = codec_from_content_encoding (
+      soup_message_headers_get_one (message->response_headers, "Content-Encoding"));
+
+  return aws_s3_client_create_converter (codec, FALSE, converter, error);
+}
+
+static gboolean
+aws_s3_client_check_status (SoupMessage  *message,
+                            GError      **error)
+{
+  g_assert (SOUP_IS_MESSAGE (message));
+
+  if (SOUP_STATUS_IS_SUCCESSFUL (message->status_code))
+    return TRUE;
+
+  if (message->status_code == SOUP_STATUS_CANCELLED)
+    g_set_error (error,
+                 G_IO_ERROR,
+                 G_IO_ERROR_CANCELLED,
+                 "The request was cancelled");
+  else if (message->status_code == SOUP_STATUS_NOT_FOUND)
+    g_set_error (error,
+                 AWS_S3_CLIENT_ERROR,
+                 AWS_S3_CLIENT_ERROR_NOT_FOUND,
+                 "The requested object was not found.");
+  else if (message->status_code == SOUP_STATUS_PRECONDITION_FAILED)
+    g_set_error (error,
+                 AWS_S3_CLIENT_ERROR,
+                 AWS_S3_CLIENT_ERROR_PRECONDITION_FAILED,
+                 "The object was modified.");
+  else if (SOUP_STATUS_IS_CLIENT_ERROR (message->status_code))
+    g_set_error (error,
+                 AWS_S3_CLIENT_ERROR,
+                 AWS_S3_CLIENT_ERROR_BAD_REQUEST,
+                 "The request was invalid.");
+  else
+    g_set_error (error,
+                 AWS_S3_CLIENT_ERROR,
+                 AWS_S3_CLIENT_ERROR_UNKNOWN,
+                 "Request failed: %d",
+                 message->status_code);
+
+  return FALSE;
+}
+
+/*
+ * Creates a new message for @bucket and @path with the headers required
+ * for signing. @query, if any, is appended to the request URI. Callers may
+ * add further headers and a request body before calling
+ * aws_s3_client_sign_message().
+ */
+static SoupMessage *
+aws_s3_client_new_message (AwsS3Client *self,
+                           const gchar *method,
+                           const gchar *bucket,
+                           const gchar *path,
+                           const gchar *query)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (self);
+  g_autofree gchar *date_str = NULL;
+  g_autofree gchar *host = NULL;
+  g_autofree gchar *uri = NULL;
+  g_autoptr(SoupDate) date = NULL;
+  SoupMessage *message;
+  gboolean virtual_hosted;
+  guint16 port;
+
+  g_assert (AWS_IS_S3_CLIENT (self));
+  g_assert (method != NULL);
+  g_assert (bucket != NULL);
+  g_assert (path != NULL);
+
+  /*
+   * Determine our connection port.
+   */
+  port = priv->port_set ? priv->port : (priv->secure ? 443 : 80);
+
+  /*
+   * Build our HTTP request message.
+   */
+  host = aws_s3_client_resolve_host (self, bucket, &virtual_hosted);
+
+  if (virtual_hosted)
+    uri = g_strdup_printf ("%s://%s:%d/%s%s%s",
+                           priv->secure ? "https" : "http",
+                           host,
+                           port,
+                           path,
+                           query ? "?" : "",
+                           query ? query : "");
+  else
+    uri = g_strdup_printf ("%s://%s:%d/%s/%s%s%s",
+                           priv->secure ? "https" : "http",
+                           host,
+                           port,
+                           bucket,
+                           path,
+                           query ? "?" : "",
+                           query ? query : "");
+  message = soup_message_new (method, uri);
+
+  /*
+   * We follow redirects ourselves since the request must be re-signed
+   * against the new endpoint.
+   */
+  soup_message_set_flags (message, SOUP_MESSAGE_NO_REDIRECT);
+
+  /*
+   * Don't let libsoup decode the body out from under our own codecs.
+   */
+  if (priv->read_codec != AWS_S3_CLIENT_CODEC_NONE && g_str_equal (method, SOUP_METHOD_GET))
+    soup_message_disable_feature (message, SOUP_TYPE_CONTENT_DECODER);
+
+  /*
+   * Set the Host header for systems that may be proxying.
+   */
+  if (host != NULL)
+    soup_message_headers_append (message->request_headers, "Host", host);
+
+  /*
+   * Add the Date header which we need for signing.
+   */
+  date = soup_date_new_from_now (0);
+  date_str = soup_date_to_string (date, SOUP_DATE_HTTP);
+  soup_message_headers_append (message->request_headers, "Date", date_str);
+
+  return message;
+}
+
+/*
+ * Query parameters that name a sub-resource and therefore take part in
+ * the canonical resource of a signature. Must remain sorted.
+ */
+static const gchar *subresources[] = {
+  "acl", "cors", "delete", "lifecycle", "location", "logging",
+  "notification", "partNumber", "policy", "requestPayment",
+  "response-cache-control", "response-content-disposition",
+  "response-content-encoding", "response-content-language",
+  "response-content-type", "response-expires", "select", "select-type",
+  "tagging", "torrent", "uploadId", "uploads", "versionId", "versioning",
+  "versions", "website",
+};
+
+static gint
+compare_subresource (gconstpointer a,
+                     gconstpointer b)
+{
+  return strcmp (a, *(const gchar * const *)b);
+}
+
+static gint
+compare_query_params (gconstpointer a,
+                      gconstpointer b)
+{
+  const gchar *param_a = *(const gchar * const *)a;
+  const gchar *param_b = *(const gchar * const *)b;
+  gsize len_a = strcspn (param_a, "=");
+  gsize len_b = strcspn (param_b, "=");
+  gint ret;
+
+  ret = strncmp (param_a, param_b, MIN (len_a, len_b));
+  if (ret == 0)
+    ret = (len_a > len_b) - (len_a < len_b);
+
+  return ret;
+}
+
+/*
+ * Appends the sub-resources found within @query to @str, sorted by name,
+ * as required for the canonical resource.
+ */
+static void
+append_subresources (GString     *str,
+                     const gchar *query)
+{
+  g_auto(GStrv) params = NULL;
+  g_autoptr(GPtrArray) found = NULL;
+  guint i;
+
+  if (query == NULL || *query == '\0')
+    return;
+
+  params = g_strsplit (query, "&", -1);
+  found = g_ptr_array_new ();
+
+  for (i = 0; params [i] != NULL; i++)
+    {
+      g_autofree gchar *name = g_strndup (params [i], strcspn (params [i], "="));
+
+      if (bsearch (name,
+                   subresources,
+                   G_N_ELEMENTS (subresources),
+                   sizeof (gchar *),
+                   compare_subresource))
+        g_ptr_array_add (found, params [i]);
+    }
+
+  g_ptr_array_sort (found, compare_query_params);
+
+  for (i = 0; i < found->len; i++)
+    {
+      g_string_append_c (str, i == 0 ? '?' : '&');
+      g_string_append (str, g_ptr_array_index (found, i));
+    }
+}
+
+/*
+ * Appends @text to @str using the URI encoding required by Signature
+ * Version 4: everything but unreserved characters is percent-encoded,
+ * with '/' kept as-is unless @encode_slash is set.
+ */
+static void
+append_uri_encoded (GString     *str,
+                    const gchar *text,
+                    gboolean     encode_slash)
+{
+  static const gchar hex[] = "0123456789ABCDEF";
+  const guchar *p;
+
+  for (p = (const guchar *)text; *p; p++)
+    {
+      if (g_ascii_isalnum (*p) ||
+          *p == '-' || *p == '.' || *p == '_' || *p == '~' ||
+          (*p == '/' && !encode_slash))
+        g_string_append_c (str, *p);
+      else
+        {
+          g_string_append_c (str, '%');
+          g_string_append_c (str, hex [*p >> 4]);
+          g_string_append_c (str, hex [*p & 0xF]);
+        }
+    }
+}
+
+static void
+hex_encode (const guint8 *data,
+            gsize         len,
+            gchar        *out)
+{
+  static const gchar hex[] = "0123456789abcdef";
+  gsize i;
+
+  for (i = 0; i < len; i++)
+    {
+      out [i * 2] = hex [data [i] >> 4];
+      out [i * 2 + 1] = hex [data [i] & 0xF];
+    }
+
+  out [len * 2] = '\0';
+}
+
+static void
+hmac_sha256 (const guint8 *key,
+             gsize         key_len,
+             const gchar  *data,
+             guint8       *digest)
+{
+  g_autoptr(GHmac) hmac = g_hmac_new (G_CHECKSUM_SHA256, key, key_len);
+  gsize digest_len = 32;
+
+  g_hmac_update (hmac, (const guchar *)data, -1);
+  g_hmac_get_digest (hmac, digest, &digest_len);
+}
+
+/*
+ * Derives the Signature Version 4 signing key for S3 in @region on @date.
+ */
+static void
+derive_signing_key (AwsCredentials *creds,
+                    const gchar    *date,
+                    const gchar    *region,
+                    guint8         *key)
+{
+  g_autofree gchar *secret = NULL;
+
+  secret = g_strconcat ("AWS4", aws_credentials_get_secret_key (creds), NULL);
+  hmac_sha256 ((const guint8 *)secret, strlen (secret), date, key);
+  hmac_sha256 (key, 32, region, key);
+  hmac_sha256 (key, 32, "s3", key);
+  hmac_sha256 (key, 32, "aws4_request", key);
+}
+
+/*
+ * Returns the region of a regional endpoint such as
+ * "bucket.s3.eu-central-1.amazonaws.com", or %NULL for the global
+ * endpoint and any other host.
+ */
+static gchar *
+region_from_host (const gchar *host)
+{
+  const gchar *end;
+  const gchar *p;
+
+  if (host == NULL || !g_str_has_suffix (host, ".amazonaws.com"))
+    return NULL;
+
+  end = host + strlen (host) - strlen (".amazonaws.com");
+
+  for (p = host; p + 3 < end; p++)
+    {
+      if ((p == host || p [-1] == '.') &&
+          strncmp (p, "s3.", 3) == 0 &&
+          memchr (p + 3, '.', end - (p + 3)) == NULL)
+        return g_strndup (p + 3, end - (p + 3));
+    }
+
+  return NULL;
+}
+
+static gchar *
+unescape_or_dup (const gchar *text,
+                 gssize       len)
+{
+  g_autofree gchar *escaped = g_strndup (text, len < 0 ? strlen (text) : (gsize)len);
+  gchar *unescaped;
+
+  if ((unescaped = g_uri_unescape_string (escaped, NULL)))
+    return unescaped;
+
+  return g_steal_pointer (&escaped);
+}
+
+/*
+ * Returns the credentials to sign with. This only takes a reference to the
+ * provider's snapshot and never waits for a load; when there is none yet,
+ * or it has expired without being replaced, a load is requested in the
+ * background and the request is signed with what is at hand.
+ */
+static AwsCredentials *
+aws_s3_client_ref_credentials (AwsS3Client *self)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (self);
+  AwsCredentials *creds;
+
+  g_assert (AWS_IS_S3_CLIENT (self));
+
+  if (priv->provider == NULL)
+    return g_object_ref (priv->creds);
+
+  creds = aws_credentials_provider_get_credentials (priv->provider);
+
+  if (creds == NULL || aws_credentials_is_expired (creds))
+    aws_credentials_provider_request_refresh (priv->provider);
+
+  return creds != NULL ? creds : g_object_ref (priv->creds);
+}
+
+/*
+ * Signs @message for @region with Signature Version 4 in the Authorization
+ * header. The payload is left unsigned, which S3 permits, so that bodies
+ * need not be hashed up front.
+ */
+static void
+aws_s3_client_sign_message_v4 (AwsS3Client    *self,
+                               SoupMessage    *message,
+                               AwsCredentials *creds,
+                               const gchar    *region)
+{
+  g_autoptr(GChecksum) checksum = NULL;
+  g_autoptr(GDateTime) now = NULL;
+  g_autoptr(GHmac) signer = NULL;
+  g_autoptr(GPtrArray) names = NULL;
+  g_autoptr(GString) canonical = NULL;
+  g_autoptr(GString) signed_headers = NULL;
+  g_autoptr(GString) str = NULL;
+  g_autofree gchar *amz_date = NULL;
+  g_autofree gchar *auth = NULL;
+  g_autofree gchar *date = NULL;
+  g_autofree gchar *path = NULL;
+  g_autofree gchar *scope = NULL;
+  SoupURI *uri;
+  const gchar *query;
+  guint8 key [32];
+  guint8 digest [32];
+  gchar hex [65];
+  gsize digest_len = sizeof digest;
+  guint i;
+
+  g_assert (AWS_IS_S3_CLIENT (self));
+  g_assert (SOUP_IS_MESSAGE (message));
+  g_assert (AWS_IS_CREDENTIALS (creds));
+  g_assert (region != NULL);
+
+  now = g_date_time_new_now_utc ();
+  amz_date = g_date_time_format (now, "%Y%m%dT%H%M%SZ");
+  date = g_date_time_format (now, "%Y%m%d");
+  scope = g_strdup_printf ("%s/%s/s3/aws4_request", date, region);
+
+  soup_message_headers_replace (message->request_headers, "x-amz-date", amz_date);
+  soup_message_headers_replace (message->request_headers, "x-amz-content-sha256", "UNSIGNED-PAYLOAD");
+
+  uri = soup_message_get_uri (message);
+
+  canonical = g_string_new (message->method);
+  g_string_append_c (canonical, '\n');
+
+  path = unescape_or_dup (soup_uri_get_path (uri), -1);
+  append_uri_encoded (canonical, path, FALSE);
+  g_string_append_c (canonical, '\n');
+
+  /* Parameters are decoded and re-encoded so they are encoded exactly once */
+  if ((query = soup_uri_get_query (uri)) && *query)
+    {
+      g_auto(GStrv) params = g_strsplit (query, "&", -1);
+      g_autoptr(GPtrArray) sorted = g_ptr_array_new_with_free_func (g_free);
+
+      for (i = 0; params [i] != NULL; i++)
+        {
+          const gchar *eq = strchr (params [i], '=');
+          g_autofree gchar *name = NULL;
+          g_autofree gchar *value = NULL;
+          GString *param = g_string_new (NULL);
+
+          name = unescape_or_dup (params [i], eq ? eq - params [i] : -1);
+          value = unescape_or_dup (eq ? eq + 1 : "", -1);
+
+          append_uri_encoded (param, name, TRUE);
+          g_string_append_c (param, '=');
+          append_uri_encoded (param, value, TRUE);
+          g_ptr_array_add (sorted, g_string_free (param, FALSE));
+        }
+
+      g_ptr_array_sort (sorted, compare_query_params);
+
+      for (i = 0; i < sorted->len; i++)
+        {
+          if (i > 0)
+            g_string_append_c (canonical, '&');
+          g_string_append (canonical, g_ptr_array_index (sorted, i));
+        }
+    }
+  g_string_append_c (canonical, '\n');
+
+  /* Host, content and x-amz-* headers are signed, sorted by name */
+  names = g_ptr_array_new_with_free_func (g_free);
+  soup_message_headers_foreach (message->request_headers, collect_amz_header, names);
+  g_ptr_array_add (names, g_strdup ("host"));
+  if (soup_message_headers_get_one (message->request_headers, "Content-MD5"))
+    g_ptr_array_add (names, g_strdup ("content-md5"));
+  if (soup_message_headers_get_one (message->request_headers, "Content-Type"))
+    g_ptr_array_add (names, g_strdup ("content-type"));
+  g_ptr_array_sort (names, compare_strings);
+
+  signed_headers = g_string_new (NULL);
+
+  for (i = 0; i < names->len; i++)
+    {
+      const gchar *name = g_ptr_array_index (names, i);
+      g_autofree gchar *value = NULL;
+
+      if (i > 0 && g_str_equal (name, g_ptr_array_index (names, i - 1)))
+        continue;
+
+      value = g_strdup (soup_message_headers_get_list (message->request_headers, name));
+      /* libsoup adds the port to Host when it isn't the scheme's default */
+      if (value == NULL && g_str_equal (name, "host"))
+        {
+          if (soup_uri_uses_default_port (uri))
+            value = g_strdup (soup_uri_get_host (uri));
+          else
+            value = g_strdup_printf ("%s:%u", soup_uri_get_host (uri), soup_uri_get_port (uri));
+        }
+
+      g_string_append_printf (canonical, "%s:%s\n", name, value ? g_strstrip (value) : "");
+
+      if (signed_headers->len > 0)
+        g_string_append_c (signed_headers, ';');
+      g_string_append (signed_headers, name);
+    }
+
+  g_string_append_printf (canonical, "\n%s\nUNSIGNED-PAYLOAD", signed_headers->str);
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  g_checksum_update (checksum, (const guchar *)canonical->str, canonical->len);
+  g_checksum_get_digest (checksum, digest, &digest_len);
+  hex_encode (digest, digest_len, hex);
+
+  str = g_string_new (NULL);
+  g_string_printf (str, "AWS4-HMAC-SHA256\n%s\n%s\n%s", amz_date, scope, hex);
+
+  derive_signing_key (creds, date, region, key);
+  signer = g_hmac_new (G_CHECKSUM_SHA256, key, sizeof key);
+  g_hmac_update (signer, (const guchar *)str->str, str->len);
+  digest_len = sizeof digest;
+  g_hmac_get_digest (signer, digest, &digest_len);
+  hex_encode (digest, digest_len, hex);
+
+  auth = g_strdup_printf ("AWS4-HMAC-SHA256 Credential=%s/%s, SignedHeaders=%s, Signature=%s",
+                          aws_credentials_get_access_key (creds),
+                          scope,
+                          signed_headers->str,
+                          hex);
+  soup_message_headers_replace (message->request_headers, "Authorization", auth);
+}
+
+static void
+aws_s3_client_sign_message (AwsS3Client *self,
+                            SoupMessage *message,
+                            const gchar *bucket,
+                            const gchar *path)
+{
+  g_autoptr(AwsCredentials) creds = NULL;
+  g_autoptr(GPtrArray) amz_headers = NULL;
+  g_autoptr(GString) str = NULL;
+  g_autofree gchar *auth = NULL;
+  g_autofree gchar *region = NULL;
+  g_autofree gchar *signature = NULL;
+  const gchar *content_md5;
+  const gchar *content_type;
+  const gchar *date;
+  const gchar *session_token;
+  guint i;
+
+  g_assert (AWS_IS_S3_CLIENT (self));
+  g_assert (SOUP_IS_MESSAGE (message));
+
+  creds = aws_s3_client_ref_credentials (self);
+
+  /*
+   * Temporary credentials carry a token which is itself signed.
+   */
+  if ((session_token = aws_credentials_get_session_token (creds)))
+    soup_message_headers_replace (message->request_headers, "x-amz-security-token", session_token);
+  else
+    soup_message_headers_remove (message->request_headers, "x-amz-security-token");
+
+  /* Regional endpoints may only accept Signature Version 4 */
+  if ((region = region_from_host (soup_uri_get_host (soup_message_get_uri (message)))))
+    {
+      aws_s3_client_sign_message_v4 (self, message, creds, region);
+      return;
+    }
+
+  /* Left over when @message is a copy of one signed for a regional endpoint */
+  soup_message_headers_remove (message->request_headers, "x-amz-date");
+  soup_message_headers_remove (message->request_headers, "x-amz-content-sha256");
+
+  content_md5 = soup_message_headers_get_one (message->request_headers, "Content-MD5");
+  content_type = soup_message_headers_get_one (message->request_headers, "Content-Type");
+  date = soup_message_headers_get_one (message->request_headers, "Date");
+
+  str = g_string_new (message->method);
+  g_string_append_printf (str, "\n%s\n%s\n%s\n",
+                          content_md5 ? content_md5 : "",
+                          content_type ? content_type : "",
+                          date ? date : "");
+
+  /*
+   * Any x-amz-* headers are part of the signature, sorted by name.
+   */
+  amz_headers = g_ptr_array_new_with_free_func (g_free);
+  soup_message_headers_foreach (message->request_headers, collect_amz_header, amz_headers);
+  g_ptr_array_sort (amz_headers, compare_strings);
+
+  for (i = 0; i < amz_headers->len; i++)
+    {
+      const gchar *name = g_ptr_array_index (amz_headers, i);
+
+      if (i > 0 && g_str_equal (name, g_ptr_array_index (amz_headers, i - 1)))
+        continue;
+
+      g_string_append_printf (str, "%s:%s\n",
+                              name,
+                              soup_message_headers_get_list (message->request_headers, name));
+    }
+
+  g_string_append_printf (str, "/%s/%s", bucket, path);
+  append_subresources (str, soup_uri_get_query (soup_message_get_uri (message)));
+  signature = aws_credentials_sign (creds, str->str, str->len, G_CHECKSUM_SHA1);
+
+  /*
+   * Attach request signature to our headers.
+   */
+  auth = g_strdup_printf ("AWS %s:%s",
+                          aws_credentials_get_access_key (creds),
+                          signature);
+  soup_message_headers_replace (message->request_headers, "Authorization", auth);
+}
+
+static void
+copy_request_header (const gchar *name,
+                     const gchar *value,
+                     gpointer     user_data)
+{
+  SoupMessage *message = user_data;
+
+  if (g_ascii_strcasecmp (name, "Host") != 0 &&
+      g_ascii_strcasecmp (name, "Date") != 0 &&
+      g_ascii_strcasecmp (name, "Authorization") != 0)
+    soup_message_headers_append (message->request_headers, name, value);
+}
+
+/*
+ * If @message failed because the bucket lives in another region, learns
+ * that region and returns a copy of @message signed for the regional
+ * endpoint. Returns %NULL if retrying would not change anything.
+ */
+static SoupMessage *
+aws_s3_client_redirect_message (AwsS3Client *self,
+                                SoupMessage *message,
+                                const gchar *bucket,
+                                const gchar *path)
+{
+  g_autoptr(SoupMessage) retry = NULL;
+  SoupBuffer *body;
+
+  g_assert (AWS_IS_S3_CLIENT (self));
+  g_assert (SOUP_IS_MESSAGE (message));
+
+  if (message->status_code != SOUP_STATUS_MOVED_PERMANENTLY &&
+      message->status_code != SOUP_STATUS_TEMPORARY_REDIRECT &&
+      message->status_code != SOUP_STATUS_BAD_REQUEST)
+    return NULL;
+
+  aws_s3_client_learn_region (self, bucket, message);
+
+  retry = aws_s3_client_new_message (self,
+                                     message->method,
+                                     bucket,
+                                     path,
+                                     soup_uri_get_query (soup_message_get_uri (message)));
+
+  if (g_strcmp0 (soup_uri_get_host (soup_message_get_uri (message)),
+                 soup_uri_get_host (soup_message_get_uri (retry))) == 0)
+    return NULL;
+
+  soup_message_headers_foreach (message->request_headers, copy_request_header, retry);
+
+  body = soup_message_body_flatten (message->request_body);
+  if (body->length > 0)
+    soup_message_body_append_buffer (retry->request_body, body);
+  soup_buffer_free (body);
+
+  aws_s3_client_sign_message (self, retry, bucket, path);
+
+  return g_steal_pointer (&retry);
+}
+
+/*
+ * Builds a signed PUT message taking ownership of the data within
+ * @contents, which must already be closed.
+ */
+static SoupMessage *
+aws_s3_client_new_put_message (AwsS3Client      *self,
+                               const gchar      *bucket,
+                               const gchar      *path,
+                               AwsS3ClientCodec  codec,
+                               GBytes           *body)
+{
+  SoupMessage *message;
+  SoupBuffer *buffer;
+  const gchar *content_encoding;
+  gconstpointer data;
+  gsize size;
+
+  g_assert (AWS_IS_S3_CLIENT (self));
+  g_assert (body != NULL);
+
+  data = g_bytes_get_data (body, &size);
+
+  /* The buffer shares @body rather than copying it */
+  buffer = soup_buffer_new_with_owner (data, size, g_bytes_ref (body), (GDestroyNotify)g_bytes_unref);
+
+  message = aws_s3_client_new_message (self, SOUP_METHOD_PUT, bucket, path, NULL);
+  soup_message_headers_replace (message->request_headers, "Content-Type", "application/octet-stream");
+  soup_message_body_append_buffer (message->request_body, buffer);
+  soup_buffer_free (buffer);
+
+  if ((content_encoding = codec_to_content_encoding (codec)))
+    soup_message_headers_replace (message->request_headers, "Content-Encoding", content_encoding);
+
+  aws_s3_client_sign_message (self, message, bucket, path);
+
+  return message;
+}
+
+/*
+ * Sends @message synchronously, returning the response body stream only
+ * if the request was successful. If the request had to be redirected to
+ * another region, @message is replaced with the message that was sent.
+ */
+static GInputStream *
+aws_s3_client_send_sync (AwsS3Client   *self,
+                         SoupMessage  **message,
+                         const gchar   *bucket,
+                         const gchar   *path,
+                         GCancellable  *cancellable,
+                         GError       **error)
+{
+  g_autoptr(GInputStream) stream = NULL;
+  SoupMessage *retry;
+  gint64 begin_time;
+
+  g_assert (AWS_IS_S3_CLIENT (self));
+  g_assert (message != NULL);
+  g_assert (SOUP_IS_MESSAGE (*message));
+
+  begin_time = g_get_monotonic_time ();
+
+  AWS_PROBE_REQUEST_QUEUED (*message, bucket, path);
+
+  if (!(stream = soup_session_send (SOUP_SESSION (self), *message, cancellable, error)))
+    return NULL;
+
+  AWS_PROBE_REQUEST_HEADERS (*message, bucket, path);
+
+  if (!SOUP_STATUS_IS_SUCCESSFUL ((*message)->status_code) &&
+      (retry = aws_s3_client_redirect_message (self, *message, bucket, path)))
+    {
+      AWS_PROBE_REQUEST_RETRY (*message, bucket, path, begin_time);
+      g_input_stream_close (stream, NULL, NULL);
+      g_clear_object (&stream);
+      g_object_unref (*message);
+      *message = retry;
+
+      AWS_PROBE_REQUEST_QUEUED (*message, bucket, path);
+
+      if (!(stream = soup_session_send (SOUP_SESSION (self), *message, cancellable, error)))
+        return NULL;
+
+      AWS_PROBE_REQUEST_HEADERS (*message, bucket, path);
+    }
+
+  AWS_PROBE_REQUEST_DONE (*message, bucket, path, begin_time);
+
+  if (!aws_s3_client_check_status (*message, error))
+    {
+      g_input_stream_close (stream, NULL, NULL);
+      return NULL;
+    }
+
+  aws_s3_client_learn_region (self, bucket, *message);
+
+  return g_steal_pointer (&stream);
+}
+
+/*
+ * Wraps @stream so that it yields decompressed data according to @codec.
+ */
+static GInputStream *
+aws_s3_client_wrap_read_stream (AwsS3ClientCodec   codec,
+                                SoupMessage       *message,
+                                GInputStream      *stream,
+                                GError           **error)
+{
+  g_autoptr(GConverter) converter = NULL;
+
+  g_assert (SOUP_IS_MESSAGE (message));
+  g_assert (G_IS_INPUT_STREAM (stream));
+
+  if (!aws_s3_client_create_decompressor (codec, message, &converter, error))
+    return NULL;
+
+  if (converter == NULL)
+    return g_object_ref (stream);
+
+  return g_converter_input_stream_new (stream, converter);
+}
+
+/*
+ * Wraps @stream so that it yields data compressed according to @codec.
+ */
+static GInputStream *
+aws_s3_client_wrap_write_stream (AwsS3ClientCodec   codec,
+                                 GInputStream      *stream,
+                                 GError           **error)
+{
+  g_autoptr(GConverter) converter = NULL;
+  GInputStream *wrapped;
+
+  g_assert (G_IS_INPUT_STREAM (stream));
+
+  if (!aws_s3_client_create_converter (codec, TRUE, &converter, error))
+    return NULL;
+
+  if (converter == NULL)
+    return g_object_ref (stream);
+
+  /* @stream belongs to the caller, leave it open */
+  wrapped = g_converter_input_stream_new (stream, converter);
+  g_filter_input_stream_set_close_base_stream (G_FILTER_INPUT_STREAM (wrapped), FALSE);
+
+  return wrapped;
+}
+
+/*
+ * Makes sure there is a block to gather data into. With a buffer pool each
+ * block is a pooled buffer that is handed off to the data handler; without
+ * one a single scratch block is reused.
+ */
+static void
+read_state_reserve_block (ReadState *state)
+{
+  g_assert (state != NULL);
+
+  if (state->block != NULL)
+    return;
+
+  if (state->pool != NULL)
+    {
+      state->pooled = aws_buffer_pool_acquire (state->pool);
+      state->block = state->pooled->data;
+      state->block_size = aws_buffer_pool_get_buffer_size (state->pool);
+    }
+  else
+    {
+      state->block = g_malloc (READ_CHUNK_SIZE);
+      state->block_size = READ_CHUNK_SIZE;
+    }
+}
+
+/*
+ * Hands whatever has been gathered into the current block to the data
+ * handler. Pooled blocks are given away; the next one is acquired lazily.
+ */
+static gboolean
+aws_s3_client_read_flush (AwsS3Client  *client,
+                          SoupMessage  *message,
+                          ReadState    *state,
+                          GError      **error)
+{
+  SoupBuffer *buffer;
+  gsize len;
+  gboolean ret;
+
+  g_assert (AWS_IS_S3_CLIENT (client));
+  g_assert (state != NULL);
+
+  if (state->block_len == 0)
+    return TRUE;
+
+  len = state->block_len;
+  state->block_len = 0;
+
+  if (state->pooled != NULL)
+    {
+      buffer = aws_pooled_buffer_to_soup (g_steal_pointer (&state->pooled), len);
+      state->block = NULL;
+    }
+  else if (state->outputs != NULL)
+    buffer = soup_buffer_new (SOUP_MEMORY_TAKE, g_steal_pointer (&state->block), len);
+  else
+    buffer = soup_buffer_new (SOUP_MEMORY_TEMPORARY, state->block, len);
+
+  /* On a transform thread; the block is delivered from the main context */
+  if (state->outputs != NULL)
+    {
+      g_ptr_array_add (state->outputs, buffer);
+      return TRUE;
+    }
+
+  AWS_PROBE_HANDLER_ENTER (state->bucket, state->path, len);
+  ret = state->handler (client, message, buffer, state->handler_data);
+  AWS_PROBE_HANDLER_EXIT (state->bucket, state->path, len, ret);
+  soup_buffer_free (buffer);
+
+  if (!ret)
+    g_set_error (error,
+                 G_IO_ERROR,
+                 G_IO_ERROR_CANCELLED,
+                 "The request was cancelled");
+
+  return ret;
+}
+
+/*
+ * Copies @data into the current block, delivering each block as it fills.
+ */
+static gboolean
+aws_s3_client_read_gather (AwsS3Client   *client,
+                           SoupMessage   *message,
+                           ReadState     *state,
+                           const guint8  *data,
+                           gsize          len,
+                           GError       **error)
+{
+  g_assert (AWS_IS_S3_CLIENT (client));
+  g_assert (state != NULL);
+
+  while (len > 0)
+    {
+      gsize n;
+
+      read_state_reserve_block (state);
+
+      n = MIN (len, state->block_size - state->block_len);
+      memcpy (state->block + state->block_len, data, n);
+      state->block_len += n;
+      data += n;
+      len -= n;
+
+      if (state->block_len == state->block_size &&
+          !aws_s3_client_read_flush (client, message, state, error))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*
+ * Feeds @data through the decompressor straight into the current block,
+ * handing it to the data handler each time it fills up. When @at_end is
+ * set the stream is finished and the remaining partial block is delivered.
+ */
+static gboolean
+aws_s3_client_read_decompress (AwsS3Client   *client,
+                               SoupMessage   *message,
+                               ReadState     *state,
+                               const guint8  *data,
+                               gsize          len,
+                               gboolean       at_end,
+                               GError       **error)
+{
+  GConverterFlags flags = at_end ? G_CONVERTER_INPUT_AT_END : G_CONVERTER_NO_FLAGS;
+
+  g_assert (AWS_IS_S3_CLIENT (client));
+  g_assert (state != NULL);
+  g_assert (G_IS_CONVERTER (state->decompressor));
+
+  for (;;)
+    {
+      GConverterResult res;
+      GError *local_error = NULL;
+      gsize bytes_read = 0;
+      gsize bytes_written = 0;
+
+      if (state->decompressor_finished)
+        {
+          if (len == 0)
+            {
+              if (!at_end)
+                return TRUE;
+              break;
+            }
+
+          /* Concatenated members, as produced by parallel compressors. */
+          g_converter_reset (state->decompressor);
+          state->decompressor_finished = FALSE;
+        }
+      else if (len == 0 && !at_end)
+        return TRUE;
+
+      read_state_reserve_block (state);
+
+      res = g_converter_convert (state->decompressor,
+                                 data,
+                                 len,
+                                 state->block + state->block_len,
+                                 state->block_size - state->block_len,
+                                 flags,
+                                 &bytes_read,
+                                 &bytes_written,
+                                 &local_error);
+
+      if (res == G_CONVERTER_ERROR)
+        {
+          /* Input ended mid-block, wait for the next chunk. */
+          if (!at_end && g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT))
+            {
+              g_clear_error (&local_error);
+              return TRUE;
+            }
+
+          g_propagate_error (error, local_error);
+          return FALSE;
+        }
+
+      data += bytes_read;
+      len -= bytes_read;
+      state->block_len += bytes_written;
+
+      if (res == G_CONVERTER_FINISHED)
+        state->decompressor_finished = TRUE;
+
+      if (state->block_len == state->block_size &&
+          !aws_s3_client_read_flush (client, message, state, error))
+        return FALSE;
+    }
+
+  return aws_s3_client_read_flush (client, message, state, error);
+}
+
+static void
+transform_job_free (gpointer data)
+{
+  TransformJob *job = data;
+
+  g_clear_object (&job->task);
+  g_clear_object (&job->message);
+  g_clear_pointer (&job->input, soup_buffer_free);
+  g_clear_pointer (&job->outputs, g_ptr_array_unref);
+  g_clear_error (&job->error);
+  g_slice_free (TransformJob, job);
+}
+
+/*
+ * Runs on a transform thread. The executor runs one job of a read at a
+ * time, so the decompressor and current block need no locking.
+ */
+static void
+aws_s3_client_transform_work (gpointer data)
+{
+  TransformJob *job = data;
+  AwsS3Client *client = g_task_get_source_object (job->task);
+  ReadState *state = g_task_get_task_data (job->task);
+
+  if (state->transform_failed)
+    return;
+
+  state->outputs = job->outputs;
+
+  if (!aws_s3_client_read_decompress (client,
+                                      job->message,
+                                      state,
+                                      job->input != NULL ? (const guint8 *)job->input->data : NULL,
+                                      job->input != NULL ? job->input->length : 0,
+                                      job->at_end,
+                                      &job->error))
+    state->transform_failed = TRUE;
+
+  state->outputs = NULL;
+}
+
+/*
+ * Runs on the main context in the order jobs were pushed, handing the
+ * blocks a job produced to the data handler and resuming the read once
+ * enough of the backlog has drained.
+ */
+static void
+aws_s3_client_transform_done (gpointer data)
+{
+  TransformJob *job = data;
+  AwsS3Client *client = g_task_get_source_object (job->task);
+  ReadState *state = g_task_get_task_data (job->task);
+  guint i;
+
+  if (g_task_get_completed (job->task))
+    return;
+
+  for (i = 0; job->error == NULL && i < job->outputs->len; i++)
+    {
+      SoupBuffer *buffer = g_ptr_array_index (job->outputs, i);
+      gboolean proceed;
+
+      AWS_PROBE_HANDLER_ENTER (state->bucket, state->path, buffer->length);
+      proceed = state->handler (client, job->message, buffer, state->handler_data);
+      AWS_PROBE_HANDLER_EXIT (state->bucket, state->path, buffer->length, proceed);
+
+      if (!proceed)
+        job->error = g_error_new (G_IO_ERROR,
+                                  G_IO_ERROR_CANCELLED,
+                                  "The request was cancelled");
+    }
+
+  if (job->error != NULL)
+    {
+      g_task_return_error (job->task, g_steal_pointer (&job->error));
+
+      /* The final job runs after the message has completed */
+      if (!job->at_end)
+        {
+          state->paused = FALSE;
+          soup_session_cancel_message (SOUP_SESSION (client), job->message, SOUP_STATUS_CANCELLED);
+        }
+    }
+  else if (job->at_end)
+    g_task_return_boolean (job->task, TRUE);
+  else if (state->paused &&
+           aws_serial_executor_get_pending (state->executor) <= TRANSFORM_RESUME_PENDING)
+    {
+      state->paused = FALSE;
+      soup_session_unpause_message (SOUP_SESSION (client), job->message);
+    }
+}
+
+/*
+ * Queues @input, or the end of the stream when @at_end is set, to be
+ * decompressed on a transform thread. Takes ownership of @input.
+ */
+static void
+aws_s3_client_push_transform (SoupMessage *message,
+                              GTask       *task,
+                              SoupBuffer  *input,
+                              gboolean     at_end)
+{
+  ReadState *state = g_task_get_task_data (task);
+  TransformJob *job;
+
+  g_assert (state->executor != NULL);
+
+  job = g_slice_new0 (TransformJob);
+  job->task = g_object_ref (task);
+  job->message = g_object_ref (message);
+  job->input = input;
+  job->outputs = g_ptr_array_new_with_free_func ((GDestroyNotify)soup_buffer_free);
+  job->at_end = at_end;
+
+  aws_serial_executor_push (state->executor,
+                            aws_s3_client_transform_work,
+                            aws_s3_client_transform_done,
+                            job,
+                            transform_job_free);
+}
+
+static void aws_s3_client_queue_read (AwsS3Client *client,
+                                      SoupMessage *message,
+                                      GTask       *task);
+
+static void
+aws_s3_client_read_cb (SoupSession *session,
+                       SoupMessage *message,
+                       gpointer     user_data)
+{
+  g_autoptr(GTask) task = user_data;
+  ReadState *state;
+  GError *error = NULL;
+
+  g_assert (SOUP_IS_MESSAGE (message));
+
+  state = g_task_get_task_data (task);
+  g_assert (state != NULL);
+
+  /* got_headers() may have found the bucket in another region */
+  if (state->retry != NULL)
+    {
+      state->redirected = TRUE;
+      aws_s3_client_queue_read (g_task_get_source_object (task),
+                                g_steal_pointer (&state->retry),
+                                g_steal_pointer (&task));
+      return;
+    }
+
+  AWS_PROBE_REQUEST_DONE (message, state->bucket, state->path, state->begin_time);
+
+  /* We might have completed in got_chunk() from a handler */
+  if (g_task_get_completed (task))
+    return;
+
+  if (!aws_s3_client_check_status (message, &error))
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  /* Completes once every chunk queued before it has been delivered */
+  if (state->executor != NULL)
+    {
+      aws_s3_client_push_transform (message, task, NULL, TRUE);
+      return;
+    }
+
+  /* Flush whatever the decompressor or the last block is holding on to */
+  if (state->decompressor != NULL)
+    {
+      if (!aws_s3_client_read_decompress (g_task_get_source_object (task),
+                                          message,
+                                          state,
+                                          NULL,
+                                          0,
+                                          TRUE,
+                                          &error))
+        {
+          g_task_return_error (task, error);
+          return;
+        }
+    }
+  else if (!aws_s3_client_read_flush (g_task_get_source_object (task), message, state, &error))
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static void
+aws_s3_client_read_got_chunk (SoupMessage *message,
+                              SoupBuffer  *buffer,
+                              GTask       *task)
+{
+  AwsS3Client *client;
+  ReadState *state;
+  GError *error = NULL;
+
+  g_assert (SOUP_IS_MESSAGE (message));
+  g_assert (buffer != NULL);
+  g_assert (G_IS_TASK (task));
+
+  client = g_task_get_source_object (task);
+  g_assert (AWS_IS_S3_CLIENT (client));
+
+  state = g_task_get_task_data (task);
+  g_assert (state != NULL);
+  g_assert (state->handler != NULL);
+
+  AWS_PROBE_REQUEST_CHUNK (state->bucket, state->path, buffer->length);
+
+  if (state->executor != NULL)
+    {
+      aws_s3_client_push_transform (message, task, soup_buffer_copy (buffer), FALSE);
+
+      /* Stop reading from the socket until the transform threads catch up */
+      if (!state->paused &&
+          aws_serial_executor_get_pending (state->executor) >= TRANSFORM_MAX_PENDING)
+        {
+          state->paused = TRUE;
+          soup_session_pause_message (SOUP_SESSION (client), message);
+        }
+    }
+  else if (state->decompressor != NULL)
+    {
+      if (!aws_s3_client_read_decompress (client,
+                                          message,
+                                          state,
+                                          (const guint8 *)buffer->data,
+                                          buffer->length,
+                                          FALSE,
+                                          &error))
+        {
+          g_task_return_error (task, error);
+          soup_session_cancel_message (SOUP_SESSION (client), message, SOUP_STATUS_CANCELLED);
+        }
+    }
+  else if (state->pool != NULL)
+    {
+      if (!aws_s3_client_read_gather (client,
+                                      message,
+                                      state,
+                                      (const guint8 *)buffer->data,
+                                      buffer->length,
+                                      &error))
+        {
+          g_task_return_error (task, error);
+          soup_session_cancel_message (SOUP_SESSION (client), message, SOUP_STATUS_CANCELLED);
+        }
+    }
+  else
+    {
+      gboolean proceed;
+
+      AWS_PROBE_HANDLER_ENTER (state->bucket, state->path, buffer->length);
+      proceed = state->handler (client, message, buffer, state->handler_data);
+      AWS_PROBE_HANDLER_EXIT (state->bucket, state->path, buffer->length, proceed);
+
+      if (!proceed)
+        {
+          g_task_return_new_error (task,
+                                   G_IO_ERROR,
+                                   G_IO_ERROR_CANCELLED,
+                                   "The request was cancelled");
+          soup_session_cancel_message (SOUP_SESSION (client), message, SOUP_STATUS_CANCELLED);
+        }
+    }
+}
+
+static void
+aws_s3_client_read_got_headers (SoupMessage *message,
+                                GTask       *task)
+{
+  AwsS3Client *client;
+  ReadState *state;
+  GError *error = NULL;
+
+  g_assert (SOUP_IS_MESSAGE(message));
+  g_assert (G_IS_TASK (task));
+
+  client = g_task_get_source_object (task);
+  g_assert (AWS_IS_S3_CLIENT (client));
+
+  state = g_task_get_task_data (task);
+  g_assert (state != NULL);
+
+  AWS_PROBE_REQUEST_HEADERS (message, state->bucket, state->path);
+
+  /*
+   * If the bucket lives in another region, resubmit once against the
+   * regional endpoint when this message completes.
+   */
+  if (!SOUP_STATUS_IS_SUCCESSFUL (message->status_code) &&
+      !state->redirected &&
+      (state->retry = aws_s3_client_redirect_message (client, message, state->bucket, state->path)))
+    {
+      AWS_PROBE_REQUEST_RETRY (message, state->bucket, state->path, state->begin_time);
+      soup_session_cancel_message (SOUP_SESSION (client), message, SOUP_STATUS_CANCELLED);
+      return;
+    }
+
+  if (aws_s3_client_check_status (message, &error))
+    {
+      aws_s3_client_learn_region (client, state->bucket, message);
+
+      if (!aws_s3_client_create_decompressor (state->codec, message, &state->decompressor, &error))
+        {
+          g_task_return_error (task, error);
+          soup_session_cancel_message (SOUP_SESSION (client), message, SOUP_STATUS_CANCELLED);
+        }
+      else if (state->decompressor != NULL && state->executor == NULL)
+        state->executor = aws_s3_client_new_transform_executor (client);
+    }
+  else
+    {
+      guint status_code = message->status_code;
+
+      g_task_return_error (task, error);
+
+      if (!SOUP_STATUS_IS_CLIENT_ERROR (status_code))
+        status_code = SOUP_STATUS_CANCELLED;
+
+      soup_session_cancel_message (SOUP_SESSION (client), message, status_code);
+    }
+}
+
+/*
+ * Submits a signed read @message, taking ownership of both @message
+ * and @task.
+ */
+static void
+aws_s3_client_queue_read (AwsS3Client *client,
+                          SoupMessage *message,
+                          GTask       *task)
+{
+  ReadState *state;
+
+  g_assert (AWS_IS_S3_CLIENT (client));
+  g_assert (SOUP_IS_MESSAGE (message));
+  g_assert (G_IS_TASK (task));
+
+  state = g_task_get_task_data (task);
+  g_assert (state != NULL);
+
+  soup_message_body_set_accumulate (message->response_body, FALSE);
+  g_signal_connect_object (message,
+                           "got-chunk",
+                           G_CALLBACK (aws_s3_client_read_got_chunk),
+                           task,
+                           0);
+  g_signal_connect_object (message,
+                           "got-headers",
+                           G_CALLBACK (aws_s3_client_read_got_headers),
+                           task,
+                           0);
+
+  /*
+   * Submit our request to the target.
+   */
+  AWS_PROBE_REQUEST_QUEUED (message, state->bucket, state->path);
+  soup_session_queue_message (SOUP_SESSION (client), message, aws_s3_client_read_cb, task);
+}
+
+void
+aws_s3_client_read_async (AwsS3Client            *client,
+                          const gchar            *bucket,
+                          const gchar            *path,
+                          AwsS3ClientDataHandler  handler,
+                          gpointer                handler_data,
+                          GDestroyNotify          handler_notify,
+                          GCancellable           *cancellable,
+                          GAsyncReadyCallback     callback,
+                          gpointer                user_data)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (client);
+  g_autoptr(GTask) task = NULL;
+  g_autoptr(SoupMessage) message = NULL;
+  ReadState *state;
+
+  g_return_if_fail (AWS_IS_S3_CLIENT(client));
+  g_return_if_fail (bucket);
+  g_return_if_fail (path);
+  g_return_if_fail (g_utf8_validate(bucket, -1, NULL));
+  g_return_if_fail (g_utf8_validate(path, -1, NULL));
+  g_return_if_fail (handler != NULL);
+
+  task = g_task_new (client, cancellable, callback, user_data);
+  g_task_set_source_tag (task, aws_s3_client_read_async);
+
+  /*
+   * Strip leading '/' from the path.
+   */
+  path = skip_leading_slashes (path);
+
+  state = read_state_new (bucket, path, handler, handler_data, handler_notify);
+  state->codec = priv->read_codec;
+  if (priv->pool != NULL)
+    state->pool = aws_buffer_pool_ref (priv->pool);
+  g_task_set_task_data (task, state, read_state_free);
+
+  /*
+   * Build and sign our HTTP request message.
+   */
+  message = aws_s3_client_new_message (client, SOUP_METHOD_GET, bucket, path, NULL);
+  aws_s3_client_sign_message (client, message, bucket, path);
+
+  aws_s3_client_queue_read (client,
+                            g_steal_pointer (&message),
+                            g_steal_pointer (&task));
+}
+
+gboolean
+aws_s3_client_read_finish (AwsS3Client   *client,
+                           GAsyncResult  *result,
+                           GError       **error)
+{
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), FALSE);
+  g_return_val_if_fail (G_IS_TASK (result), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/**
+ * aws_s3_client_read_sync:
+ * @client: An #AwsS3Client.
+ * @bucket: The bucket containing the object.
+ * @path: The path of the object within @bucket.
+ * @handler: (scope call): A handler for incoming data.
+ * @handler_data: User data for @handler.
+ * @cancellable: (nullable): A #GCancellable, or %NULL.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Synchronously reads the object at @path, calling @handler for each
+ * block of data received. This does not require a main loop and is
+ * intended for use from worker threads.
+ *
+ * The #SoupBuffer passed to @handler is only valid for the duration of
+ * the call; use soup_buffer_copy() to keep it around. Blocks are
+ * #AwsS3Client:delivery-size bytes when that is set.
+ *
+ * Returns: %TRUE if the object was read in full; otherwise %FALSE and
+ *   @error is set.
+ */
+gboolean
+aws_s3_client_read_sync (AwsS3Client             *client,
+                         const gchar             *bucket,
+                         const gchar             *path,
+                         AwsS3ClientDataHandler   handler,
+                         gpointer                 handler_data,
+                         GCancellable            *cancellable,
+                         GError                 **error)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (client);
+  g_autoptr(SoupMessage) message = NULL;
+  g_autoptr(GInputStream) response = NULL;
+  g_autoptr(GInputStream) stream = NULL;
+  g_autoptr(AwsBufferPool) pool = NULL;
+  g_autofree guint8 *data = NULL;
+  gsize block_size = READ_CHUNK_SIZE;
+  gboolean ret = FALSE;
+
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), FALSE);
+  g_return_val_if_fail (bucket != NULL, FALSE);
+  g_return_val_if_fail (path != NULL, FALSE);
+  g_return_val_if_fail (handler != NULL, FALSE);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), FALSE);
+
+  path = skip_leading_slashes (path);
+
+  message = aws_s3_client_new_message (client, SOUP_METHOD_GET, bucket, path, NULL);
+  aws_s3_client_sign_message (client, message, bucket, path);
+
+  if (!(response = aws_s3_client_send_sync (client, &message, bucket, path, cancellable, error)))
+    return FALSE;
+
+  if (!(stream = aws_s3_client_wrap_read_stream (priv->read_codec, message, response, error)))
+    {
+      g_input_stream_close (response, NULL, NULL);
+      return FALSE;
+    }
+
+  if (priv->pool != NULL)
+    {
+      pool = aws_buffer_pool_ref (priv->pool);
+      block_size = aws_buffer_pool_get_buffer_size (pool);
+    }
+  else
+    data = g_malloc (READ_CHUNK_SIZE);
+
+  for (;;)
+    {
+      AwsPooledBuffer *pooled = NULL;
+      SoupBuffer *buffer;
+      guint8 *block = data;
+      gsize n_read = 0;
+      gboolean proceed;
+
+      /* Read pooled blocks in place so they can be handed off without a copy */
+      if (pool != NULL)
+        {
+          pooled = aws_buffer_pool_acquire (pool);
+          block = pooled->data;
+        }
+
+      if (!g_input_stream_read_all (stream, block, block_size, &n_read, cancellable, error))
+        {
+          g_clear_pointer (&pooled, aws_buffer_pool_release);
+          break;
+        }
+
+      if (n_read == 0)
+        {
+          g_clear_pointer (&pooled, aws_buffer_pool_release);
+          ret = TRUE;
+          break;
+        }
+
+      if (pooled != NULL)
+        buffer = aws_pooled_buffer_to_soup (pooled, n_read);
+      else
+        buffer = soup_buffer_new (SOUP_MEMORY_TEMPORARY, data, n_read);
+      AWS_PROBE_REQUEST_CHUNK (bucket, path, n_read);
+      AWS_PROBE_HANDLER_ENTER (bucket, path, n_read);
+      proceed = handler (client, message, buffer, handler_data);
+      AWS_PROBE_HANDLER_EXIT (bucket, path, n_read, proceed);
+      soup_buffer_free (buffer);
+
+      if (!proceed)
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_CANCELLED,
+                       "The request was cancelled");
+          break;
+        }
+
+      if (n_read < block_size)
+        {
+          ret = TRUE;
+          break;
+        }
+    }
+
+  g_input_stream_close (stream, NULL, NULL);
+
+  return ret;
+}
+
+/**
+ * aws_s3_client_open_sync:
+ * @client: An #AwsS3Client.
+ * @bucket: The bucket containing the object.
+ * @path: The path of the object within @bucket.
+ * @cancellable: (nullable): A #GCancellable, or %NULL.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Synchronously requests the object at @path and returns a stream of its
+ * contents once the response headers have been received. The stream is
+ * decompressed according to #AwsS3Client:read-codec.
+ *
+ * Returns: (transfer full): A #GInputStream or %NULL and @error is set.
+ */
+GInputStream *
+aws_s3_client_open_sync (AwsS3Client   *client,
+                         const gchar   *bucket,
+                         const gchar   *path,
+                         GCancellable  *cancellable,
+                         GError       **error)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (client);
+  g_autoptr(SoupMessage) message = NULL;
+  g_autoptr(GInputStream) response = NULL;
+  GInputStream *stream;
+
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), NULL);
+  g_return_val_if_fail (bucket != NULL, NULL);
+  g_return_val_if_fail (path != NULL, NULL);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), NULL);
+
+  path = skip_leading_slashes (path);
+
+  message = aws_s3_client_new_message (client, SOUP_METHOD_GET, bucket, path, NULL);
+  aws_s3_client_sign_message (client, message, bucket, path);
+
+  if (!(response = aws_s3_client_send_sync (client, &message, bucket, path, cancellable, error)))
+    return NULL;
+
+  if (!(stream = aws_s3_client_wrap_read_stream (priv->read_codec, message, response, error)))
+    g_input_stream_close (response, NULL, NULL);
+
+  return stream;
+}
+
+/*
+ * Prepares everything that presigned URLs for @bucket have in common: the
+ * derived signing key, the credential scope and query string, and the
+ * constant parts of the canonical request. The canonical request checksum
+ * is seeded with everything before the object key, and the HMAC is keyed
+ * and seeded with the string-to-sign header, so that each URL only needs
+ * to copy them and hash its own key.
+ */
+static void
+presign_context_init (AwsS3Client    *self,
+                      PresignContext *ctx,
+                      const gchar    *method,
+                      const gchar    *bucket,
+                      guint           expires_in)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (self);
+  g_autoptr(AwsCredentials) creds = NULL;
+  g_autoptr(GDateTime) now = NULL;
+  g_autoptr(GString) str = NULL;
+  g_autofree gchar *amz_date = NULL;
+  g_autofree gchar *date = NULL;
+  g_autofree gchar *host = NULL;
+  g_autofree gchar *region = NULL;
+  g_autofree gchar *scope = NULL;
+  const gchar *session_token;
+  guint8 key [32];
+  gboolean virtual_hosted;
+
+  g_assert (AWS_IS_S3_CLIENT (self));
+  g_assert (ctx != NULL);
+  g_assert (method != NULL);
+  g_assert (bucket != NULL);
+
+  creds = aws_s3_client_ref_credentials (self);
+  session_token = aws_credentials_get_session_token (creds);
+
+  now = g_date_time_new_now_utc ();
+  amz_date = g_date_time_format (now, "%Y%m%dT%H%M%SZ");
+  date = g_date_time_format (now, "%Y%m%d");
+
+  if (priv->region_cache_ttl == 0 || !(region = aws_s3_client_lookup_region (self, bucket)))
+    region = g_strdup (priv->region);
+
+  scope = g_strdup_printf ("%s/%s/s3/aws4_request", date, region);
+
+  derive_signing_key (creds, date, region, key);
+
+  /*
+   * Clients only send the port in the Host header when it isn't the
+   * default, so it must only be signed in that case too.
+   */
+  host = aws_s3_client_resolve_host (self, bucket, &virtual_hosted);
+  if (priv->port_set && priv->port != (priv->secure ? 443 : 80))
+    {
+      gchar *with_port = g_strdup_printf ("%s:%u", host, priv->port);
+
+      g_free (host);
+      host = with_port;
+    }
+
+  /* The canonical URI up to the object key */
+  str = g_string_new ("/");
+  if (!virtual_hosted)
+    {
+      append_uri_encoded (str, bucket, TRUE);
+      g_string_append_c (str, '/');
+    }
+
+  ctx->canonical = g_checksum_new (G_CHECKSUM_SHA256);
+  g_checksum_update (ctx->canonical, (const guchar *)method, -1);
+  g_checksum_update (ctx->canonical, (const guchar *)"\n", 1);
+  g_checksum_update (ctx->canonical, (const guchar *)str->str, str->len);
+
+  ctx->url_prefix = g_strdup_printf ("%s://%s%s",
+                                     priv->secure ? "https" : "http",
+                                     host,
+                                     str->str);
+
+  /* Parameters must be in sorted order */
+  g_string_assign (str, "X-Amz-Algorithm=AWS4-HMAC-SHA256&X-Amz-Credential=");
+  append_uri_encoded (str, aws_credentials_get_access_key (creds), TRUE);
+  g_string_append (str, "%2F");
+  append_uri_encoded (str, scope, TRUE);
+  g_string_append_printf (str, "&X-Amz-Date=%s&X-Amz-Expires=%u", amz_date, expires_in);
+  if (session_token != NULL)
+    {
+      g_string_append (str, "&X-Amz-Security-Token=");
+      append_uri_encoded (str, session_token, TRUE);
+    }
+  g_string_append (str, "&X-Amz-SignedHeaders=host");
+  ctx->query = g_strdup (str->str);
+
+  ctx->suffix = g_strdup_printf ("\n%s\nhost:%s\n\nhost\nUNSIGNED-PAYLOAD", ctx->query, host);
+
+  g_string_printf (str, "AWS4-HMAC-SHA256\n%s\n%s\n", amz_date, scope);
+  ctx->signer = g_hmac_new (G_CHECKSUM_SHA256, key, sizeof key);
+  g_hmac_update (ctx->signer, (const guchar *)str->str, str->len);
+}
+
+static void
+presign_context_clear (PresignContext *ctx)
+{
+  g_clear_pointer (&ctx->canonical, g_checksum_free);
+  g_clear_pointer (&ctx->signer, g_hmac_unref);
+  g_clear_pointer (&ctx->url_prefix, g_free);
+  g_clear_pointer (&ctx->query, g_free);
+  g_clear_pointer (&ctx->suffix, g_free);
+}
+
+/*
+ * Appends the presigned URL for @path to @url.
+ */
+static void
+presign_context_sign (PresignContext *ctx,
+                      const gchar    *path,
+                      GString        *url)
+{
+  g_autoptr(GChecksum) canonical = NULL;
+  g_autoptr(GHmac) signer = NULL;
+  guint8 digest [32];
+  gchar hex [65];
+  gsize digest_len = sizeof digest;
+  gsize key_start;
+
+  g_assert (ctx != NULL);
+  g_assert (path != NULL);
+  g_assert (url != NULL);
+
+  g_string_append (url, ctx->url_prefix);
+  key_start = url->len;
+  append_uri_encoded (url, skip_leading_slashes (path), FALSE);
+
+  canonical = g_checksum_copy (ctx->canonical);
+  g_checksum_update (canonical, (const guchar *)url->str + key_start, url->len - key_start);
+  g_checksum_update (canonical, (const guchar *)ctx->suffix, -1);
+  g_checksum_get_digest (canonical, digest, &digest_len);
+  hex_encode (digest, digest_len, hex);
+
+  signer = g_hmac_copy (ctx->signer);
+  g_hmac_update (signer, (const guchar *)hex, digest_len * 2);
+  digest_len = sizeof digest;
+  g_hmac_get_digest (signer, digest, &digest_len);
+  hex_encode (digest, digest_len, hex);
+
+  g_string_append_c (url, '?');
+  g_string_append (url, ctx->query);
+  g_string_append (url, "&X-Amz-Signature=");
+  g_string_append_len (url, hex, digest_len * 2);
+}
+
+/**
+ * aws_s3_client_presign:
+ * @client: An #AwsS3Client.
+ * @method: The HTTP method the URL is for, such as %SOUP_METHOD_GET.
+ * @bucket: The bucket containing the object.
+ * @path: The path of the object within @bucket.
+ * @expires_in: The number of seconds the URL remains valid, at most a week.
+ *
+ * Creates a URL that allows anyone holding it to perform @method on the
+ * object at @path until it expires, without credentials of their own. The
+ * URL carries a Signature Version 4 query string signed for the bucket's
+ * discovered region or, failing that, #AwsS3Client:region.
+ *
+ * Use aws_s3_client_presign_batch() to sign many objects at once.
+ *
+ * Returns: (transfer full): A newly allocated URL.
+ */
+gchar *
+aws_s3_client_presign (AwsS3Client *client,
+                       const gchar *method,
+                       const gchar *bucket,
+                       const gchar *path,
+                       guint        expires_in)
+{
+  PresignContext ctx = { 0 };
+  GString *url;
+
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), NULL);
+  g_return_val_if_fail (method != NULL, NULL);
+  g_return_val_if_fail (bucket != NULL, NULL);
+  g_return_val_if_fail (path != NULL, NULL);
+  g_return_val_if_fail (expires_in > 0 && expires_in <= PRESIGN_MAX_EXPIRES, NULL);
+
+  presign_context_init (client, &ctx, method, bucket, expires_in);
+  url = g_string_new (NULL);
+  presign_context_sign (&ctx, path, url);
+  presign_context_clear (&ctx);
+
+  return g_string_free (url, FALSE);
+}
+
+/**
+ * aws_s3_client_presign_batch:
+ * @client: An #AwsS3Client.
+ * @method: The HTTP method the URLs are for, such as %SOUP_METHOD_GET.
+ * @bucket: The bucket containing the objects.
+ * @paths: (array length=n_paths): The paths of the objects within @bucket.
+ * @n_paths: The number of elements in @paths.
+ * @expires_in: The number of seconds the URLs remain valid, at most a week.
+ * @buffer: (array length=buffer_len) (element-type guint8): Storage for the URLs.
+ * @buffer_len: The size of @buffer in bytes.
+ * @urls: (array length=n_paths) (out caller-allocates): A location for
+ *   pointers to each URL within @buffer.
+ *
+ * Like aws_s3_client_presign() for each of @paths, but the signing key,
+ * credential scope and the constant parts of the canonical request are
+ * only computed once, leaving two hashes of work per URL.
+ *
+ * The URLs are written one after another into @buffer, each terminated by
+ * a NUL byte, and @urls[i] is set to the URL for @paths[i]. If @buffer
+ * fills up, signing stops early; call again with the remaining paths and
+ * a fresh buffer.
+ *
+ * Returns: The number of leading @paths that were signed.
+ */
+guint
+aws_s3_client_presign_batch (AwsS3Client         *client,
+                             const gchar         *method,
+                             const gchar         *bucket,
+                             const gchar * const *paths,
+                             guint                n_paths,
+                             guint                expires_in,
+                             gchar               *buffer,
+                             gsize                buffer_len,
+                             gchar              **urls)
+{
+  PresignContext ctx = { 0 };
+  g_autoptr(GString) url = NULL;
+  gsize offset = 0;
+  guint i;
+
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), 0);
+  g_return_val_if_fail (method != NULL, 0);
+  g_return_val_if_fail (bucket != NULL, 0);
+  g_return_val_if_fail (paths != NULL || n_paths == 0, 0);
+  g_return_val_if_fail (expires_in > 0 && expires_in <= PRESIGN_MAX_EXPIRES, 0);
+  g_return_val_if_fail (buffer != NULL || buffer_len == 0, 0);
+  g_return_val_if_fail (urls != NULL || n_paths == 0, 0);
+
+  if (n_paths == 0)
+    return 0;
+
+  presign_context_init (client, &ctx, method, bucket, expires_in);
+  url = g_string_sized_new (512);
+
+  for (i = 0; i < n_paths; i++)
+    {
+      g_string_truncate (url, 0);
+      presign_context_sign (&ctx, paths [i], url);
+
+      if (url->len >= buffer_len - offset)
+        break;
+
+      memcpy (buffer + offset, url->str, url->len + 1);
+      urls [i] = buffer + offset;
+      offset += url->len + 1;
+    }
+
+  presign_context_clear (&ctx);
+
+  return i;
+}
+
+/*
+ * Parses either an HTTP date, as found in Last-Modified, or the ISO 8601
+ * dates found in listings.
+ */
+static gint64
+parse_date (const gchar *str)
+{
+  g_autoptr(SoupDate) date = NULL;
+
+  if (str == NULL || !(date = soup_date_new_from_string (str)))
+    return 0;
+
+  return soup_date_to_time_t (date);
+}
+
+/**
+ * aws_s3_client_stat_sync:
+ * @client: An #AwsS3Client.
+ * @bucket: The bucket containing the object.
+ * @path: The path of the object within @bucket.
+ * @cancellable: (nullable): A #GCancellable, or %NULL.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Synchronously looks up the metadata of the object at @path with a HEAD
+ * request. Results are cached for #AwsS3Client:stat-cache-ttl seconds, so
+ * repeated calls do not each cost a round trip.
+ *
+ * Returns: (transfer full): An #AwsS3ObjectInfo or %NULL and @error is set.
+ */
+AwsS3ObjectInfo *
+aws_s3_client_stat_sync (AwsS3Client   *client,
+                         const gchar   *bucket,
+                         const gchar   *path,
+                         GCancellable  *cancellable,
+                         GError       **error)
+{
+  g_autoptr(SoupMessage) message = NULL;
+  g_autoptr(GInputStream) response = NULL;
+  AwsS3ObjectInfo *info;
+  const gchar *last_modified;
+
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), NULL);
+  g_return_val_if_fail (bucket != NULL, NULL);
+  g_return_val_if_fail (path != NULL, NULL);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), NULL);
+
+  path = skip_leading_slashes (path);
+
+  if ((info = aws_s3_client_lookup_stat (client, bucket, path)))
+    return info;
+
+  message = aws_s3_client_new_message (client, SOUP_METHOD_HEAD, bucket, path, NULL);
+  soup_message_disable_feature (message, SOUP_TYPE_CONTENT_DECODER);
+  aws_s3_client_sign_message (client, message, bucket, path);
+
+  if (!(response = aws_s3_client_send_sync (client, &message, bucket, path, cancellable, error)))
+    return NULL;
+
+  g_input_stream_close (response, NULL, NULL);
+
+  last_modified = soup_message_headers_get_one (message->response_headers, "Last-Modified");
+  info = aws_s3_object_info_new (path,
+                                 soup_message_headers_get_content_length (message->response_headers),
+                                 soup_message_headers_get_one (message->response_headers, "ETag"),
+                                 parse_date (last_modified));
+  aws_s3_client_cache_stat (client, bucket, info);
+
+  return info;
+}
+
+static void
+list_parser_start_element (GMarkupParseContext  *context,
+                           const gchar          *element_name,
+                           const gchar         **attribute_names,
+                           const gchar         **attribute_values,
+                           gpointer              user_data,
+                           GError              **error)
+{
+  ListParser *parser = user_data;
+
+  if (g_str_equal (element_name, "Contents"))
+    {
+      parser->in_contents = TRUE;
+      g_clear_pointer (&parser->key, g_free);
+      g_clear_pointer (&parser->etag, g_free);
+      parser->size = 0;
+      parser->last_modified = 0;
+    }
+  else if (g_str_equal (element_name, "CommonPrefixes"))
+    parser->in_prefixes = TRUE;
+
+  g_string_truncate (parser->text, 0);
+}
+
+static void
+list_parser_end_element (GMarkupParseContext  *context,
+                         const gchar          *element_name,
+                         gpointer              user_data,
+                         GError              **error)
+{
+  ListParser *parser = user_data;
+  const gchar *text = parser->text->str;
+
+  if (parser->in_contents)
+    {
+      if (g_str_equal (element_name, "Key"))
+        {
+          g_free (parser->key);
+          parser->key = g_strdup (text);
+        }
+      else if (g_str_equal (element_name, "ETag"))
+        {
+          g_free (parser->etag);
+          parser->etag = g_strdup (text);
+        }
+      else if (g_str_equal (element_name, "Size"))
+        parser->size = g_ascii_strtoull (text, NULL, 10);
+      else if (g_str_equal (element_name, "LastModified"))
+        parser->last_modified = parse_date (text);
+      else if (g_str_equal (element_name, "Contents"))
+        {
+          if (parser->key != NULL)
+            g_ptr_array_add (parser->objects,
+                             aws_s3_object_info_new (parser->key,
+                                                     parser->size,
+                                                     parser->etag,
+                                                     parser->last_modified));
+          parser->in_contents = FALSE;
+        }
+    }
+  else if (parser->in_prefixes)
+    {
+      if (g_str_equal (element_name, "Prefix"))
+        g_ptr_array_add (parser->objects, aws_s3_object_info_new_prefix (text));
+      else if (g_str_equal (element_name, "CommonPrefixes"))
+        parser->in_prefixes = FALSE;
+    }
+  else if (g_str_equal (element_name, "NextContinuationToken"))
+    {
+      g_free (parser->next_token);
+      parser->next_token = g_strdup (text);
+    }
+
+  g_string_truncate (parser->text, 0);
+}
+
+static void
+list_parser_text (GMarkupParseContext  *context,
+                  const gchar          *text,
+                  gsize                 text_len,
+                  gpointer              user_data,
+                  GError              **error)
+{
+  ListParser *parser = user_data;
+
+  g_string_append_len (parser->text, text, text_len);
+}
+
+static const GMarkupParser list_parser = {
+  list_parser_start_element,
+  list_parser_end_element,
+  list_parser_text,
+  NULL,
+  NULL,
+};
+
+/**
+ * aws_s3_client_list_sync:
+ * @client: An #AwsS3Client.
+ * @bucket: The bucket to list.
+ * @prefix: (nullable): Only list keys starting with @prefix.
+ * @delimiter: (nullable): Group keys sharing a prefix up to @delimiter.
+ * @max_keys: The maximum number of entries to return, or 0 for the
+ *   server's default of 1000.
+ * @continuation_token: (nullable): The token from a previous page.
+ * @next_continuation_token: (out) (optional) (nullable): A location for
+ *   the token of the next page, which is set to %NULL on the last page.
+ * @cancellable: (nullable): A #GCancellable, or %NULL.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Synchronously fetches one page of the keys in @bucket, in order. When
+ * @delimiter is set, keys that contain it after @prefix are rolled up
+ * into a single common prefix entry, which is how directories are
+ * modelled.
+ *
+ * The objects are also stored in the cache used by
+ * aws_s3_client_stat_sync().
+ *
+ * Returns: (transfer container) (element-type AwsS3ObjectInfo): The
+ *   entries of the page, or %NULL and @error is set.
+ */
+GPtrArray *
+aws_s3_client_list_sync (AwsS3Client   *client,
+                         const gchar   *bucket,
+                         const gchar   *prefix,
+                         const gchar   *delimiter,
+                         guint          max_keys,
+                         const gchar   *continuation_token,
+                         gchar        **next_continuation_token,
+                         GCancellable  *cancellable,
+                         GError       **error)
+{
+  g_autoptr(GMarkupParseContext) context = NULL;
+  g_autoptr(SoupMessage) message = NULL;
+  g_autoptr(GInputStream) response = NULL;
+  g_autoptr(GOutputStream) contents = NULL;
+  g_autoptr(GString) query = NULL;
+  ListParser parser = { 0 };
+  GPtrArray *ret = NULL;
+  const gchar *data;
+  gsize len;
+  guint i;
+
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), NULL);
+  g_return_val_if_fail (bucket != NULL, NULL);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), NULL);
+
+  if (next_continuation_token != NULL)
+    *next_continuation_token = NULL;
+
+  /* Parameters in sorted order, as S3 documents them */
+  query = g_string_new ("list-type=2");
+  if (continuation_token != NULL)
+    {
+      g_string_append (query, "&continuation-token=");
+      append_uri_encoded (query, continuation_token, TRUE);
+    }
+  if (delimiter != NULL)
+    {
+      g_string_append (query, "&delimiter=");
+      append_uri_encoded (query, delimiter, TRUE);
+    }
+  if (max_keys > 0)
+    g_string_append_printf (query, "&max-keys=%u", max_keys);
+  if (prefix != NULL)
+    {
+      g_string_append (query, "&prefix=");
+      append_uri_encoded (query, prefix, TRUE);
+    }
+
+  message = aws_s3_client_new_message (client, SOUP_METHOD_GET, bucket, "", query->str);
+  aws_s3_client_sign_message (client, message, bucket, "");
+
+  if (!(response = aws_s3_client_send_sync (client, &message, bucket, "", cancellable, error)))
+    return NULL;
+
+  contents = g_memory_output_stream_new_resizable ();
+
+  if (g_output_stream_splice (contents,
+                              response,
+                              G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE | G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+                              cancellable,
+                              error) < 0)
+    return NULL;
+
+  data = g_memory_output_stream_get_data (G_MEMORY_OUTPUT_STREAM (contents));
+  len = g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (contents));
+
+  parser.objects = g_ptr_array_new_with_free_func ((GDestroyNotify)aws_s3_object_info_unref);
+  parser.text = g_string_new (NULL);
+
+  context = g_markup_parse_context_new (&list_parser, 0, &parser, NULL);
+
+  if (g_markup_parse_context_parse (context, data, len, error) &&
+      g_markup_parse_context_end_parse (context, error))
+    {
+      for (i = 0; i < parser.objects->len; i++)
+        {
+          AwsS3ObjectInfo *info = g_ptr_array_index (parser.objects, i);
+
+          if (!aws_s3_object_info_is_prefix (info))
+            aws_s3_client_cache_stat (client, bucket, info);
+        }
+
+      if (next_continuation_token != NULL)
+        *next_continuation_token = g_steal_pointer (&parser.next_token);
+
+      ret = g_steal_pointer (&parser.objects);
+    }
+
+  g_clear_pointer (&parser.objects, g_ptr_array_unref);
+  g_string_free (parser.text, TRUE);
+  g_free (parser.key);
+  g_free (parser.etag);
+  g_free (parser.next_token);
+
+  return ret;
+}
+
+/**
+ * aws_s3_client_open_range_sync:
+ * @client: An #AwsS3Client.
+ * @bucket: The bucket containing the object.
+ * @path: The path of the object within @bucket.
+ * @offset: The offset to start reading from.
+ * @etag: (nullable): The ETag the object must still have, or %NULL.
+ * @cancellable: (nullable): A #GCancellable, or %NULL.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Synchronously requests the object at @path from @offset to its end and
+ * returns a stream of the stored bytes. If @etag is set and the object
+ * has since been replaced, this fails with
+ * %AWS_S3_CLIENT_ERROR_PRECONDITION_FAILED, so that a reader resuming at
+ * @offset never mixes two versions of an object.
+ *
+ * #AwsS3Client:read-codec does not apply.
+ *
+ * Returns: (transfer full): A #GInputStream or %NULL and @error is set.
+ */
+GInputStream *
+aws_s3_client_open_range_sync (AwsS3Client   *client,
+                               const gchar   *bucket,
+                               const gchar   *path,
+                               guint64        offset,
+                               const gchar   *etag,
+                               GCancellable  *cancellable,
+                               GError       **error)
+{
+  g_autoptr(SoupMessage) message = NULL;
+  g_autoptr(GInputStream) response = NULL;
+
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), NULL);
+  g_return_val_if_fail (bucket != NULL, NULL);
+  g_return_val_if_fail (path != NULL, NULL);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), NULL);
+
+  path = skip_leading_slashes (path);
+
+  message = aws_s3_client_new_message (client, SOUP_METHOD_GET, bucket, path, NULL);
+  soup_message_disable_feature (message, SOUP_TYPE_CONTENT_DECODER);
+  if (offset > 0)
+    soup_message_headers_set_range (message->request_headers, offset, -1);
+  if (etag != NULL)
+    soup_message_headers_replace (message->request_headers, "If-Match", etag);
+  aws_s3_client_sign_message (client, message, bucket, path);
+
+  if (!(response = aws_s3_client_send_sync (client, &message, bucket, path, cancellable, error)))
+    return NULL;
+
+  if (offset > 0 && message->status_code != SOUP_STATUS_PARTIAL_CONTENT)
+    {
+      g_input_stream_close (response, NULL, NULL);
+      g_set_error (error,
+                   AWS_S3_CLIENT_ERROR,
+                   AWS_S3_CLIENT_ERROR_UNKNOWN,
+                   "The server ignored the requested range");
+      return NULL;
+    }
+
+  return g_steal_pointer (&response);
+}
+
+/**
+ * aws_s3_client_read_range_sync:
+ * @client: An #AwsS3Client.
+ * @bucket: The bucket containing the object.
+ * @path: The path of the object within @bucket.
+ * @offset: The offset of the first byte to read.
+ * @length: The number of bytes to read.
+ * @cancellable: (nullable): A #GCancellable, or %NULL.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Synchronously reads @length stored bytes of the object at @path
+ * starting at @offset with a single ranged GET. This fails if the object
+ * is too short to contain the whole range.
+ *
+ * #AwsS3Client:read-codec does not apply.
+ *
+ * Returns: (transfer full): A #GBytes or %NULL and @error is set.
+ */
+GBytes *
+aws_s3_client_read_range_sync (AwsS3Client   *client,
+                               const gchar   *bucket,
+                               const gchar   *path,
+                               guint64        offset,
+                               gsize          length,
+                               GCancellable  *cancellable,
+                               GError       **error)
+{
+  g_autoptr(SoupMessage) message = NULL;
+  g_autoptr(GInputStream) response = NULL;
+  g_autofree guint8 *data = NULL;
+  gsize n_read = 0;
+  gboolean ret;
+
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), NULL);
+  g_return_val_if_fail (bucket != NULL, NULL);
+  g_return_val_if_fail (path != NULL, NULL);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), NULL);
+
+  if (length == 0)
+    return g_bytes_new (NULL, 0);
+
+  path = skip_leading_slashes (path);
+
+  message = aws_s3_client_new_message (client, SOUP_METHOD_GET, bucket, path, NULL);
+  soup_message_disable_feature (message, SOUP_TYPE_CONTENT_DECODER);
+  soup_message_headers_set_range (message->request_headers, offset, offset + length - 1);
+  aws_s3_client_sign_message (client, message, bucket, path);
+
+  if (!(response = aws_s3_client_send_sync (client, &message, bucket, path, cancellable, error)))
+    return NULL;
+
+  if (message->status_code != SOUP_STATUS_PARTIAL_CONTENT)
+    {
+      g_input_stream_close (response, NULL, NULL);
+      g_set_error (error,
+                   AWS_S3_CLIENT_ERROR,
+                   AWS_S3_CLIENT_ERROR_UNKNOWN,
+                   "The server ignored the requested range");
+      return NULL;
+    }
+
+  data = g_malloc (length);
+  ret = g_input_stream_read_all (response, data, length, &n_read, cancellable, error);
+  g_input_stream_close (response, NULL, NULL);
+
+  if (!ret)
+    return NULL;
+
+  if (n_read != length)
+    {
+      g_set_error (error,
+                   AWS_S3_CLIENT_ERROR,
+                   AWS_S3_CLIENT_ERROR_UNKNOWN,
+                   "Expected %"G_GSIZE_FORMAT" bytes but received %"G_GSIZE_FORMAT,
+                   length,
+                   n_read);
+      return NULL;
+    }
+
+  return g_bytes_new_take (g_steal_pointer (&data), length);
+}
+
+static const gchar *
+select_format_to_input (AwsS3ClientSelectFormat format)
+{
+  switch (format)
+    {
+    case AWS_S3_CLIENT_SELECT_FORMAT_CSV_WITH_HEADER:
+      return "<CSV><FileHeaderInfo>USE</FileHeaderInfo></CSV>";
+
+    case AWS_S3_CLIENT_SELECT_FORMAT_JSON_LINES:
+      return "<JSON><Type>LINES</Type></JSON>";
+
+    case AWS_S3_CLIENT_SELECT_FORMAT_JSON_DOCUMENT:
+      return "<JSON><Type>DOCUMENT</Type></JSON>";
+
+    case AWS_S3_CLIENT_SELECT_FORMAT_CSV:
+    default:
+      return "<CSV><FileHeaderInfo>NONE</FileHeaderInfo></CSV>";
+    }
+}
+
+static const gchar *
+select_format_to_output (AwsS3ClientSelectFormat format)
+{
+  switch (format)
+    {
+    case AWS_S3_CLIENT_SELECT_FORMAT_JSON_LINES:
+    case AWS_S3_CLIENT_SELECT_FORMAT_JSON_DOCUMENT:
+      return "<JSON/>";
+
+    case AWS_S3_CLIENT_SELECT_FORMAT_CSV:
+    case AWS_S3_CLIENT_SELECT_FORMAT_CSV_WITH_HEADER:
+    default:
+      return "<CSV/>";
+    }
+}
+
+static guint64
+parse_select_stat (const gchar *xml,
+                   const gchar *element)
+{
+  g_autofree gchar *tag = g_strdup_printf ("<%s>", element);
+  const gchar *found;
+
+  if (!(found = strstr (xml, tag)))
+    return 0;
+
+  return g_ascii_strtoull (found + strlen (tag), NULL, 10);
+}
+
+static void
+aws_s3_client_select_update_stats (SelectState                 *state,
+                                   const AwsEventStreamMessage *message,
+                                   gboolean                     final)
+{
+  g_autofree gchar *xml = NULL;
+
+  g_assert (state != NULL);
+  g_assert (message != NULL);
+
+  xml = g_strndup ((const gchar *)message->payload, message->payload_len);
+
+  state->stats.bytes_scanned = parse_select_stat (xml, "BytesScanned");
+  state->stats.bytes_processed = parse_select_stat (xml, "BytesProcessed");
+  state->stats.bytes_returned = parse_select_stat (xml, "BytesReturned");
+
+  if (state->progress != NULL)
+    state->progress (state->client, &state->stats, final, state->handler_data);
+}
+
+static gboolean
+aws_s3_client_select_event (const AwsEventStreamMessage  *message,
+                            gpointer                      user_data,
+                            GError                      **error)
+{
+  SelectState *state = user_data;
+
+  g_assert (message != NULL);
+  g_assert (state != NULL);
+
+  if (g_str_equal (message->message_type, "error"))
+    {
+      g_set_error (error,
+                   AWS_S3_CLIENT_ERROR,
+                   AWS_S3_CLIENT_ERROR_BAD_REQUEST,
+                   "%s: %s",
+                   message->error_code,
+                   message->error_message);
+      return FALSE;
+    }
+
+  if (!g_str_equal (message->message_type, "event"))
+    return TRUE;
+
+  if (g_str_equal (message->event_type, "Records"))
+    {
+      SoupBuffer *buffer;
+      gboolean proceed;
+
+      if (message->payload_len == 0)
+        return TRUE;
+
+      buffer = soup_buffer_new (SOUP_MEMORY_TEMPORARY, message->payload, message->payload_len);
+      proceed = state->handler (state->client, state->message, buffer, state->handler_data);
+      soup_buffer_free (buffer);
+
+      if (!proceed)
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_CANCELLED,
+                       "The request was cancelled");
+          return FALSE;
+        }
+    }
+  else if (g_str_equal (message->event_type, "Progress"))
+    aws_s3_client_select_update_stats (state, message, FALSE);
+  else if (g_str_equal (message->event_type, "Stats"))
+    aws_s3_client_select_update_stats (state, message, TRUE);
+  else if (g_str_equal (message->event_type, "End"))
+    state->ended = TRUE;
+
+  return TRUE;
+}
+
+/*
+ * Data handler for the underlying read which decodes the event stream
+ * as it arrives. Errors are stashed so that they can be reported in
+ * place of the generic cancellation from the read.
+ */
+static gboolean
+aws_s3_client_select_handler (AwsS3Client *client,
+                              SoupMessage *message,
+                              SoupBuffer  *buffer,
+                              gpointer     user_data)
+{
+  SelectState *state = user_data;
+  gboolean ret;
+
+  g_assert (AWS_IS_S3_CLIENT (client));
+  g_assert (state != NULL);
+
+  state->client = client;
+  state->message = message;
+
+  ret = aws_event_stream_decoder_feed (state->decoder,
+                                       (const guint8 *)buffer->data,
+                                       buffer->length,
+                                       &state->error);
+
+  state->client = NULL;
+  state->message = NULL;
+
+  return ret;
+}
+
+static void
+aws_s3_client_select_cb (GObject      *object,
+                         GAsyncResult *result,
+                         gpointer      user_data)
+{
+  AwsS3Client *client = (AwsS3Client *)object;
+  g_autoptr(GTask) task = user_data;
+  SelectState *state;
+  GError *error = NULL;
+
+  g_assert (AWS_IS_S3_CLIENT (client));
+  g_assert (G_IS_TASK (task));
+
+  state = g_task_get_task_data (task);
+
+  if (!aws_s3_client_read_finish (client, result, &error))
+    {
+      if (state->error != NULL)
+        {
+          g_clear_error (&error);
+          error = g_steal_pointer (&state->error);
+        }
+      g_task_return_error (task, error);
+    }
+  else if (!state->ended || !aws_event_stream_decoder_is_idle (state->decoder))
+    g_task_return_new_error (task,
+                             G_IO_ERROR,
+                             G_IO_ERROR_PARTIAL_INPUT,
+                             "The select response ended prematurely");
+  else
+    g_task_return_boolean (task, TRUE);
+}
+
+/**
+ * aws_s3_client_select_async:
+ * @client: An #AwsS3Client.
+ * @bucket: The bucket containing the object.
+ * @path: The path of the object within @bucket.
+ * @expression: An S3 Select SQL expression.
+ * @input_format: The format of the object.
+ * @output_format: The format in which to return records.
+ * @handler: A handler for incoming records.
+ * @progress: (nullable): A handler for progress and statistics.
+ * @handler_data: User data for @handler and @progress.
+ * @handler_notify: A #GDestroyNotify for @handler_data.
+ * @cancellable: (nullable): A #GCancellable, or %NULL.
+ * @callback: A callback to execute upon completion.
+ * @user_data: User data for @callback.
+ *
+ * Asynchronously runs @expression against the object at @path so that only
+ * matching records are transferred. The event stream response is decoded as
+ * it arrives and @handler is called with the payload of each Records event,
+ * which may split a record across calls.
+ *
+ * If @progress is set, progress events are requested and reported as they
+ * arrive, followed by the final statistics.
+ */
+void
+aws_s3_client_select_async (AwsS3Client               *client,
+                            const gchar               *bucket,
+                            const gchar               *path,
+                            const gchar               *expression,
+                            AwsS3ClientSelectFormat    input_format,
+                            AwsS3ClientSelectFormat    output_format,
+                            AwsS3ClientDataHandler     handler,
+                            AwsS3ClientSelectProgress  progress,
+                            gpointer                   handler_data,
+                            GDestroyNotify             handler_notify,
+                            GCancellable              *cancellable,
+                            GAsyncReadyCallback        callback,
+                            gpointer                   user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  g_autoptr(GTask) read_task = NULL;
+  g_autoptr(SoupMessage) message = NULL;
+  g_autofree gchar *escaped = NULL;
+  GString *body;
+  SelectState *state;
+  ReadState *read_state;
+  gsize body_len;
+
+  g_return_if_fail (AWS_IS_S3_CLIENT (client));
+  g_return_if_fail (bucket != NULL);
+  g_return_if_fail (path != NULL);
+  g_return_if_fail (expression != NULL);
+  g_return_if_fail (handler != NULL);
+
+  path = skip_leading_slashes (path);
+
+  state = g_slice_new0 (SelectState);
+  state->handler = handler;
+  state->progress = progress;
+  state->handler_data = handler_data;
+  state->handler_data_destroy = handler_notify;
+  state->decoder = aws_event_stream_decoder_new (aws_s3_client_select_event, state);
+
+  task = g_task_new (client, cancellable, callback, user_data);
+  g_task_set_source_tag (task, aws_s3_client_select_async);
+  g_task_set_task_data (task, state, select_state_free);
+
+  escaped = g_markup_escape_text (expression, -1);
+  body = g_string_new ("<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+                       "<SelectObjectContentRequest xmlns=\"http://s3.amazonaws.com/doc/2006-03-01/\">");
+  g_string_append_printf (body,
+                          "<Expression>%s</Expression>"
+                          "<ExpressionType>SQL</ExpressionType>"
+                          "<InputSerialization>"
+                          "<CompressionType>NONE</CompressionType>%s"
+                          "</InputSerialization>"
+                          "<OutputSerialization>%s</OutputSerialization>"
+                          "<RequestProgress><Enabled>%s</Enabled></RequestProgress>"
+                          "</SelectObjectContentRequest>",
+                          escaped,
+                          select_format_to_input (input_format),
+                          select_format_to_output (output_format),
+                          progress != NULL ? "TRUE" : "FALSE");
+  body_len = body->len;
+
+  /*
+   * Build and sign our HTTP request message.
+   */
+  message = aws_s3_client_new_message (client, SOUP_METHOD_POST, bucket, path, "select&select-type=2");
+  soup_message_set_request (message,
+                            "application/xml",
+                            SOUP_MEMORY_TAKE,
+                            g_string_free (body, FALSE),
+                            body_len);
+  aws_s3_client_sign_message (client, message, bucket, path);
+
+  /*
+   * The response is consumed by a regular read whose handler decodes the
+   * event stream, so redirects and error statuses are handled as usual.
+   */
+  read_state = read_state_new (bucket, path, aws_s3_client_select_handler, state, NULL);
+  read_state->codec = AWS_S3_CLIENT_CODEC_NONE;
+
+  read_task = g_task_new (client,
+                          cancellable,
+                          aws_s3_client_select_cb,
+                          g_steal_pointer (&task));
+  g_task_set_source_tag (read_task, aws_s3_client_read_async);
+  g_task_set_task_data (read_task, read_state, read_state_free);
+
+  aws_s3_client_queue_read (client,
+                            g_steal_pointer (&message),
+                            g_steal_pointer (&read_task));
+}
+
+/**
+ * aws_s3_client_select_finish:
+ * @client: An #AwsS3Client.
+ * @result: A #GAsyncResult.
+ * @stats: (out) (optional): A location for the final statistics.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Completes a request started with aws_s3_client_select_async().
+ *
+ * Returns: %TRUE if the query ran to completion; otherwise %FALSE and
+ *   @error is set.
+ */
+gboolean
+aws_s3_client_select_finish (AwsS3Client             *client,
+                             GAsyncResult            *result,
+                             AwsS3ClientSelectStats  *stats,
+                             GError                 **error)
+{
+  SelectState *state;
+
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), FALSE);
+  g_return_val_if_fail (G_IS_TASK (result), FALSE);
+
+  if (!g_task_propagate_boolean (G_TASK (result), error))
+    return FALSE;
+
+  state = g_task_get_task_data (G_TASK (result));
+
+  if (stats != NULL)
+    *stats = state->stats;
+
+  return TRUE;
+}
+
+/*
+ * Records a completed range, merging it with its neighbours so that the
+ * journal stays small no matter how many chunks have been fetched.
+ */
+static void
+download_journal_add (DownloadJournal *journal,
+                      guint64          start,
+                      guint64          end)
+{
+  ByteRange range = { start, end };
+  guint i;
+
+  g_assert (journal != NULL);
+  g_assert (start < end);
+
+  for (i = 0; i < journal->ranges->len; i++)
+    {
+      if (g_array_index (journal->ranges, ByteRange, i).start > start)
+        break;
+    }
+
+  g_array_insert_val (journal->ranges, i, range);
+
+  for (i = 1; i < journal->ranges->len;)
+    {
+      ByteRange *prev = &g_array_index (journal->ranges, ByteRange, i - 1);
+      ByteRange *cur = &g_array_index (journal->ranges, ByteRange, i);
+
+      if (cur->start <= prev->end)
+        {
+          prev->end = MAX (prev->end, cur->end);
+          g_array_remove_index (journal->ranges, i);
+        }
+      else
+        i++;
+    }
+}
+
+/*
+ * Loads the journal left by an interrupted download of the same object.
+ * Progress is only kept if the object still has the ETag and size that
+ * the journal was written for.
+ */
+static DownloadJournal *
+download_journal_load (GFile       *file,
+                       const gchar *bucket,
+                       const gchar *path,
+                       const gchar *etag,
+                       guint64      size)
+{
+  g_autoptr(GKeyFile) key_file = NULL;
+  g_autofree gchar *contents = NULL;
+  g_autofree gchar *journal_bucket = NULL;
+  g_autofree gchar *journal_path = NULL;
+  g_autofree gchar *journal_etag = NULL;
+  g_auto(GStrv) ranges = NULL;
+  DownloadJournal *journal;
+  gsize len = 0;
+  guint i;
+
+  g_assert (G_IS_FILE (file));
+
+  journal = g_slice_new0 (DownloadJournal);
+  journal->file = g_object_ref (file);
+  journal->etag = g_strdup (etag);
+  journal->size = size;
+  journal->ranges = g_array_new (FALSE, FALSE, sizeof (ByteRange));
+
+  key_file = g_key_file_new ();
+
+  if (!g_file_load_contents (file, NULL, &contents, &len, NULL, NULL) ||
+      !g_key_file_load_from_data (key_file, contents, len, G_KEY_FILE_NONE, NULL))
+    return journal;
+
+  journal_bucket = g_key_file_get_string (key_file, JOURNAL_GROUP, "bucket", NULL);
+  journal_path = g_key_file_get_string (key_file, JOURNAL_GROUP, "path", NULL);
+  journal_etag = g_key_file_get_string (key_file, JOURNAL_GROUP, "etag", NULL);
+
+  if (g_strcmp0 (journal_bucket, bucket) != 0 ||
+      g_strcmp0 (journal_path, path) != 0 ||
+      g_strcmp0 (journal_etag, etag) != 0 ||
+      g_key_file_get_uint64 (key_file, JOURNAL_GROUP, "size", NULL) != size)
+    return journal;
+
+  ranges = g_key_file_get_string_list (key_file, JOURNAL_GROUP, "completed", NULL, NULL);
+
+  for (i = 0; ranges != NULL && ranges [i] != NULL; i++)
+    {
+      guint64 start;
+      guint64 end;
+      gchar *endptr;
+
+      start = g_ascii_strtoull (ranges [i], &endptr, 10);
+      if (*endptr != '-')
+        continue;
+
+      end = g_ascii_strtoull (endptr + 1, &endptr, 10);
+      if (*endptr != '\0' || start >= end || end > size)
+        continue;
+
+      download_journal_add (journal, start, end);
+    }
+
+  return journal;
+}
+
+static gboolean
+download_journal_save (DownloadJournal  *journal,
+                       const gchar      *bucket,
+                       const gchar      *path,
+                       GCancellable     *cancellable,
+                       GError          **error)
+{
+  g_autoptr(GKeyFile) key_file = NULL;
+  g_autoptr(GPtrArray) ranges = NULL;
+  g_autofree gchar *contents = NULL;
+  gsize len = 0;
+  guint i;
+
+  g_assert (journal != NULL);
+
+  key_file = g_key_file_new ();
+  g_key_file_set_string (key_file, JOURNAL_GROUP, "bucket", bucket);
+  g_key_file_set_string (key_file, JOURNAL_GROUP, "path", path);
+  g_key_file_set_string (key_file, JOURNAL_GROUP, "etag", journal->etag);
+  g_key_file_set_uint64 (key_file, JOURNAL_GROUP, "size", journal->size);
+
+  ranges = g_ptr_array_new_with_free_func (g_free);
+
+  for (i = 0; i < journal->ranges->len; i++)
+    {
+      const ByteRange *range = &g_array_index (journal->ranges, ByteRange, i);
+
+      g_ptr_array_add (ranges,
+                       g_strdup_printf ("%"G_GUINT64_FORMAT"-%"G_GUINT64_FORMAT,
+                                        range->start,
+                                        range->end));
+    }
+
+  g_key_file_set_string_list (key_file,
+                              JOURNAL_GROUP,
+                              "completed",
+                              (const gchar * const *)ranges->pdata,
+                              ranges->len);
+
+  contents = g_key_file_to_data (key_file, &len, NULL);
+
+  /* Replaced atomically so that a crash never leaves a torn journal */
+  return g_file_replace_contents (journal->file,
+                                  contents,
+                                  len,
+                                  NULL,
+                                  FALSE,
+                                  G_FILE_CREATE_REPLACE_DESTINATION,
+                                  NULL,
+                                  cancellable,
+                                  error);
+}
+
+/*
+ * Makes what has been written to @file durable. This must precede saving
+ * the journal, or a crash could leave it recording ranges that never made
+ * it to disk; flushing alone is a no-op for local files.
+ */
+static gboolean
+download_sync_file (GFileIOStream  *file,
+                    GCancellable   *cancellable,
+                    GError        **error)
+{
+  GOutputStream *output;
+  gint fd;
+
+  g_assert (G_IS_FILE_IO_STREAM (file));
+
+  output = g_io_stream_get_output_stream (G_IO_STREAM (file));
+
+  if (!g_output_stream_flush (output, cancellable, error))
+    return FALSE;
+
+  if (!G_IS_FILE_DESCRIPTOR_BASED (output))
+    return TRUE;
+
+  fd = g_file_descriptor_based_get_fd (G_FILE_DESCRIPTOR_BASED (output));
+
+  if (fsync (fd) != 0)
+    {
+      gint errsv = errno;
+
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errsv),
+                   "Failed to sync download: %s",
+                   g_strerror (errsv));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*
+ * Fetches [@start, @end) of the object into @file at the same offset. The
+ * request is conditional on @etag so that a changed object is detected
+ * instead of silently mixing two versions.
+ */
+static gboolean
+aws_s3_client_download_range (AwsS3Client   *self,
+                              const gchar   *bucket,
+                              const gchar   *path,
+                              const gchar   *etag,
+                              guint64        start,
+                              guint64        end,
+                              GFileIOStream *file,
+                              guint8        *buffer,
+                              GCancellable  *cancellable,
+                              GError       **error)
+{
+  g_autoptr(SoupMessage) message = NULL;
+  g_autoptr(GInputStream) response = NULL;
+  GOutputStream *output;
+  guint64 received = 0;
+  gboolean ret = FALSE;
+
+  g_assert (AWS_IS_S3_CLIENT (self));
+  g_assert (G_IS_FILE_IO_STREAM (file));
+  g_assert (start < end);
+
+  message = aws_s3_client_new_message (self, SOUP_METHOD_GET, bucket, path, NULL);
+  soup_message_disable_feature (message, SOUP_TYPE_CONTENT_DECODER);
+  soup_message_headers_set_range (message->request_headers, start, end - 1);
+  soup_message_headers_replace (message->request_headers, "If-Match", etag);
+  aws_s3_client_sign_message (self, message, bucket, path);
+
+  if (!(response = aws_s3_client_send_sync (self, &message, bucket, path, cancellable, error)))
+    return FALSE;
+
+  if (message->status_code != SOUP_STATUS_PARTIAL_CONTENT && start != 0)
+    {
+      g_set_error (error,
+                   AWS_S3_CLIENT_ERROR,
+                   AWS_S3_CLIENT_ERROR_UNKNOWN,
+                   "The server ignored the requested range");
+      goto cleanup;
+    }
+
+  if (!g_seekable_seek (G_SEEKABLE (file), start, G_SEEK_SET, cancellable, error))
+    goto cleanup;
+
+  output = g_io_stream_get_output_stream (G_IO_STREAM (file));
+
+  while (received < end - start)
+    {
+      gsize want = MIN (READ_CHUNK_SIZE, end - start - received);
+      gssize n_read;
+
+      if ((n_read = g_input_stream_read (response, buffer, want, cancellable, error)) < 0)
+        goto cleanup;
+
+      if (n_read == 0)
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_PARTIAL_INPUT,
+                       "The connection closed before the range was complete");
+          goto cleanup;
+        }
+
+      AWS_PROBE_REQUEST_CHUNK (bucket, path, n_read);
+
+      if (!g_output_stream_write_all (output, buffer, n_read, NULL, cancellable, error))
+        goto cleanup;
+
+      received += n_read;
+    }
+
+  ret = g_output_stream_flush (output, cancellable, error);
+
+cleanup:
+  g_input_stream_close (response, NULL, NULL);
+
+  return ret;
+}
+
+/**
+ * aws_s3_client_download_sync:
+ * @client: An #AwsS3Client.
+ * @bucket: The bucket containing the object.
+ * @path: The path of the object within @bucket.
+ * @destination: The #GFile to download to.
+ * @cancellable: (nullable): A #GCancellable, or %NULL.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Synchronously downloads the object at @path into @destination, fetching
+ * it in ranges. Progress is recorded in a journal next to @destination so
+ * that, if the download is interrupted, calling this again fetches only
+ * the missing ranges. The journal is discarded if the object's ETag has
+ * changed, and removed once the download completes.
+ *
+ * The object is stored as-is; #AwsS3Client:read-codec does not apply.
+ *
+ * Returns: %TRUE if the object was downloaded in full; otherwise %FALSE
+ *   and @error is set.
+ */
+gboolean
+aws_s3_client_download_sync (AwsS3Client   *client,
+                             const gchar   *bucket,
+                             const gchar   *path,
+                             GFile         *destination,
+                             GCancellable  *cancellable,
+                             GError       **error)
+{
+  g_autoptr(SoupMessage) message = NULL;
+  g_autoptr(GInputStream) response = NULL;
+  g_autoptr(GFileIOStream) file = NULL;
+  g_autoptr(GFile) journal_file = NULL;
+  g_autoptr(GFile) parent = NULL;
+  g_autoptr(DownloadJournal) journal = NULL;
+  g_autoptr(GArray) missing = NULL;
+  g_autofree gchar *etag = NULL;
+  g_autofree gchar *basename = NULL;
+  g_autofree gchar *journal_name = NULL;
+  g_autofree guint8 *buffer = NULL;
+  GError *local_error = NULL;
+  guint64 offset = 0;
+  guint64 size;
+  guint i;
+
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), FALSE);
+  g_return_val_if_fail (bucket != NULL, FALSE);
+  g_return_val_if_fail (path != NULL, FALSE);
+  g_return_val_if_fail (G_IS_FILE (destination), FALSE);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), FALSE);
+
+  path = skip_leading_slashes (path);
+
+  /*
+   * Find out what we are downloading.
+   */
+  message = aws_s3_client_new_message (client, SOUP_METHOD_HEAD, bucket, path, NULL);
+  soup_message_disable_feature (message, SOUP_TYPE_CONTENT_DECODER);
+  aws_s3_client_sign_message (client, message, bucket, path);
+
+  if (!(response = aws_s3_client_send_sync (client, &message, bucket, path, cancellable, error)))
+    return FALSE;
+
+  g_input_stream_close (response, NULL, NULL);
+
+  etag = g_strdup (soup_message_headers_get_one (message->response_headers, "ETag"));
+  size = soup_message_headers_get_content_length (message->response_headers);
+
+  if (etag == NULL)
+    {
+      g_set_error (error,
+                   AWS_S3_CLIENT_ERROR,
+                   AWS_S3_CLIENT_ERROR_UNKNOWN,
+                   "The object has no ETag");
+      return FALSE;
+    }
+
+  if (!(parent = g_file_get_parent (destination)))
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVALID_FILENAME,
+                   "Cannot download to a root directory");
+      return FALSE;
+    }
+
+  basename = g_file_get_basename (destination);
+  journal_name = g_strconcat (basename, JOURNAL_SUFFIX, NULL);
+  journal_file = g_file_get_child (parent, journal_name);
+  journal = download_journal_load (journal_file, bucket, path, etag, size);
+
+  /*
+   * Resume into the existing file if the journal is still valid, otherwise
+   * start again from an empty one.
+   */
+  if (journal->ranges->len > 0)
+    file = g_file_open_readwrite (destination, cancellable, &local_error);
+
+  if (file == NULL)
+    {
+      g_clear_error (&local_error);
+      g_array_set_size (journal->ranges, 0);
+
+      if (!(file = g_file_replace_readwrite (destination, NULL, FALSE, G_FILE_CREATE_NONE, cancellable, error)))
+        return FALSE;
+
+      /* Close right away so that the file exists in place while we fill it */
+      if (!g_io_stream_close (G_IO_STREAM (file), cancellable, error))
+        return FALSE;
+      g_clear_object (&file);
+
+      if (!(file = g_file_open_readwrite (destination, cancellable, error)) ||
+          !download_journal_save (journal, bucket, path, cancellable, error))
+        return FALSE;
+    }
+
+  /*
+   * Collect the gaps between completed ranges.
+   */
+  missing = g_array_new (FALSE, FALSE, sizeof (ByteRange));
+
+  for (i = 0; i <= journal->ranges->len; i++)
+    {
+      ByteRange gap;
+
+      gap.start = offset;
+      gap.end = i < journal->ranges->len ? g_array_index (journal->ranges, ByteRange, i).start : size;
+
+      if (gap.start < gap.end)
+        g_array_append_val (missing, gap);
+
+      if (i < journal->ranges->len)
+        offset = g_array_index (journal->ranges, ByteRange, i).end;
+    }
+
+  buffer = g_malloc (READ_CHUNK_SIZE);
+
+  for (i = 0; i < missing->len; i++)
+    {
+      const ByteRange *gap = &g_array_index (missing, ByteRange, i);
+
+      for (offset = gap->start; offset < gap->end; offset += DOWNLOAD_CHUNK_SIZE)
+        {
+          guint64 end = MIN (offset + DOWNLOAD_CHUNK_SIZE, gap->end);
+
+          if (!aws_s3_client_download_range (client, bucket, path, etag, offset, end, file, buffer, cancellable, error))
+            {
+              g_io_stream_close (G_IO_STREAM (file), NULL, NULL);
+              return FALSE;
+            }
+
+          download_journal_add (journal, offset, end);
+
+          if (!download_sync_file (file, cancellable, error) ||
+              !download_journal_save (journal, bucket, path, cancellable, error))
+            {
+              g_io_stream_close (G_IO_STREAM (file), NULL, NULL);
+              return FALSE;
+            }
+        }
+    }
+
+  if (!g_seekable_truncate (G_SEEKABLE (file), size, cancellable, error) ||
+      !download_sync_file (file, cancellable, error) ||
+      !g_io_stream_close (G_IO_STREAM (file), cancellable, error))
+    return FALSE;
+
+  g_file_delete (journal_file, NULL, NULL);
+
+  return TRUE;
+}
+
+static void
+aws_s3_client_download_worker (GTask        *task,
+                               gpointer      source_object,
+                               gpointer      task_data,
+                               GCancellable *cancellable)
+{
+  DownloadState *state = task_data;
+  GError *error = NULL;
+
+  g_assert (AWS_IS_S3_CLIENT (source_object));
+  g_assert (state != NULL);
+
+  if (aws_s3_client_download_sync (source_object,
+                                   state->bucket,
+                                   state->path,
+                                   state->destination,
+                                   cancellable,
+                                   &error))
+    g_task_return_boolean (task, TRUE);
+  else
+    g_task_return_error (task, error);
+}
+
+/**
+ * aws_s3_client_download_async:
+ * @client: An #AwsS3Client.
+ * @bucket: The bucket containing the object.
+ * @path: The path of the object within @bucket.
+ * @destination: The #GFile to download to.
+ * @cancellable: (nullable): A #GCancellable, or %NULL.
+ * @callback: A callback to execute upon completion.
+ * @user_data: User data for @callback.
+ *
+ * Asynchronously performs aws_s3_client_download_sync() on a worker thread.
+ */
+void
+aws_s3_client_download_async (AwsS3Client         *client,
+                              const gchar         *bucket,
+                              const gchar         *path,
+                              GFile               *destination,
+                              GCancellable        *cancellable,
+                              GAsyncReadyCallback  callback,
+                              gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  DownloadState *state;
+
+  g_return_if_fail (AWS_IS_S3_CLIENT (client));
+  g_return_if_fail (bucket != NULL);
+  g_return_if_fail (path != NULL);
+  g_return_if_fail (G_IS_FILE (destination));
+
+  state = g_slice_new0 (DownloadState);
+  state->bucket = g_strdup (bucket);
+  state->path = g_strdup (path);
+  state->destination = g_object_ref (destination);
+
+  task = g_task_new (client, cancellable, callback, user_data);
+  g_task_set_source_tag (task, aws_s3_client_download_async);
+  g_task_set_task_data (task, state, download_state_free);
+  g_task_run_in_thread (task, aws_s3_client_download_worker);
+}
 
-  /* We might have completed in got_chunk() from a handler */
-  if (g_task_get_completed (task))
-    return;
+gboolean
+aws_s3_client_download_finish (AwsS3Client   *client,
+                               GAsyncResult  *result,
+                               GError       **error)
+{
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), FALSE);
+  g_return_val_if_fail (G_IS_TASK (result), FALSE);
 
-  if (SOUP_STATUS_IS_SUCCESSFUL (message->status_code))
-    g_task_return_boolean (task, TRUE);
-  else
-    g_task_return_new_error (task,
-                             AWS_S3_CLIENT_ERROR,
-                             AWS_S3_CLIENT_ERROR_UNKNOWN,
-                             "Request failed: %d",
-                             message->status_code);
+  return g_task_propagate_boolean (G_TASK (result), error);
 }
 
 static void
-aws_s3_client_read_got_chunk (SoupMessage *message,
-                              SoupBuffer  *buffer,
-                              GTask       *task)
+aws_s3_client_write_cb (SoupSession *session,
+                        SoupMessage *message,
+                        gpointer     user_data)
 {
+  g_autoptr(GTask) task = user_data;
   AwsS3Client *client;
-  ReadState *state;
+  WriteState *state;
+  SoupMessage *retry;
+  GError *error = NULL;
 
   g_assert (SOUP_IS_MESSAGE (message));
-  g_assert (buffer != NULL);
   g_assert (G_IS_TASK (task));
 
   client = g_task_get_source_object (task);
-  g_assert (AWS_IS_S3_CLIENT (client));
-
   state = g_task_get_task_data (task);
-  g_assert (state != NULL);
-  g_assert (state->handler != NULL);
 
-  if (!state->handler (client, message, buffer, state->handler_data))
+  AWS_PROBE_REQUEST_HEADERS (message, state->bucket, state->path);
+
+  if (!SOUP_STATUS_IS_SUCCESSFUL (message->status_code) &&
+      !state->redirected &&
+      (retry = aws_s3_client_redirect_message (client, message, state->bucket, state->path)))
     {
-      g_task_return_new_error (task,
-                               G_IO_ERROR,
-                               G_IO_ERROR_CANCELLED,
-                               "The request was cancelled");
-      soup_session_cancel_message (SOUP_SESSION (client), message, SOUP_STATUS_CANCELLED);
-   }
+      state->redirected = TRUE;
+      AWS_PROBE_REQUEST_RETRY (message, state->bucket, state->path, state->begin_time);
+      AWS_PROBE_REQUEST_QUEUED (retry, state->bucket, state->path);
+      soup_session_queue_message (SOUP_SESSION (client),
+                                  retry,
+                                  aws_s3_client_write_cb,
+                                  g_steal_pointer (&task));
+      return;
+    }
+
+  AWS_PROBE_REQUEST_DONE (message, state->bucket, state->path, state->begin_time);
+
+  if (aws_s3_client_check_status (message, &error))
+    {
+      aws_s3_client_learn_region (client, state->bucket, message);
+      aws_s3_client_forget_stat (client, state->bucket, state->path);
+      g_task_return_boolean (task, TRUE);
+    }
+  else
+    g_task_return_error (task, error);
 }
 
+/*
+ * Uploads the spliced @contents, taking ownership of @task.
+ */
 static void
-aws_s3_client_read_got_headers (SoupMessage *message,
-                                GTask       *task)
+aws_s3_client_queue_write (GTask               *task,
+                           GMemoryOutputStream *contents)
 {
+  g_autoptr(GBytes) body = NULL;
   AwsS3Client *client;
+  WriteState *state;
+  SoupMessage *message;
 
-  g_assert (SOUP_IS_MESSAGE(message));
   g_assert (G_IS_TASK (task));
+  g_assert (G_IS_MEMORY_OUTPUT_STREAM (contents));
 
   client = g_task_get_source_object (task);
-  g_assert (AWS_IS_S3_CLIENT (client));
+  state = g_task_get_task_data (task);
+  body = g_memory_output_stream_steal_as_bytes (contents);
 
-  if (!SOUP_STATUS_IS_SUCCESSFUL (message->status_code))
-    {
-      /*
-       * Extract the given error type.
-       */
-      if (message->status_code == SOUP_STATUS_NOT_FOUND)
-        {
-          g_task_return_new_error (task,
-                                   AWS_S3_CLIENT_ERROR,
-                                   AWS_S3_CLIENT_ERROR_NOT_FOUND,
-                                   "The requested object was not found.");
-         soup_session_cancel_message (SOUP_SESSION (client), message, message->status_code);
-        }
-      else if (SOUP_STATUS_IS_CLIENT_ERROR (message->status_code))
-        {
-          g_task_return_new_error (task,
-                                   AWS_S3_CLIENT_ERROR,
-                                   AWS_S3_CLIENT_ERROR_BAD_REQUEST,
-                                   "The request was invalid.");
-          soup_session_cancel_message (SOUP_SESSION (client), message, message->status_code);
-        }
-      else
-        {
-          g_task_return_new_error (task,
-                                   AWS_S3_CLIENT_ERROR,
-                                   AWS_S3_CLIENT_ERROR_UNKNOWN,
-                                   "An unknown error occurred.");
-          soup_session_cancel_message (SOUP_SESSION (client), message, SOUP_STATUS_CANCELLED);
-        }
-    }
+  message = aws_s3_client_new_put_message (client,
+                                           state->bucket,
+                                           state->path,
+                                           state->codec,
+                                           body);
+
+  AWS_PROBE_REQUEST_QUEUED (message, state->bucket, state->path);
+  soup_session_queue_message (SOUP_SESSION (client),
+                              message,
+                              aws_s3_client_write_cb,
+                              task);
 }
 
-void
-aws_s3_client_read_async (AwsS3Client            *client,
-                          const gchar            *bucket,
-                          const gchar            *path,
-                          AwsS3ClientDataHandler  handler,
-                          gpointer                handler_data,
-                          GDestroyNotify          handler_notify,
-                          GCancellable           *cancellable,
-                          GAsyncReadyCallback     callback,
-                          gpointer                user_data)
+static void
+aws_s3_client_write_splice_cb (GObject      *object,
+                               GAsyncResult *result,
+                               gpointer      user_data)
 {
-  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (client);
-  g_autoptr(GTask) task = NULL;
-  g_autofree gchar *auth = NULL;
-  g_autofree gchar *date_str = NULL;
-  g_autofree gchar *signature = NULL;
-  g_autofree gchar *uri = NULL;
-  g_autoptr(SoupDate) date = NULL;
-  g_autoptr(GString) str = NULL;
-  g_autoptr(SoupMessage) message = NULL;
-  ReadState *state;
-  guint16 port;
-
-  g_return_if_fail (AWS_IS_S3_CLIENT(client));
-  g_return_if_fail (bucket);
-  g_return_if_fail (path);
-  g_return_if_fail (g_utf8_validate(bucket, -1, NULL));
-  g_return_if_fail (g_utf8_validate(path, -1, NULL));
-  g_return_if_fail (handler != NULL);
-
-  task = g_task_new (client, cancellable, callback, user_data);
-  g_task_set_source_tag (task, aws_s3_client_read_async);
-
-  state = read_state_new (handler, handler_data, handler_notify);
-  g_task_set_task_data (task, state, read_state_free);
-
-  /*
-   * Strip leading '/' from the path.
-   */
-  while (g_utf8_get_char (path) == '/')
-    path = g_utf8_next_char (path);
+  GOutputStream *contents = (GOutputStream *)object;
+  g_autoptr(GTask) task = user_data;
+  GError *error = NULL;
 
-  /*
-   * Determine our connection port.
-   */
-  port = priv->port_set ? priv->port : (priv->secure ? 443 : 80);
+  g_assert (G_IS_MEMORY_OUTPUT_STREAM (contents));
+  g_assert (G_IS_TASK (task));
 
-  /*
-   * Build our HTTP request message.
-   */
-  uri = g_strdup_printf ("%s://%s:%d/%s/%s",
-                         priv->secure ? "https" : "http",
-                         priv->host,
-                         port,
-                         bucket,
-                         path);
-  message = soup_message_new (SOUP_METHOD_GET, uri);
-  soup_message_body_set_accumulate (message->response_body, FALSE);
-  g_signal_connect_object (message,
-                           "got-chunk",
-                           G_CALLBACK (aws_s3_client_read_got_chunk),
-                           task,
-                           0);
-  g_signal_connect_object (message,
-                           "got-headers",
-                           G_CALLBACK (aws_s3_client_read_got_headers),
-                           task,
-                           0);
+  if (g_output_stream_splice_finish (contents, result, &error) < 0)
+    {
+      g_task_return_error (task, error);
+      return;
+    }
 
-  /*
-   * Set the Host header for systems that may be proxying.
-   */
-  if (priv->host != NULL)
-    soup_message_headers_append (message->request_headers, "Host", priv->host);
+  aws_s3_client_queue_write (g_steal_pointer (&task), G_MEMORY_OUTPUT_STREAM (contents));
+}
 
-  /*
-   * Add the Date header which we need for signing.
-   */
-  date = soup_date_new_from_now (0);
-  date_str = soup_date_to_string (date, SOUP_DATE_HTTP);
-  soup_message_headers_append (message->request_headers, "Date", date_str);
+static void
+compress_job_free (gpointer data)
+{
+  CompressJob *job = data;
 
-  /*
-   * Sign our request.
-   */
-  str = g_string_new ("GET\n\n\n");
-  g_string_append_printf (str, "%s\n", date_str);
-  g_string_append_printf (str, "/%s/%s", bucket, path);
-  signature = aws_credentials_sign (priv->creds, str->str, str->len, G_CHECKSUM_SHA1);
+  g_clear_object (&job->task);
+  g_clear_object (&job->source);
+  g_clear_object (&job->contents);
+  g_clear_error (&job->error);
+  g_slice_free (CompressJob, job);
+}
 
-  /*
-   * Attach request signature to our headers.
-   */
-  auth = g_strdup_printf ("AWS %s:%s",
-                          aws_credentials_get_access_key (priv->creds),
-                          signature);
-  soup_message_headers_append (message->request_headers, "Authorization", auth);
+/*
+ * Runs on a transform thread, reading and compressing the whole source.
+ */
+static void
+aws_s3_client_compress_work (gpointer data)
+{
+  CompressJob *job = data;
 
-  /*
-   * Submit our request to the target.
-   */
-  soup_session_queue_message (SOUP_SESSION (client),
-                              g_steal_pointer (&message),
-                              aws_s3_client_read_cb,
-                              g_steal_pointer (&task));
+  g_output_stream_splice (job->contents,
+                          job->source,
+                          G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+                          g_task_get_cancellable (job->task),
+                          &job->error);
 }
 
-gboolean
-aws_s3_client_read_finish (AwsS3Client   *client,
-                           GAsyncResult  *result,
-                           GError       **error)
+static void
+aws_s3_client_compress_done (gpointer data)
 {
-  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), FALSE);
-  g_return_val_if_fail (G_IS_TASK (result), FALSE);
+  CompressJob *job = data;
 
-  return g_task_propagate_boolean (G_TASK (result), error);
+  if (job->error != NULL)
+    g_task_return_error (job->task, g_steal_pointer (&job->error));
+  else
+    aws_s3_client_queue_write (g_steal_pointer (&job->task),
+                               G_MEMORY_OUTPUT_STREAM (job->contents));
 }
 
+/**
+ * aws_s3_client_write_async:
+ * @client: An #AwsS3Client.
+ * @bucket: The bucket to write to.
+ * @path: The path of the object within @bucket.
+ * @stream: A #GInputStream containing the contents.
+ * @cancellable: (nullable): A #GCancellable, or %NULL.
+ * @callback: A callback to execute upon completion.
+ * @user_data: User data for @callback.
+ *
+ * Asynchronously uploads the contents of @stream to @path. The contents
+ * are read in full, and compressed according to #AwsS3Client:write-codec,
+ * before the request is sent.
+ */
 void
 aws_s3_client_write_async (AwsS3Client         *client,
                            const gchar         *bucket,
@@ -423,7 +4477,12 @@ aws_s3_client_write_async (AwsS3Client         *client,
                            GAsyncReadyCallback  callback,
                            gpointer             user_data)
 {
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (client);
   g_autoptr(GTask) task = NULL;
+  g_autoptr(GOutputStream) contents = NULL;
+  g_autoptr(GInputStream) source = NULL;
+  g_autoptr(AwsSerialExecutor) executor = NULL;
+  GError *error = NULL;
 
   g_return_if_fail (AWS_IS_S3_CLIENT (client));
   g_return_if_fail (bucket);
@@ -432,11 +4491,44 @@ aws_s3_client_write_async (AwsS3Client         *client,
 
   task = g_task_new (client, cancellable, callback, user_data);
   g_task_set_source_tag (task, aws_s3_client_write_async);
+  g_task_set_task_data (task,
+                        write_state_new (bucket, skip_leading_slashes (path), priv->write_codec),
+                        write_state_free);
+
+  if (!(source = aws_s3_client_wrap_write_stream (priv->write_codec, stream, &error)))
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  contents = g_memory_output_stream_new_resizable ();
+
+  /* Compress on a transform thread rather than the main context */
+  if (priv->write_codec != AWS_S3_CLIENT_CODEC_NONE &&
+      (executor = aws_s3_client_new_transform_executor (client)))
+    {
+      CompressJob *job;
 
-  g_task_return_new_error (task,
-                           G_IO_ERROR,
-                           G_IO_ERROR_NOT_SUPPORTED,
-                           "Writing support has not been implemented");
+      job = g_slice_new0 (CompressJob);
+      job->task = g_steal_pointer (&task);
+      job->source = g_steal_pointer (&source);
+      job->contents = g_steal_pointer (&contents);
+
+      aws_serial_executor_push (executor,
+                                aws_s3_client_compress_work,
+                                aws_s3_client_compress_done,
+                                job,
+                                compress_job_free);
+      return;
+    }
+
+  g_output_stream_splice_async (contents,
+                                source,
+                                G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+                                G_PRIORITY_DEFAULT,
+                                cancellable,
+                                aws_s3_client_write_splice_cb,
+                                g_steal_pointer (&task));
 }
 
 gboolean
@@ -450,6 +4542,117 @@ aws_s3_client_write_finish (AwsS3Client   *client,
   return g_task_propagate_boolean (G_TASK (result), error);
 }
 
+/**
+ * aws_s3_client_write_sync:
+ * @client: An #AwsS3Client.
+ * @bucket: The bucket to write to.
+ * @path: The path of the object within @bucket.
+ * @stream: A #GInputStream containing the contents.
+ * @cancellable: (nullable): A #GCancellable, or %NULL.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Synchronously uploads the contents of @stream to @path. This does not
+ * require a main loop and is intended for use from worker threads. As with
+ * aws_s3_client_write_async(), the contents are read in full, and
+ * compressed according to #AwsS3Client:write-codec, before the request is
+ * sent; use aws_s3_client_write_bytes_sync() to upload a mapped file
+ * without a copy.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ */
+gboolean
+aws_s3_client_write_sync (AwsS3Client   *client,
+                          const gchar   *bucket,
+                          const gchar   *path,
+                          GInputStream  *stream,
+                          GCancellable  *cancellable,
+                          GError       **error)
+{
+  AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (client);
+  g_autoptr(GOutputStream) contents = NULL;
+  g_autoptr(SoupMessage) message = NULL;
+  g_autoptr(GInputStream) response = NULL;
+  g_autoptr(GInputStream) source = NULL;
+  g_autoptr(GBytes) body = NULL;
+  AwsS3ClientCodec codec;
+
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), FALSE);
+  g_return_val_if_fail (bucket != NULL, FALSE);
+  g_return_val_if_fail (path != NULL, FALSE);
+  g_return_val_if_fail (G_IS_INPUT_STREAM (stream), FALSE);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), FALSE);
+
+  path = skip_leading_slashes (path);
+  codec = priv->write_codec;
+
+  if (!(source = aws_s3_client_wrap_write_stream (codec, stream, error)))
+    return FALSE;
+
+  contents = g_memory_output_stream_new_resizable ();
+
+  if (g_output_stream_splice (contents,
+                              source,
+                              G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+                              cancellable,
+                              error) < 0)
+    return FALSE;
+
+  body = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (contents));
+  message = aws_s3_client_new_put_message (client, bucket, path, codec, body);
+
+  if (!(response = aws_s3_client_send_sync (client, &message, bucket, path, cancellable, error)))
+    return FALSE;
+
+  aws_s3_client_forget_stat (client, bucket, path);
+
+  return g_input_stream_close (response, cancellable, error);
+}
+
+/**
+ * aws_s3_client_write_bytes_sync:
+ * @client: An #AwsS3Client.
+ * @bucket: The bucket to store the object in.
+ * @path: The path of the object within @bucket.
+ * @bytes: The contents of the object.
+ * @cancellable: (nullable): A #GCancellable, or %NULL.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Synchronously stores @bytes at @path exactly as given, so that byte
+ * offsets into @bytes remain valid for aws_s3_client_read_range_sync().
+ *
+ * #AwsS3Client:write-codec does not apply.
+ *
+ * Returns: %TRUE if successful, otherwise %FALSE and @error is set.
+ */
+gboolean
+aws_s3_client_write_bytes_sync (AwsS3Client   *client,
+                                const gchar   *bucket,
+                                const gchar   *path,
+                                GBytes        *bytes,
+                                GCancellable  *cancellable,
+                                GError       **error)
+{
+  g_autoptr(SoupMessage) message = NULL;
+  g_autoptr(GInputStream) response = NULL;
+
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), FALSE);
+  g_return_val_if_fail (bucket != NULL, FALSE);
+  g_return_val_if_fail (path != NULL, FALSE);
+  g_return_val_if_fail (bytes != NULL, FALSE);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), FALSE);
+
+  path = skip_leading_slashes (path);
+
+  message = aws_s3_client_new_put_message (client, bucket, path, AWS_S3_CLIENT_CODEC_NONE, bytes);
+
+  if (!(response = aws_s3_client_send_sync (client, &message, bucket, path, cancellable, error)))
+    return FALSE;
+
+  aws_s3_client_forget_stat (client, bucket, path);
+
+  return g_input_stream_close (response, cancellable, error);
+}
+
 static void
 aws_s3_client_finalize (GObject *object)
 {
@@ -457,7 +4660,15 @@ aws_s3_client_finalize (GObject *object)
   AwsS3ClientPrivate *priv = aws_s3_client_get_instance_private (self);
 
   g_clear_pointer (&priv->host, g_free);
+  g_clear_pointer (&priv->region, g_free);
+  g_clear_pointer (&priv->regions, g_hash_table_unref);
+  g_clear_pointer (&priv->stats, g_hash_table_unref);
   g_clear_object (&priv->creds);
+  g_clear_object (&priv->provider);
+  g_clear_pointer (&priv->pool, aws_buffer_pool_unref);
+  g_clear_pointer (&priv->transform_pool, aws_serial_executor_pool_unref);
+  g_mutex_clear (&priv->regions_mutex);
+  g_mutex_clear (&priv->stats_mutex);
 
   G_OBJECT_CLASS (aws_s3_client_parent_class)->finalize (object);
 }
@@ -476,6 +4687,14 @@ aws_s3_client_get_property (GObject    *object,
       g_value_set_object (value, aws_s3_client_get_credentials (self));
       break;
 
+    case PROP_CREDENTIALS_PROVIDER:
+      g_value_set_object (value, aws_s3_client_get_credentials_provider (self));
+      break;
+
+    case PROP_DELIVERY_SIZE:
+      g_value_set_uint (value, aws_s3_client_get_delivery_size (self));
+      break;
+
     case PROP_HOST:
       g_value_set_string (value, aws_s3_client_get_host (self));
       break;
@@ -488,10 +4707,34 @@ aws_s3_client_get_property (GObject    *object,
       g_value_set_boolean (value, aws_s3_client_get_port_set (self));
       break;
 
+    case PROP_READ_CODEC:
+      g_value_set_enum (value, aws_s3_client_get_read_codec (self));
+      break;
+
+    case PROP_REGION:
+      g_value_set_string (value, aws_s3_client_get_region (self));
+      break;
+
+    case PROP_REGION_CACHE_TTL:
+      g_value_set_uint (value, aws_s3_client_get_region_cache_ttl (self));
+      break;
+
     case PROP_SECURE:
       g_value_set_boolean (value, aws_s3_client_get_secure (self));
       break;
 
+    case PROP_STAT_CACHE_TTL:
+      g_value_set_uint (value, aws_s3_client_get_stat_cache_ttl (self));
+      break;
+
+    case PROP_TRANSFORM_THREADS:
+      g_value_set_uint (value, aws_s3_client_get_transform_threads (self));
+      break;
+
+    case PROP_WRITE_CODEC:
+      g_value_set_enum (value, aws_s3_client_get_write_codec (self));
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     }
@@ -511,6 +4754,14 @@ aws_s3_client_set_property (GObject      *object,
       aws_s3_client_set_credentials (self, g_value_get_object (value));
       break;
 
+    case PROP_CREDENTIALS_PROVIDER:
+      aws_s3_client_set_credentials_provider (self, g_value_get_object (value));
+      break;
+
+    case PROP_DELIVERY_SIZE:
+      aws_s3_client_set_delivery_size (self, g_value_get_uint (value));
+      break;
+
     case PROP_HOST:
       aws_s3_client_set_host (self, g_value_get_string (value));
       break;
@@ -519,10 +4770,34 @@ aws_s3_client_set_property (GObject      *object,
       aws_s3_client_set_port (self, g_value_get_uint (value));
       break;
 
+    case PROP_READ_CODEC:
+      aws_s3_client_set_read_codec (self, g_value_get_enum (value));
+      break;
+
+    case PROP_REGION:
+      aws_s3_client_set_region (self, g_value_get_string (value));
+      break;
+
+    case PROP_REGION_CACHE_TTL:
+      aws_s3_client_set_region_cache_ttl (self, g_value_get_uint (value));
+      break;
+
     case PROP_SECURE:
       aws_s3_client_set_secure (self, g_value_get_boolean (value));
       break;
 
+    case PROP_STAT_CACHE_TTL:
+      aws_s3_client_set_stat_cache_ttl (self, g_value_get_uint (value));
+      break;
+
+    case PROP_TRANSFORM_THREADS:
+      aws_s3_client_set_transform_threads (self, g_value_get_uint (value));
+      break;
+
+    case PROP_WRITE_CODEC:
+      aws_s3_client_set_write_codec (self, g_value_get_enum (value));
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     }
@@ -544,6 +4819,22 @@ aws_s3_client_class_init (AwsS3ClientClass *klass)
                          AWS_TYPE_CREDENTIALS,
                          G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
 
+  properties [PROP_CREDENTIALS_PROVIDER] =
+    g_param_spec_object ("credentials-provider",
+                         "Credentials Provider",
+                         "A provider of credentials, which takes precedence over credentials.",
+                         AWS_TYPE_CREDENTIALS_PROVIDER,
+                         G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+
+  properties [PROP_DELIVERY_SIZE] =
+    g_param_spec_uint ("delivery-size",
+                       "Delivery Size",
+                       "The size of blocks passed to data handlers, or 0 to pass data as it arrives.",
+                       0,
+                       G_MAXUINT,
+                       0,
+                       G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+
   properties [PROP_HOST] =
     g_param_spec_string ("host",
                          "Host",
@@ -567,6 +4858,30 @@ aws_s3_client_class_init (AwsS3ClientClass *klass)
                          FALSE,
                          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
 
+  properties [PROP_READ_CODEC] =
+    g_param_spec_enum ("read-codec",
+                       "Read Codec",
+                       "How object contents are decompressed while reading.",
+                       AWS_TYPE_S3_CLIENT_CODEC,
+                       AWS_S3_CLIENT_CODEC_NONE,
+                       G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+
+  properties [PROP_REGION] =
+    g_param_spec_string ("region",
+                         "Region",
+                         "The region to presign URLs for when a bucket's region is unknown.",
+                         "us-east-1",
+                         G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+
+  properties [PROP_REGION_CACHE_TTL] =
+    g_param_spec_uint ("region-cache-ttl",
+                       "Region Cache TTL",
+                       "Seconds to remember the region discovered for a bucket.",
+                       0,
+                       G_MAXUINT,
+                       3600,
+                       G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+
   properties [PROP_SECURE] =
     g_param_spec_boolean("secure",
                          _("Secure"),
@@ -574,6 +4889,32 @@ aws_s3_client_class_init (AwsS3ClientClass *klass)
                          TRUE,
                          G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
 
+  properties [PROP_STAT_CACHE_TTL] =
+    g_param_spec_uint ("stat-cache-ttl",
+                       "Stat Cache TTL",
+                       "Seconds to reuse object metadata from stat and list requests.",
+                       0,
+                       G_MAXUINT,
+                       5,
+                       G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+
+  properties [PROP_TRANSFORM_THREADS] =
+    g_param_spec_uint ("transform-threads",
+                       "Transform Threads",
+                       "Threads used to compress and decompress object contents, or 0 for none.",
+                       0,
+                       G_MAXUINT,
+                       0,
+                       G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+
+  properties [PROP_WRITE_CODEC] =
+    g_param_spec_enum ("write-codec",
+                       "Write Codec",
+                       "How object contents are compressed while writing.",
+                       AWS_TYPE_S3_CLIENT_CODEC,
+                       AWS_S3_CLIENT_CODEC_NONE,
+                       G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (object_class, N_PROPS, properties);
 }
 
@@ -584,7 +4925,14 @@ aws_s3_client_init (AwsS3Client *client)
 
   priv->host = g_strdup_printf ("s3.amazonaws.com");
   priv->creds = aws_credentials_new ("", "");
+  priv->region = g_strdup ("us-east-1");
   priv->secure = TRUE;
+  priv->region_cache_ttl = 3600;
+  priv->regions = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, region_entry_free);
+  g_mutex_init (&priv->regions_mutex);
+  priv->stat_cache_ttl = 5;
+  priv->stats = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, stat_entry_free);
+  g_mutex_init (&priv->stats_mutex);
 }
 
 GQuark
@@ -592,3 +4940,26 @@ aws_s3_client_error_quark (void)
 {
   return g_quark_from_static_string ("aws-s3-client-error-quark");
 }
+
+GType
+aws_s3_client_codec_get_type (void)
+{
+  static gsize type_id;
+
+  if (g_once_init_enter (&type_id))
+    {
+      static const GEnumValue values[] = {
+        { AWS_S3_CLIENT_CODEC_NONE, "AWS_S3_CLIENT_CODEC_NONE", "none" },
+        { AWS_S3_CLIENT_CODEC_AUTO, "AWS_S3_CLIENT_CODEC_AUTO", "auto" },
+        { AWS_S3_CLIENT_CODEC_GZIP, "AWS_S3_CLIENT_CODEC_GZIP", "gzip" },
+        { AWS_S3_CLIENT_CODEC_ZSTD, "AWS_S3_CLIENT_CODEC_ZSTD", "zstd" },
+        { 0 }
+      };
+      GType _type_id;
+
+      _type_id = g_enum_register_static ("AwsS3ClientCodec", values);
+      g_once_init_leave (&type_id, _type_id);
+    }
+
+  return type_id;
+}
@@ -23,11 +23,14 @@
 #include <libsoup/soup.h>
 
 #include "aws-credentials.h"
+#include "aws-credentials-provider.h"
+#include "aws-s3-object-info.h"
 
 G_BEGIN_DECLS
 
-#define AWS_TYPE_S3_CLIENT  (aws_s3_client_get_type())
-#define AWS_S3_CLIENT_ERROR (aws_s3_client_error_quark())
+#define AWS_TYPE_S3_CLIENT       (aws_s3_client_get_type())
+#define AWS_TYPE_S3_CLIENT_CODEC (aws_s3_client_codec_get_type())
+#define AWS_S3_CLIENT_ERROR      (aws_s3_client_error_quark())
 
 G_DECLARE_DERIVABLE_TYPE (AwsS3Client, aws_s3_client, AWS, S3_CLIENT, SoupSession)
 
@@ -64,16 +67,110 @@ typedef enum
   AWS_S3_CLIENT_ERROR_CANCELLED   = 2,
   AWS_S3_CLIENT_ERROR_UNKNOWN     = 3,
   AWS_S3_CLIENT_ERROR_NOT_FOUND   = 404,
+  AWS_S3_CLIENT_ERROR_PRECONDITION_FAILED = 412,
 } AwsS3ClientError;
 
+typedef enum
+{
+  AWS_S3_CLIENT_CODEC_NONE = 0,
+  AWS_S3_CLIENT_CODEC_AUTO = 1,
+  AWS_S3_CLIENT_CODEC_GZIP = 2,
+  AWS_S3_CLIENT_CODEC_ZSTD = 3,
+} AwsS3ClientCodec;
+
+typedef enum
+{
+  AWS_S3_CLIENT_SELECT_FORMAT_CSV             = 0,
+  AWS_S3_CLIENT_SELECT_FORMAT_CSV_WITH_HEADER = 1,
+  AWS_S3_CLIENT_SELECT_FORMAT_JSON_LINES      = 2,
+  AWS_S3_CLIENT_SELECT_FORMAT_JSON_DOCUMENT   = 3,
+} AwsS3ClientSelectFormat;
+
+typedef struct
+{
+  guint64 bytes_scanned;
+  guint64 bytes_processed;
+  guint64 bytes_returned;
+} AwsS3ClientSelectStats;
+
+typedef void (*AwsS3ClientSelectProgress) (AwsS3Client                  *client,
+                                           const AwsS3ClientSelectStats *stats,
+                                           gboolean                      final,
+                                           gpointer                      user_data);
+
 GQuark          aws_s3_client_error_quark     (void);
+GType           aws_s3_client_codec_get_type  (void);
 AwsCredentials *aws_s3_client_get_credentials (AwsS3Client             *self);
 void            aws_s3_client_set_credentials (AwsS3Client             *self,
                                                AwsCredentials          *credentials);
+AwsCredentialsProvider *aws_s3_client_get_credentials_provider
+                                              (AwsS3Client             *self);
+guint           aws_s3_client_get_delivery_size
+                                              (AwsS3Client             *self);
 const gchar    *aws_s3_client_get_host        (AwsS3Client             *self);
 guint16         aws_s3_client_get_port        (AwsS3Client             *self);
 gboolean        aws_s3_client_get_port_set    (AwsS3Client             *self);
+void            aws_s3_client_download_async  (AwsS3Client             *self,
+                                               const gchar             *bucket,
+                                               const gchar             *path,
+                                               GFile                   *destination,
+                                               GCancellable            *cancellable,
+                                               GAsyncReadyCallback      callback,
+                                               gpointer                 user_data);
+gboolean        aws_s3_client_download_finish (AwsS3Client             *self,
+                                               GAsyncResult            *result,
+                                               GError                 **error);
+gboolean        aws_s3_client_download_sync   (AwsS3Client             *self,
+                                               const gchar             *bucket,
+                                               const gchar             *path,
+                                               GFile                   *destination,
+                                               GCancellable            *cancellable,
+                                               GError                 **error);
+AwsS3ClientCodec aws_s3_client_get_read_codec (AwsS3Client             *self);
+const gchar    *aws_s3_client_get_region      (AwsS3Client             *self);
+guint           aws_s3_client_get_region_cache_ttl
+                                              (AwsS3Client             *self);
 gboolean        aws_s3_client_get_secure      (AwsS3Client             *self);
+guint           aws_s3_client_get_stat_cache_ttl
+                                              (AwsS3Client             *self);
+guint           aws_s3_client_get_transform_threads
+                                              (AwsS3Client             *self);
+AwsS3ClientCodec aws_s3_client_get_write_codec (AwsS3Client            *self);
+GPtrArray      *aws_s3_client_list_sync       (AwsS3Client             *self,
+                                               const gchar             *bucket,
+                                               const gchar             *prefix,
+                                               const gchar             *delimiter,
+                                               guint                    max_keys,
+                                               const gchar             *continuation_token,
+                                               gchar                  **next_continuation_token,
+                                               GCancellable            *cancellable,
+                                               GError                 **error);
+GInputStream   *aws_s3_client_open_range_sync (AwsS3Client             *self,
+                                               const gchar             *bucket,
+                                               const gchar             *path,
+                                               guint64                  offset,
+                                               const gchar             *etag,
+                                               GCancellable            *cancellable,
+                                               GError                 **error);
+GInputStream   *aws_s3_client_open_sync       (AwsS3Client             *self,
+                                               const gchar             *bucket,
+                                               const gchar             *path,
+                                               GCancellable            *cancellable,
+                                               GError                 **error);
+gchar          *aws_s3_client_presign         (AwsS3Client             *self,
+                                               const gchar             *method,
+                                               const gchar             *bucket,
+                                               const gchar             *path,
+                                               guint                    expires_in);
+guint           aws_s3_client_presign_batch   (AwsS3Client             *self,
+                                               const gchar             *method,
+                                               const gchar             *bucket,
+                                               const gchar * const     *paths,
+                                               guint                    n_paths,
+                                               guint                    expires_in,
+                                               gchar                   *buffer,
+                                               gsize                    buffer_len,
+                                               gchar                  **urls);
 void            aws_s3_client_read_async      (AwsS3Client             *self,
                                                const gchar             *bucket,
                                                const gchar             *path,
@@ -86,12 +183,69 @@ void            aws_s3_client_read_async      (AwsS3Client             *self,
 gboolean        aws_s3_client_read_finish     (AwsS3Client             *self,
                                                GAsyncResult            *result,
                                                GError                 **error);
+GBytes         *aws_s3_client_read_range_sync (AwsS3Client             *self,
+                                               const gchar             *bucket,
+                                               const gchar             *path,
+                                               guint64                  offset,
+                                               gsize                    length,
+                                               GCancellable            *cancellable,
+                                               GError                 **error);
+gboolean        aws_s3_client_read_sync       (AwsS3Client             *self,
+                                               const gchar             *bucket,
+                                               const gchar             *path,
+                                               AwsS3ClientDataHandler   handler,
+                                               gpointer                 handler_data,
+                                               GCancellable            *cancellable,
+                                               GError                 **error);
+void            aws_s3_client_select_async    (AwsS3Client             *self,
+                                               const gchar             *bucket,
+                                               const gchar             *path,
+                                               const gchar             *expression,
+                                               AwsS3ClientSelectFormat  input_format,
+                                               AwsS3ClientSelectFormat  output_format,
+                                               AwsS3ClientDataHandler   handler,
+                                               AwsS3ClientSelectProgress progress,
+                                               gpointer                 handler_data,
+                                               GDestroyNotify           handler_notify,
+                                               GCancellable            *cancellable,
+                                               GAsyncReadyCallback      callback,
+                                               gpointer                 user_data);
+gboolean        aws_s3_client_select_finish   (AwsS3Client             *self,
+                                               GAsyncResult            *result,
+                                               AwsS3ClientSelectStats  *stats,
+                                               GError                 **error);
+void            aws_s3_client_set_credentials_provider
+                                              (AwsS3Client             *self,
+                                               AwsCredentialsProvider  *provider);
+void            aws_s3_client_set_delivery_size
+                                              (AwsS3Client             *self,
+                                               guint                    delivery_size);
 void            aws_s3_client_set_host        (AwsS3Client             *self,
                                                const gchar             *host);
 void            aws_s3_client_set_port        (AwsS3Client             *self,
                                                guint16                  port);
+void            aws_s3_client_set_read_codec  (AwsS3Client             *self,
+                                               AwsS3ClientCodec         read_codec);
+void            aws_s3_client_set_region      (AwsS3Client             *self,
+                                               const gchar             *region);
+void            aws_s3_client_set_region_cache_ttl
+                                              (AwsS3Client             *self,
+                                               guint                    region_cache_ttl);
 void            aws_s3_client_set_secure      (AwsS3Client             *self,
                                                gboolean                 secure);
+void            aws_s3_client_set_stat_cache_ttl
+                                              (AwsS3Client             *self,
+                                               guint                    stat_cache_ttl);
+void            aws_s3_client_set_transform_threads
+                                              (AwsS3Client             *self,
+                                               guint                    transform_threads);
+void            aws_s3_client_set_write_codec (AwsS3Client             *self,
+                                               AwsS3ClientCodec         write_codec);
+AwsS3ObjectInfo *aws_s3_client_stat_sync      (AwsS3Client             *self,
+                                               const gchar             *bucket,
+                                               const gchar             *path,
+                                               GCancellable            *cancellable,
+                                               GError                 **error);
 void            aws_s3_client_write_async     (AwsS3Client             *self,
                                                const gchar             *bucket,
                                                const gchar             *path,
@@ -99,9 +253,22 @@ void            aws_s3_client_write_async     (AwsS3Client             *self,
                                                GCancellable            *cancellable,
                                                GAsyncReadyCallback      callback,
                                                gpointer                 user_data);
+gboolean        aws_s3_client_write_bytes_sync
+                                              (AwsS3Client             *self,
+                                               const gchar             *bucket,
+                                               const gchar             *path,
+                                               GBytes                  *bytes,
+                                               GCancellable            *cancellable,
+                                               GError                 **error);
 gboolean        aws_s3_client_write_finish    (AwsS3Client             *self,
                                                GAsyncResult            *result,
                                                GError                 **error);
+gboolean        aws_s3_client_write_sync      (AwsS3Client             *self,
+                                               const gchar             *bucket,
+                                               const gchar             *path,
+                                               GInputStream            *stream,
+                                               GCancellable            *cancellable,
+                                               GError                 **error);
 
 G_END_DECLS
 
@@ -0,0 +1,189 @@
+/* aws-s3-file-enumerator.c
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "aws-s3-file-enumerator.h"
+#include "aws-s3-file-private.h"
+
+/*
+ * Enumerates the children of an AwsS3File by listing its key prefix with
+ * a "/" delimiter, one page at a time as the caller advances.
+ */
+
+struct _AwsS3FileEnumerator
+{
+  GFileEnumerator parent_instance;
+
+  GFileAttributeMatcher *matcher;
+  gchar *prefix;
+  GPtrArray *page;
+  gchar *token;
+  guint index;
+};
+
+G_DEFINE_TYPE (AwsS3FileEnumerator, aws_s3_file_enumerator, G_TYPE_FILE_ENUMERATOR)
+
+static gboolean
+aws_s3_file_enumerator_fetch (AwsS3FileEnumerator  *self,
+                              GCancellable         *cancellable,
+                              GError              **error)
+{
+  AwsS3File *container;
+  GPtrArray *page;
+  GError *local_error = NULL;
+  gchar *next_token = NULL;
+
+  g_assert (AWS_IS_S3_FILE_ENUMERATOR (self));
+
+  container = AWS_S3_FILE (g_file_enumerator_get_container (G_FILE_ENUMERATOR (self)));
+
+  page = aws_s3_client_list_sync (aws_s3_file_get_client (container),
+                                  aws_s3_file_get_bucket (container),
+                                  *self->prefix ? self->prefix : NULL,
+                                  "/",
+                                  0,
+                                  self->token,
+                                  &next_token,
+                                  cancellable,
+                                  &local_error);
+
+  if (page == NULL)
+    {
+      aws_s3_file_set_error (error, local_error);
+      return FALSE;
+    }
+
+  g_clear_pointer (&self->page, g_ptr_array_unref);
+  g_free (self->token);
+
+  self->page = page;
+  self->token = next_token;
+  self->index = 0;
+
+  return TRUE;
+}
+
+/*
+ * Creates an enumerator for the children of @container, fetching the
+ * first page right away so that a missing directory is reported here
+ * rather than looking empty.
+ */
+GFileEnumerator *
+aws_s3_file_enumerator_new (AwsS3File     *container,
+                            const gchar   *attributes,
+                            GCancellable  *cancellable,
+                            GError       **error)
+{
+  g_autoptr(AwsS3FileEnumerator) self = NULL;
+  const gchar *path;
+
+  g_return_val_if_fail (AWS_IS_S3_FILE (container), NULL);
+
+  self = g_object_new (AWS_TYPE_S3_FILE_ENUMERATOR,
+                       "container", container,
+                       NULL);
+
+  path = aws_s3_file_get_object_path (container);
+  self->prefix = *path ? g_strconcat (path, "/", NULL) : g_strdup ("");
+  self->matcher = g_file_attribute_matcher_new (attributes);
+
+  if (!aws_s3_file_enumerator_fetch (self, cancellable, error))
+    return NULL;
+
+  if (self->page->len == 0 && *path != '\0')
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_FOUND,
+                   "No such directory");
+      return NULL;
+    }
+
+  return G_FILE_ENUMERATOR (g_steal_pointer (&self));
+}
+
+static GFileInfo *
+aws_s3_file_enumerator_next_file (GFileEnumerator  *enumerator,
+                                  GCancellable     *cancellable,
+                                  GError          **error)
+{
+  AwsS3FileEnumerator *self = (AwsS3FileEnumerator *)enumerator;
+
+  g_assert (AWS_IS_S3_FILE_ENUMERATOR (self));
+
+  for (;;)
+    {
+      while (self->page != NULL && self->index < self->page->len)
+        {
+          AwsS3ObjectInfo *info = g_ptr_array_index (self->page, self->index++);
+
+          /* Skip the placeholder object some tools create for a directory */
+          if (g_str_equal (aws_s3_object_info_get_key (info), self->prefix))
+            continue;
+
+          return aws_s3_file_create_info (info, self->matcher);
+        }
+
+      if (self->token == NULL || !aws_s3_file_enumerator_fetch (self, cancellable, error))
+        return NULL;
+    }
+}
+
+static gboolean
+aws_s3_file_enumerator_close_fn (GFileEnumerator  *enumerator,
+                                 GCancellable     *cancellable,
+                                 GError          **error)
+{
+  AwsS3FileEnumerator *self = (AwsS3FileEnumerator *)enumerator;
+
+  g_assert (AWS_IS_S3_FILE_ENUMERATOR (self));
+
+  g_clear_pointer (&self->page, g_ptr_array_unref);
+  g_clear_pointer (&self->token, g_free);
+
+  return TRUE;
+}
+
+static void
+aws_s3_file_enumerator_finalize (GObject *object)
+{
+  AwsS3FileEnumerator *self = (AwsS3FileEnumerator *)object;
+
+  g_clear_pointer (&self->matcher, g_file_attribute_matcher_unref);
+  g_clear_pointer (&self->prefix, g_free);
+  g_clear_pointer (&self->page, g_ptr_array_unref);
+  g_clear_pointer (&self->token, g_free);
+
+  G_OBJECT_CLASS (aws_s3_file_enumerator_parent_class)->finalize (object);
+}
+
+static void
+aws_s3_file_enumerator_class_init (AwsS3FileEnumeratorClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GFileEnumeratorClass *enumerator_class = G_FILE_ENUMERATOR_CLASS (klass);
+
+  object_class->finalize = aws_s3_file_enumerator_finalize;
+
+  enumerator_class->next_file = aws_s3_file_enumerator_next_file;
+  enumerator_class->close_fn = aws_s3_file_enumerator_close_fn;
+}
+
+static void
+aws_s3_file_enumerator_init (AwsS3FileEnumerator *self)
+{
+}
@@ -0,0 +1,37 @@
+/* aws-s3-file-enumerator.h
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AWS_S3_FILE_ENUMERATOR_H
+#define AWS_S3_FILE_ENUMERATOR_H
+
+#include "aws-s3-file.h"
+
+G_BEGIN_DECLS
+
+#define AWS_TYPE_S3_FILE_ENUMERATOR (aws_s3_file_enumerator_get_type())
+
+G_DECLARE_FINAL_TYPE (AwsS3FileEnumerator, aws_s3_file_enumerator, AWS, S3_FILE_ENUMERATOR, GFileEnumerator)
+
+GFileEnumerator *aws_s3_file_enumerator_new (AwsS3File            *container,
+                                             const gchar          *attributes,
+                                             GCancellable         *cancellable,
+                                             GError              **error);
+
+G_END_DECLS
+
+#endif /* AWS_S3_FILE_ENUMERATOR_H */
@@ -0,0 +1,33 @@
+/* aws-s3-file-private.h
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AWS_S3_FILE_PRIVATE_H
+#define AWS_S3_FILE_PRIVATE_H
+
+#include "aws-s3-file.h"
+
+G_BEGIN_DECLS
+
+GFileInfo *aws_s3_file_create_info (AwsS3ObjectInfo       *info,
+                                    GFileAttributeMatcher *matcher);
+void       aws_s3_file_set_error   (GError               **error,
+                                    GError                *source);
+
+G_END_DECLS
+
+#endif /* AWS_S3_FILE_PRIVATE_H */
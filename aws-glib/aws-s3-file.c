@@ -0,0 +1,755 @@
+/* aws-s3-file.c
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "aws-s3-file.h"
+#include "aws-s3-file-enumerator.h"
+#include "aws-s3-file-private.h"
+#include "aws-s3-input-stream.h"
+
+struct _AwsS3File
+{
+  GObject parent_instance;
+
+  AwsS3Client *client;
+  gchar *bucket;
+  gchar *path;
+};
+
+static void file_iface_init (GFileIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (AwsS3File, aws_s3_file, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (G_TYPE_FILE, file_iface_init))
+
+enum {
+  PROP_0,
+  PROP_BUCKET,
+  PROP_CLIENT,
+  PROP_OBJECT_PATH,
+  N_PROPS
+};
+
+static GParamSpec *properties [N_PROPS];
+
+/*
+ * Object keys are treated as '/' separated paths. Empty, "." and ".."
+ * components are resolved so that equal files have equal keys.
+ */
+static gchar *
+normalize_path (const gchar *path)
+{
+  g_auto(GStrv) parts = NULL;
+  g_autoptr(GPtrArray) kept = NULL;
+  guint i;
+
+  parts = g_strsplit (path, "/", -1);
+  kept = g_ptr_array_new ();
+
+  for (i = 0; parts [i] != NULL; i++)
+    {
+      if (parts [i][0] == '\0' || g_str_equal (parts [i], "."))
+        continue;
+
+      if (g_str_equal (parts [i], ".."))
+        {
+          if (kept->len > 0)
+            g_ptr_array_set_size (kept, kept->len - 1);
+          continue;
+        }
+
+      g_ptr_array_add (kept, parts [i]);
+    }
+
+  g_ptr_array_add (kept, NULL);
+
+  return g_strjoinv ("/", (gchar **)kept->pdata);
+}
+
+static GFile *
+aws_s3_file_new_normalized (AwsS3Client *client,
+                            const gchar *bucket,
+                            const gchar *path)
+{
+  return g_object_new (AWS_TYPE_S3_FILE,
+                       "client", client,
+                       "bucket", bucket,
+                       "object-path", path,
+                       NULL);
+}
+
+/**
+ * aws_s3_file_new:
+ * @client: The #AwsS3Client to access the object with.
+ * @uri: A URI of the form s3://bucket/key.
+ *
+ * Creates a #GFile for the object or directory named by @uri. No request
+ * is made until the file is used.
+ *
+ * Returns: (transfer full) (nullable): A #GFile, or %NULL if @uri is not
+ *   a valid s3:// URI.
+ */
+GFile *
+aws_s3_file_new (AwsS3Client *client,
+                 const gchar *uri)
+{
+  g_autofree gchar *bucket = NULL;
+  g_autofree gchar *unescaped = NULL;
+  g_autofree gchar *path = NULL;
+  const gchar *slash;
+
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), NULL);
+  g_return_val_if_fail (uri != NULL, NULL);
+
+  if (g_ascii_strncasecmp (uri, "s3://", 5) != 0)
+    return NULL;
+
+  uri += 5;
+
+  if ((slash = strchr (uri, '/')))
+    bucket = g_strndup (uri, slash - uri);
+  else
+    bucket = g_strdup (uri);
+
+  if (*bucket == '\0' || !(unescaped = g_uri_unescape_string (slash ? slash : "", NULL)))
+    return NULL;
+
+  path = normalize_path (unescaped);
+
+  return aws_s3_file_new_normalized (client, bucket, path);
+}
+
+/**
+ * aws_s3_file_new_for_object:
+ * @client: The #AwsS3Client to access the object with.
+ * @bucket: The bucket containing the object.
+ * @path: The path of the object within @bucket, or "" for the bucket itself.
+ *
+ * Returns: (transfer full): A #GFile for the object at @path.
+ */
+GFile *
+aws_s3_file_new_for_object (AwsS3Client *client,
+                            const gchar *bucket,
+                            const gchar *path)
+{
+  g_autofree gchar *normalized = NULL;
+
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), NULL);
+  g_return_val_if_fail (bucket != NULL && *bucket != '\0', NULL);
+  g_return_val_if_fail (path != NULL, NULL);
+
+  normalized = normalize_path (path);
+
+  return aws_s3_file_new_normalized (client, bucket, normalized);
+}
+
+const gchar *
+aws_s3_file_get_bucket (AwsS3File *self)
+{
+  g_return_val_if_fail (AWS_IS_S3_FILE (self), NULL);
+
+  return self->bucket;
+}
+
+/**
+ * aws_s3_file_get_client:
+ * @self: An #AwsS3File.
+ *
+ * Returns: (transfer none): The #AwsS3Client used to access @self.
+ */
+AwsS3Client *
+aws_s3_file_get_client (AwsS3File *self)
+{
+  g_return_val_if_fail (AWS_IS_S3_FILE (self), NULL);
+
+  return self->client;
+}
+
+/**
+ * aws_s3_file_get_object_path:
+ * @self: An #AwsS3File.
+ *
+ * Gets the key of the object within its bucket, without leading or
+ * trailing slashes. This is "" for the root of the bucket.
+ *
+ * Returns: The path of the object.
+ */
+const gchar *
+aws_s3_file_get_object_path (AwsS3File *self)
+{
+  g_return_val_if_fail (AWS_IS_S3_FILE (self), NULL);
+
+  return self->path;
+}
+
+static GFile *
+aws_s3_file_lookup (GVfs        *vfs,
+                    const gchar *identifier,
+                    gpointer     user_data)
+{
+  return aws_s3_file_new (user_data, identifier);
+}
+
+/**
+ * aws_s3_file_register_uri_scheme:
+ * @client: The #AwsS3Client to access objects with.
+ *
+ * Registers the s3:// URI scheme with the default #GVfs, so that
+ * g_file_new_for_uri() and g_file_parse_name() return an #AwsS3File
+ * using @client. This lets existing GIO consumers read from S3 directly.
+ *
+ * Returns: %TRUE if the scheme was registered, %FALSE if it already was.
+ */
+gboolean
+aws_s3_file_register_uri_scheme (AwsS3Client *client)
+{
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), FALSE);
+
+  if (!g_vfs_register_uri_scheme (g_vfs_get_default (),
+                                  "s3",
+                                  aws_s3_file_lookup,
+                                  g_object_ref (client),
+                                  g_object_unref,
+                                  aws_s3_file_lookup,
+                                  g_object_ref (client),
+                                  g_object_unref))
+    {
+      g_object_unref (client);
+      g_object_unref (client);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/**
+ * aws_s3_file_unregister_uri_scheme:
+ *
+ * Undoes aws_s3_file_register_uri_scheme().
+ *
+ * Returns: %TRUE if the scheme was unregistered.
+ */
+gboolean
+aws_s3_file_unregister_uri_scheme (void)
+{
+  return g_vfs_unregister_uri_scheme (g_vfs_get_default (), "s3");
+}
+
+/*
+ * Builds the #GFileInfo for @info. Common prefixes are presented as
+ * directories.
+ */
+GFileInfo *
+aws_s3_file_create_info (AwsS3ObjectInfo       *info,
+                         GFileAttributeMatcher *matcher)
+{
+  g_autofree gchar *name = NULL;
+  GFileInfo *file_info;
+  const gchar *key;
+  const gchar *etag;
+  const gchar *base;
+  gboolean is_dir;
+  gsize len;
+
+  g_return_val_if_fail (info != NULL, NULL);
+  g_return_val_if_fail (matcher != NULL, NULL);
+
+  key = aws_s3_object_info_get_key (info);
+  is_dir = aws_s3_object_info_is_prefix (info);
+
+  /* The last component of the key, ignoring a trailing delimiter */
+  len = strlen (key);
+  if (len > 0 && key [len - 1] == '/')
+    len--;
+  name = g_strndup (key, len);
+  base = strrchr (name, '/');
+  base = base != NULL ? base + 1 : name;
+
+  file_info = g_file_info_new ();
+  g_file_info_set_name (file_info, *base ? base : "/");
+  g_file_info_set_display_name (file_info, *base ? base : "/");
+  g_file_info_set_file_type (file_info, is_dir ? G_FILE_TYPE_DIRECTORY : G_FILE_TYPE_REGULAR);
+  g_file_info_set_attribute_boolean (file_info, G_FILE_ATTRIBUTE_ACCESS_CAN_READ, TRUE);
+
+  if (!is_dir)
+    {
+      g_file_info_set_size (file_info, aws_s3_object_info_get_size (info));
+
+      if (aws_s3_object_info_get_last_modified (info) > 0)
+        g_file_info_set_attribute_uint64 (file_info,
+                                          G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                          aws_s3_object_info_get_last_modified (info));
+
+      if ((etag = aws_s3_object_info_get_etag (info)))
+        g_file_info_set_attribute_string (file_info, G_FILE_ATTRIBUTE_ETAG_VALUE, etag);
+    }
+
+  if (g_file_attribute_matcher_matches (matcher, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE) ||
+      g_file_attribute_matcher_matches (matcher, G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE))
+    {
+      g_autofree gchar *content_type = NULL;
+
+      if (is_dir)
+        content_type = g_strdup ("inode/directory");
+      else
+        content_type = g_content_type_guess (base, NULL, 0, NULL);
+
+      g_file_info_set_content_type (file_info, content_type);
+      g_file_info_set_attribute_string (file_info,
+                                        G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE,
+                                        content_type);
+    }
+
+  return file_info;
+}
+
+/*
+ * Propagates @source into @error, translating the client's errors into
+ * the #G_IO_ERROR codes GIO consumers check for.
+ */
+void
+aws_s3_file_set_error (GError **error,
+                       GError  *source)
+{
+  g_return_if_fail (source != NULL);
+
+  if (g_error_matches (source, AWS_S3_CLIENT_ERROR, AWS_S3_CLIENT_ERROR_NOT_FOUND))
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, source->message);
+      g_error_free (source);
+    }
+  else if (g_error_matches (source, AWS_S3_CLIENT_ERROR, AWS_S3_CLIENT_ERROR_CANCELLED))
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CANCELLED, source->message);
+      g_error_free (source);
+    }
+  else
+    g_propagate_error (error, source);
+}
+
+static GFile *
+aws_s3_file_dup (GFile *file)
+{
+  AwsS3File *self = AWS_S3_FILE (file);
+
+  return aws_s3_file_new_normalized (self->client, self->bucket, self->path);
+}
+
+static guint
+aws_s3_file_hash (GFile *file)
+{
+  AwsS3File *self = AWS_S3_FILE (file);
+
+  return g_str_hash (self->bucket) ^ g_str_hash (self->path);
+}
+
+static gboolean
+aws_s3_file_equal (GFile *file1,
+                   GFile *file2)
+{
+  AwsS3File *self1 = AWS_S3_FILE (file1);
+  AwsS3File *self2 = AWS_S3_FILE (file2);
+
+  return g_str_equal (self1->bucket, self2->bucket) &&
+         g_str_equal (self1->path, self2->path);
+}
+
+static gboolean
+aws_s3_file_is_native (GFile *file)
+{
+  return FALSE;
+}
+
+static gboolean
+aws_s3_file_has_uri_scheme (GFile       *file,
+                            const gchar *uri_scheme)
+{
+  return g_ascii_strcasecmp (uri_scheme, "s3") == 0;
+}
+
+static gchar *
+aws_s3_file_get_uri_scheme (GFile *file)
+{
+  return g_strdup ("s3");
+}
+
+static gchar *
+aws_s3_file_get_basename (GFile *file)
+{
+  AwsS3File *self = AWS_S3_FILE (file);
+  const gchar *base;
+
+  if (*self->path == '\0')
+    return g_strdup ("/");
+
+  base = strrchr (self->path, '/');
+
+  return g_strdup (base != NULL ? base + 1 : self->path);
+}
+
+static gchar *
+aws_s3_file_get_path (GFile *file)
+{
+  return NULL;
+}
+
+static gchar *
+aws_s3_file_get_uri (GFile *file)
+{
+  AwsS3File *self = AWS_S3_FILE (file);
+  g_autofree gchar *escaped = NULL;
+
+  escaped = g_uri_escape_string (self->path, G_URI_RESERVED_CHARS_ALLOWED_IN_PATH, FALSE);
+
+  return g_strdup_printf ("s3://%s/%s", self->bucket, escaped);
+}
+
+static gchar *
+aws_s3_file_get_parse_name (GFile *file)
+{
+  return aws_s3_file_get_uri (file);
+}
+
+static GFile *
+aws_s3_file_get_parent (GFile *file)
+{
+  AwsS3File *self = AWS_S3_FILE (file);
+  g_autofree gchar *parent = NULL;
+  const gchar *slash;
+
+  if (*self->path == '\0')
+    return NULL;
+
+  slash = strrchr (self->path, '/');
+  parent = slash != NULL ? g_strndup (self->path, slash - self->path) : g_strdup ("");
+
+  return aws_s3_file_new_normalized (self->client, self->bucket, parent);
+}
+
+/*
+ * Returns the part of @file's path below @prefix, or %NULL if @file is
+ * not a descendant of @prefix.
+ */
+static const gchar *
+aws_s3_file_get_descendant_path (AwsS3File *prefix,
+                                 AwsS3File *file)
+{
+  gsize len = strlen (prefix->path);
+
+  if (!g_str_equal (prefix->bucket, file->bucket) || *file->path == '\0')
+    return NULL;
+
+  if (len == 0)
+    return file->path;
+
+  if (strncmp (file->path, prefix->path, len) != 0 || file->path [len] != '/')
+    return NULL;
+
+  return file->path + len + 1;
+}
+
+static gboolean
+aws_s3_file_prefix_matches (GFile *prefix,
+                            GFile *file)
+{
+  if (!AWS_IS_S3_FILE (prefix) || !AWS_IS_S3_FILE (file))
+    return FALSE;
+
+  return aws_s3_file_get_descendant_path (AWS_S3_FILE (prefix), AWS_S3_FILE (file)) != NULL;
+}
+
+static gchar *
+aws_s3_file_get_relative_path (GFile *parent,
+                               GFile *descendant)
+{
+  if (!AWS_IS_S3_FILE (parent) || !AWS_IS_S3_FILE (descendant))
+    return NULL;
+
+  return g_strdup (aws_s3_file_get_descendant_path (AWS_S3_FILE (parent), AWS_S3_FILE (descendant)));
+}
+
+static GFile *
+aws_s3_file_resolve_relative_path (GFile       *file,
+                                   const gchar *relative_path)
+{
+  AwsS3File *self = AWS_S3_FILE (file);
+  g_autofree gchar *joined = NULL;
+  g_autofree gchar *path = NULL;
+
+  if (*relative_path == '/')
+    joined = g_strdup (relative_path);
+  else
+    joined = g_strconcat (self->path, "/", relative_path, NULL);
+
+  path = normalize_path (joined);
+
+  return aws_s3_file_new_normalized (self->client, self->bucket, path);
+}
+
+static GFile *
+aws_s3_file_get_child_for_display_name (GFile        *file,
+                                        const gchar  *display_name,
+                                        GError      **error)
+{
+  if (strchr (display_name, '/') != NULL)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVALID_FILENAME,
+                   "Invalid filename %s",
+                   display_name);
+      return NULL;
+    }
+
+  return g_file_get_child (file, display_name);
+}
+
+static GFileEnumerator *
+aws_s3_file_enumerate_children (GFile                *file,
+                                const gchar          *attributes,
+                                GFileQueryInfoFlags   flags,
+                                GCancellable         *cancellable,
+                                GError              **error)
+{
+  return aws_s3_file_enumerator_new (AWS_S3_FILE (file), attributes, cancellable, error);
+}
+
+static GFileInfo *
+aws_s3_file_query_info (GFile                *file,
+                        const gchar          *attributes,
+                        GFileQueryInfoFlags   flags,
+                        GCancellable         *cancellable,
+                        GError              **error)
+{
+  AwsS3File *self = AWS_S3_FILE (file);
+  g_autoptr(GFileAttributeMatcher) matcher = NULL;
+  g_autoptr(AwsS3ObjectInfo) info = NULL;
+  g_autoptr(GPtrArray) children = NULL;
+  g_autofree gchar *prefix = NULL;
+  GError *local_error = NULL;
+
+  matcher = g_file_attribute_matcher_new (attributes);
+
+  /* The root of the bucket is always a directory */
+  if (*self->path == '\0')
+    info = aws_s3_object_info_new_prefix ("");
+  else
+    info = aws_s3_client_stat_sync (self->client, self->bucket, self->path, cancellable, &local_error);
+
+  if (info != NULL)
+    return aws_s3_file_create_info (info, matcher);
+
+  if (!g_error_matches (local_error, AWS_S3_CLIENT_ERROR, AWS_S3_CLIENT_ERROR_NOT_FOUND))
+    {
+      aws_s3_file_set_error (error, local_error);
+      return NULL;
+    }
+
+  g_clear_error (&local_error);
+
+  /*
+   * There is no such object, but keys below it make it a directory.
+   */
+  prefix = g_strconcat (self->path, "/", NULL);
+  children = aws_s3_client_list_sync (self->client,
+                                      self->bucket,
+                                      prefix,
+                                      "/",
+                                      1,
+                                      NULL,
+                                      NULL,
+                                      cancellable,
+                                      &local_error);
+
+  if (children == NULL)
+    {
+      aws_s3_file_set_error (error, local_error);
+      return NULL;
+    }
+
+  if (children->len == 0)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_FOUND,
+                   "No such file or directory");
+      return NULL;
+    }
+
+  info = aws_s3_object_info_new_prefix (prefix);
+
+  return aws_s3_file_create_info (info, matcher);
+}
+
+static GFileInputStream *
+aws_s3_file_read_fn (GFile         *file,
+                     GCancellable  *cancellable,
+                     GError       **error)
+{
+  AwsS3File *self = AWS_S3_FILE (file);
+  g_autoptr(AwsS3ObjectInfo) info = NULL;
+  GError *local_error = NULL;
+
+  if (*self->path == '\0')
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_IS_DIRECTORY,
+                   "Cannot read the root of a bucket");
+      return NULL;
+    }
+
+  /*
+   * The stream fetches ranges lazily, but knowing the size and ETag up
+   * front lets it seek and detect the object changing underneath it.
+   */
+  if (!(info = aws_s3_client_stat_sync (self->client, self->bucket, self->path, cancellable, &local_error)))
+    {
+      aws_s3_file_set_error (error, local_error);
+      return NULL;
+    }
+
+  return aws_s3_input_stream_new (self->client, self->bucket, info);
+}
+
+static void
+file_iface_init (GFileIface *iface)
+{
+  iface->dup = aws_s3_file_dup;
+  iface->hash = aws_s3_file_hash;
+  iface->equal = aws_s3_file_equal;
+  iface->is_native = aws_s3_file_is_native;
+  iface->has_uri_scheme = aws_s3_file_has_uri_scheme;
+  iface->get_uri_scheme = aws_s3_file_get_uri_scheme;
+  iface->get_basename = aws_s3_file_get_basename;
+  iface->get_path = aws_s3_file_get_path;
+  iface->get_uri = aws_s3_file_get_uri;
+  iface->get_parse_name = aws_s3_file_get_parse_name;
+  iface->get_parent = aws_s3_file_get_parent;
+  iface->prefix_matches = aws_s3_file_prefix_matches;
+  iface->get_relative_path = aws_s3_file_get_relative_path;
+  iface->resolve_relative_path = aws_s3_file_resolve_relative_path;
+  iface->get_child_for_display_name = aws_s3_file_get_child_for_display_name;
+  iface->enumerate_children = aws_s3_file_enumerate_children;
+  iface->query_info = aws_s3_file_query_info;
+  iface->read_fn = aws_s3_file_read_fn;
+}
+
+static void
+aws_s3_file_finalize (GObject *object)
+{
+  AwsS3File *self = (AwsS3File *)object;
+
+  g_clear_object (&self->client);
+  g_clear_pointer (&self->bucket, g_free);
+  g_clear_pointer (&self->path, g_free);
+
+  G_OBJECT_CLASS (aws_s3_file_parent_class)->finalize (object);
+}
+
+static void
+aws_s3_file_get_property (GObject    *object,
+                          guint       prop_id,
+                          GValue     *value,
+                          GParamSpec *pspec)
+{
+  AwsS3File *self = AWS_S3_FILE (object);
+
+  switch (prop_id)
+    {
+    case PROP_BUCKET:
+      g_value_set_string (value, self->bucket);
+      break;
+
+    case PROP_CLIENT:
+      g_value_set_object (value, self->client);
+      break;
+
+    case PROP_OBJECT_PATH:
+      g_value_set_string (value, self->path);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+aws_s3_file_set_property (GObject      *object,
+                          guint         prop_id,
+                          const GValue *value,
+                          GParamSpec   *pspec)
+{
+  AwsS3File *self = AWS_S3_FILE (object);
+
+  switch (prop_id)
+    {
+    case PROP_BUCKET:
+      self->bucket = g_value_dup_string (value);
+      break;
+
+    case PROP_CLIENT:
+      self->client = g_value_dup_object (value);
+      break;
+
+    case PROP_OBJECT_PATH:
+      self->path = g_value_dup_string (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+aws_s3_file_class_init (AwsS3FileClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = aws_s3_file_finalize;
+  object_class->get_property = aws_s3_file_get_property;
+  object_class->set_property = aws_s3_file_set_property;
+
+  properties [PROP_BUCKET] =
+    g_param_spec_string ("bucket",
+                         "Bucket",
+                         "The bucket containing the object.",
+                         NULL,
+                         G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+  properties [PROP_CLIENT] =
+    g_param_spec_object ("client",
+                         "Client",
+                         "The client used to access the object.",
+                         AWS_TYPE_S3_CLIENT,
+                         G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+  properties [PROP_OBJECT_PATH] =
+    g_param_spec_string ("object-path",
+                         "Object Path",
+                         "The path of the object within the bucket.",
+                         "",
+                         G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties (object_class, N_PROPS, properties);
+}
+
+static void
+aws_s3_file_init (AwsS3File *self)
+{
+}
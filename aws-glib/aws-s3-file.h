@@ -0,0 +1,45 @@
+/* aws-s3-file.h
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AWS_S3_FILE_H
+#define AWS_S3_FILE_H
+
+#include <gio/gio.h>
+
+#include "aws-s3-client.h"
+
+G_BEGIN_DECLS
+
+#define AWS_TYPE_S3_FILE (aws_s3_file_get_type())
+
+G_DECLARE_FINAL_TYPE (AwsS3File, aws_s3_file, AWS, S3_FILE, GObject)
+
+GFile       *aws_s3_file_new                   (AwsS3Client *client,
+                                                const gchar *uri);
+GFile       *aws_s3_file_new_for_object        (AwsS3Client *client,
+                                                const gchar *bucket,
+                                                const gchar *path);
+const gchar *aws_s3_file_get_bucket            (AwsS3File   *self);
+AwsS3Client *aws_s3_file_get_client            (AwsS3File   *self);
+const gchar *aws_s3_file_get_object_path       (AwsS3File   *self);
+gboolean     aws_s3_file_register_uri_scheme   (AwsS3Client *client);
+gboolean     aws_s3_file_unregister_uri_scheme (void);
+
+G_END_DECLS
+
+#endif /* AWS_S3_FILE_H */
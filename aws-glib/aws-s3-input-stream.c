@@ -0,0 +1,307 @@
+/* aws-s3-input-stream.c
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "aws-s3-file-private.h"
+#include "aws-s3-input-stream.h"
+
+/*
+ * A seekable stream over an object. Reads are served from a single
+ * ranged GET starting at the current position, which is only reopened
+ * when the reader seeks away from it. Every request is conditional on
+ * the ETag the object had when the stream was opened, so a reader never
+ * mixes bytes from two versions of an object.
+ */
+
+#define SEEK_SKIP_MAX (256 * 1024)
+
+struct _AwsS3InputStream
+{
+  GFileInputStream parent_instance;
+
+  AwsS3Client *client;
+  gchar *bucket;
+  AwsS3ObjectInfo *info;
+  GInputStream *response;
+  guint64 position;
+  guint64 response_position;
+};
+
+G_DEFINE_TYPE (AwsS3InputStream, aws_s3_input_stream, G_TYPE_FILE_INPUT_STREAM)
+
+GFileInputStream *
+aws_s3_input_stream_new (AwsS3Client     *client,
+                         const gchar     *bucket,
+                         AwsS3ObjectInfo *info)
+{
+  AwsS3InputStream *self;
+
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), NULL);
+  g_return_val_if_fail (bucket != NULL, NULL);
+  g_return_val_if_fail (info != NULL, NULL);
+
+  self = g_object_new (AWS_TYPE_S3_INPUT_STREAM, NULL);
+  self->client = g_object_ref (client);
+  self->bucket = g_strdup (bucket);
+  self->info = aws_s3_object_info_ref (info);
+
+  return G_FILE_INPUT_STREAM (self);
+}
+
+static void
+aws_s3_input_stream_drop_response (AwsS3InputStream *self)
+{
+  g_assert (AWS_IS_S3_INPUT_STREAM (self));
+
+  if (self->response != NULL)
+    {
+      g_input_stream_close (self->response, NULL, NULL);
+      g_clear_object (&self->response);
+    }
+}
+
+static gssize
+aws_s3_input_stream_read_fn (GInputStream  *stream,
+                             void          *buffer,
+                             gsize          count,
+                             GCancellable  *cancellable,
+                             GError       **error)
+{
+  AwsS3InputStream *self = (AwsS3InputStream *)stream;
+  GError *local_error = NULL;
+  gssize n_read;
+
+  g_assert (AWS_IS_S3_INPUT_STREAM (self));
+
+  if (count == 0 || self->position >= aws_s3_object_info_get_size (self->info))
+    return 0;
+
+  /*
+   * Short forward seeks are cheaper to read through than to reconnect for.
+   */
+  if (self->response != NULL && self->response_position != self->position)
+    {
+      if (self->position > self->response_position &&
+          self->position - self->response_position <= SEEK_SKIP_MAX)
+        {
+          while (self->response != NULL && self->response_position < self->position)
+            {
+              gssize skipped;
+
+              skipped = g_input_stream_skip (self->response,
+                                             self->position - self->response_position,
+                                             cancellable,
+                                             error);
+
+              if (skipped < 0)
+                {
+                  aws_s3_input_stream_drop_response (self);
+                  return -1;
+                }
+
+              if (skipped == 0)
+                aws_s3_input_stream_drop_response (self);
+              else
+                self->response_position += skipped;
+            }
+        }
+      else
+        aws_s3_input_stream_drop_response (self);
+    }
+
+  if (self->response == NULL)
+    {
+      self->response = aws_s3_client_open_range_sync (self->client,
+                                                      self->bucket,
+                                                      aws_s3_object_info_get_key (self->info),
+                                                      self->position,
+                                                      aws_s3_object_info_get_etag (self->info),
+                                                      cancellable,
+                                                      &local_error);
+
+      if (self->response == NULL)
+        {
+          aws_s3_file_set_error (error, local_error);
+          return -1;
+        }
+
+      self->response_position = self->position;
+    }
+
+  if ((n_read = g_input_stream_read (self->response, buffer, count, cancellable, error)) < 0)
+    {
+      aws_s3_input_stream_drop_response (self);
+      return -1;
+    }
+
+  if (n_read == 0)
+    {
+      aws_s3_input_stream_drop_response (self);
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_PARTIAL_INPUT,
+                   "The connection closed before the end of the object");
+      return -1;
+    }
+
+  self->position += n_read;
+  self->response_position += n_read;
+
+  return n_read;
+}
+
+static gssize
+aws_s3_input_stream_skip (GInputStream  *stream,
+                          gsize          count,
+                          GCancellable  *cancellable,
+                          GError       **error)
+{
+  AwsS3InputStream *self = (AwsS3InputStream *)stream;
+  guint64 size;
+
+  g_assert (AWS_IS_S3_INPUT_STREAM (self));
+
+  /* The response catches up lazily on the next read */
+  size = aws_s3_object_info_get_size (self->info);
+  count = self->position < size ? MIN (count, size - self->position) : 0;
+  self->position += count;
+
+  return count;
+}
+
+static gboolean
+aws_s3_input_stream_close_fn (GInputStream  *stream,
+                              GCancellable  *cancellable,
+                              GError       **error)
+{
+  aws_s3_input_stream_drop_response (AWS_S3_INPUT_STREAM (stream));
+
+  return TRUE;
+}
+
+static goffset
+aws_s3_input_stream_tell (GFileInputStream *stream)
+{
+  return AWS_S3_INPUT_STREAM (stream)->position;
+}
+
+static gboolean
+aws_s3_input_stream_can_seek (GFileInputStream *stream)
+{
+  return TRUE;
+}
+
+static gboolean
+aws_s3_input_stream_seek (GFileInputStream  *stream,
+                          goffset            offset,
+                          GSeekType          type,
+                          GCancellable      *cancellable,
+                          GError           **error)
+{
+  AwsS3InputStream *self = (AwsS3InputStream *)stream;
+  goffset base;
+
+  g_assert (AWS_IS_S3_INPUT_STREAM (self));
+
+  switch (type)
+    {
+    case G_SEEK_CUR:
+      base = self->position;
+      break;
+
+    case G_SEEK_SET:
+      base = 0;
+      break;
+
+    case G_SEEK_END:
+      base = aws_s3_object_info_get_size (self->info);
+      break;
+
+    default:
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVALID_ARGUMENT,
+                   "Invalid seek type");
+      return FALSE;
+    }
+
+  if (base + offset < 0)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVALID_ARGUMENT,
+                   "Cannot seek before the start of the stream");
+      return FALSE;
+    }
+
+  self->position = base + offset;
+
+  return TRUE;
+}
+
+static GFileInfo *
+aws_s3_input_stream_query_info (GFileInputStream  *stream,
+                                const char        *attributes,
+                                GCancellable      *cancellable,
+                                GError           **error)
+{
+  AwsS3InputStream *self = (AwsS3InputStream *)stream;
+  g_autoptr(GFileAttributeMatcher) matcher = NULL;
+
+  g_assert (AWS_IS_S3_INPUT_STREAM (self));
+
+  matcher = g_file_attribute_matcher_new (attributes);
+
+  return aws_s3_file_create_info (self->info, matcher);
+}
+
+static void
+aws_s3_input_stream_finalize (GObject *object)
+{
+  AwsS3InputStream *self = (AwsS3InputStream *)object;
+
+  g_clear_object (&self->response);
+  g_clear_object (&self->client);
+  g_clear_pointer (&self->bucket, g_free);
+  g_clear_pointer (&self->info, aws_s3_object_info_unref);
+
+  G_OBJECT_CLASS (aws_s3_input_stream_parent_class)->finalize (object);
+}
+
+static void
+aws_s3_input_stream_class_init (AwsS3InputStreamClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GInputStreamClass *stream_class = G_INPUT_STREAM_CLASS (klass);
+  GFileInputStreamClass *file_stream_class = G_FILE_INPUT_STREAM_CLASS (klass);
+
+  object_class->finalize = aws_s3_input_stream_finalize;
+
+  stream_class->read_fn = aws_s3_input_stream_read_fn;
+  stream_class->skip = aws_s3_input_stream_skip;
+  stream_class->close_fn = aws_s3_input_stream_close_fn;
+
+  file_stream_class->tell = aws_s3_input_stream_tell;
+  file_stream_class->can_seek = aws_s3_input_stream_can_seek;
+  file_stream_class->seek = aws_s3_input_stream_seek;
+  file_stream_class->query_info = aws_s3_input_stream_query_info;
+}
+
+static void
+aws_s3_input_stream_init (AwsS3InputStream *self)
+{
+}
@@ -0,0 +1,38 @@
+/* aws-s3-input-stream.h
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AWS_S3_INPUT_STREAM_H
+#define AWS_S3_INPUT_STREAM_H
+
+#include <gio/gio.h>
+
+#include "aws-s3-client.h"
+
+G_BEGIN_DECLS
+
+#define AWS_TYPE_S3_INPUT_STREAM (aws_s3_input_stream_get_type())
+
+G_DECLARE_FINAL_TYPE (AwsS3InputStream, aws_s3_input_stream, AWS, S3_INPUT_STREAM, GFileInputStream)
+
+GFileInputStream *aws_s3_input_stream_new (AwsS3Client     *client,
+                                           const gchar     *bucket,
+                                           AwsS3ObjectInfo *info);
+
+G_END_DECLS
+
+#endif /* AWS_S3_INPUT_STREAM_H */
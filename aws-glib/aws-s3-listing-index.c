@@ -0,0 +1,925 @@
+/* aws-s3-listing-index.c
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "aws-s3-listing-index.h"
+#include "aws-varint.h"
+
+/*
+ * An index file is laid out as follows, with all integers little endian:
+ *
+ *   header       HEADER_SIZE bytes, see the HEADER_* offsets
+ *   bucket       bucket_len bytes
+ *   prefix       prefix_len bytes
+ *   entries      entries_len bytes
+ *   restarts     n_restarts 64-bit offsets into entries, 8-byte aligned
+ *
+ * Entries are sorted by key. Each is a run of varints: the number of key
+ * bytes shared with the previous key, the number of bytes that follow,
+ * the key bytes, size, mtime, ETag length and the ETag bytes. Every
+ * restart_interval-th entry stores its key in full and is listed in the
+ * restart table, so lookups binary search the restarts and then decode
+ * at most restart_interval entries.
+ */
+
+#define INDEX_MAGIC          "S3LIDX\0\1"
+#define RESTART_INTERVAL     16
+
+#define HEADER_N_KEYS          8
+#define HEADER_N_RESTARTS     16
+#define HEADER_CREATED        24
+#define HEADER_ENTRIES_OFFSET 32
+#define HEADER_ENTRIES_LEN    40
+#define HEADER_RESTARTS_OFFSET 48
+#define HEADER_BUCKET_LEN     56
+#define HEADER_PREFIX_LEN     60
+#define HEADER_INTERVAL       64
+#define HEADER_SIZE           72
+
+struct _AwsS3ListingIndex
+{
+  GObject parent_instance;
+
+  GFile *file;
+  GMappedFile *mapped;
+  const guint8 *entries;
+  gsize entries_len;
+  const guint8 *restarts;
+  guint64 n_restarts;
+  guint64 n_keys;
+  gint64 created;
+  gchar *bucket;
+  gchar *prefix;
+  guint restart_interval;
+};
+
+typedef struct
+{
+  const guint8 *p;
+  const guint8 *end;
+  GString      *key;
+  GString      *etag;
+  guint64       size;
+  gint64        last_modified;
+} IndexCursor;
+
+typedef struct
+{
+  GByteArray *entries;
+  GArray     *restarts;
+  GString    *last_key;
+  guint64     n_keys;
+} IndexWriter;
+
+G_DEFINE_TYPE (AwsS3ListingIndex, aws_s3_listing_index, G_TYPE_OBJECT)
+
+static guint32
+read_u32 (const guint8 *data)
+{
+  guint32 value;
+
+  memcpy (&value, data, sizeof value);
+
+  return GUINT32_FROM_LE (value);
+}
+
+static guint64
+read_u64 (const guint8 *data)
+{
+  guint64 value;
+
+  memcpy (&value, data, sizeof value);
+
+  return GUINT64_FROM_LE (value);
+}
+
+static void
+write_u32 (guint8  *data,
+           guint32  value)
+{
+  value = GUINT32_TO_LE (value);
+  memcpy (data, &value, sizeof value);
+}
+
+static void
+write_u64 (guint8  *data,
+           guint64  value)
+{
+  value = GUINT64_TO_LE (value);
+  memcpy (data, &value, sizeof value);
+}
+
+static void
+index_cursor_init (IndexCursor  *cursor,
+                   const guint8 *begin,
+                   const guint8 *end)
+{
+  cursor->p = begin;
+  cursor->end = end;
+  cursor->key = g_string_sized_new (256);
+  cursor->etag = g_string_sized_new (64);
+  cursor->size = 0;
+  cursor->last_modified = 0;
+}
+
+static void
+index_cursor_clear (IndexCursor *cursor)
+{
+  g_string_free (cursor->key, TRUE);
+  g_string_free (cursor->etag, TRUE);
+}
+
+static const gchar *
+index_cursor_get_etag (IndexCursor *cursor)
+{
+  return cursor->etag->len > 0 ? cursor->etag->str : NULL;
+}
+
+/*
+ * Decodes the entry at the cursor, applying its key to the previous one.
+ */
+static gboolean
+index_cursor_next (IndexCursor *cursor)
+{
+  const guint8 *p = cursor->p;
+  guint64 shared;
+  guint64 unshared;
+  guint64 size;
+  guint64 last_modified;
+  guint64 etag_len;
+
+  if (p >= cursor->end ||
+      !aws_varint_read (&p, cursor->end, &shared) ||
+      !aws_varint_read (&p, cursor->end, &unshared) ||
+      shared > cursor->key->len ||
+      unshared > (guint64)(cursor->end - p))
+    return FALSE;
+
+  g_string_truncate (cursor->key, shared);
+  g_string_append_len (cursor->key, (const gchar *)p, unshared);
+  p += unshared;
+
+  if (!aws_varint_read (&p, cursor->end, &size) ||
+      !aws_varint_read (&p, cursor->end, &last_modified) ||
+      !aws_varint_read (&p, cursor->end, &etag_len) ||
+      etag_len > (guint64)(cursor->end - p))
+    return FALSE;
+
+  g_string_truncate (cursor->etag, 0);
+  g_string_append_len (cursor->etag, (const gchar *)p, etag_len);
+  p += etag_len;
+
+  cursor->size = size;
+  cursor->last_modified = last_modified;
+  cursor->p = p;
+
+  return TRUE;
+}
+
+static guint64
+aws_s3_listing_index_get_restart (AwsS3ListingIndex *self,
+                                  guint64            i)
+{
+  return read_u64 (self->restarts + i * 8);
+}
+
+/*
+ * Compares the full key stored at restart @i with @target.
+ */
+static gint
+aws_s3_listing_index_compare_restart (AwsS3ListingIndex *self,
+                                      guint64            i,
+                                      const gchar       *target)
+{
+  const guint8 *p = self->entries + aws_s3_listing_index_get_restart (self, i);
+  const guint8 *end = self->entries + self->entries_len;
+  gsize target_len = strlen (target);
+  guint64 shared;
+  guint64 len;
+  gint ret;
+
+  /* Validated when the index was loaded */
+  aws_varint_read (&p, end, &shared);
+  aws_varint_read (&p, end, &len);
+
+  if ((ret = memcmp (p, target, MIN (len, target_len))) != 0)
+    return ret;
+
+  return (len > target_len) - (len < target_len);
+}
+
+/*
+ * Positions @cursor on the first entry whose key is not less than
+ * @target, or the first entry if @target is %NULL. @cursor is always
+ * initialized and must be cleared by the caller.
+ */
+static gboolean
+aws_s3_listing_index_seek (AwsS3ListingIndex *self,
+                           IndexCursor       *cursor,
+                           const gchar       *target)
+{
+  guint64 lo = 0;
+  guint64 hi = self->n_restarts;
+  guint64 block;
+
+  /* Find the last restart whose key is not greater than @target */
+  while (target != NULL && lo < hi)
+    {
+      guint64 mid = lo + (hi - lo) / 2;
+
+      if (aws_s3_listing_index_compare_restart (self, mid, target) <= 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  block = lo > 0 ? lo - 1 : 0;
+
+  if (self->n_restarts == 0)
+    {
+      index_cursor_init (cursor, self->entries, self->entries);
+      return FALSE;
+    }
+
+  index_cursor_init (cursor,
+                     self->entries + aws_s3_listing_index_get_restart (self, block),
+                     self->entries + self->entries_len);
+
+  while (index_cursor_next (cursor))
+    {
+      if (target == NULL || strcmp (cursor->key->str, target) >= 0)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+index_writer_init (IndexWriter *writer)
+{
+  writer->entries = g_byte_array_new ();
+  writer->restarts = g_array_new (FALSE, FALSE, sizeof (guint64));
+  writer->last_key = g_string_new (NULL);
+  writer->n_keys = 0;
+}
+
+static void
+index_writer_clear (IndexWriter *writer)
+{
+  g_byte_array_unref (writer->entries);
+  g_array_unref (writer->restarts);
+  g_string_free (writer->last_key, TRUE);
+}
+
+static gboolean
+index_writer_add (IndexWriter  *writer,
+                  const gchar  *key,
+                  guint64       size,
+                  const gchar  *etag,
+                  gint64        last_modified,
+                  GError      **error)
+{
+  gsize key_len = strlen (key);
+  gsize etag_len = etag != NULL ? strlen (etag) : 0;
+  gsize shared = 0;
+
+  if (writer->n_keys > 0 && strcmp (key, writer->last_key->str) <= 0)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVALID_DATA,
+                   "The listing is not sorted at %s",
+                   key);
+      return FALSE;
+    }
+
+  if (writer->n_keys % RESTART_INTERVAL == 0)
+    {
+      guint64 offset = writer->entries->len;
+
+      g_array_append_val (writer->restarts, offset);
+    }
+  else
+    {
+      while (shared < key_len &&
+             shared < writer->last_key->len &&
+             key [shared] == writer->last_key->str [shared])
+        shared++;
+    }
+
+  aws_varint_append (writer->entries, shared);
+  aws_varint_append (writer->entries, key_len - shared);
+  g_byte_array_append (writer->entries, (const guint8 *)key + shared, key_len - shared);
+  aws_varint_append (writer->entries, size);
+  aws_varint_append (writer->entries, MAX (last_modified, 0));
+  aws_varint_append (writer->entries, etag_len);
+  g_byte_array_append (writer->entries, (const guint8 *)etag, etag_len);
+
+  g_string_truncate (writer->last_key, shared);
+  g_string_append (writer->last_key, key + shared);
+  writer->n_keys++;
+
+  return TRUE;
+}
+
+/*
+ * Appends every key below @prefix, fetching the listing a page at a time.
+ */
+static gboolean
+index_writer_add_listing (IndexWriter   *writer,
+                          AwsS3Client   *client,
+                          const gchar   *bucket,
+                          const gchar   *prefix,
+                          GCancellable  *cancellable,
+                          GError       **error)
+{
+  g_autofree gchar *token = NULL;
+
+  do
+    {
+      g_autoptr(GPtrArray) page = NULL;
+      gchar *next_token = NULL;
+      guint i;
+
+      page = aws_s3_client_list_sync (client,
+                                      bucket,
+                                      *prefix ? prefix : NULL,
+                                      NULL,
+                                      0,
+                                      token,
+                                      &next_token,
+                                      cancellable,
+                                      error);
+
+      if (page == NULL)
+        return FALSE;
+
+      g_free (token);
+      token = next_token;
+
+      for (i = 0; i < page->len; i++)
+        {
+          AwsS3ObjectInfo *info = g_ptr_array_index (page, i);
+
+          if (!index_writer_add (writer,
+                                 aws_s3_object_info_get_key (info),
+                                 aws_s3_object_info_get_size (info),
+                                 aws_s3_object_info_get_etag (info),
+                                 aws_s3_object_info_get_last_modified (info),
+                                 error))
+            return FALSE;
+        }
+    }
+  while (token != NULL);
+
+  return TRUE;
+}
+
+static gboolean
+index_writer_write (IndexWriter   *writer,
+                    GFile         *file,
+                    const gchar   *bucket,
+                    const gchar   *prefix,
+                    GCancellable  *cancellable,
+                    GError       **error)
+{
+  g_autoptr(GByteArray) data = NULL;
+  gsize bucket_len = strlen (bucket);
+  gsize prefix_len = strlen (prefix);
+  gsize entries_offset;
+  gsize restarts_offset;
+  guint i;
+
+  entries_offset = HEADER_SIZE + bucket_len + prefix_len;
+  restarts_offset = (entries_offset + writer->entries->len + 7) & ~(gsize)7;
+
+  data = g_byte_array_sized_new (restarts_offset + writer->restarts->len * 8);
+  g_byte_array_set_size (data, restarts_offset + writer->restarts->len * 8);
+  memset (data->data, 0, data->len);
+
+  memcpy (data->data, INDEX_MAGIC, 8);
+  write_u64 (data->data + HEADER_N_KEYS, writer->n_keys);
+  write_u64 (data->data + HEADER_N_RESTARTS, writer->restarts->len);
+  write_u64 (data->data + HEADER_CREATED, g_get_real_time () / G_USEC_PER_SEC);
+  write_u64 (data->data + HEADER_ENTRIES_OFFSET, entries_offset);
+  write_u64 (data->data + HEADER_ENTRIES_LEN, writer->entries->len);
+  write_u64 (data->data + HEADER_RESTARTS_OFFSET, restarts_offset);
+  write_u32 (data->data + HEADER_BUCKET_LEN, bucket_len);
+  write_u32 (data->data + HEADER_PREFIX_LEN, prefix_len);
+  write_u32 (data->data + HEADER_INTERVAL, RESTART_INTERVAL);
+
+  memcpy (data->data + HEADER_SIZE, bucket, bucket_len);
+  memcpy (data->data + HEADER_SIZE + bucket_len, prefix, prefix_len);
+  memcpy (data->data + entries_offset, writer->entries->data, writer->entries->len);
+
+  for (i = 0; i < writer->restarts->len; i++)
+    write_u64 (data->data + restarts_offset + i * 8, g_array_index (writer->restarts, guint64, i));
+
+  /* Replaced atomically, so indexes still mapping the old file are unaffected */
+  return g_file_replace_contents (file,
+                                  (const gchar *)data->data,
+                                  data->len,
+                                  NULL,
+                                  FALSE,
+                                  G_FILE_CREATE_NONE,
+                                  NULL,
+                                  cancellable,
+                                  error);
+}
+
+static gint
+compare_prefix (gconstpointer a,
+                gconstpointer b)
+{
+  return strcmp (*(const gchar * const *)a, *(const gchar * const *)b);
+}
+
+static gboolean
+aws_s3_listing_index_load (AwsS3ListingIndex  *self,
+                           GError            **error)
+{
+  const guint8 *data;
+  IndexCursor cursor;
+  guint64 entries_offset;
+  guint64 restarts_offset;
+  guint64 i;
+  gsize len;
+  guint32 bucket_len;
+  guint32 prefix_len;
+  gboolean ret = FALSE;
+
+  g_assert (AWS_IS_S3_LISTING_INDEX (self));
+
+  data = (const guint8 *)g_mapped_file_get_contents (self->mapped);
+  len = g_mapped_file_get_length (self->mapped);
+
+  if (len < HEADER_SIZE || memcmp (data, INDEX_MAGIC, 8) != 0)
+    goto invalid;
+
+  self->n_keys = read_u64 (data + HEADER_N_KEYS);
+  self->n_restarts = read_u64 (data + HEADER_N_RESTARTS);
+  self->created = read_u64 (data + HEADER_CREATED);
+  entries_offset = read_u64 (data + HEADER_ENTRIES_OFFSET);
+  self->entries_len = read_u64 (data + HEADER_ENTRIES_LEN);
+  restarts_offset = read_u64 (data + HEADER_RESTARTS_OFFSET);
+  bucket_len = read_u32 (data + HEADER_BUCKET_LEN);
+  prefix_len = read_u32 (data + HEADER_PREFIX_LEN);
+  self->restart_interval = read_u32 (data + HEADER_INTERVAL);
+
+  if (self->restart_interval == 0 ||
+      entries_offset != (guint64)HEADER_SIZE + bucket_len + prefix_len ||
+      entries_offset > len ||
+      self->entries_len > len - entries_offset ||
+      restarts_offset < entries_offset + self->entries_len ||
+      restarts_offset > len ||
+      self->n_restarts > (len - restarts_offset) / 8 ||
+      self->n_restarts != (self->n_keys + self->restart_interval - 1) / self->restart_interval)
+    goto invalid;
+
+  self->bucket = g_strndup ((const gchar *)data + HEADER_SIZE, bucket_len);
+  self->prefix = g_strndup ((const gchar *)data + HEADER_SIZE + bucket_len, prefix_len);
+  self->entries = data + entries_offset;
+  self->restarts = data + restarts_offset;
+
+  /*
+   * Walk every entry once so that queries can trust the restart table
+   * and never run off the end of the mapping.
+   */
+  index_cursor_init (&cursor, self->entries, self->entries + self->entries_len);
+
+  for (i = 0; i < self->n_keys; i++)
+    {
+      if (i % self->restart_interval == 0)
+        {
+          guint64 offset = aws_s3_listing_index_get_restart (self, i / self->restart_interval);
+
+          if (offset != (guint64)(cursor.p - self->entries) ||
+              cursor.p >= cursor.end ||
+              *cursor.p != 0)
+            break;
+        }
+
+      if (!index_cursor_next (&cursor))
+        break;
+    }
+
+  ret = (i == self->n_keys && cursor.p == cursor.end);
+  index_cursor_clear (&cursor);
+
+  if (ret)
+    return TRUE;
+
+invalid:
+  g_set_error (error,
+               G_IO_ERROR,
+               G_IO_ERROR_INVALID_DATA,
+               "Not a valid listing index");
+  return FALSE;
+}
+
+/**
+ * aws_s3_listing_index_new_for_file:
+ * @file: A local #GFile written by aws_s3_listing_index_build_sync().
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Maps an existing listing index into memory.
+ *
+ * Returns: (transfer full): An #AwsS3ListingIndex or %NULL and @error is set.
+ */
+AwsS3ListingIndex *
+aws_s3_listing_index_new_for_file (GFile   *file,
+                                   GError **error)
+{
+  g_autoptr(AwsS3ListingIndex) self = NULL;
+  g_autofree gchar *path = NULL;
+
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+  if (!(path = g_file_get_path (file)))
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_SUPPORTED,
+                   "Listing indexes must be stored in local files");
+      return NULL;
+    }
+
+  self = g_object_new (AWS_TYPE_S3_LISTING_INDEX, NULL);
+  self->file = g_object_ref (file);
+
+  if (!(self->mapped = g_mapped_file_new (path, FALSE, error)) ||
+      !aws_s3_listing_index_load (self, error))
+    return NULL;
+
+  return g_steal_pointer (&self);
+}
+
+/**
+ * aws_s3_listing_index_build_sync:
+ * @client: An #AwsS3Client.
+ * @bucket: The bucket to index.
+ * @prefix: (nullable): Only index keys starting with @prefix.
+ * @file: A local #GFile to store the index in.
+ * @cancellable: (nullable): A #GCancellable, or %NULL.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Synchronously lists every key in @bucket below @prefix and writes a
+ * snapshot of the keys with their size, ETag and modification time to
+ * @file. Any existing index in @file is replaced atomically.
+ *
+ * The index is memory-mapped, and keys are prefix-compressed. Lookups,
+ * prefix queries and range queries are answered locally without
+ * contacting S3.
+ *
+ * Returns: (transfer full): An #AwsS3ListingIndex or %NULL and @error is set.
+ */
+AwsS3ListingIndex *
+aws_s3_listing_index_build_sync (AwsS3Client   *client,
+                                 const gchar   *bucket,
+                                 const gchar   *prefix,
+                                 GFile         *file,
+                                 GCancellable  *cancellable,
+                                 GError       **error)
+{
+  IndexWriter writer;
+  gboolean ret;
+
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), NULL);
+  g_return_val_if_fail (bucket != NULL, NULL);
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), NULL);
+
+  if (prefix == NULL)
+    prefix = "";
+
+  index_writer_init (&writer);
+  ret = index_writer_add_listing (&writer, client, bucket, prefix, cancellable, error) &&
+        index_writer_write (&writer, file, bucket, prefix, cancellable, error);
+  index_writer_clear (&writer);
+
+  if (!ret)
+    return NULL;
+
+  return aws_s3_listing_index_new_for_file (file, error);
+}
+
+/**
+ * aws_s3_listing_index_refresh_sync:
+ * @self: An #AwsS3ListingIndex.
+ * @client: An #AwsS3Client.
+ * @prefixes: (array zero-terminated=1): The prefixes that have changed.
+ * @cancellable: (nullable): A #GCancellable, or %NULL.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Synchronously brings the index up to date by listing only @prefixes
+ * again. Entries below each of @prefixes are replaced with the new
+ * listing and everything else is carried over. Each of @prefixes must lie
+ * within the prefix the index was built for.
+ *
+ * The new snapshot replaces the index file and is returned as a new
+ * #AwsS3ListingIndex; @self remains valid and unchanged, so readers may
+ * keep using it until they switch over.
+ *
+ * Returns: (transfer full): An #AwsS3ListingIndex or %NULL and @error is set.
+ */
+AwsS3ListingIndex *
+aws_s3_listing_index_refresh_sync (AwsS3ListingIndex    *self,
+                                   AwsS3Client          *client,
+                                   const gchar * const  *prefixes,
+                                   GCancellable         *cancellable,
+                                   GError              **error)
+{
+  g_autoptr(GPtrArray) sorted = NULL;
+  IndexWriter writer;
+  IndexCursor cursor;
+  const gchar *last = NULL;
+  gboolean valid;
+  gboolean ret = FALSE;
+  guint i;
+
+  g_return_val_if_fail (AWS_IS_S3_LISTING_INDEX (self), NULL);
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), NULL);
+  g_return_val_if_fail (prefixes != NULL, NULL);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), NULL);
+
+  sorted = g_ptr_array_new ();
+
+  for (i = 0; prefixes [i] != NULL; i++)
+    {
+      if (!g_str_has_prefix (prefixes [i], self->prefix))
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_INVALID_ARGUMENT,
+                       "%s is not within the indexed prefix %s",
+                       prefixes [i],
+                       self->prefix);
+          return NULL;
+        }
+
+      g_ptr_array_add (sorted, (gpointer)prefixes [i]);
+    }
+
+  g_ptr_array_sort (sorted, compare_prefix);
+
+  index_writer_init (&writer);
+  index_cursor_init (&cursor, self->entries, self->entries + self->entries_len);
+  valid = index_cursor_next (&cursor);
+
+  for (i = 0; i < sorted->len; i++)
+    {
+      const gchar *prefix = g_ptr_array_index (sorted, i);
+
+      /* Already covered by a shorter prefix */
+      if (last != NULL && g_str_has_prefix (prefix, last))
+        continue;
+
+      last = prefix;
+
+      /* Keep what sorts before the prefix, */
+      for (; valid && strcmp (cursor.key->str, prefix) < 0; valid = index_cursor_next (&cursor))
+        {
+          if (!index_writer_add (&writer,
+                                 cursor.key->str,
+                                 cursor.size,
+                                 index_cursor_get_etag (&cursor),
+                                 cursor.last_modified,
+                                 error))
+            goto cleanup;
+        }
+
+      /* replace everything below it, */
+      if (!index_writer_add_listing (&writer, client, self->bucket, prefix, cancellable, error))
+        goto cleanup;
+
+      /* and skip the stale entries. */
+      while (valid && g_str_has_prefix (cursor.key->str, prefix))
+        valid = index_cursor_next (&cursor);
+    }
+
+  for (; valid; valid = index_cursor_next (&cursor))
+    {
+      if (!index_writer_add (&writer,
+                             cursor.key->str,
+                             cursor.size,
+                             index_cursor_get_etag (&cursor),
+                             cursor.last_modified,
+                             error))
+        goto cleanup;
+    }
+
+  ret = index_writer_write (&writer, self->file, self->bucket, self->prefix, cancellable, error);
+
+cleanup:
+  index_cursor_clear (&cursor);
+  index_writer_clear (&writer);
+
+  if (!ret)
+    return NULL;
+
+  return aws_s3_listing_index_new_for_file (self->file, error);
+}
+
+/**
+ * aws_s3_listing_index_lookup:
+ * @self: An #AwsS3ListingIndex.
+ * @key: The key to look up.
+ *
+ * Returns: (transfer full) (nullable): The #AwsS3ObjectInfo recorded for
+ *   @key, or %NULL if it was not present when the index was built.
+ */
+AwsS3ObjectInfo *
+aws_s3_listing_index_lookup (AwsS3ListingIndex *self,
+                             const gchar       *key)
+{
+  AwsS3ObjectInfo *info = NULL;
+  IndexCursor cursor;
+
+  g_return_val_if_fail (AWS_IS_S3_LISTING_INDEX (self), NULL);
+  g_return_val_if_fail (key != NULL, NULL);
+
+  if (aws_s3_listing_index_seek (self, &cursor, key) && g_str_equal (cursor.key->str, key))
+    info = aws_s3_object_info_new (key,
+                                   cursor.size,
+                                   index_cursor_get_etag (&cursor),
+                                   cursor.last_modified);
+
+  index_cursor_clear (&cursor);
+
+  return info;
+}
+
+gboolean
+aws_s3_listing_index_contains (AwsS3ListingIndex *self,
+                               const gchar       *key)
+{
+  IndexCursor cursor;
+  gboolean ret;
+
+  g_return_val_if_fail (AWS_IS_S3_LISTING_INDEX (self), FALSE);
+  g_return_val_if_fail (key != NULL, FALSE);
+
+  ret = aws_s3_listing_index_seek (self, &cursor, key) && g_str_equal (cursor.key->str, key);
+  index_cursor_clear (&cursor);
+
+  return ret;
+}
+
+/**
+ * aws_s3_listing_index_foreach_prefix:
+ * @self: An #AwsS3ListingIndex.
+ * @prefix: The prefix of the keys to visit.
+ * @func: (scope call): A function to call for each key.
+ * @user_data: User data for @func.
+ *
+ * Calls @func for each key starting with @prefix, in order, until @func
+ * returns %FALSE. The strings passed to @func are only valid for the
+ * duration of the call.
+ */
+void
+aws_s3_listing_index_foreach_prefix (AwsS3ListingIndex     *self,
+                                     const gchar           *prefix,
+                                     AwsS3ListingIndexFunc  func,
+                                     gpointer               user_data)
+{
+  IndexCursor cursor;
+  gboolean valid;
+
+  g_return_if_fail (AWS_IS_S3_LISTING_INDEX (self));
+  g_return_if_fail (prefix != NULL);
+  g_return_if_fail (func != NULL);
+
+  for (valid = aws_s3_listing_index_seek (self, &cursor, prefix);
+       valid && g_str_has_prefix (cursor.key->str, prefix);
+       valid = index_cursor_next (&cursor))
+    {
+      if (!func (cursor.key->str,
+                 cursor.size,
+                 index_cursor_get_etag (&cursor),
+                 cursor.last_modified,
+                 user_data))
+        break;
+    }
+
+  index_cursor_clear (&cursor);
+}
+
+/**
+ * aws_s3_listing_index_foreach_range:
+ * @self: An #AwsS3ListingIndex.
+ * @start: (nullable): The first key to visit, or %NULL to start at the beginning.
+ * @end: (nullable): The key to stop before, or %NULL to continue to the end.
+ * @func: (scope call): A function to call for each key.
+ * @user_data: User data for @func.
+ *
+ * Calls @func for each key in [@start, @end), in order, until @func
+ * returns %FALSE. The strings passed to @func are only valid for the
+ * duration of the call.
+ */
+void
+aws_s3_listing_index_foreach_range (AwsS3ListingIndex     *self,
+                                    const gchar           *start,
+                                    const gchar           *end,
+                                    AwsS3ListingIndexFunc  func,
+                                    gpointer               user_data)
+{
+  IndexCursor cursor;
+  gboolean valid;
+
+  g_return_if_fail (AWS_IS_S3_LISTING_INDEX (self));
+  g_return_if_fail (func != NULL);
+
+  for (valid = aws_s3_listing_index_seek (self, &cursor, start);
+       valid && (end == NULL || strcmp (cursor.key->str, end) < 0);
+       valid = index_cursor_next (&cursor))
+    {
+      if (!func (cursor.key->str,
+                 cursor.size,
+                 index_cursor_get_etag (&cursor),
+                 cursor.last_modified,
+                 user_data))
+        break;
+    }
+
+  index_cursor_clear (&cursor);
+}
+
+const gchar *
+aws_s3_listing_index_get_bucket (AwsS3ListingIndex *self)
+{
+  g_return_val_if_fail (AWS_IS_S3_LISTING_INDEX (self), NULL);
+
+  return self->bucket;
+}
+
+/**
+ * aws_s3_listing_index_get_created:
+ * @self: An #AwsS3ListingIndex.
+ *
+ * Returns: When the snapshot was written, in seconds since the Unix epoch.
+ */
+gint64
+aws_s3_listing_index_get_created (AwsS3ListingIndex *self)
+{
+  g_return_val_if_fail (AWS_IS_S3_LISTING_INDEX (self), 0);
+
+  return self->created;
+}
+
+guint64
+aws_s3_listing_index_get_n_keys (AwsS3ListingIndex *self)
+{
+  g_return_val_if_fail (AWS_IS_S3_LISTING_INDEX (self), 0);
+
+  return self->n_keys;
+}
+
+const gchar *
+aws_s3_listing_index_get_prefix (AwsS3ListingIndex *self)
+{
+  g_return_val_if_fail (AWS_IS_S3_LISTING_INDEX (self), NULL);
+
+  return self->prefix;
+}
+
+static void
+aws_s3_listing_index_finalize (GObject *object)
+{
+  AwsS3ListingIndex *self = (AwsS3ListingIndex *)object;
+
+  g_clear_object (&self->file);
+  g_clear_pointer (&self->mapped, g_mapped_file_unref);
+  g_clear_pointer (&self->bucket, g_free);
+  g_clear_pointer (&self->prefix, g_free);
+
+  G_OBJECT_CLASS (aws_s3_listing_index_parent_class)->finalize (object);
+}
+
+static void
+aws_s3_listing_index_class_init (AwsS3ListingIndexClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = aws_s3_listing_index_finalize;
+}
+
+static void
+aws_s3_listing_index_init (AwsS3ListingIndex *self)
+{
+}
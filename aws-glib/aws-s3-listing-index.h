@@ -0,0 +1,71 @@
+/* aws-s3-listing-index.h
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AWS_S3_LISTING_INDEX_H
+#define AWS_S3_LISTING_INDEX_H
+
+#include <gio/gio.h>
+
+#include "aws-s3-client.h"
+
+G_BEGIN_DECLS
+
+#define AWS_TYPE_S3_LISTING_INDEX (aws_s3_listing_index_get_type())
+
+G_DECLARE_FINAL_TYPE (AwsS3ListingIndex, aws_s3_listing_index, AWS, S3_LISTING_INDEX, GObject)
+
+typedef gboolean (*AwsS3ListingIndexFunc) (const gchar *key,
+                                           guint64      size,
+                                           const gchar *etag,
+                                           gint64       last_modified,
+                                           gpointer     user_data);
+
+AwsS3ListingIndex *aws_s3_listing_index_new_for_file   (GFile                  *file,
+                                                        GError                **error);
+AwsS3ListingIndex *aws_s3_listing_index_build_sync     (AwsS3Client            *client,
+                                                        const gchar            *bucket,
+                                                        const gchar            *prefix,
+                                                        GFile                  *file,
+                                                        GCancellable           *cancellable,
+                                                        GError                **error);
+gboolean           aws_s3_listing_index_contains       (AwsS3ListingIndex      *self,
+                                                        const gchar            *key);
+void               aws_s3_listing_index_foreach_prefix (AwsS3ListingIndex      *self,
+                                                        const gchar            *prefix,
+                                                        AwsS3ListingIndexFunc   func,
+                                                        gpointer                user_data);
+void               aws_s3_listing_index_foreach_range  (AwsS3ListingIndex      *self,
+                                                        const gchar            *start,
+                                                        const gchar            *end,
+                                                        AwsS3ListingIndexFunc   func,
+                                                        gpointer                user_data);
+const gchar       *aws_s3_listing_index_get_bucket     (AwsS3ListingIndex      *self);
+gint64             aws_s3_listing_index_get_created    (AwsS3ListingIndex      *self);
+guint64            aws_s3_listing_index_get_n_keys     (AwsS3ListingIndex      *self);
+const gchar       *aws_s3_listing_index_get_prefix     (AwsS3ListingIndex      *self);
+AwsS3ObjectInfo   *aws_s3_listing_index_lookup         (AwsS3ListingIndex      *self,
+                                                        const gchar            *key);
+AwsS3ListingIndex *aws_s3_listing_index_refresh_sync   (AwsS3ListingIndex      *self,
+                                                        AwsS3Client            *client,
+                                                        const gchar * const    *prefixes,
+                                                        GCancellable           *cancellable,
+                                                        GError                **error);
+
+G_END_DECLS
+
+#endif /* AWS_S3_LISTING_INDEX_H */
@@ -0,0 +1,153 @@
+/* aws-s3-object-info.c
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "aws-s3-object-info.h"
+
+struct _AwsS3ObjectInfo
+{
+  volatile gint  ref_count;
+  gchar         *key;
+  gchar         *etag;
+  guint64        size;
+  gint64         last_modified;
+  guint          is_prefix : 1;
+};
+
+G_DEFINE_BOXED_TYPE (AwsS3ObjectInfo, aws_s3_object_info, aws_s3_object_info_ref, aws_s3_object_info_unref)
+
+/**
+ * aws_s3_object_info_new:
+ * @key: The key of the object.
+ * @size: The size of the object in bytes.
+ * @etag: (nullable): The ETag of the object.
+ * @last_modified: When the object was last modified in seconds since the
+ *   Unix epoch, or 0 if unknown.
+ *
+ * Returns: (transfer full): A new #AwsS3ObjectInfo.
+ */
+AwsS3ObjectInfo *
+aws_s3_object_info_new (const gchar *key,
+                        guint64      size,
+                        const gchar *etag,
+                        gint64       last_modified)
+{
+  AwsS3ObjectInfo *self;
+
+  g_return_val_if_fail (key != NULL, NULL);
+
+  self = g_slice_new0 (AwsS3ObjectInfo);
+  self->ref_count = 1;
+  self->key = g_strdup (key);
+  self->etag = g_strdup (etag);
+  self->size = size;
+  self->last_modified = last_modified;
+
+  return self;
+}
+
+/**
+ * aws_s3_object_info_new_prefix:
+ * @prefix: The common prefix, including the trailing delimiter.
+ *
+ * Returns: (transfer full): A new #AwsS3ObjectInfo for a common prefix.
+ */
+AwsS3ObjectInfo *
+aws_s3_object_info_new_prefix (const gchar *prefix)
+{
+  AwsS3ObjectInfo *self;
+
+  g_return_val_if_fail (prefix != NULL, NULL);
+
+  self = aws_s3_object_info_new (prefix, 0, NULL, 0);
+  self->is_prefix = TRUE;
+
+  return self;
+}
+
+AwsS3ObjectInfo *
+aws_s3_object_info_ref (AwsS3ObjectInfo *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (self->ref_count > 0, NULL);
+
+  g_atomic_int_inc (&self->ref_count);
+
+  return self;
+}
+
+void
+aws_s3_object_info_unref (AwsS3ObjectInfo *self)
+{
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (self->ref_count > 0);
+
+  if (g_atomic_int_dec_and_test (&self->ref_count))
+    {
+      g_free (self->key);
+      g_free (self->etag);
+      g_slice_free (AwsS3ObjectInfo, self);
+    }
+}
+
+/**
+ * aws_s3_object_info_get_etag:
+ * @self: An #AwsS3ObjectInfo.
+ *
+ * Gets the ETag of the object, including its surrounding quotes.
+ *
+ * Returns: (nullable): The ETag, or %NULL for a common prefix.
+ */
+const gchar *
+aws_s3_object_info_get_etag (AwsS3ObjectInfo *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+
+  return self->etag;
+}
+
+const gchar *
+aws_s3_object_info_get_key (AwsS3ObjectInfo *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+
+  return self->key;
+}
+
+gint64
+aws_s3_object_info_get_last_modified (AwsS3ObjectInfo *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->last_modified;
+}
+
+guint64
+aws_s3_object_info_get_size (AwsS3ObjectInfo *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->size;
+}
+
+gboolean
+aws_s3_object_info_is_prefix (AwsS3ObjectInfo *self)
+{
+  g_return_val_if_fail (self != NULL, FALSE);
+
+  return self->is_prefix;
+}
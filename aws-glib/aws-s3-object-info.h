@@ -0,0 +1,48 @@
+/* aws-s3-object-info.h
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AWS_S3_OBJECT_INFO_H
+#define AWS_S3_OBJECT_INFO_H
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define AWS_TYPE_S3_OBJECT_INFO (aws_s3_object_info_get_type())
+
+typedef struct _AwsS3ObjectInfo AwsS3ObjectInfo;
+
+GType            aws_s3_object_info_get_type          (void);
+AwsS3ObjectInfo *aws_s3_object_info_new               (const gchar     *key,
+                                                       guint64          size,
+                                                       const gchar     *etag,
+                                                       gint64           last_modified);
+AwsS3ObjectInfo *aws_s3_object_info_new_prefix        (const gchar     *prefix);
+AwsS3ObjectInfo *aws_s3_object_info_ref               (AwsS3ObjectInfo *self);
+void             aws_s3_object_info_unref             (AwsS3ObjectInfo *self);
+const gchar     *aws_s3_object_info_get_etag          (AwsS3ObjectInfo *self);
+const gchar     *aws_s3_object_info_get_key           (AwsS3ObjectInfo *self);
+gint64           aws_s3_object_info_get_last_modified (AwsS3ObjectInfo *self);
+guint64          aws_s3_object_info_get_size          (AwsS3ObjectInfo *self);
+gboolean         aws_s3_object_info_is_prefix         (AwsS3ObjectInfo *self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (AwsS3ObjectInfo, aws_s3_object_info_unref)
+
+G_END_DECLS
+
+#endif /* AWS_S3_OBJECT_INFO_H */
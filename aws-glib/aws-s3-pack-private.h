@@ -0,0 +1,51 @@
+/* aws-s3-pack-private.h
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AWS_S3_PACK_PRIVATE_H
+#define AWS_S3_PACK_PRIVATE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * A pack writer stores each batch of records under its prefix as two
+ * objects sharing an id that sorts by creation time:
+ *
+ *   PREFIX "packs/" ID ".pack"   the concatenated record bytes
+ *   PREFIX "index/" ID ".idx"    where each record lies in the pack
+ *
+ * The index starts with AWS_S3_PACK_INDEX_MAGIC and a varint count,
+ * followed by that many entries sorted by name, each a run of varints:
+ * the name bytes shared with the previous name, the number of bytes that
+ * follow, the name bytes, the offset and the length. The pack is always
+ * uploaded before its index, so any index that can be seen refers to a
+ * complete pack. When several packs hold the same name, the one with the
+ * greatest id wins.
+ */
+
+#define AWS_S3_PACK_INDEX_MAGIC     "S3PACK\0\1"
+#define AWS_S3_PACK_INDEX_MAGIC_LEN 8
+#define AWS_S3_PACK_DIR             "packs/"
+#define AWS_S3_PACK_SUFFIX          ".pack"
+#define AWS_S3_PACK_INDEX_DIR       "index/"
+#define AWS_S3_PACK_INDEX_SUFFIX    ".idx"
+
+G_END_DECLS
+
+#endif /* AWS_S3_PACK_PRIVATE_H */
@@ -0,0 +1,525 @@
+/* aws-s3-pack-reader.c
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "aws-s3-pack-private.h"
+#include "aws-s3-pack-reader.h"
+#include "aws-varint.h"
+
+/* Limits how often lookups of unknown names go back to S3 */
+#define MISS_REFRESH_INTERVAL (G_USEC_PER_SEC)
+
+struct _AwsS3PackReader
+{
+  GObject parent_instance;
+
+  AwsS3Client *client;
+  gchar *bucket;
+  gchar *prefix;
+
+  /* Everything below is protected by mutex */
+  GMutex mutex;
+  GHashTable *locations;
+  GHashTable *loaded;
+  GPtrArray *packs;
+  gint64 last_refresh;
+};
+
+typedef struct
+{
+  guint   pack;
+  guint64 offset;
+  guint64 length;
+} PackLocation;
+
+typedef struct
+{
+  gchar   *name;
+  guint64  offset;
+  guint64  length;
+} IndexEntry;
+
+G_DEFINE_TYPE (AwsS3PackReader, aws_s3_pack_reader, G_TYPE_OBJECT)
+
+enum {
+  PROP_0,
+  PROP_BUCKET,
+  PROP_CLIENT,
+  PROP_PREFIX,
+  N_PROPS
+};
+
+static GParamSpec *properties [N_PROPS];
+
+static void
+pack_location_free (gpointer data)
+{
+  g_slice_free (PackLocation, data);
+}
+
+static void
+index_entry_clear (gpointer data)
+{
+  IndexEntry *entry = data;
+
+  g_free (entry->name);
+}
+
+static GBytes *
+aws_s3_pack_reader_fetch (AwsS3PackReader  *self,
+                          const gchar      *path,
+                          GCancellable     *cancellable,
+                          GError          **error)
+{
+  g_autoptr(GInputStream) stream = NULL;
+  g_autoptr(GOutputStream) contents = NULL;
+
+  g_assert (AWS_IS_S3_PACK_READER (self));
+
+  if (!(stream = aws_s3_client_open_range_sync (self->client, self->bucket, path, 0, NULL, cancellable, error)))
+    return NULL;
+
+  contents = g_memory_output_stream_new_resizable ();
+
+  if (g_output_stream_splice (contents,
+                              stream,
+                              G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE |
+                              G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+                              cancellable,
+                              error) < 0)
+    return NULL;
+
+  return g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (contents));
+}
+
+static GArray *
+parse_index (GBytes  *bytes,
+             GError **error)
+{
+  g_autoptr(GArray) entries = NULL;
+  g_autoptr(GString) name = NULL;
+  const guint8 *p;
+  const guint8 *end;
+  guint64 n_entries;
+  guint64 i;
+  gsize len;
+
+  p = g_bytes_get_data (bytes, &len);
+  end = p + len;
+
+  if (len < AWS_S3_PACK_INDEX_MAGIC_LEN ||
+      memcmp (p, AWS_S3_PACK_INDEX_MAGIC, AWS_S3_PACK_INDEX_MAGIC_LEN) != 0)
+    goto invalid;
+
+  p += AWS_S3_PACK_INDEX_MAGIC_LEN;
+
+  /* Every entry takes at least four bytes */
+  if (!aws_varint_read (&p, end, &n_entries) || n_entries > (guint64)(end - p) / 4)
+    goto invalid;
+
+  entries = g_array_sized_new (FALSE, FALSE, sizeof (IndexEntry), n_entries);
+  g_array_set_clear_func (entries, index_entry_clear);
+  name = g_string_new (NULL);
+
+  for (i = 0; i < n_entries; i++)
+    {
+      IndexEntry entry;
+      guint64 shared;
+      guint64 unshared;
+
+      if (!aws_varint_read (&p, end, &shared) ||
+          !aws_varint_read (&p, end, &unshared) ||
+          shared > name->len ||
+          unshared > (guint64)(end - p))
+        goto invalid;
+
+      g_string_truncate (name, shared);
+      g_string_append_len (name, (const gchar *)p, unshared);
+      p += unshared;
+
+      if (!aws_varint_read (&p, end, &entry.offset) ||
+          !aws_varint_read (&p, end, &entry.length))
+        goto invalid;
+
+      entry.name = g_strndup (name->str, name->len);
+      g_array_append_val (entries, entry);
+    }
+
+  if (p == end)
+    return g_steal_pointer (&entries);
+
+invalid:
+  g_set_error (error,
+               G_IO_ERROR,
+               G_IO_ERROR_INVALID_DATA,
+               "Not a valid pack index");
+  return NULL;
+}
+
+static void
+aws_s3_pack_reader_merge (AwsS3PackReader *self,
+                          const gchar     *index_path,
+                          const gchar     *pack_path,
+                          GArray          *entries)
+{
+  guint pack;
+  guint i;
+
+  g_assert (AWS_IS_S3_PACK_READER (self));
+
+  g_mutex_lock (&self->mutex);
+
+  if (g_hash_table_contains (self->loaded, index_path))
+    goto unlock;
+
+  g_hash_table_add (self->loaded, g_strdup (index_path));
+
+  pack = self->packs->len;
+  g_ptr_array_add (self->packs, g_strdup (pack_path));
+
+  for (i = 0; i < entries->len; i++)
+    {
+      IndexEntry *entry = &g_array_index (entries, IndexEntry, i);
+      PackLocation *location = g_hash_table_lookup (self->locations, entry->name);
+
+      /* Pack ids sort by creation time, so the newest record wins */
+      if (location != NULL)
+        {
+          if (strcmp (pack_path, g_ptr_array_index (self->packs, location->pack)) < 0)
+            continue;
+        }
+      else
+        {
+          location = g_slice_new (PackLocation);
+          g_hash_table_insert (self->locations, g_steal_pointer (&entry->name), location);
+        }
+
+      location->pack = pack;
+      location->offset = entry->offset;
+      location->length = entry->length;
+    }
+
+unlock:
+  g_mutex_unlock (&self->mutex);
+}
+
+/**
+ * aws_s3_pack_reader_new:
+ * @client: An #AwsS3Client.
+ * @bucket: The bucket containing the packs.
+ * @prefix: (nullable): The prefix given to the #AwsS3PackWriter.
+ *
+ * Creates a reader for records stored by #AwsS3PackWriter. Indexes are
+ * fetched once and cached, so each record read is a single ranged GET.
+ *
+ * Returns: (transfer full): An #AwsS3PackReader.
+ */
+AwsS3PackReader *
+aws_s3_pack_reader_new (AwsS3Client *client,
+                        const gchar *bucket,
+                        const gchar *prefix)
+{
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), NULL);
+  g_return_val_if_fail (bucket != NULL, NULL);
+
+  return g_object_new (AWS_TYPE_S3_PACK_READER,
+                       "bucket", bucket,
+                       "client", client,
+                       "prefix", prefix,
+                       NULL);
+}
+
+/**
+ * aws_s3_pack_reader_refresh_sync:
+ * @self: An #AwsS3PackReader.
+ * @cancellable: (nullable): A #GCancellable, or %NULL.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Synchronously lists the pack indexes and fetches those that have not
+ * been loaded yet.
+ *
+ * Returns: %TRUE if successful, otherwise %FALSE and @error is set.
+ */
+gboolean
+aws_s3_pack_reader_refresh_sync (AwsS3PackReader  *self,
+                                 GCancellable     *cancellable,
+                                 GError          **error)
+{
+  g_autofree gchar *index_prefix = NULL;
+  g_autofree gchar *token = NULL;
+  gsize index_prefix_len;
+
+  g_return_val_if_fail (AWS_IS_S3_PACK_READER (self), FALSE);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), FALSE);
+
+  index_prefix = g_strconcat (self->prefix, AWS_S3_PACK_INDEX_DIR, NULL);
+  index_prefix_len = strlen (index_prefix);
+
+  g_mutex_lock (&self->mutex);
+  self->last_refresh = g_get_monotonic_time ();
+  g_mutex_unlock (&self->mutex);
+
+  do
+    {
+      g_autoptr(GPtrArray) page = NULL;
+      gchar *next_token = NULL;
+      guint i;
+
+      page = aws_s3_client_list_sync (self->client,
+                                      self->bucket,
+                                      index_prefix,
+                                      NULL,
+                                      0,
+                                      token,
+                                      &next_token,
+                                      cancellable,
+                                      error);
+
+      if (page == NULL)
+        return FALSE;
+
+      g_free (token);
+      token = next_token;
+
+      for (i = 0; i < page->len; i++)
+        {
+          AwsS3ObjectInfo *info = g_ptr_array_index (page, i);
+          const gchar *key = aws_s3_object_info_get_key (info);
+          g_autoptr(GBytes) bytes = NULL;
+          g_autoptr(GArray) entries = NULL;
+          g_autofree gchar *id = NULL;
+          g_autofree gchar *pack_path = NULL;
+          gboolean loaded;
+
+          if (!g_str_has_suffix (key, AWS_S3_PACK_INDEX_SUFFIX))
+            continue;
+
+          g_mutex_lock (&self->mutex);
+          loaded = g_hash_table_contains (self->loaded, key);
+          g_mutex_unlock (&self->mutex);
+
+          if (loaded)
+            continue;
+
+          if (!(bytes = aws_s3_pack_reader_fetch (self, key, cancellable, error)) ||
+              !(entries = parse_index (bytes, error)))
+            return FALSE;
+
+          id = g_strndup (key + index_prefix_len,
+                          strlen (key) - index_prefix_len - strlen (AWS_S3_PACK_INDEX_SUFFIX));
+          pack_path = g_strconcat (self->prefix, AWS_S3_PACK_DIR, id, AWS_S3_PACK_SUFFIX, NULL);
+
+          aws_s3_pack_reader_merge (self, key, pack_path, entries);
+        }
+    }
+  while (token != NULL);
+
+  return TRUE;
+}
+
+/**
+ * aws_s3_pack_reader_read_sync:
+ * @self: An #AwsS3PackReader.
+ * @name: The name of the record.
+ * @cancellable: (nullable): A #GCancellable, or %NULL.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Synchronously reads the record most recently stored under @name. Names
+ * missing from the cached indexes trigger a refresh, at most once per
+ * second, before failing with %AWS_S3_CLIENT_ERROR_NOT_FOUND.
+ *
+ * This function may be called from multiple threads.
+ *
+ * Returns: (transfer full): A #GBytes or %NULL and @error is set.
+ */
+GBytes *
+aws_s3_pack_reader_read_sync (AwsS3PackReader  *self,
+                              const gchar      *name,
+                              GCancellable     *cancellable,
+                              GError          **error)
+{
+  g_autofree gchar *pack_path = NULL;
+  PackLocation *location;
+  guint64 offset = 0;
+  guint64 length = 0;
+  gboolean refresh;
+  guint attempt;
+
+  g_return_val_if_fail (AWS_IS_S3_PACK_READER (self), NULL);
+  g_return_val_if_fail (name != NULL, NULL);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), NULL);
+
+  for (attempt = 0; pack_path == NULL && attempt < 2; attempt++)
+    {
+      g_mutex_lock (&self->mutex);
+
+      if ((location = g_hash_table_lookup (self->locations, name)))
+        {
+          pack_path = g_strdup (g_ptr_array_index (self->packs, location->pack));
+          offset = location->offset;
+          length = location->length;
+        }
+
+      refresh = (pack_path == NULL &&
+                 attempt == 0 &&
+                 g_get_monotonic_time () - self->last_refresh >= MISS_REFRESH_INTERVAL);
+
+      g_mutex_unlock (&self->mutex);
+
+      if (!refresh)
+        break;
+
+      if (!aws_s3_pack_reader_refresh_sync (self, cancellable, error))
+        return NULL;
+    }
+
+  if (pack_path == NULL)
+    {
+      g_set_error (error,
+                   AWS_S3_CLIENT_ERROR,
+                   AWS_S3_CLIENT_ERROR_NOT_FOUND,
+                   "No record named %s",
+                   name);
+      return NULL;
+    }
+
+  return aws_s3_client_read_range_sync (self->client,
+                                        self->bucket,
+                                        pack_path,
+                                        offset,
+                                        length,
+                                        cancellable,
+                                        error);
+}
+
+static void
+aws_s3_pack_reader_finalize (GObject *object)
+{
+  AwsS3PackReader *self = (AwsS3PackReader *)object;
+
+  g_clear_object (&self->client);
+  g_clear_pointer (&self->bucket, g_free);
+  g_clear_pointer (&self->prefix, g_free);
+  g_clear_pointer (&self->locations, g_hash_table_unref);
+  g_clear_pointer (&self->loaded, g_hash_table_unref);
+  g_clear_pointer (&self->packs, g_ptr_array_unref);
+  g_mutex_clear (&self->mutex);
+
+  G_OBJECT_CLASS (aws_s3_pack_reader_parent_class)->finalize (object);
+}
+
+static void
+aws_s3_pack_reader_get_property (GObject    *object,
+                                 guint       prop_id,
+                                 GValue     *value,
+                                 GParamSpec *pspec)
+{
+  AwsS3PackReader *self = AWS_S3_PACK_READER (object);
+
+  switch (prop_id)
+    {
+    case PROP_BUCKET:
+      g_value_set_string (value, self->bucket);
+      break;
+
+    case PROP_CLIENT:
+      g_value_set_object (value, self->client);
+      break;
+
+    case PROP_PREFIX:
+      g_value_set_string (value, self->prefix);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+aws_s3_pack_reader_set_property (GObject      *object,
+                                 guint         prop_id,
+                                 const GValue *value,
+                                 GParamSpec   *pspec)
+{
+  AwsS3PackReader *self = AWS_S3_PACK_READER (object);
+
+  switch (prop_id)
+    {
+    case PROP_BUCKET:
+      self->bucket = g_value_dup_string (value);
+      break;
+
+    case PROP_CLIENT:
+      self->client = g_value_dup_object (value);
+      break;
+
+    case PROP_PREFIX:
+      if (!(self->prefix = g_value_dup_string (value)))
+        self->prefix = g_strdup ("");
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+aws_s3_pack_reader_class_init (AwsS3PackReaderClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = aws_s3_pack_reader_finalize;
+  object_class->get_property = aws_s3_pack_reader_get_property;
+  object_class->set_property = aws_s3_pack_reader_set_property;
+
+  properties [PROP_BUCKET] =
+    g_param_spec_string ("bucket",
+                         "Bucket",
+                         "The bucket containing the packs.",
+                         NULL,
+                         G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+  properties [PROP_CLIENT] =
+    g_param_spec_object ("client",
+                         "Client",
+                         "The client used to read packs.",
+                         AWS_TYPE_S3_CLIENT,
+                         G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+  properties [PROP_PREFIX] =
+    g_param_spec_string ("prefix",
+                         "Prefix",
+                         "The prefix packs and indexes are stored under.",
+                         "",
+                         G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties (object_class, N_PROPS, properties);
+}
+
+static void
+aws_s3_pack_reader_init (AwsS3PackReader *self)
+{
+  self->locations = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, pack_location_free);
+  self->loaded = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  self->packs = g_ptr_array_new_with_free_func (g_free);
+  self->last_refresh = G_MININT64 / 2;
+  g_mutex_init (&self->mutex);
+}
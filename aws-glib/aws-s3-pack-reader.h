@@ -0,0 +1,45 @@
+/* aws-s3-pack-reader.h
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AWS_S3_PACK_READER_H
+#define AWS_S3_PACK_READER_H
+
+#include <gio/gio.h>
+
+#include "aws-s3-client.h"
+
+G_BEGIN_DECLS
+
+#define AWS_TYPE_S3_PACK_READER (aws_s3_pack_reader_get_type())
+
+G_DECLARE_FINAL_TYPE (AwsS3PackReader, aws_s3_pack_reader, AWS, S3_PACK_READER, GObject)
+
+AwsS3PackReader *aws_s3_pack_reader_new          (AwsS3Client      *client,
+                                                  const gchar      *bucket,
+                                                  const gchar      *prefix);
+GBytes          *aws_s3_pack_reader_read_sync    (AwsS3PackReader  *self,
+                                                  const gchar      *name,
+                                                  GCancellable     *cancellable,
+                                                  GError          **error);
+gboolean         aws_s3_pack_reader_refresh_sync (AwsS3PackReader  *self,
+                                                  GCancellable     *cancellable,
+                                                  GError          **error);
+
+G_END_DECLS
+
+#endif /* AWS_S3_PACK_READER_H */
@@ -0,0 +1,728 @@
+/* aws-s3-pack-writer.c
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "aws-s3-pack-private.h"
+#include "aws-s3-pack-writer.h"
+#include "aws-varint.h"
+
+#define DEFAULT_MAX_PACK_SIZE (64 * 1024 * 1024)
+#define DEFAULT_MAX_PACK_AGE  60
+#define RETRY_MIN_INTERVAL    1
+#define RETRY_MAX_INTERVAL    60
+
+/*
+ * Appends only hold mutex long enough to copy the record in. A flush swaps
+ * the pending pack out under it and uploads without it, so appends carry
+ * on meanwhile; flush_mutex keeps packs uploading one at a time, in order.
+ *
+ * Packs that reach max-pack-age are uploaded by a thread of the writer's
+ * own, started with the first pack, so that idle writers still flush.
+ */
+struct _AwsS3PackWriter
+{
+  GObject parent_instance;
+
+  AwsS3Client *client;
+  gchar *bucket;
+  gchar *prefix;
+  guint64 max_pack_size;
+  guint max_pack_age;
+
+  GMutex flush_mutex;
+  GThread *thread;
+  GCancellable *cancellable;
+
+  /* Everything below is protected by mutex */
+  GMutex mutex;
+  GCond cond;
+  GByteArray *pack;
+  GArray *records;
+  gint64 opened_at;
+  gint64 retry_at;
+  guint retries;
+  guint shutdown : 1;
+};
+
+typedef struct
+{
+  gchar   *name;
+  guint64  offset;
+  guint64  length;
+} PackRecord;
+
+G_DEFINE_TYPE (AwsS3PackWriter, aws_s3_pack_writer, G_TYPE_OBJECT)
+
+enum {
+  PROP_0,
+  PROP_BUCKET,
+  PROP_CLIENT,
+  PROP_MAX_PACK_AGE,
+  PROP_MAX_PACK_SIZE,
+  PROP_PREFIX,
+  N_PROPS
+};
+
+static GParamSpec *properties [N_PROPS];
+
+static void
+pack_record_clear (gpointer data)
+{
+  PackRecord *record = data;
+
+  g_free (record->name);
+}
+
+/*
+ * Orders records by name, and records with the same name by the order
+ * they were appended in.
+ */
+static gint
+pack_record_compare (gconstpointer a,
+                     gconstpointer b)
+{
+  const PackRecord *ra = *(const PackRecord * const *)a;
+  const PackRecord *rb = *(const PackRecord * const *)b;
+  gint ret;
+
+  if ((ret = strcmp (ra->name, rb->name)) != 0)
+    return ret;
+
+  return (ra->offset > rb->offset) - (ra->offset < rb->offset);
+}
+
+static GArray *
+pack_records_new (void)
+{
+  GArray *records;
+
+  records = g_array_new (FALSE, FALSE, sizeof (PackRecord));
+  g_array_set_clear_func (records, pack_record_clear);
+
+  return records;
+}
+
+static GBytes *
+aws_s3_pack_writer_build_index (GArray *records)
+{
+  g_autoptr(GPtrArray) sorted = NULL;
+  GByteArray *index;
+  const gchar *last = "";
+  guint n_unique = 0;
+  guint i;
+
+  g_assert (records != NULL);
+
+  sorted = g_ptr_array_sized_new (records->len);
+
+  for (i = 0; i < records->len; i++)
+    g_ptr_array_add (sorted, &g_array_index (records, PackRecord, i));
+
+  g_ptr_array_sort (sorted, pack_record_compare);
+
+  /* Only the last record appended under each name is kept */
+  for (i = 0; i < sorted->len; i++)
+    {
+      PackRecord *record = g_ptr_array_index (sorted, i);
+      PackRecord *next = i + 1 < sorted->len ? g_ptr_array_index (sorted, i + 1) : NULL;
+
+      if (next == NULL || strcmp (record->name, next->name) != 0)
+        g_ptr_array_index (sorted, n_unique++) = record;
+    }
+
+  g_ptr_array_set_size (sorted, n_unique);
+
+  index = g_byte_array_new ();
+  g_byte_array_append (index, (const guint8 *)AWS_S3_PACK_INDEX_MAGIC, AWS_S3_PACK_INDEX_MAGIC_LEN);
+  aws_varint_append (index, sorted->len);
+
+  for (i = 0; i < sorted->len; i++)
+    {
+      PackRecord *record = g_ptr_array_index (sorted, i);
+      gsize len = strlen (record->name);
+      gsize shared = 0;
+
+      while (last [shared] != '\0' && last [shared] == record->name [shared])
+        shared++;
+
+      aws_varint_append (index, shared);
+      aws_varint_append (index, len - shared);
+      g_byte_array_append (index, (const guint8 *)record->name + shared, len - shared);
+      aws_varint_append (index, record->offset);
+      aws_varint_append (index, record->length);
+
+      last = record->name;
+    }
+
+  return g_byte_array_free_to_bytes (index);
+}
+
+/*
+ * Uploads @pack followed by its index.
+ */
+static gboolean
+aws_s3_pack_writer_upload (AwsS3PackWriter  *self,
+                           GByteArray       *pack,
+                           GArray           *records,
+                           GCancellable     *cancellable,
+                           GError          **error)
+{
+  g_autoptr(GBytes) bytes = NULL;
+  g_autoptr(GBytes) index = NULL;
+  g_autofree gchar *id = NULL;
+  g_autofree gchar *pack_path = NULL;
+  g_autofree gchar *index_path = NULL;
+
+  g_assert (AWS_IS_S3_PACK_WRITER (self));
+  g_assert (pack != NULL);
+  g_assert (records != NULL);
+
+  id = g_strdup_printf ("%016"G_GINT64_MODIFIER"x-%08x",
+                        g_get_real_time (),
+                        g_random_int ());
+  pack_path = g_strconcat (self->prefix, AWS_S3_PACK_DIR, id, AWS_S3_PACK_SUFFIX, NULL);
+  index_path = g_strconcat (self->prefix, AWS_S3_PACK_INDEX_DIR, id, AWS_S3_PACK_INDEX_SUFFIX, NULL);
+
+  /* Shares @pack with the request, which may outlive this call */
+  bytes = g_bytes_new_with_free_func (pack->data,
+                                      pack->len,
+                                      (GDestroyNotify)g_byte_array_unref,
+                                      g_byte_array_ref (pack));
+  index = aws_s3_pack_writer_build_index (records);
+
+  return aws_s3_client_write_bytes_sync (self->client, self->bucket, pack_path, bytes, cancellable, error) &&
+         aws_s3_client_write_bytes_sync (self->client, self->bucket, index_path, index, cancellable, error);
+}
+
+/*
+ * Puts a pack that failed to upload back in front of the records appended
+ * since, which are newer and so must still win for readers.
+ */
+static void
+aws_s3_pack_writer_restore_locked (AwsS3PackWriter *self,
+                                   GByteArray      *pack,
+                                   GArray          *records,
+                                   gint64           opened_at)
+{
+  GByteArray *merged;
+  guint i;
+
+  g_assert (AWS_IS_S3_PACK_WRITER (self));
+
+  for (i = 0; i < self->records->len; i++)
+    g_array_index (self->records, PackRecord, i).offset += pack->len;
+
+  /* Not appended to @pack in place, a failed request may still share it */
+  merged = g_byte_array_sized_new (pack->len + self->pack->len);
+  g_byte_array_append (merged, pack->data, pack->len);
+  g_byte_array_append (merged, self->pack->data, self->pack->len);
+
+  g_array_append_vals (records, self->records->data, self->records->len);
+
+  /* The names now belong to @records */
+  g_array_set_clear_func (self->records, NULL);
+  g_array_unref (self->records);
+  g_byte_array_unref (self->pack);
+
+  self->records = g_array_ref (records);
+  self->pack = merged;
+  self->opened_at = opened_at;
+}
+
+/*
+ * Uploads the pending records as a new pack. The records are kept on
+ * failure and automatic flushes back off, doubling the delay each time up
+ * to RETRY_MAX_INTERVAL; with @force, the backoff is ignored.
+ */
+static gboolean
+aws_s3_pack_writer_flush (AwsS3PackWriter  *self,
+                          gboolean          force,
+                          GCancellable     *cancellable,
+                          GError          **error)
+{
+  g_autoptr(GByteArray) pack = NULL;
+  g_autoptr(GArray) records = NULL;
+  gint64 opened_at;
+  gboolean ret;
+
+  g_assert (AWS_IS_S3_PACK_WRITER (self));
+
+  g_mutex_lock (&self->flush_mutex);
+  g_mutex_lock (&self->mutex);
+
+  if (self->records->len == 0 ||
+      (!force && g_get_monotonic_time () < self->retry_at))
+    {
+      g_mutex_unlock (&self->mutex);
+      g_mutex_unlock (&self->flush_mutex);
+      return TRUE;
+    }
+
+  pack = g_steal_pointer (&self->pack);
+  records = g_steal_pointer (&self->records);
+  opened_at = self->opened_at;
+
+  self->pack = g_byte_array_new ();
+  self->records = pack_records_new ();
+  self->opened_at = 0;
+
+  g_mutex_unlock (&self->mutex);
+
+  ret = aws_s3_pack_writer_upload (self, pack, records, cancellable, error);
+
+  g_mutex_lock (&self->mutex);
+
+  if (ret)
+    {
+      self->retries = 0;
+      self->retry_at = 0;
+    }
+  else
+    {
+      guint delay = RETRY_MIN_INTERVAL << MIN (self->retries, 16);
+
+      self->retries++;
+      self->retry_at = g_get_monotonic_time () +
+                       (gint64)MIN (delay, RETRY_MAX_INTERVAL) * G_USEC_PER_SEC;
+
+      aws_s3_pack_writer_restore_locked (self, pack, records, opened_at);
+    }
+
+  /* The flush thread may have to wait for a new deadline */
+  g_cond_signal (&self->cond);
+
+  g_mutex_unlock (&self->mutex);
+  g_mutex_unlock (&self->flush_mutex);
+
+  return ret;
+}
+
+/*
+ * Returns when the pending pack is due to be uploaded by age, or 0.
+ */
+static gint64
+aws_s3_pack_writer_get_deadline_locked (AwsS3PackWriter *self)
+{
+  g_assert (AWS_IS_S3_PACK_WRITER (self));
+
+  if (self->records->len == 0 || self->max_pack_age == 0)
+    return 0;
+
+  return MAX (self->opened_at + (gint64)self->max_pack_age * G_USEC_PER_SEC,
+              self->retry_at);
+}
+
+static gpointer
+aws_s3_pack_writer_thread_func (gpointer data)
+{
+  AwsS3PackWriter *self = data;
+
+  g_assert (AWS_IS_S3_PACK_WRITER (self));
+
+  g_mutex_lock (&self->mutex);
+
+  while (!self->shutdown)
+    {
+      g_autoptr(GError) error = NULL;
+      gint64 deadline = aws_s3_pack_writer_get_deadline_locked (self);
+
+      if (deadline == 0)
+        {
+          g_cond_wait (&self->cond, &self->mutex);
+          continue;
+        }
+
+      if (g_get_monotonic_time () < deadline)
+        {
+          g_cond_wait_until (&self->cond, &self->mutex, deadline);
+          continue;
+        }
+
+      g_mutex_unlock (&self->mutex);
+
+      if (!aws_s3_pack_writer_flush (self, FALSE, self->cancellable, &error))
+        g_debug ("Failed to flush pack: %s", error->message);
+
+      g_mutex_lock (&self->mutex);
+    }
+
+  g_mutex_unlock (&self->mutex);
+
+  return NULL;
+}
+
+/**
+ * aws_s3_pack_writer_new:
+ * @client: An #AwsS3Client.
+ * @bucket: The bucket to store packs in.
+ * @prefix: (nullable): The prefix to store packs and their indexes under.
+ *
+ * Creates a writer that batches small records into large pack objects,
+ * so that storing many records costs two PUT requests per pack rather
+ * than one per record. Read the records back with #AwsS3PackReader.
+ *
+ * Packs are uploaded once they reach #AwsS3PackWriter:max-pack-size, or
+ * from a background thread once they have been open for
+ * #AwsS3PackWriter:max-pack-age seconds. Records still pending when the
+ * writer is disposed are dropped, so call aws_s3_pack_writer_flush_sync()
+ * before releasing the last reference.
+ *
+ * Returns: (transfer full): An #AwsS3PackWriter.
+ */
+AwsS3PackWriter *
+aws_s3_pack_writer_new (AwsS3Client *client,
+                        const gchar *bucket,
+                        const gchar *prefix)
+{
+  g_return_val_if_fail (AWS_IS_S3_CLIENT (client), NULL);
+  g_return_val_if_fail (bucket != NULL, NULL);
+
+  return g_object_new (AWS_TYPE_S3_PACK_WRITER,
+                       "bucket", bucket,
+                       "client", client,
+                       "prefix", prefix,
+                       NULL);
+}
+
+/**
+ * aws_s3_pack_writer_append_sync:
+ * @self: An #AwsS3PackWriter.
+ * @name: The name to store the record under.
+ * @data: (array length=length): The contents of the record.
+ * @length: The length of @data.
+ * @cancellable: (nullable): A #GCancellable, or %NULL.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Appends a record to the current pack. Once the pack reaches
+ * #AwsS3PackWriter:max-pack-size it is uploaded synchronously; an error
+ * from that upload is reported here, and the records are kept for the next
+ * flush. After a failed upload, packs are not uploaded by size or age
+ * again until a backoff delay has passed.
+ *
+ * Appending a name again replaces the earlier record for readers. This
+ * function may be called from multiple threads.
+ *
+ * Returns: %TRUE if successful, otherwise %FALSE and @error is set.
+ */
+gboolean
+aws_s3_pack_writer_append_sync (AwsS3PackWriter  *self,
+                                const gchar      *name,
+                                gconstpointer     data,
+                                gsize             length,
+                                GCancellable     *cancellable,
+                                GError          **error)
+{
+  PackRecord record;
+  gboolean full;
+
+  g_return_val_if_fail (AWS_IS_S3_PACK_WRITER (self), FALSE);
+  g_return_val_if_fail (name != NULL, FALSE);
+  g_return_val_if_fail (data != NULL || length == 0, FALSE);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), FALSE);
+
+  g_mutex_lock (&self->mutex);
+
+  if (self->records->len == 0)
+    {
+      self->opened_at = g_get_monotonic_time ();
+
+      if (self->thread == NULL && self->max_pack_age > 0)
+        self->thread = g_thread_new ("aws-s3-pack-writer", aws_s3_pack_writer_thread_func, self);
+
+      g_cond_signal (&self->cond);
+    }
+
+  record.name = g_strdup (name);
+  record.offset = self->pack->len;
+  record.length = length;
+  g_array_append_val (self->records, record);
+  g_byte_array_append (self->pack, data, length);
+
+  full = self->pack->len >= self->max_pack_size;
+
+  g_mutex_unlock (&self->mutex);
+
+  if (full)
+    return aws_s3_pack_writer_flush (self, FALSE, cancellable, error);
+
+  return TRUE;
+}
+
+/**
+ * aws_s3_pack_writer_flush_sync:
+ * @self: An #AwsS3PackWriter.
+ * @cancellable: (nullable): A #GCancellable, or %NULL.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Synchronously uploads any pending records as a new pack, regardless of
+ * any backoff from a previous failure. Appends made meanwhile go into the
+ * next pack.
+ *
+ * Returns: %TRUE if successful, otherwise %FALSE and @error is set.
+ */
+gboolean
+aws_s3_pack_writer_flush_sync (AwsS3PackWriter  *self,
+                               GCancellable     *cancellable,
+                               GError          **error)
+{
+  g_return_val_if_fail (AWS_IS_S3_PACK_WRITER (self), FALSE);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), FALSE);
+
+  return aws_s3_pack_writer_flush (self, TRUE, cancellable, error);
+}
+
+guint
+aws_s3_pack_writer_get_max_pack_age (AwsS3PackWriter *self)
+{
+  g_return_val_if_fail (AWS_IS_S3_PACK_WRITER (self), 0);
+
+  return self->max_pack_age;
+}
+
+guint64
+aws_s3_pack_writer_get_max_pack_size (AwsS3PackWriter *self)
+{
+  g_return_val_if_fail (AWS_IS_S3_PACK_WRITER (self), 0);
+
+  return self->max_pack_size;
+}
+
+/**
+ * aws_s3_pack_writer_set_max_pack_age:
+ * @self: An #AwsS3PackWriter.
+ * @max_pack_age: The age in seconds, or 0 to flush by size only.
+ *
+ * Sets how long a pack may collect records before it is uploaded in the
+ * background.
+ */
+void
+aws_s3_pack_writer_set_max_pack_age (AwsS3PackWriter *self,
+                                     guint            max_pack_age)
+{
+  g_return_if_fail (AWS_IS_S3_PACK_WRITER (self));
+
+  if (self->max_pack_age != max_pack_age)
+    {
+      g_mutex_lock (&self->mutex);
+      self->max_pack_age = max_pack_age;
+      if (self->thread == NULL && max_pack_age > 0 && self->records->len > 0)
+        self->thread = g_thread_new ("aws-s3-pack-writer", aws_s3_pack_writer_thread_func, self);
+      g_cond_signal (&self->cond);
+      g_mutex_unlock (&self->mutex);
+
+      g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_MAX_PACK_AGE]);
+    }
+}
+
+void
+aws_s3_pack_writer_set_max_pack_size (AwsS3PackWriter *self,
+                                      guint64          max_pack_size)
+{
+  g_return_if_fail (AWS_IS_S3_PACK_WRITER (self));
+  g_return_if_fail (max_pack_size > 0);
+
+  if (self->max_pack_size != max_pack_size)
+    {
+      self->max_pack_size = max_pack_size;
+      g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_MAX_PACK_SIZE]);
+    }
+}
+
+/*
+ * Stops the flush thread, cancelling any upload it has in progress, so
+ * that releasing the writer never waits on the network.
+ */
+static void
+aws_s3_pack_writer_dispose (GObject *object)
+{
+  AwsS3PackWriter *self = (AwsS3PackWriter *)object;
+
+  if (self->thread != NULL)
+    {
+      g_mutex_lock (&self->mutex);
+      self->shutdown = TRUE;
+      g_cond_signal (&self->cond);
+      g_mutex_unlock (&self->mutex);
+
+      g_cancellable_cancel (self->cancellable);
+      g_thread_join (self->thread);
+      self->thread = NULL;
+    }
+
+  if (self->records->len > 0)
+    g_debug ("Dropping %u records that were not flushed", self->records->len);
+
+  G_OBJECT_CLASS (aws_s3_pack_writer_parent_class)->dispose (object);
+}
+
+static void
+aws_s3_pack_writer_finalize (GObject *object)
+{
+  AwsS3PackWriter *self = (AwsS3PackWriter *)object;
+
+  g_clear_object (&self->client);
+  g_clear_object (&self->cancellable);
+  g_clear_pointer (&self->bucket, g_free);
+  g_clear_pointer (&self->prefix, g_free);
+  g_clear_pointer (&self->pack, g_byte_array_unref);
+  g_clear_pointer (&self->records, g_array_unref);
+  g_cond_clear (&self->cond);
+  g_mutex_clear (&self->mutex);
+  g_mutex_clear (&self->flush_mutex);
+
+  G_OBJECT_CLASS (aws_s3_pack_writer_parent_class)->finalize (object);
+}
+
+static void
+aws_s3_pack_writer_get_property (GObject    *object,
+                                 guint       prop_id,
+                                 GValue     *value,
+                                 GParamSpec *pspec)
+{
+  AwsS3PackWriter *self = AWS_S3_PACK_WRITER (object);
+
+  switch (prop_id)
+    {
+    case PROP_BUCKET:
+      g_value_set_string (value, self->bucket);
+      break;
+
+    case PROP_CLIENT:
+      g_value_set_object (value, self->client);
+      break;
+
+    case PROP_MAX_PACK_AGE:
+      g_value_set_uint (value, self->max_pack_age);
+      break;
+
+    case PROP_MAX_PACK_SIZE:
+      g_value_set_uint64 (value, self->max_pack_size);
+      break;
+
+    case PROP_PREFIX:
+      g_value_set_string (value, self->prefix);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+aws_s3_pack_writer_set_property (GObject      *object,
+                                 guint         prop_id,
+                                 const GValue *value,
+                                 GParamSpec   *pspec)
+{
+  AwsS3PackWriter *self = AWS_S3_PACK_WRITER (object);
+
+  switch (prop_id)
+    {
+    case PROP_BUCKET:
+      self->bucket = g_value_dup_string (value);
+      break;
+
+    case PROP_CLIENT:
+      self->client = g_value_dup_object (value);
+      break;
+
+    case PROP_MAX_PACK_AGE:
+      aws_s3_pack_writer_set_max_pack_age (self, g_value_get_uint (value));
+      break;
+
+    case PROP_MAX_PACK_SIZE:
+      aws_s3_pack_writer_set_max_pack_size (self, g_value_get_uint64 (value));
+      break;
+
+    case PROP_PREFIX:
+      if (!(self->prefix = g_value_dup_string (value)))
+        self->prefix = g_strdup ("");
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+aws_s3_pack_writer_class_init (AwsS3PackWriterClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = aws_s3_pack_writer_dispose;
+  object_class->finalize = aws_s3_pack_writer_finalize;
+  object_class->get_property = aws_s3_pack_writer_get_property;
+  object_class->set_property = aws_s3_pack_writer_set_property;
+
+  properties [PROP_BUCKET] =
+    g_param_spec_string ("bucket",
+                         "Bucket",
+                         "The bucket to store packs in.",
+                         NULL,
+                         G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+  properties [PROP_CLIENT] =
+    g_param_spec_object ("client",
+                         "Client",
+                         "The client used to upload packs.",
+                         AWS_TYPE_S3_CLIENT,
+                         G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+  properties [PROP_MAX_PACK_AGE] =
+    g_param_spec_uint ("max-pack-age",
+                       "Max Pack Age",
+                       "The number of seconds a pack may collect records, or 0.",
+                       0,
+                       G_MAXUINT,
+                       DEFAULT_MAX_PACK_AGE,
+                       G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+
+  properties [PROP_MAX_PACK_SIZE] =
+    g_param_spec_uint64 ("max-pack-size",
+                         "Max Pack Size",
+                         "The size in bytes at which a pack is uploaded.",
+                         1,
+                         G_MAXUINT64,
+                         DEFAULT_MAX_PACK_SIZE,
+                         G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+
+  properties [PROP_PREFIX] =
+    g_param_spec_string ("prefix",
+                         "Prefix",
+                         "The prefix to store packs and indexes under.",
+                         "",
+                         G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties (object_class, N_PROPS, properties);
+}
+
+static void
+aws_s3_pack_writer_init (AwsS3PackWriter *self)
+{
+  self->max_pack_age = DEFAULT_MAX_PACK_AGE;
+  self->max_pack_size = DEFAULT_MAX_PACK_SIZE;
+  self->pack = g_byte_array_new ();
+  self->records = pack_records_new ();
+  self->cancellable = g_cancellable_new ();
+  g_mutex_init (&self->flush_mutex);
+  g_mutex_init (&self->mutex);
+  g_cond_init (&self->cond);
+}
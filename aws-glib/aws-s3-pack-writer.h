@@ -0,0 +1,53 @@
+/* aws-s3-pack-writer.h
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AWS_S3_PACK_WRITER_H
+#define AWS_S3_PACK_WRITER_H
+
+#include <gio/gio.h>
+
+#include "aws-s3-client.h"
+
+G_BEGIN_DECLS
+
+#define AWS_TYPE_S3_PACK_WRITER (aws_s3_pack_writer_get_type())
+
+G_DECLARE_FINAL_TYPE (AwsS3PackWriter, aws_s3_pack_writer, AWS, S3_PACK_WRITER, GObject)
+
+AwsS3PackWriter *aws_s3_pack_writer_new               (AwsS3Client     *client,
+                                                       const gchar     *bucket,
+                                                       const gchar     *prefix);
+gboolean         aws_s3_pack_writer_append_sync       (AwsS3PackWriter *self,
+                                                       const gchar     *name,
+                                                       gconstpointer    data,
+                                                       gsize            length,
+                                                       GCancellable    *cancellable,
+                                                       GError         **error);
+gboolean         aws_s3_pack_writer_flush_sync        (AwsS3PackWriter *self,
+                                                       GCancellable    *cancellable,
+                                                       GError         **error);
+guint            aws_s3_pack_writer_get_max_pack_age  (AwsS3PackWriter *self);
+guint64          aws_s3_pack_writer_get_max_pack_size (AwsS3PackWriter *self);
+void             aws_s3_pack_writer_set_max_pack_age  (AwsS3PackWriter *self,
+                                                       guint            max_pack_age);
+void             aws_s3_pack_writer_set_max_pack_size (AwsS3PackWriter *self,
+                                                       guint64          max_pack_size);
+
+G_END_DECLS
+
+#endif /* AWS_S3_PACK_WRITER_H */
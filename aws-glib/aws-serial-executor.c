@@ -0,0 +1,327 @@
+/* aws-serial-executor.c
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "aws-serial-executor.h"
+
+/*
+ * Runs jobs for a single stream on a shared thread pool, one at a time
+ * and in the order they were pushed, so that stateful transforms such as
+ * a decompressor never see their input reordered or touched from two
+ * threads at once. Each job's done function is then called on the
+ * executor's main context, again in push order, so results can be handed
+ * to code that expects to run there.
+ *
+ * Executors are queued on the pool rather than individual jobs, so one
+ * stream never occupies more than one worker and many streams share
+ * the pool fairly. Each executor holds a reference on its pool, so the
+ * pool's owner may drop it while streams are still being transformed.
+ */
+
+#define JOBS_PER_TURN 8
+
+struct _AwsSerialExecutorPool
+{
+  volatile gint  ref_count;
+  GThreadPool   *threads;
+};
+
+struct _AwsSerialExecutor
+{
+  volatile gint          ref_count;
+  AwsSerialExecutorPool *pool;
+  GMainContext  *context;
+  GMutex         mutex;
+  GQueue         work_queue;
+  GQueue         done_queue;
+  guint          pending;
+  guint          running : 1;
+  guint          dispatching : 1;
+};
+
+typedef struct
+{
+  AwsSerialExecutorFunc work;
+  AwsSerialExecutorFunc done;
+  gpointer              data;
+  GDestroyNotify        destroy;
+} Job;
+
+static void
+job_free (Job *job)
+{
+  if (job->destroy != NULL)
+    job->destroy (job->data);
+  g_slice_free (Job, job);
+}
+
+static gboolean
+aws_serial_executor_dispatch (gpointer user_data)
+{
+  AwsSerialExecutor *self = user_data;
+  GQueue done = G_QUEUE_INIT;
+  Job *job;
+
+  g_mutex_lock (&self->mutex);
+  done = self->done_queue;
+  g_queue_init (&self->done_queue);
+  self->dispatching = FALSE;
+  g_mutex_unlock (&self->mutex);
+
+  while ((job = g_queue_pop_head (&done)))
+    {
+      if (job->done != NULL)
+        job->done (job->data);
+
+      g_mutex_lock (&self->mutex);
+      self->pending--;
+      g_mutex_unlock (&self->mutex);
+
+      job_free (job);
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * Runs a few jobs from @data, which holds a reference taken when it was
+ * queued on the pool, and requeues it if more remain.
+ */
+static void
+aws_serial_executor_run (gpointer data,
+                         gpointer user_data)
+{
+  AwsSerialExecutor *self = data;
+  gboolean requeue;
+  guint i;
+
+  for (i = 0; i < JOBS_PER_TURN; i++)
+    {
+      Job *job;
+
+      g_mutex_lock (&self->mutex);
+      job = g_queue_pop_head (&self->work_queue);
+      if (job == NULL)
+        self->running = FALSE;
+      g_mutex_unlock (&self->mutex);
+
+      if (job == NULL)
+        {
+          aws_serial_executor_unref (self);
+          return;
+        }
+
+      job->work (job->data);
+
+      g_mutex_lock (&self->mutex);
+      g_queue_push_tail (&self->done_queue, job);
+      if (!self->dispatching)
+        {
+          /* Not g_main_context_invoke(), which may run it on this thread */
+          GSource *source = g_idle_source_new ();
+
+          self->dispatching = TRUE;
+          g_source_set_priority (source, G_PRIORITY_DEFAULT);
+          g_source_set_callback (source,
+                                 aws_serial_executor_dispatch,
+                                 aws_serial_executor_ref (self),
+                                 (GDestroyNotify)aws_serial_executor_unref);
+          g_source_attach (source, self->context);
+          g_source_unref (source);
+        }
+      g_mutex_unlock (&self->mutex);
+    }
+
+  /* Give other streams a turn, keeping our reference, if work remains */
+  g_mutex_lock (&self->mutex);
+  requeue = !g_queue_is_empty (&self->work_queue);
+  if (!requeue)
+    self->running = FALSE;
+  g_mutex_unlock (&self->mutex);
+
+  if (requeue)
+    g_thread_pool_push (self->pool->threads, self, NULL);
+  else
+    aws_serial_executor_unref (self);
+}
+
+/*
+ * Creates a pool for aws_serial_executor_new() to run jobs on.
+ */
+AwsSerialExecutorPool *
+aws_serial_executor_pool_new (guint    max_threads,
+                              GError **error)
+{
+  AwsSerialExecutorPool *self;
+  GThreadPool *threads;
+
+  g_return_val_if_fail (max_threads > 0, NULL);
+
+  if (!(threads = g_thread_pool_new (aws_serial_executor_run, NULL, max_threads, FALSE, error)))
+    return NULL;
+
+  self = g_slice_new0 (AwsSerialExecutorPool);
+  self->ref_count = 1;
+  self->threads = threads;
+
+  return self;
+}
+
+AwsSerialExecutorPool *
+aws_serial_executor_pool_ref (AwsSerialExecutorPool *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (self->ref_count > 0, NULL);
+
+  g_atomic_int_inc (&self->ref_count);
+
+  return self;
+}
+
+void
+aws_serial_executor_pool_unref (AwsSerialExecutorPool *self)
+{
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (self->ref_count > 0);
+
+  if (g_atomic_int_dec_and_test (&self->ref_count))
+    {
+      /*
+       * Every queued executor holds a reference, so nothing is queued. This
+       * may run on one of the pool's own threads, so don't wait for them.
+       */
+      g_thread_pool_free (self->threads, FALSE, FALSE);
+      g_slice_free (AwsSerialExecutorPool, self);
+    }
+}
+
+void
+aws_serial_executor_pool_set_max_threads (AwsSerialExecutorPool *self,
+                                          guint                  max_threads)
+{
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (max_threads > 0);
+
+  g_thread_pool_set_max_threads (self->threads, max_threads, NULL);
+}
+
+/*
+ * Creates an executor running jobs on @pool and calling their done
+ * functions on @context.
+ */
+AwsSerialExecutor *
+aws_serial_executor_new (AwsSerialExecutorPool *pool,
+                         GMainContext          *context)
+{
+  AwsSerialExecutor *self;
+
+  g_return_val_if_fail (pool != NULL, NULL);
+
+  self = g_slice_new0 (AwsSerialExecutor);
+  self->ref_count = 1;
+  self->pool = aws_serial_executor_pool_ref (pool);
+  self->context = context != NULL ? g_main_context_ref (context) : g_main_context_ref_thread_default ();
+  g_mutex_init (&self->mutex);
+  g_queue_init (&self->work_queue);
+  g_queue_init (&self->done_queue);
+
+  return self;
+}
+
+AwsSerialExecutor *
+aws_serial_executor_ref (AwsSerialExecutor *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (self->ref_count > 0, NULL);
+
+  g_atomic_int_inc (&self->ref_count);
+
+  return self;
+}
+
+void
+aws_serial_executor_unref (AwsSerialExecutor *self)
+{
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (self->ref_count > 0);
+
+  if (g_atomic_int_dec_and_test (&self->ref_count))
+    {
+      /* Queued work and dispatches hold references, so both queues are empty */
+      g_assert (g_queue_is_empty (&self->work_queue));
+      g_assert (g_queue_is_empty (&self->done_queue));
+
+      aws_serial_executor_pool_unref (self->pool);
+      g_main_context_unref (self->context);
+      g_mutex_clear (&self->mutex);
+      g_slice_free (AwsSerialExecutor, self);
+    }
+}
+
+/*
+ * Returns the number of jobs whose done function has not run yet.
+ */
+guint
+aws_serial_executor_get_pending (AwsSerialExecutor *self)
+{
+  guint pending;
+
+  g_return_val_if_fail (self != NULL, 0);
+
+  g_mutex_lock (&self->mutex);
+  pending = self->pending;
+  g_mutex_unlock (&self->mutex);
+
+  return pending;
+}
+
+/*
+ * Queues @work to run on the pool after every job pushed before it, and
+ * then @done to run on the executor's context. @destroy is called for
+ * @data once @done has returned.
+ */
+void
+aws_serial_executor_push (AwsSerialExecutor     *self,
+                          AwsSerialExecutorFunc  work,
+                          AwsSerialExecutorFunc  done,
+                          gpointer               data,
+                          GDestroyNotify         destroy)
+{
+  Job *job;
+  gboolean start;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (work != NULL);
+
+  job = g_slice_new0 (Job);
+  job->work = work;
+  job->done = done;
+  job->data = data;
+  job->destroy = destroy;
+
+  g_mutex_lock (&self->mutex);
+  g_queue_push_tail (&self->work_queue, job);
+  self->pending++;
+  start = !self->running;
+  self->running = TRUE;
+  g_mutex_unlock (&self->mutex);
+
+  if (start)
+    g_thread_pool_push (self->pool->threads, aws_serial_executor_ref (self), NULL);
+}
@@ -0,0 +1,53 @@
+/* aws-serial-executor.h
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AWS_SERIAL_EXECUTOR_H
+#define AWS_SERIAL_EXECUTOR_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _AwsSerialExecutor     AwsSerialExecutor;
+typedef struct _AwsSerialExecutorPool AwsSerialExecutorPool;
+
+typedef void (*AwsSerialExecutorFunc) (gpointer data);
+
+AwsSerialExecutorPool *aws_serial_executor_pool_new             (guint                   max_threads,
+                                                                 GError                **error);
+AwsSerialExecutorPool *aws_serial_executor_pool_ref             (AwsSerialExecutorPool  *self);
+void                   aws_serial_executor_pool_unref           (AwsSerialExecutorPool  *self);
+void                   aws_serial_executor_pool_set_max_threads (AwsSerialExecutorPool  *self,
+                                                                 guint                   max_threads);
+AwsSerialExecutor     *aws_serial_executor_new                  (AwsSerialExecutorPool  *pool,
+                                                                 GMainContext           *context);
+AwsSerialExecutor     *aws_serial_executor_ref                  (AwsSerialExecutor      *self);
+void                   aws_serial_executor_unref                (AwsSerialExecutor      *self);
+guint                  aws_serial_executor_get_pending          (AwsSerialExecutor      *self);
+void                   aws_serial_executor_push                 (AwsSerialExecutor      *self,
+                                                                 AwsSerialExecutorFunc   work,
+                                                                 AwsSerialExecutorFunc   done,
+                                                                 gpointer                data,
+                                                                 GDestroyNotify          destroy);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (AwsSerialExecutor, aws_serial_executor_unref)
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (AwsSerialExecutorPool, aws_serial_executor_pool_unref)
+
+G_END_DECLS
+
+#endif /* AWS_SERIAL_EXECUTOR_H */
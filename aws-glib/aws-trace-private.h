@@ -0,0 +1,179 @@
+/* aws-trace-private.h
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AWS_TRACE_PRIVATE_H
+#define AWS_TRACE_PRIVATE_H
+
+#include <libsoup/soup.h>
+
+#ifdef HAVE_SYS_SDT_H
+# define _SDT_HAS_SEMAPHORES 1
+# include <sys/sdt.h>
+#endif
+
+G_BEGIN_DECLS
+
+/*
+ * Tracepoints along the life of a request. Whenever sys/sdt.h is available
+ * they are compiled in as USDT probes in the "aws_glib" provider, each with
+ * a semaphore so that its arguments are only computed while a tracer is
+ * attached. With sysprof-capture available, completed and retried requests
+ * also emit sysprof marks while a collector is active.
+ *
+ * Every probe starts with the bucket and a hash of the key (g_str_hash),
+ * so requests can be correlated without copying keys out of the process:
+ *
+ *   request__queued  (bucket, key_hash, method)
+ *   request__send    (bucket, key_hash, wait_usec)
+ *   request__headers (bucket, key_hash, status, content_length)
+ *   request__chunk   (bucket, key_hash, length)
+ *   handler__enter   (bucket, key_hash, length)
+ *   handler__exit    (bucket, key_hash, length, proceed)
+ *   request__retry   (bucket, key_hash, status)
+ *   request__done    (bucket, key_hash, status, usec)
+ *
+ * request__send fires when libsoup starts writing the request, once it has
+ * a connection, with the time spent waiting since request__queued. Set
+ * against request__headers, it separates starvation of the connection
+ * pool from server latency.
+ *
+ * Synchronous requests hand the body to the caller as a stream, so for
+ * them request__done fires once the response headers are in.
+ */
+
+#ifdef HAVE_SYS_SDT_H
+
+# define AWS_TRACE_SEMAPHORE(name) aws_glib_##name##_semaphore
+
+# define AWS_PROBE3(name, a, b, c)    DTRACE_PROBE3 (aws_glib, name, a, b, c)
+# define AWS_PROBE4(name, a, b, c, d) DTRACE_PROBE4 (aws_glib, name, a, b, c, d)
+
+void aws_trace_watch_send (SoupMessage *message,
+                           const gchar *bucket,
+                           const gchar *path);
+
+# define AWS_TRACE_WATCH_SEND(message, bucket, path) aws_trace_watch_send (message, bucket, path)
+
+extern unsigned short AWS_TRACE_SEMAPHORE (request__queued);
+extern unsigned short AWS_TRACE_SEMAPHORE (request__send);
+extern unsigned short AWS_TRACE_SEMAPHORE (request__headers);
+extern unsigned short AWS_TRACE_SEMAPHORE (request__chunk);
+extern unsigned short AWS_TRACE_SEMAPHORE (handler__enter);
+extern unsigned short AWS_TRACE_SEMAPHORE (handler__exit);
+extern unsigned short AWS_TRACE_SEMAPHORE (request__retry);
+extern unsigned short AWS_TRACE_SEMAPHORE (request__done);
+
+# define aws_glib_request__queued_enabled()  G_UNLIKELY (AWS_TRACE_SEMAPHORE (request__queued))
+# define aws_glib_request__send_enabled()    G_UNLIKELY (AWS_TRACE_SEMAPHORE (request__send))
+# define aws_glib_request__headers_enabled() G_UNLIKELY (AWS_TRACE_SEMAPHORE (request__headers))
+# define aws_glib_request__chunk_enabled()   G_UNLIKELY (AWS_TRACE_SEMAPHORE (request__chunk))
+# define aws_glib_handler__enter_enabled()   G_UNLIKELY (AWS_TRACE_SEMAPHORE (handler__enter))
+# define aws_glib_handler__exit_enabled()    G_UNLIKELY (AWS_TRACE_SEMAPHORE (handler__exit))
+# define aws_glib_request__retry_enabled()   G_UNLIKELY (AWS_TRACE_SEMAPHORE (request__retry))
+# define aws_glib_request__done_enabled()    G_UNLIKELY (AWS_TRACE_SEMAPHORE (request__done))
+
+#else
+
+# define aws_glib_request__queued_enabled()  0
+# define aws_glib_request__send_enabled()    0
+# define aws_glib_request__headers_enabled() 0
+# define aws_glib_request__chunk_enabled()   0
+# define aws_glib_handler__enter_enabled()   0
+# define aws_glib_handler__exit_enabled()    0
+# define aws_glib_request__retry_enabled()   0
+# define aws_glib_request__done_enabled()    0
+
+# define AWS_PROBE3(name, a, b, c)    G_STMT_START { } G_STMT_END
+# define AWS_PROBE4(name, a, b, c, d) G_STMT_START { } G_STMT_END
+
+# define AWS_TRACE_WATCH_SEND(message, bucket, path) G_STMT_START { } G_STMT_END
+
+#endif
+
+#ifdef HAVE_SYSPROF
+
+void     aws_trace_mark      (SoupMessage *message,
+                              const gchar *bucket,
+                              const gchar *path,
+                              const gchar *name,
+                              gint64       begin_time);
+gboolean aws_trace_is_active (void);
+
+# define AWS_TRACE_MARK(message, bucket, path, name, begin_time) \
+  G_STMT_START { \
+    if (aws_trace_is_active ()) \
+      aws_trace_mark (message, bucket, path, name, begin_time); \
+  } G_STMT_END
+
+#else
+
+# define AWS_TRACE_MARK(message, bucket, path, name, begin_time) G_STMT_START { } G_STMT_END
+
+#endif
+
+#define AWS_PROBE_REQUEST_QUEUED(message, bucket, path) \
+  G_STMT_START { \
+    if (aws_glib_request__queued_enabled ()) \
+      AWS_PROBE3 (request__queued, bucket, g_str_hash (path), (message)->method); \
+    if (aws_glib_request__send_enabled ()) \
+      AWS_TRACE_WATCH_SEND (message, bucket, path); \
+  } G_STMT_END
+
+#define AWS_PROBE_REQUEST_HEADERS(message, bucket, path) \
+  G_STMT_START { \
+    if (aws_glib_request__headers_enabled ()) \
+      AWS_PROBE4 (request__headers, bucket, g_str_hash (path), (message)->status_code, \
+                  soup_message_headers_get_content_length ((message)->response_headers)); \
+  } G_STMT_END
+
+#define AWS_PROBE_REQUEST_CHUNK(bucket, path, length) \
+  G_STMT_START { \
+    if (aws_glib_request__chunk_enabled ()) \
+      AWS_PROBE3 (request__chunk, bucket, g_str_hash (path), length); \
+  } G_STMT_END
+
+#define AWS_PROBE_HANDLER_ENTER(bucket, path, length) \
+  G_STMT_START { \
+    if (aws_glib_handler__enter_enabled ()) \
+      AWS_PROBE3 (handler__enter, bucket, g_str_hash (path), length); \
+  } G_STMT_END
+
+#define AWS_PROBE_HANDLER_EXIT(bucket, path, length, proceed) \
+  G_STMT_START { \
+    if (aws_glib_handler__exit_enabled ()) \
+      AWS_PROBE4 (handler__exit, bucket, g_str_hash (path), length, proceed); \
+  } G_STMT_END
+
+#define AWS_PROBE_REQUEST_RETRY(message, bucket, path, begin_time) \
+  G_STMT_START { \
+    if (aws_glib_request__retry_enabled ()) \
+      AWS_PROBE3 (request__retry, bucket, g_str_hash (path), (message)->status_code); \
+    AWS_TRACE_MARK (message, bucket, path, "retry", begin_time); \
+  } G_STMT_END
+
+#define AWS_PROBE_REQUEST_DONE(message, bucket, path, begin_time) \
+  G_STMT_START { \
+    if (aws_glib_request__done_enabled ()) \
+      AWS_PROBE4 (request__done, bucket, g_str_hash (path), (message)->status_code, \
+                  g_get_monotonic_time () - (begin_time)); \
+    AWS_TRACE_MARK (message, bucket, path, "request", begin_time); \
+  } G_STMT_END
+
+G_END_DECLS
+
+#endif /* AWS_TRACE_PRIVATE_H */
@@ -0,0 +1,132 @@
+/* aws-trace.c
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#ifdef HAVE_SYSPROF
+# include <sysprof-capture.h>
+#endif
+
+#include "aws-trace-private.h"
+
+#ifdef HAVE_SYS_SDT_H
+/*
+ * Tracers attaching to a probe increment its semaphore, which is how the
+ * call sites know to compute the probe's arguments.
+ */
+# define AWS_TRACE_DEFINE_SEMAPHORE(name) \
+  __extension__ unsigned short AWS_TRACE_SEMAPHORE (name) \
+    __attribute__ ((section (".probes")))
+
+AWS_TRACE_DEFINE_SEMAPHORE (request__queued);
+AWS_TRACE_DEFINE_SEMAPHORE (request__send);
+AWS_TRACE_DEFINE_SEMAPHORE (request__headers);
+AWS_TRACE_DEFINE_SEMAPHORE (request__chunk);
+AWS_TRACE_DEFINE_SEMAPHORE (handler__enter);
+AWS_TRACE_DEFINE_SEMAPHORE (handler__exit);
+AWS_TRACE_DEFINE_SEMAPHORE (request__retry);
+AWS_TRACE_DEFINE_SEMAPHORE (request__done);
+
+typedef struct
+{
+  gchar  *bucket;
+  guint   key_hash;
+  gint64  queued_at;
+} SendWatch;
+
+static void
+send_watch_free (gpointer  data,
+                 GClosure *closure)
+{
+  SendWatch *watch = data;
+
+  g_free (watch->bucket);
+  g_slice_free (SendWatch, watch);
+}
+
+static void
+aws_trace_starting_cb (SoupMessage *message,
+                       gpointer     user_data)
+{
+  SendWatch *watch = user_data;
+
+  if (aws_glib_request__send_enabled ())
+    AWS_PROBE3 (request__send,
+                watch->bucket,
+                watch->key_hash,
+                g_get_monotonic_time () - watch->queued_at);
+}
+
+/*
+ * Fires request__send once libsoup starts on @message. Only called while
+ * a tracer is attached to the probe, so untraced requests pay nothing for
+ * the handler.
+ */
+void
+aws_trace_watch_send (SoupMessage *message,
+                      const gchar *bucket,
+                      const gchar *path)
+{
+  SendWatch *watch;
+
+  g_return_if_fail (SOUP_IS_MESSAGE (message));
+
+  watch = g_slice_new0 (SendWatch);
+  watch->bucket = g_strdup (bucket);
+  watch->key_hash = g_str_hash (path);
+  watch->queued_at = g_get_monotonic_time ();
+
+  g_signal_connect_data (message,
+                         "starting",
+                         G_CALLBACK (aws_trace_starting_cb),
+                         watch,
+                         send_watch_free,
+                         0);
+}
+#endif
+
+#ifdef HAVE_SYSPROF
+gboolean
+aws_trace_is_active (void)
+{
+  return sysprof_collector_is_active ();
+}
+
+void
+aws_trace_mark (SoupMessage *message,
+                const gchar *bucket,
+                const gchar *path,
+                const gchar *name,
+                gint64       begin_time)
+{
+  gint64 duration = g_get_monotonic_time () - begin_time;
+
+  g_return_if_fail (SOUP_IS_MESSAGE (message));
+
+  /* g_get_monotonic_time() and sysprof share CLOCK_MONOTONIC */
+  sysprof_collector_mark_printf (begin_time * 1000,
+                                 duration * 1000,
+                                 "aws-glib",
+                                 name,
+                                 "%s s3://%s/%s status=%u",
+                                 message->method,
+                                 bucket,
+                                 path,
+                                 message->status_code);
+}
+#endif
@@ -0,0 +1,81 @@
+/* aws-varint.h
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AWS_VARINT_H
+#define AWS_VARINT_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Unsigned LEB128 integers: seven bits per byte, least significant group
+ * first, with the high bit set on every byte but the last.
+ */
+
+static inline void
+aws_varint_append (GByteArray *array,
+                   guint64     value)
+{
+  guint8 buf [10];
+  guint len = 0;
+
+  while (value >= 0x80)
+    {
+      buf [len++] = (value & 0x7F) | 0x80;
+      value >>= 7;
+    }
+
+  buf [len++] = value;
+
+  g_byte_array_append (array, buf, len);
+}
+
+/*
+ * Decodes a varint at *@data, advancing it past the value. Fails without
+ * touching *@data if the value is truncated by @end or too long.
+ */
+static inline gboolean
+aws_varint_read (const guint8 **data,
+                 const guint8  *end,
+                 guint64       *value)
+{
+  const guint8 *p = *data;
+  guint64 result = 0;
+  guint shift;
+
+  for (shift = 0; shift < 64 && p < end; shift += 7)
+    {
+      guint8 byte = *p++;
+
+      result |= (guint64)(byte & 0x7F) << shift;
+
+      if ((byte & 0x80) == 0)
+        {
+          *value = result;
+          *data = p;
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+G_END_DECLS
+
+#endif /* AWS_VARINT_H */
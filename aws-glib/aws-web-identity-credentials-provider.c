@@ -0,0 +1,385 @@
+/* aws-web-identity-credentials-provider.c
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <libsoup/soup.h>
+#include <string.h>
+
+#include "aws-credentials-provider-private.h"
+#include "aws-web-identity-credentials-provider.h"
+
+/*
+ * Exchanges the OIDC token found in AWS_WEB_IDENTITY_TOKEN_FILE for
+ * temporary credentials of AWS_ROLE_ARN using AssumeRoleWithWebIdentity,
+ * as set up for Kubernetes service accounts.
+ */
+
+#define DEFAULT_ENDPOINT "https://sts.amazonaws.com/"
+
+struct _AwsWebIdentityCredentialsProvider
+{
+  AwsCredentialsProvider  parent_instance;
+
+  SoupSession            *session;
+  gchar                  *endpoint;
+};
+
+typedef struct
+{
+  gchar *endpoint;
+  gchar *role_arn;
+  gchar *token_file;
+  gchar *session_name;
+} LoadState;
+
+typedef struct
+{
+  gchar *access_key;
+  gchar *secret_key;
+  gchar *session_token;
+  gchar *expiration;
+} StsCredentials;
+
+G_DEFINE_TYPE (AwsWebIdentityCredentialsProvider, aws_web_identity_credentials_provider, AWS_TYPE_CREDENTIALS_PROVIDER)
+
+enum {
+  PROP_0,
+  PROP_ENDPOINT,
+  N_PROPS
+};
+
+static GParamSpec *properties [N_PROPS];
+
+static void
+load_state_free (gpointer data)
+{
+  LoadState *state = data;
+
+  if (state != NULL)
+    {
+      g_free (state->endpoint);
+      g_free (state->role_arn);
+      g_free (state->token_file);
+      g_free (state->session_name);
+      g_slice_free (LoadState, state);
+    }
+}
+
+static void
+sts_credentials_clear (StsCredentials *creds)
+{
+  g_clear_pointer (&creds->access_key, g_free);
+  g_clear_pointer (&creds->secret_key, g_free);
+  g_clear_pointer (&creds->session_token, g_free);
+  g_clear_pointer (&creds->expiration, g_free);
+}
+
+AwsCredentialsProvider *
+aws_web_identity_credentials_provider_new (void)
+{
+  return g_object_new (AWS_TYPE_WEB_IDENTITY_CREDENTIALS_PROVIDER, NULL);
+}
+
+const gchar *
+aws_web_identity_credentials_provider_get_endpoint (AwsWebIdentityCredentialsProvider *self)
+{
+  g_return_val_if_fail (AWS_IS_WEB_IDENTITY_CREDENTIALS_PROVIDER (self), NULL);
+
+  return self->endpoint;
+}
+
+/**
+ * aws_web_identity_credentials_provider_set_endpoint:
+ * @self: An #AwsWebIdentityCredentialsProvider.
+ * @endpoint: (nullable): The URI of the STS endpoint.
+ *
+ * Sets the STS endpoint to use. If %NULL, AWS_ENDPOINT_URL_STS is used
+ * when set, otherwise the global STS endpoint.
+ */
+void
+aws_web_identity_credentials_provider_set_endpoint (AwsWebIdentityCredentialsProvider *self,
+                                                    const gchar                       *endpoint)
+{
+  g_return_if_fail (AWS_IS_WEB_IDENTITY_CREDENTIALS_PROVIDER (self));
+
+  if (endpoint == NULL && !(endpoint = g_getenv ("AWS_ENDPOINT_URL_STS")))
+    endpoint = DEFAULT_ENDPOINT;
+
+  if (g_strcmp0 (self->endpoint, endpoint) != 0)
+    {
+      g_free (self->endpoint);
+      self->endpoint = g_strdup (endpoint);
+      g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_ENDPOINT]);
+    }
+}
+
+static void
+sts_response_text (GMarkupParseContext  *context,
+                   const gchar          *text,
+                   gsize                 text_len,
+                   gpointer              user_data,
+                   GError              **error)
+{
+  StsCredentials *creds = user_data;
+  const gchar *element = g_markup_parse_context_get_element (context);
+  gchar **target = NULL;
+
+  if (g_strcmp0 (element, "AccessKeyId") == 0)
+    target = &creds->access_key;
+  else if (g_strcmp0 (element, "SecretAccessKey") == 0)
+    target = &creds->secret_key;
+  else if (g_strcmp0 (element, "SessionToken") == 0)
+    target = &creds->session_token;
+  else if (g_strcmp0 (element, "Expiration") == 0)
+    target = &creds->expiration;
+
+  if (target != NULL)
+    {
+      g_free (*target);
+      *target = g_strndup (text, text_len);
+    }
+}
+
+static const GMarkupParser sts_response_parser = {
+  NULL,
+  NULL,
+  sts_response_text,
+  NULL,
+  NULL,
+};
+
+static void
+aws_web_identity_credentials_provider_load_worker (GTask        *task,
+                                                   gpointer      source_object,
+                                                   gpointer      task_data,
+                                                   GCancellable *cancellable)
+{
+  AwsWebIdentityCredentialsProvider *self = source_object;
+  LoadState *state = task_data;
+  g_autoptr(GMarkupParseContext) context = NULL;
+  g_autoptr(SoupMessage) message = NULL;
+  g_autofree gchar *token = NULL;
+  StsCredentials creds = { 0 };
+  GError *error = NULL;
+  guint status;
+
+  g_assert (AWS_IS_WEB_IDENTITY_CREDENTIALS_PROVIDER (self));
+  g_assert (state != NULL);
+
+  if (state->role_arn == NULL || state->token_file == NULL)
+    {
+      g_task_return_new_error (task,
+                               AWS_CREDENTIALS_PROVIDER_ERROR,
+                               AWS_CREDENTIALS_PROVIDER_ERROR_UNAVAILABLE,
+                               "AWS_ROLE_ARN and AWS_WEB_IDENTITY_TOKEN_FILE are not set");
+      return;
+    }
+
+  if (!g_file_get_contents (state->token_file, &token, NULL, &error))
+    {
+      g_task_return_new_error (task,
+                               AWS_CREDENTIALS_PROVIDER_ERROR,
+                               AWS_CREDENTIALS_PROVIDER_ERROR_UNAVAILABLE,
+                               "Failed to read web identity token: %s",
+                               error->message);
+      g_clear_error (&error);
+      return;
+    }
+
+  message = soup_form_request_new (SOUP_METHOD_POST,
+                                   state->endpoint,
+                                   "Action", "AssumeRoleWithWebIdentity",
+                                   "Version", "2011-06-15",
+                                   "RoleArn", state->role_arn,
+                                   "RoleSessionName", state->session_name,
+                                   "WebIdentityToken", g_strstrip (token),
+                                   NULL);
+
+  if (message == NULL)
+    {
+      g_task_return_new_error (task,
+                               AWS_CREDENTIALS_PROVIDER_ERROR,
+                               AWS_CREDENTIALS_PROVIDER_ERROR_FAILED,
+                               "Invalid STS endpoint \"%s\"",
+                               state->endpoint);
+      return;
+    }
+
+  status = soup_session_send_message (self->session, message);
+
+  if (!SOUP_STATUS_IS_SUCCESSFUL (status))
+    {
+      g_task_return_new_error (task,
+                               AWS_CREDENTIALS_PROVIDER_ERROR,
+                               AWS_CREDENTIALS_PROVIDER_ERROR_FAILED,
+                               "AssumeRoleWithWebIdentity failed: %u",
+                               status);
+      return;
+    }
+
+  context = g_markup_parse_context_new (&sts_response_parser, 0, &creds, NULL);
+
+  if (!g_markup_parse_context_parse (context,
+                                     message->response_body->data,
+                                     message->response_body->length,
+                                     &error) ||
+      !g_markup_parse_context_end_parse (context, &error))
+    {
+      g_task_return_new_error (task,
+                               AWS_CREDENTIALS_PROVIDER_ERROR,
+                               AWS_CREDENTIALS_PROVIDER_ERROR_INVALID,
+                               "Invalid STS response: %s",
+                               error->message);
+      g_clear_error (&error);
+      sts_credentials_clear (&creds);
+      return;
+    }
+
+  if (creds.access_key == NULL || creds.secret_key == NULL || creds.session_token == NULL)
+    g_task_return_new_error (task,
+                             AWS_CREDENTIALS_PROVIDER_ERROR,
+                             AWS_CREDENTIALS_PROVIDER_ERROR_INVALID,
+                             "STS response did not contain credentials");
+  else
+    g_task_return_pointer (task,
+                           aws_credentials_new_full (creds.access_key,
+                                                     creds.secret_key,
+                                                     creds.session_token,
+                                                     aws_credentials_provider_parse_expiration (creds.expiration)),
+                           g_object_unref);
+
+  sts_credentials_clear (&creds);
+}
+
+static void
+aws_web_identity_credentials_provider_load_async (AwsCredentialsProvider *provider,
+                                                  GCancellable           *cancellable,
+                                                  GAsyncReadyCallback     callback,
+                                                  gpointer                user_data)
+{
+  AwsWebIdentityCredentialsProvider *self = (AwsWebIdentityCredentialsProvider *)provider;
+  g_autoptr(GTask) task = NULL;
+  const gchar *session_name;
+  LoadState *state;
+
+  g_assert (AWS_IS_WEB_IDENTITY_CREDENTIALS_PROVIDER (self));
+
+  state = g_slice_new0 (LoadState);
+  state->endpoint = g_strdup (self->endpoint);
+  state->role_arn = g_strdup (g_getenv ("AWS_ROLE_ARN"));
+  state->token_file = g_strdup (g_getenv ("AWS_WEB_IDENTITY_TOKEN_FILE"));
+
+  if ((session_name = g_getenv ("AWS_ROLE_SESSION_NAME")) && *session_name)
+    state->session_name = g_strdup (session_name);
+  else
+    state->session_name = g_strdup_printf ("aws-glib-%"G_GINT64_FORMAT,
+                                           g_get_real_time () / G_USEC_PER_SEC);
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, aws_web_identity_credentials_provider_load_async);
+  g_task_set_task_data (task, state, load_state_free);
+  g_task_run_in_thread (task, aws_web_identity_credentials_provider_load_worker);
+}
+
+static AwsCredentials *
+aws_web_identity_credentials_provider_load_finish (AwsCredentialsProvider  *provider,
+                                                   GAsyncResult            *result,
+                                                   GError                 **error)
+{
+  g_assert (AWS_IS_WEB_IDENTITY_CREDENTIALS_PROVIDER (provider));
+  g_assert (G_IS_TASK (result));
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+static void
+aws_web_identity_credentials_provider_finalize (GObject *object)
+{
+  AwsWebIdentityCredentialsProvider *self = (AwsWebIdentityCredentialsProvider *)object;
+
+  g_clear_object (&self->session);
+  g_clear_pointer (&self->endpoint, g_free);
+
+  G_OBJECT_CLASS (aws_web_identity_credentials_provider_parent_class)->finalize (object);
+}
+
+static void
+aws_web_identity_credentials_provider_get_property (GObject    *object,
+                                                    guint       prop_id,
+                                                    GValue     *value,
+                                                    GParamSpec *pspec)
+{
+  AwsWebIdentityCredentialsProvider *self = AWS_WEB_IDENTITY_CREDENTIALS_PROVIDER (object);
+
+  switch (prop_id)
+    {
+    case PROP_ENDPOINT:
+      g_value_set_string (value, aws_web_identity_credentials_provider_get_endpoint (self));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+aws_web_identity_credentials_provider_set_property (GObject      *object,
+                                                    guint         prop_id,
+                                                    const GValue *value,
+                                                    GParamSpec   *pspec)
+{
+  AwsWebIdentityCredentialsProvider *self = AWS_WEB_IDENTITY_CREDENTIALS_PROVIDER (object);
+
+  switch (prop_id)
+    {
+    case PROP_ENDPOINT:
+      aws_web_identity_credentials_provider_set_endpoint (self, g_value_get_string (value));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+aws_web_identity_credentials_provider_class_init (AwsWebIdentityCredentialsProviderClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  AwsCredentialsProviderClass *provider_class = AWS_CREDENTIALS_PROVIDER_CLASS (klass);
+
+  object_class->finalize = aws_web_identity_credentials_provider_finalize;
+  object_class->get_property = aws_web_identity_credentials_provider_get_property;
+  object_class->set_property = aws_web_identity_credentials_provider_set_property;
+
+  provider_class->load_async = aws_web_identity_credentials_provider_load_async;
+  provider_class->load_finish = aws_web_identity_credentials_provider_load_finish;
+
+  properties [PROP_ENDPOINT] =
+    g_param_spec_string ("endpoint",
+                         "Endpoint",
+                         "The URI of the STS endpoint.",
+                         NULL,
+                         G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties (object_class, N_PROPS, properties);
+}
+
+static void
+aws_web_identity_credentials_provider_init (AwsWebIdentityCredentialsProvider *self)
+{
+  self->session = soup_session_new_with_options (SOUP_SESSION_TIMEOUT, 10, NULL);
+}
@@ -0,0 +1,37 @@
+/* aws-web-identity-credentials-provider.h
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AWS_WEB_IDENTITY_CREDENTIALS_PROVIDER_H
+#define AWS_WEB_IDENTITY_CREDENTIALS_PROVIDER_H
+
+#include "aws-credentials-provider.h"
+
+G_BEGIN_DECLS
+
+#define AWS_TYPE_WEB_IDENTITY_CREDENTIALS_PROVIDER (aws_web_identity_credentials_provider_get_type())
+
+G_DECLARE_FINAL_TYPE (AwsWebIdentityCredentialsProvider, aws_web_identity_credentials_provider, AWS, WEB_IDENTITY_CREDENTIALS_PROVIDER, AwsCredentialsProvider)
+
+AwsCredentialsProvider *aws_web_identity_credentials_provider_new          (void);
+const gchar            *aws_web_identity_credentials_provider_get_endpoint (AwsWebIdentityCredentialsProvider *self);
+void                    aws_web_identity_credentials_provider_set_endpoint (AwsWebIdentityCredentialsProvider *self,
+                                                                            const gchar                       *endpoint);
+
+G_END_DECLS
+
+#endif /* AWS_WEB_IDENTITY_CREDENTIALS_PROVIDER_H */
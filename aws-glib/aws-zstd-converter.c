@@ -0,0 +1,292 @@
+/* aws-zstd-converter.c
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <zstd.h>
+
+#include "aws-zstd-converter.h"
+
+struct _AwsZstdConverter
+{
+  GObject    parent_instance;
+
+  ZSTD_CCtx *cctx;
+  ZSTD_DCtx *dctx;
+
+  guint      compress : 1;
+  guint      in_frame : 1;
+};
+
+static void converter_iface_init (GConverterIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (AwsZstdConverter, aws_zstd_converter, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (G_TYPE_CONVERTER, converter_iface_init))
+
+enum {
+  PROP_0,
+  PROP_COMPRESS,
+  N_PROPS
+};
+
+static GParamSpec *properties [N_PROPS];
+
+AwsZstdConverter *
+aws_zstd_converter_new (gboolean compress)
+{
+  return g_object_new (AWS_TYPE_ZSTD_CONVERTER,
+                       "compress", compress,
+                       NULL);
+}
+
+static GConverterResult
+aws_zstd_converter_compress (AwsZstdConverter  *self,
+                             ZSTD_inBuffer     *in,
+                             ZSTD_outBuffer    *out,
+                             GConverterFlags    flags,
+                             GError           **error)
+{
+  ZSTD_EndDirective directive = ZSTD_e_continue;
+  gsize ret;
+
+  if (flags & G_CONVERTER_INPUT_AT_END)
+    directive = ZSTD_e_end;
+  else if (flags & G_CONVERTER_FLUSH)
+    directive = ZSTD_e_flush;
+
+  ret = ZSTD_compressStream2 (self->cctx, out, in, directive);
+
+  if (ZSTD_isError (ret))
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_FAILED,
+                   "zstd compression failed: %s",
+                   ZSTD_getErrorName (ret));
+      return G_CONVERTER_ERROR;
+    }
+
+  /* ret is the number of bytes still to be flushed for end/flush */
+  if (directive == ZSTD_e_end && ret == 0)
+    return G_CONVERTER_FINISHED;
+
+  if (directive == ZSTD_e_flush && ret == 0)
+    return G_CONVERTER_FLUSHED;
+
+  if (in->pos == 0 && out->pos == 0)
+    {
+      if (directive == ZSTD_e_continue && in->size == 0)
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT, "Need more input");
+      else
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE, "Need more output space");
+      return G_CONVERTER_ERROR;
+    }
+
+  return G_CONVERTER_CONVERTED;
+}
+
+static GConverterResult
+aws_zstd_converter_decompress (AwsZstdConverter  *self,
+                               ZSTD_inBuffer     *in,
+                               ZSTD_outBuffer    *out,
+                               GConverterFlags    flags,
+                               GError           **error)
+{
+  gsize ret;
+
+  ret = ZSTD_decompressStream (self->dctx, out, in);
+
+  if (ZSTD_isError (ret))
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVALID_DATA,
+                   "Invalid zstd data: %s",
+                   ZSTD_getErrorName (ret));
+      return G_CONVERTER_ERROR;
+    }
+
+  /*
+   * A return of 0 means the current frame has been decoded and flushed
+   * in full. Anything else means we're part way through a frame, which
+   * may simply be another frame concatenated to the previous one.
+   */
+  if (ret == 0)
+    self->in_frame = FALSE;
+  else if (in->pos > 0 || out->pos > 0)
+    self->in_frame = TRUE;
+
+  if (!self->in_frame && in->pos == in->size)
+    {
+      if (flags & G_CONVERTER_INPUT_AT_END)
+        return G_CONVERTER_FINISHED;
+
+      if (flags & G_CONVERTER_FLUSH)
+        return G_CONVERTER_FLUSHED;
+    }
+
+  if (in->pos == 0 && out->pos == 0)
+    {
+      if (in->size > 0)
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE, "Need more output space");
+      else if (flags & G_CONVERTER_INPUT_AT_END)
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT, "Truncated zstd stream");
+      else
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT, "Need more input");
+      return G_CONVERTER_ERROR;
+    }
+
+  return G_CONVERTER_CONVERTED;
+}
+
+static GConverterResult
+aws_zstd_converter_convert (GConverter       *converter,
+                            const void       *inbuf,
+                            gsize             inbuf_size,
+                            void             *outbuf,
+                            gsize             outbuf_size,
+                            GConverterFlags   flags,
+                            gsize            *bytes_read,
+                            gsize            *bytes_written,
+                            GError          **error)
+{
+  AwsZstdConverter *self = (AwsZstdConverter *)converter;
+  ZSTD_inBuffer in = { inbuf, inbuf_size, 0 };
+  ZSTD_outBuffer out = { outbuf, outbuf_size, 0 };
+  GConverterResult res;
+
+  g_assert (AWS_IS_ZSTD_CONVERTER (self));
+
+  if (self->compress)
+    res = aws_zstd_converter_compress (self, &in, &out, flags, error);
+  else
+    res = aws_zstd_converter_decompress (self, &in, &out, flags, error);
+
+  *bytes_read = in.pos;
+  *bytes_written = out.pos;
+
+  return res;
+}
+
+static void
+aws_zstd_converter_reset (GConverter *converter)
+{
+  AwsZstdConverter *self = (AwsZstdConverter *)converter;
+
+  g_assert (AWS_IS_ZSTD_CONVERTER (self));
+
+  if (self->cctx != NULL)
+    ZSTD_CCtx_reset (self->cctx, ZSTD_reset_session_only);
+
+  if (self->dctx != NULL)
+    ZSTD_DCtx_reset (self->dctx, ZSTD_reset_session_only);
+
+  self->in_frame = FALSE;
+}
+
+static void
+converter_iface_init (GConverterIface *iface)
+{
+  iface->convert = aws_zstd_converter_convert;
+  iface->reset = aws_zstd_converter_reset;
+}
+
+static void
+aws_zstd_converter_constructed (GObject *object)
+{
+  AwsZstdConverter *self = (AwsZstdConverter *)object;
+
+  G_OBJECT_CLASS (aws_zstd_converter_parent_class)->constructed (object);
+
+  if (self->compress)
+    self->cctx = ZSTD_createCCtx ();
+  else
+    self->dctx = ZSTD_createDCtx ();
+}
+
+static void
+aws_zstd_converter_finalize (GObject *object)
+{
+  AwsZstdConverter *self = (AwsZstdConverter *)object;
+
+  g_clear_pointer (&self->cctx, ZSTD_freeCCtx);
+  g_clear_pointer (&self->dctx, ZSTD_freeDCtx);
+
+  G_OBJECT_CLASS (aws_zstd_converter_parent_class)->finalize (object);
+}
+
+static void
+aws_zstd_converter_get_property (GObject    *object,
+                                 guint       prop_id,
+                                 GValue     *value,
+                                 GParamSpec *pspec)
+{
+  AwsZstdConverter *self = AWS_ZSTD_CONVERTER (object);
+
+  switch (prop_id)
+    {
+    case PROP_COMPRESS:
+      g_value_set_boolean (value, self->compress);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    }
+}
+
+static void
+aws_zstd_converter_set_property (GObject      *object,
+                                 guint         prop_id,
+                                 const GValue *value,
+                                 GParamSpec   *pspec)
+{
+  AwsZstdConverter *self = AWS_ZSTD_CONVERTER (object);
+
+  switch (prop_id)
+    {
+    case PROP_COMPRESS:
+      self->compress = g_value_get_boolean (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    }
+}
+
+static void
+aws_zstd_converter_class_init (AwsZstdConverterClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->constructed = aws_zstd_converter_constructed;
+  object_class->finalize = aws_zstd_converter_finalize;
+  object_class->get_property = aws_zstd_converter_get_property;
+  object_class->set_property = aws_zstd_converter_set_property;
+
+  properties [PROP_COMPRESS] =
+    g_param_spec_boolean ("compress",
+                          "Compress",
+                          "If the converter compresses rather than decompresses.",
+                          FALSE,
+                          G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties (object_class, N_PROPS, properties);
+}
+
+static void
+aws_zstd_converter_init (AwsZstdConverter *self)
+{
+}
@@ -0,0 +1,34 @@
+/* aws-zstd-converter.h
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AWS_ZSTD_CONVERTER_H
+#define AWS_ZSTD_CONVERTER_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define AWS_TYPE_ZSTD_CONVERTER (aws_zstd_converter_get_type())
+
+G_DECLARE_FINAL_TYPE (AwsZstdConverter, aws_zstd_converter, AWS, ZSTD_CONVERTER, GObject)
+
+AwsZstdConverter *aws_zstd_converter_new (gboolean compress);
+
+G_END_DECLS
+
+#endif /* AWS_ZSTD_CONVERTER_H */
@@ -0,0 +1,381 @@
+/* test-credentials-provider.c
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib/gstdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "aws-glib.h"
+
+#define ACCESS_KEY    "ASIATESTACCESSKEY"
+#define SECRET_KEY    "test-secret-key"
+#define SESSION_TOKEN "test-session-token"
+#define IMDS_TOKEN    "test-imds-token"
+#define ROLE_NAME     "test-role"
+#define ROLE_ARN      "arn:aws:iam::123456789012:role/test-role"
+#define WEB_TOKEN     "test-web-identity-token"
+
+/*
+ * A stand-in for the metadata service and STS. It runs on a thread of its
+ * own, so that it keeps serving while the test thread blocks on a load.
+ */
+typedef struct
+{
+  GThread   *thread;
+  GMainLoop *main_loop;
+  GMutex     mutex;
+  GCond      cond;
+  guint      port;
+  guint      n_requests;
+} StandIn;
+
+static gchar *
+format_expiration (void)
+{
+  g_autoptr(GDateTime) now = g_date_time_new_now_utc ();
+  g_autoptr(GDateTime) expiration = g_date_time_add_hours (now, 1);
+
+  return g_date_time_format (expiration, "%Y-%m-%dT%H:%M:%SZ");
+}
+
+static void
+metadata_cb (SoupServer        *server,
+             SoupMessage       *message,
+             const char        *path,
+             GHashTable        *query,
+             SoupClientContext *client,
+             gpointer           user_data)
+{
+  StandIn *stand_in = user_data;
+  const gchar *token;
+
+  g_mutex_lock (&stand_in->mutex);
+  stand_in->n_requests++;
+  g_mutex_unlock (&stand_in->mutex);
+
+  if (g_strcmp0 (path, "/latest/api/token") == 0)
+    {
+      g_assert_cmpstr (message->method, ==, SOUP_METHOD_PUT);
+      g_assert_nonnull (soup_message_headers_get_one (message->request_headers,
+                                                      "X-aws-ec2-metadata-token-ttl-seconds"));
+      soup_message_set_status (message, SOUP_STATUS_OK);
+      soup_message_set_response (message, "text/plain", SOUP_MEMORY_STATIC,
+                                 IMDS_TOKEN, strlen (IMDS_TOKEN));
+      return;
+    }
+
+  token = soup_message_headers_get_one (message->request_headers, "X-aws-ec2-metadata-token");
+  g_assert_cmpstr (token, ==, IMDS_TOKEN);
+
+  if (g_strcmp0 (path, "/latest/meta-data/iam/security-credentials/") == 0)
+    {
+      soup_message_set_status (message, SOUP_STATUS_OK);
+      soup_message_set_response (message, "text/plain", SOUP_MEMORY_STATIC,
+                                 ROLE_NAME "\n", strlen (ROLE_NAME "\n"));
+    }
+  else if (g_strcmp0 (path, "/latest/meta-data/iam/security-credentials/" ROLE_NAME) == 0)
+    {
+      g_autofree gchar *expiration = format_expiration ();
+      gchar *json;
+
+      json = g_strdup_printf ("{\"Code\":\"Success\","
+                              "\"AccessKeyId\":\"" ACCESS_KEY "\","
+                              "\"SecretAccessKey\":\"" SECRET_KEY "\","
+                              "\"Token\":\"" SESSION_TOKEN "\","
+                              "\"Expiration\":\"%s\"}",
+                              expiration);
+      soup_message_set_status (message, SOUP_STATUS_OK);
+      soup_message_set_response (message, "application/json", SOUP_MEMORY_TAKE,
+                                 json, strlen (json));
+    }
+  else
+    {
+      soup_message_set_status (message, SOUP_STATUS_NOT_FOUND);
+    }
+}
+
+static void
+sts_cb (SoupServer        *server,
+        SoupMessage       *message,
+        const char        *path,
+        GHashTable        *query,
+        SoupClientContext *client,
+        gpointer           user_data)
+{
+  StandIn *stand_in = user_data;
+  g_autoptr(GHashTable) form = NULL;
+  g_autofree gchar *body = NULL;
+  g_autofree gchar *expiration = NULL;
+  gchar *xml;
+
+  g_mutex_lock (&stand_in->mutex);
+  stand_in->n_requests++;
+  g_mutex_unlock (&stand_in->mutex);
+
+  g_assert_cmpstr (message->method, ==, SOUP_METHOD_POST);
+
+  body = g_strndup (message->request_body->data, message->request_body->length);
+  form = soup_form_decode (body);
+
+  g_assert_cmpstr (g_hash_table_lookup (form, "Action"), ==, "AssumeRoleWithWebIdentity");
+  g_assert_cmpstr (g_hash_table_lookup (form, "RoleArn"), ==, ROLE_ARN);
+  g_assert_cmpstr (g_hash_table_lookup (form, "WebIdentityToken"), ==, WEB_TOKEN);
+  g_assert_nonnull (g_hash_table_lookup (form, "RoleSessionName"));
+
+  expiration = format_expiration ();
+  xml = g_strdup_printf ("<AssumeRoleWithWebIdentityResponse>"
+                         "<AssumeRoleWithWebIdentityResult>"
+                         "<Credentials>"
+                         "<AccessKeyId>" ACCESS_KEY "</AccessKeyId>"
+                         "<SecretAccessKey>" SECRET_KEY "</SecretAccessKey>"
+                         "<SessionToken>" SESSION_TOKEN "</SessionToken>"
+                         "<Expiration>%s</Expiration>"
+                         "</Credentials>"
+                         "</AssumeRoleWithWebIdentityResult>"
+                         "</AssumeRoleWithWebIdentityResponse>",
+                         expiration);
+  soup_message_set_status (message, SOUP_STATUS_OK);
+  soup_message_set_response (message, "text/xml", SOUP_MEMORY_TAKE, xml, strlen (xml));
+}
+
+static gpointer
+stand_in_thread_func (gpointer data)
+{
+  StandIn *stand_in = data;
+  g_autoptr(GMainContext) context = g_main_context_new ();
+  g_autoptr(SoupServer) server = NULL;
+  GError *error = NULL;
+  GSList *uris;
+
+  g_main_context_push_thread_default (context);
+
+  server = soup_server_new (NULL, NULL);
+  soup_server_add_handler (server, "/latest", metadata_cb, stand_in, NULL);
+  soup_server_add_handler (server, "/sts", sts_cb, stand_in, NULL);
+  soup_server_listen_local (server, 0, SOUP_SERVER_LISTEN_IPV4_ONLY, &error);
+  g_assert_no_error (error);
+
+  uris = soup_server_get_uris (server);
+  g_assert_nonnull (uris);
+
+  g_mutex_lock (&stand_in->mutex);
+  stand_in->main_loop = g_main_loop_new (context, FALSE);
+  stand_in->port = soup_uri_get_port (uris->data);
+  g_cond_signal (&stand_in->cond);
+  g_mutex_unlock (&stand_in->mutex);
+
+  g_slist_free_full (uris, (GDestroyNotify)soup_uri_free);
+
+  g_main_loop_run (stand_in->main_loop);
+
+  soup_server_disconnect (server);
+  g_main_context_pop_thread_default (context);
+
+  return NULL;
+}
+
+static void
+stand_in_start (StandIn *stand_in)
+{
+  memset (stand_in, 0, sizeof *stand_in);
+  g_mutex_init (&stand_in->mutex);
+  g_cond_init (&stand_in->cond);
+
+  stand_in->thread = g_thread_new ("stand-in", stand_in_thread_func, stand_in);
+
+  g_mutex_lock (&stand_in->mutex);
+  while (stand_in->port == 0)
+    g_cond_wait (&stand_in->cond, &stand_in->mutex);
+  g_mutex_unlock (&stand_in->mutex);
+}
+
+static gboolean
+stand_in_quit_cb (gpointer data)
+{
+  g_main_loop_quit (data);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+stand_in_stop (StandIn *stand_in)
+{
+  GSource *source;
+
+  source = g_idle_source_new ();
+  g_source_set_callback (source, stand_in_quit_cb, stand_in->main_loop, NULL);
+  g_source_attach (source, g_main_loop_get_context (stand_in->main_loop));
+  g_source_unref (source);
+
+  g_thread_join (stand_in->thread);
+
+  g_main_loop_unref (stand_in->main_loop);
+  g_cond_clear (&stand_in->cond);
+  g_mutex_clear (&stand_in->mutex);
+}
+
+static void
+assert_credentials (AwsCredentials *credentials)
+{
+  gint64 remaining;
+
+  g_assert_nonnull (credentials);
+  g_assert_cmpstr (aws_credentials_get_access_key (credentials), ==, ACCESS_KEY);
+  g_assert_cmpstr (aws_credentials_get_secret_key (credentials), ==, SECRET_KEY);
+  g_assert_cmpstr (aws_credentials_get_session_token (credentials), ==, SESSION_TOKEN);
+  g_assert_false (aws_credentials_is_expired (credentials));
+
+  remaining = aws_credentials_get_expiration (credentials) - g_get_real_time () / G_USEC_PER_SEC;
+  g_assert_cmpint (remaining, >, 3500);
+  g_assert_cmpint (remaining, <=, 3600);
+}
+
+static void
+test_metadata (void)
+{
+  g_autoptr(AwsCredentialsProvider) provider = NULL;
+  g_autoptr(AwsCredentials) credentials = NULL;
+  g_autoptr(AwsCredentials) snapshot = NULL;
+  g_autofree gchar *endpoint = NULL;
+  GError *error = NULL;
+  StandIn stand_in;
+
+  g_unsetenv ("AWS_CONTAINER_CREDENTIALS_RELATIVE_URI");
+  g_unsetenv ("AWS_CONTAINER_CREDENTIALS_FULL_URI");
+
+  stand_in_start (&stand_in);
+
+  endpoint = g_strdup_printf ("http://127.0.0.1:%u", stand_in.port);
+  provider = aws_metadata_credentials_provider_new ();
+  aws_metadata_credentials_provider_set_endpoint (AWS_METADATA_CREDENTIALS_PROVIDER (provider), endpoint);
+
+  g_assert_null (aws_credentials_provider_get_credentials (provider));
+
+  credentials = aws_credentials_provider_refresh_sync (provider, NULL, &error);
+  g_assert_no_error (error);
+  assert_credentials (credentials);
+
+  /* Token, role and credentials */
+  g_assert_cmpuint (stand_in.n_requests, ==, 3);
+
+  snapshot = aws_credentials_provider_get_credentials (provider);
+  g_assert_true (snapshot == credentials);
+
+  stand_in_stop (&stand_in);
+}
+
+static void
+test_web_identity (void)
+{
+  g_autoptr(AwsCredentialsProvider) provider = NULL;
+  g_autoptr(AwsCredentials) credentials = NULL;
+  g_autofree gchar *endpoint = NULL;
+  g_autofree gchar *token_file = NULL;
+  GError *error = NULL;
+  StandIn stand_in;
+  gint fd;
+
+  fd = g_file_open_tmp ("test-credentials-provider-XXXXXX", &token_file, &error);
+  g_assert_no_error (error);
+  close (fd);
+
+  g_file_set_contents (token_file, WEB_TOKEN "\n", -1, &error);
+  g_assert_no_error (error);
+
+  g_setenv ("AWS_ROLE_ARN", ROLE_ARN, TRUE);
+  g_setenv ("AWS_WEB_IDENTITY_TOKEN_FILE", token_file, TRUE);
+  g_unsetenv ("AWS_ROLE_SESSION_NAME");
+
+  stand_in_start (&stand_in);
+
+  endpoint = g_strdup_printf ("http://127.0.0.1:%u/sts", stand_in.port);
+  provider = aws_web_identity_credentials_provider_new ();
+  aws_web_identity_credentials_provider_set_endpoint (AWS_WEB_IDENTITY_CREDENTIALS_PROVIDER (provider), endpoint);
+
+  credentials = aws_credentials_provider_refresh_sync (provider, NULL, &error);
+  g_assert_no_error (error);
+  assert_credentials (credentials);
+
+  g_assert_cmpuint (stand_in.n_requests, ==, 1);
+
+  stand_in_stop (&stand_in);
+
+  g_unsetenv ("AWS_ROLE_ARN");
+  g_unsetenv ("AWS_WEB_IDENTITY_TOKEN_FILE");
+  g_unlink (token_file);
+}
+
+static gpointer
+presign_thread_func (gpointer data)
+{
+  AwsS3Client *client = data;
+
+  return aws_s3_client_presign (client, SOUP_METHOD_GET, "bucket", "key", 60);
+}
+
+static void
+test_client_first_load (void)
+{
+  g_autoptr(AwsCredentialsProvider) provider = NULL;
+  g_autoptr(AwsCredentials) credentials = NULL;
+  g_autoptr(AwsS3Client) client = NULL;
+  g_autofree gchar *endpoint = NULL;
+  g_autofree gchar *url = NULL;
+  GError *error = NULL;
+  StandIn stand_in;
+
+  g_unsetenv ("AWS_CONTAINER_CREDENTIALS_RELATIVE_URI");
+  g_unsetenv ("AWS_CONTAINER_CREDENTIALS_FULL_URI");
+
+  stand_in_start (&stand_in);
+
+  endpoint = g_strdup_printf ("http://127.0.0.1:%u", stand_in.port);
+  provider = aws_metadata_credentials_provider_new ();
+  aws_metadata_credentials_provider_set_endpoint (AWS_METADATA_CREDENTIALS_PROVIDER (provider), endpoint);
+
+  client = g_object_new (AWS_TYPE_S3_CLIENT, NULL);
+  aws_s3_client_set_credentials_provider (client, provider);
+
+  /* Signing never waits, so callers wait for the first load themselves.
+   * Nothing iterates a main loop on this thread or the signing one. */
+  credentials = aws_credentials_provider_refresh_sync (provider, NULL, &error);
+  g_assert_no_error (error);
+  assert_credentials (credentials);
+
+  url = g_thread_join (g_thread_new ("presign", presign_thread_func, client));
+
+  g_assert_nonnull (url);
+  g_assert_nonnull (strstr (url, ACCESS_KEY));
+
+  stand_in_stop (&stand_in);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/Aws/CredentialsProvider/metadata", test_metadata);
+  g_test_add_func ("/Aws/CredentialsProvider/web-identity", test_web_identity);
+  g_test_add_func ("/Aws/CredentialsProvider/client-first-load", test_client_first_load);
+
+  return g_test_run ();
+}
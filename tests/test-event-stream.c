@@ -0,0 +1,686 @@
+/* test-event-stream.c
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+#include <string.h>
+
+#include "aws-event-stream.h"
+#include "aws-glib.h"
+
+/*
+ * Frames messages the way S3 Select does and feeds them to the decoder in
+ * chunks of every size, so that each boundary within the prelude, headers,
+ * payload and trailing checksum is exercised.
+ */
+
+typedef struct
+{
+  GPtrArray *events;
+  GString   *records;
+  gboolean   fail_on_end;
+} Collector;
+
+static guint32
+crc32_ieee (const guint8 *data,
+            gsize         len)
+{
+  guint32 c = 0xFFFFFFFFU;
+  gsize i;
+
+  for (i = 0; i < len; i++)
+    {
+      guint k;
+
+      c ^= data [i];
+      for (k = 0; k < 8; k++)
+        c = (c & 1) ? (0xEDB88320U ^ (c >> 1)) : (c >> 1);
+    }
+
+  return c ^ 0xFFFFFFFFU;
+}
+
+static void
+append_be32 (GByteArray *bytes,
+             guint32     value)
+{
+  guint8 be [4] = { value >> 24, value >> 16, value >> 8, value };
+
+  g_byte_array_append (bytes, be, sizeof be);
+}
+
+static void
+append_string_header (GByteArray  *bytes,
+                      const gchar *name,
+                      const gchar *value)
+{
+  guint8 name_len = strlen (name);
+  guint16 value_len = strlen (value);
+  guint8 type = 7;
+  guint8 be [2] = { value_len >> 8, value_len };
+
+  g_byte_array_append (bytes, &name_len, 1);
+  g_byte_array_append (bytes, (const guint8 *)name, name_len);
+  g_byte_array_append (bytes, &type, 1);
+  g_byte_array_append (bytes, be, sizeof be);
+  g_byte_array_append (bytes, (const guint8 *)value, value_len);
+}
+
+/*
+ * Appends a framed message to @stream. A non-%NULL @error_code makes it an
+ * error message rather than an event.
+ */
+static void
+append_message (GByteArray  *stream,
+                const gchar *event_type,
+                const gchar *error_code,
+                const gchar *payload)
+{
+  g_autoptr(GByteArray) headers = g_byte_array_new ();
+  gsize payload_len = payload ? strlen (payload) : 0;
+  guint start = stream->len;
+  guint8 skip_header = 2;
+  guint8 bool_type = 0;
+
+  /* A header the decoder does not care about, which must be skipped */
+  g_byte_array_append (headers, &skip_header, 1);
+  g_byte_array_append (headers, (const guint8 *)":x", 2);
+  g_byte_array_append (headers, &bool_type, 1);
+
+  if (error_code != NULL)
+    {
+      append_string_header (headers, ":message-type", "error");
+      append_string_header (headers, ":error-code", error_code);
+      append_string_header (headers, ":error-message", "Something went wrong");
+    }
+  else
+    {
+      append_string_header (headers, ":message-type", "event");
+      append_string_header (headers, ":event-type", event_type);
+    }
+
+  append_be32 (stream, 16 + headers->len + payload_len);
+  append_be32 (stream, headers->len);
+  append_be32 (stream, crc32_ieee (stream->data + start, 8));
+  g_byte_array_append (stream, headers->data, headers->len);
+  if (payload_len > 0)
+    g_byte_array_append (stream, (const guint8 *)payload, payload_len);
+  append_be32 (stream, crc32_ieee (stream->data + start, stream->len - start));
+}
+
+static GByteArray *
+build_select_stream (void)
+{
+  GByteArray *stream = g_byte_array_new ();
+
+  append_message (stream, "Records", NULL, "a,1\nb,2\n");
+  append_message (stream, "Cont", NULL, NULL);
+  append_message (stream, "Records", NULL, "c,3\n");
+  append_message (stream, "Stats", NULL,
+                  "<Stats><BytesScanned>100</BytesScanned>"
+                  "<BytesProcessed>100</BytesProcessed>"
+                  "<BytesReturned>12</BytesReturned></Stats>");
+  append_message (stream, "End", NULL, NULL);
+
+  return stream;
+}
+
+static gboolean
+collect_message (const AwsEventStreamMessage  *message,
+                 gpointer                      user_data,
+                 GError                      **error)
+{
+  Collector *collector = user_data;
+
+  if (g_str_equal (message->message_type, "error"))
+    {
+      g_ptr_array_add (collector->events, g_strdup_printf ("error:%s", message->error_code));
+      g_assert_cmpstr (message->error_message, ==, "Something went wrong");
+      return TRUE;
+    }
+
+  g_assert_cmpstr (message->message_type, ==, "event");
+  g_ptr_array_add (collector->events, g_strdup (message->event_type));
+
+  if (g_str_equal (message->event_type, "Records"))
+    g_string_append_len (collector->records, (const gchar *)message->payload, message->payload_len);
+  else if (g_str_equal (message->event_type, "Stats"))
+    g_assert_nonnull (g_strstr_len ((const gchar *)message->payload,
+                                    message->payload_len,
+                                    "<BytesReturned>12</BytesReturned>"));
+  else if (g_str_equal (message->event_type, "End"))
+    {
+      g_assert_cmpuint (message->payload_len, ==, 0);
+
+      if (collector->fail_on_end)
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED, "Stopped");
+          return FALSE;
+        }
+    }
+
+  return TRUE;
+}
+
+static void
+collector_init (Collector *collector)
+{
+  collector->events = g_ptr_array_new_with_free_func (g_free);
+  collector->records = g_string_new (NULL);
+  collector->fail_on_end = FALSE;
+}
+
+static void
+collector_clear (Collector *collector)
+{
+  g_ptr_array_unref (collector->events);
+  g_string_free (collector->records, TRUE);
+}
+
+/*
+ * Feeds @stream in chunks of @chunk_size bytes, or of random sizes when
+ * @chunk_size is 0, stopping at the first error.
+ */
+static gboolean
+feed_chunked (AwsEventStreamDecoder  *decoder,
+              GByteArray             *stream,
+              gsize                   chunk_size,
+              GError                **error)
+{
+  gsize offset = 0;
+
+  while (offset < stream->len)
+    {
+      gsize n = chunk_size ? chunk_size : (gsize)g_test_rand_int_range (1, 64);
+
+      n = MIN (n, stream->len - offset);
+
+      if (!aws_event_stream_decoder_feed (decoder, stream->data + offset, n, error))
+        return FALSE;
+
+      offset += n;
+    }
+
+  return TRUE;
+}
+
+static void
+test_chunk_boundaries (void)
+{
+  g_autoptr(GByteArray) stream = build_select_stream ();
+  gsize chunk_size;
+  guint i;
+
+  /* Size 0 means random sizes, repeated a few times below */
+  for (chunk_size = 0; chunk_size <= stream->len; chunk_size++)
+    {
+      for (i = 0; i < (chunk_size == 0 ? 32 : 1); i++)
+        {
+          AwsEventStreamDecoder *decoder;
+          Collector collector;
+          GError *error = NULL;
+          gboolean ret;
+
+          collector_init (&collector);
+          decoder = aws_event_stream_decoder_new (collect_message, &collector);
+
+          ret = feed_chunked (decoder, stream, chunk_size, &error);
+          g_assert_no_error (error);
+          g_assert_true (ret);
+          g_assert_true (aws_event_stream_decoder_is_idle (decoder));
+
+          g_assert_cmpuint (collector.events->len, ==, 5);
+          g_assert_cmpstr (g_ptr_array_index (collector.events, 0), ==, "Records");
+          g_assert_cmpstr (g_ptr_array_index (collector.events, 1), ==, "Cont");
+          g_assert_cmpstr (g_ptr_array_index (collector.events, 2), ==, "Records");
+          g_assert_cmpstr (g_ptr_array_index (collector.events, 3), ==, "Stats");
+          g_assert_cmpstr (g_ptr_array_index (collector.events, 4), ==, "End");
+          g_assert_cmpstr (collector.records->str, ==, "a,1\nb,2\nc,3\n");
+
+          aws_event_stream_decoder_free (decoder);
+          collector_clear (&collector);
+        }
+    }
+}
+
+static void
+test_partial (void)
+{
+  g_autoptr(GByteArray) stream = build_select_stream ();
+  AwsEventStreamDecoder *decoder;
+  Collector collector;
+  GError *error = NULL;
+  gboolean ret;
+
+  collector_init (&collector);
+  decoder = aws_event_stream_decoder_new (collect_message, &collector);
+
+  /* Everything but the trailing checksum of End */
+  ret = aws_event_stream_decoder_feed (decoder, stream->data, stream->len - 4, &error);
+  g_assert_no_error (error);
+  g_assert_true (ret);
+  g_assert_false (aws_event_stream_decoder_is_idle (decoder));
+  g_assert_cmpuint (collector.events->len, ==, 4);
+
+  ret = aws_event_stream_decoder_feed (decoder, stream->data + stream->len - 4, 4, &error);
+  g_assert_no_error (error);
+  g_assert_true (ret);
+  g_assert_true (aws_event_stream_decoder_is_idle (decoder));
+  g_assert_cmpuint (collector.events->len, ==, 5);
+
+  aws_event_stream_decoder_free (decoder);
+  collector_clear (&collector);
+}
+
+static void
+test_error_message (void)
+{
+  g_autoptr(GByteArray) stream = g_byte_array_new ();
+  AwsEventStreamDecoder *decoder;
+  Collector collector;
+  GError *error = NULL;
+  gboolean ret;
+
+  append_message (stream, "Records", NULL, "x\n");
+  append_message (stream, NULL, "InternalError", NULL);
+
+  collector_init (&collector);
+  decoder = aws_event_stream_decoder_new (collect_message, &collector);
+
+  ret = feed_chunked (decoder, stream, 3, &error);
+  g_assert_no_error (error);
+  g_assert_true (ret);
+  g_assert_cmpuint (collector.events->len, ==, 2);
+  g_assert_cmpstr (g_ptr_array_index (collector.events, 1), ==, "error:InternalError");
+
+  aws_event_stream_decoder_free (decoder);
+  collector_clear (&collector);
+}
+
+static void
+test_callback_error (void)
+{
+  g_autoptr(GByteArray) stream = build_select_stream ();
+  AwsEventStreamDecoder *decoder;
+  Collector collector;
+  GError *error = NULL;
+  gboolean ret;
+
+  collector_init (&collector);
+  collector.fail_on_end = TRUE;
+  decoder = aws_event_stream_decoder_new (collect_message, &collector);
+
+  ret = feed_chunked (decoder, stream, 7, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_assert_false (ret);
+  g_clear_error (&error);
+
+  aws_event_stream_decoder_free (decoder);
+  collector_clear (&collector);
+}
+
+/*
+ * Corrupts a copy of the select stream with @corrupt and checks that the
+ * decoder rejects it at every chunk size, without delivering any message
+ * at or after the corrupted one.
+ */
+static void
+check_rejected (void   (*corrupt) (GByteArray *stream, guint *first_bad),
+                guint    max_chunk)
+{
+  gsize chunk_size;
+
+  for (chunk_size = 1; chunk_size <= max_chunk; chunk_size++)
+    {
+      g_autoptr(GByteArray) stream = build_select_stream ();
+      AwsEventStreamDecoder *decoder;
+      Collector collector;
+      GError *error = NULL;
+      guint first_bad = 0;
+      gboolean ret;
+
+      corrupt (stream, &first_bad);
+
+      collector_init (&collector);
+      decoder = aws_event_stream_decoder_new (collect_message, &collector);
+
+      ret = feed_chunked (decoder, stream, chunk_size, &error);
+      g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+      g_assert_false (ret);
+      g_assert_cmpuint (collector.events->len, <=, first_bad);
+      g_clear_error (&error);
+
+      aws_event_stream_decoder_free (decoder);
+      collector_clear (&collector);
+    }
+}
+
+static guint
+message_length_at (GByteArray *stream,
+                   guint       offset)
+{
+  return ((guint)stream->data [offset] << 24) |
+         ((guint)stream->data [offset + 1] << 16) |
+         ((guint)stream->data [offset + 2] << 8) |
+         (guint)stream->data [offset + 3];
+}
+
+static guint
+second_message_offset (GByteArray *stream)
+{
+  return message_length_at (stream, 0);
+}
+
+static void
+corrupt_prelude_crc (GByteArray *stream,
+                     guint      *first_bad)
+{
+  stream->data [second_message_offset (stream) + 9] ^= 0x01;
+  *first_bad = 1;
+}
+
+static void
+corrupt_message_crc (GByteArray *stream,
+                     guint      *first_bad)
+{
+  stream->data [second_message_offset (stream) + 13] ^= 0x80;
+  *first_bad = 1;
+}
+
+static void
+corrupt_oversized (GByteArray *stream,
+                   guint      *first_bad)
+{
+  /* Larger than any message the decoder is willing to buffer */
+  stream->data [0] = 0x7F;
+  *first_bad = 0;
+}
+
+static void
+corrupt_undersized (GByteArray *stream,
+                    guint      *first_bad)
+{
+  stream->data [0] = 0;
+  stream->data [1] = 0;
+  stream->data [2] = 0;
+  stream->data [3] = 8;
+  *first_bad = 0;
+}
+
+static void
+test_bad_prelude_crc (void)
+{
+  check_rejected (corrupt_prelude_crc, 64);
+}
+
+static void
+test_bad_message_crc (void)
+{
+  check_rejected (corrupt_message_crc, 64);
+}
+
+static void
+test_oversized (void)
+{
+  check_rejected (corrupt_oversized, 16);
+}
+
+static void
+test_undersized (void)
+{
+  check_rejected (corrupt_undersized, 16);
+}
+
+/*
+ * A stand-in for S3 Select, serving the framed stream above to
+ * aws_s3_client_select_async() over HTTP.
+ */
+
+typedef struct
+{
+  GMainLoop              *main_loop;
+  GString                *records;
+  GArray                 *progress;
+  AwsS3ClientSelectStats  stats;
+  GError                 *error;
+  guint                   n_final;
+  gboolean                corrupt;
+  gboolean                ret;
+} SelectTest;
+
+static void
+select_server_cb (SoupServer        *server,
+                  SoupMessage       *message,
+                  const char        *path,
+                  GHashTable        *query,
+                  SoupClientContext *client,
+                  gpointer           user_data)
+{
+  SelectTest *test = user_data;
+  g_autofree gchar *body = NULL;
+  GByteArray *stream;
+  gsize len;
+
+  g_assert_cmpstr (message->method, ==, SOUP_METHOD_POST);
+  g_assert_cmpstr (path, ==, "/bucket/key");
+  g_assert_cmpstr (soup_uri_get_query (soup_message_get_uri (message)), ==, "select&select-type=2");
+
+  body = g_strndup (message->request_body->data, message->request_body->length);
+  g_assert_nonnull (strstr (body, "<Expression>SELECT * FROM S3Object s WHERE s._2 &gt; 1</Expression>"));
+  g_assert_nonnull (strstr (body, "<RequestProgress><Enabled>TRUE</Enabled></RequestProgress>"));
+
+  stream = g_byte_array_new ();
+  append_message (stream, "Records", NULL, "a,1\nb,2\n");
+  append_message (stream, "Progress", NULL,
+                  "<Progress><BytesScanned>50</BytesScanned>"
+                  "<BytesProcessed>50</BytesProcessed>"
+                  "<BytesReturned>8</BytesReturned></Progress>");
+  append_message (stream, "Records", NULL, "c,3\n");
+  append_message (stream, "Stats", NULL,
+                  "<Stats><BytesScanned>100</BytesScanned>"
+                  "<BytesProcessed>100</BytesProcessed>"
+                  "<BytesReturned>12</BytesReturned></Stats>");
+  append_message (stream, "End", NULL, NULL);
+
+  /* Flip a bit in the payload of the second Records message */
+  if (test->corrupt)
+    {
+      guint offset = message_length_at (stream, 0);
+
+      offset += message_length_at (stream, offset);
+      offset += message_length_at (stream, offset);
+      stream->data [offset - 5] ^= 0x01;
+    }
+
+  len = stream->len;
+  soup_message_set_status (message, SOUP_STATUS_OK);
+  soup_message_set_response (message,
+                             "application/octet-stream",
+                             SOUP_MEMORY_TAKE,
+                             (gchar *)g_byte_array_free (stream, FALSE),
+                             len);
+}
+
+static gboolean
+select_records (AwsS3Client *client,
+                SoupMessage *message,
+                SoupBuffer  *buffer,
+                gpointer     user_data)
+{
+  SelectTest *test = user_data;
+
+  g_assert_true (AWS_IS_S3_CLIENT (client));
+  g_assert_true (SOUP_IS_MESSAGE (message));
+
+  g_string_append_len (test->records, buffer->data, buffer->length);
+
+  return TRUE;
+}
+
+static void
+select_progress (AwsS3Client                  *client,
+                 const AwsS3ClientSelectStats *stats,
+                 gboolean                      final,
+                 gpointer                      user_data)
+{
+  SelectTest *test = user_data;
+
+  g_assert_true (AWS_IS_S3_CLIENT (client));
+
+  g_array_append_val (test->progress, *stats);
+  if (final)
+    test->n_final++;
+}
+
+static void
+select_cb (GObject      *object,
+           GAsyncResult *result,
+           gpointer      user_data)
+{
+  SelectTest *test = user_data;
+
+  test->ret = aws_s3_client_select_finish (AWS_S3_CLIENT (object),
+                                           result,
+                                           &test->stats,
+                                           &test->error);
+
+  g_main_loop_quit (test->main_loop);
+}
+
+static void
+run_select (SelectTest *test)
+{
+  g_autoptr(SoupServer) server = NULL;
+  g_autoptr(AwsS3Client) client = NULL;
+  GError *error = NULL;
+  GSList *uris;
+
+  server = soup_server_new (NULL, NULL);
+  soup_server_add_handler (server, NULL, select_server_cb, test, NULL);
+  soup_server_listen_local (server, 0, SOUP_SERVER_LISTEN_IPV4_ONLY, &error);
+  g_assert_no_error (error);
+
+  uris = soup_server_get_uris (server);
+  g_assert_nonnull (uris);
+
+  client = g_object_new (AWS_TYPE_S3_CLIENT,
+                         "host", "127.0.0.1",
+                         "port", soup_uri_get_port (uris->data),
+                         "secure", FALSE,
+                         NULL);
+
+  g_slist_free_full (uris, (GDestroyNotify)soup_uri_free);
+
+  test->main_loop = g_main_loop_new (NULL, FALSE);
+  test->records = g_string_new (NULL);
+  test->progress = g_array_new (FALSE, FALSE, sizeof (AwsS3ClientSelectStats));
+
+  aws_s3_client_select_async (client,
+                              "bucket",
+                              "key",
+                              "SELECT * FROM S3Object s WHERE s._2 > 1",
+                              AWS_S3_CLIENT_SELECT_FORMAT_CSV,
+                              AWS_S3_CLIENT_SELECT_FORMAT_CSV,
+                              select_records,
+                              select_progress,
+                              test,
+                              NULL,
+                              NULL,
+                              select_cb,
+                              test);
+  g_main_loop_run (test->main_loop);
+}
+
+static void
+select_test_clear (SelectTest *test)
+{
+  g_clear_error (&test->error);
+  g_string_free (test->records, TRUE);
+  g_array_unref (test->progress);
+  g_main_loop_unref (test->main_loop);
+}
+
+static void
+test_select (void)
+{
+  SelectTest test = { 0 };
+  const AwsS3ClientSelectStats *progress;
+
+  run_select (&test);
+
+  g_assert_no_error (test.error);
+  g_assert_true (test.ret);
+  g_assert_cmpstr (test.records->str, ==, "a,1\nb,2\nc,3\n");
+
+  g_assert_cmpuint (test.progress->len, ==, 2);
+  g_assert_cmpuint (test.n_final, ==, 1);
+
+  progress = &g_array_index (test.progress, AwsS3ClientSelectStats, 0);
+  g_assert_cmpuint (progress->bytes_scanned, ==, 50);
+  g_assert_cmpuint (progress->bytes_processed, ==, 50);
+  g_assert_cmpuint (progress->bytes_returned, ==, 8);
+
+  progress = &g_array_index (test.progress, AwsS3ClientSelectStats, 1);
+  g_assert_cmpuint (progress->bytes_returned, ==, 12);
+
+  g_assert_cmpuint (test.stats.bytes_scanned, ==, 100);
+  g_assert_cmpuint (test.stats.bytes_processed, ==, 100);
+  g_assert_cmpuint (test.stats.bytes_returned, ==, 12);
+
+  select_test_clear (&test);
+}
+
+static void
+test_select_bad_crc (void)
+{
+  SelectTest test = { 0 };
+
+  test.corrupt = TRUE;
+  run_select (&test);
+
+  g_assert_error (test.error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+  g_assert_false (test.ret);
+
+  /* Nothing at or after the corrupted message may be delivered */
+  g_assert_cmpstr (test.records->str, ==, "a,1\nb,2\n");
+  g_assert_cmpuint (test.progress->len, ==, 1);
+  g_assert_cmpuint (test.n_final, ==, 0);
+
+  select_test_clear (&test);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/Aws/EventStream/chunk-boundaries", test_chunk_boundaries);
+  g_test_add_func ("/Aws/EventStream/partial", test_partial);
+  g_test_add_func ("/Aws/EventStream/error-message", test_error_message);
+  g_test_add_func ("/Aws/EventStream/callback-error", test_callback_error);
+  g_test_add_func ("/Aws/EventStream/bad-prelude-crc", test_bad_prelude_crc);
+  g_test_add_func ("/Aws/EventStream/bad-message-crc", test_bad_message_crc);
+  g_test_add_func ("/Aws/EventStream/oversized", test_oversized);
+  g_test_add_func ("/Aws/EventStream/undersized", test_undersized);
+  g_test_add_func ("/Aws/EventStream/select", test_select);
+  g_test_add_func ("/Aws/EventStream/select-bad-crc", test_select_bad_crc);
+
+  return g_test_run ();
+}
@@ -0,0 +1,155 @@
+/* test-s3-client-pool.c
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "aws-glib.h"
+
+#define BODY_SIZE (1024 * 1024)
+
+typedef struct
+{
+  GMainLoop *main_loop;
+  GThread   *main_thread;
+  GThread   *handler_thread;
+  GMutex     mutex;
+  gsize      n_bytes;
+  guint      n_chunks;
+  guint      n_wrong_thread;
+} ReadTest;
+
+static void
+server_cb (SoupServer        *server,
+           SoupMessage       *message,
+           const char        *path,
+           GHashTable        *query,
+           SoupClientContext *client,
+           gpointer           user_data)
+{
+  guint8 *body;
+
+  if (g_strcmp0 (path, "/bucket/key") != 0)
+    {
+      soup_message_set_status (message, SOUP_STATUS_NOT_FOUND);
+      return;
+    }
+
+  body = g_malloc (BODY_SIZE);
+  memset (body, 'x', BODY_SIZE);
+
+  soup_message_set_status (message, SOUP_STATUS_OK);
+  soup_message_set_response (message, "application/octet-stream", SOUP_MEMORY_TAKE, (gchar *)body, BODY_SIZE);
+}
+
+static gboolean
+read_handler (AwsS3Client *client,
+              SoupMessage *message,
+              SoupBuffer  *buffer,
+              gpointer     user_data)
+{
+  ReadTest *test = user_data;
+  GThread *self = g_thread_self ();
+
+  g_mutex_lock (&test->mutex);
+  if (test->handler_thread == NULL)
+    test->handler_thread = self;
+  if (self == test->main_thread || self != test->handler_thread)
+    test->n_wrong_thread++;
+  test->n_bytes += buffer->length;
+  test->n_chunks++;
+  g_mutex_unlock (&test->mutex);
+
+  return TRUE;
+}
+
+static void
+read_cb (GObject      *object,
+         GAsyncResult *result,
+         gpointer      user_data)
+{
+  ReadTest *test = user_data;
+  GError *error = NULL;
+  gboolean ret;
+
+  ret = aws_s3_client_pool_read_finish (AWS_S3_CLIENT_POOL (object), result, &error);
+  g_assert_no_error (error);
+  g_assert_true (ret);
+
+  g_assert_true (g_thread_self () == test->main_thread);
+
+  g_main_loop_quit (test->main_loop);
+}
+
+static void
+test_read_on_shard_thread (void)
+{
+  g_autoptr(SoupServer) server = NULL;
+  g_autoptr(AwsS3Client) prototype = NULL;
+  g_autoptr(AwsS3ClientPool) pool = NULL;
+  GSList *uris;
+  SoupURI *uri;
+  GError *error = NULL;
+  ReadTest test = { 0 };
+
+  server = soup_server_new (NULL, NULL);
+  soup_server_add_handler (server, NULL, server_cb, NULL, NULL);
+  soup_server_listen_local (server, 0, SOUP_SERVER_LISTEN_IPV4_ONLY, &error);
+  g_assert_no_error (error);
+
+  uris = soup_server_get_uris (server);
+  g_assert_nonnull (uris);
+  uri = uris->data;
+
+  prototype = g_object_new (AWS_TYPE_S3_CLIENT,
+                            "host", "127.0.0.1",
+                            "port", soup_uri_get_port (uri),
+                            "secure", FALSE,
+                            NULL);
+  pool = aws_s3_client_pool_new (prototype, 2);
+
+  g_slist_free_full (uris, (GDestroyNotify)soup_uri_free);
+
+  g_mutex_init (&test.mutex);
+  test.main_loop = g_main_loop_new (NULL, FALSE);
+  test.main_thread = g_thread_self ();
+
+  aws_s3_client_pool_read_async (pool, "bucket", "key", read_handler, &test, NULL, NULL, read_cb, &test);
+  g_main_loop_run (test.main_loop);
+
+  /* Every got-chunk must have been handled by the shard's own thread */
+  g_assert_nonnull (test.handler_thread);
+  g_assert_cmpuint (test.n_wrong_thread, ==, 0);
+  g_assert_cmpuint (test.n_chunks, >, 0);
+  g_assert_cmpuint (test.n_bytes, ==, BODY_SIZE);
+
+  g_main_loop_unref (test.main_loop);
+  g_mutex_clear (&test.mutex);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/Aws/S3ClientPool/read-on-shard-thread", test_read_on_shard_thread);
+
+  return g_test_run ();
+}
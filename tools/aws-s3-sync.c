@@ -0,0 +1,748 @@
+/* aws-s3-sync.c
+ *
+ * Copyright © 2012-2016 Christian Hergert <christian@hergert.me>
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "aws-glib.h"
+
+/*
+ * Mirrors a local directory to or from an S3 prefix, copying only files
+ * whose size, modification time or ETag differ. The local tree is walked
+ * and sorted up front; the bucket listing is then streamed a page at a
+ * time and merged against it, so transfers start while later pages are
+ * still being listed. Transfers run on a thread pool using the
+ * synchronous AwsS3Client API.
+ */
+
+/* The largest object S3 accepts in a single PUT */
+#define MAX_PUT_SIZE (G_GUINT64_CONSTANT (5) * 1024 * 1024 * 1024)
+
+#define LOCAL_ATTRIBUTES                   \
+  G_FILE_ATTRIBUTE_STANDARD_NAME ","       \
+  G_FILE_ATTRIBUTE_STANDARD_TYPE ","       \
+  G_FILE_ATTRIBUTE_STANDARD_SIZE ","       \
+  G_FILE_ATTRIBUTE_TIME_MODIFIED
+
+typedef enum
+{
+  DIRECTION_UPLOAD,
+  DIRECTION_DOWNLOAD,
+} Direction;
+
+typedef struct
+{
+  gchar   *path;
+  guint64  size;
+  gint64   mtime;
+} LocalEntry;
+
+typedef struct
+{
+  gchar    *path;
+  guint64   size;
+  gint64    remote_mtime;
+  gchar    *etag;
+  gboolean  verify;
+} Job;
+
+typedef struct
+{
+  AwsS3Client *client;
+  GFile       *root;
+  gchar       *bucket;
+  gchar       *prefix;
+  Direction    direction;
+  gboolean     dry_run;
+
+  volatile gint  n_transferred;
+  volatile gint  n_skipped;
+  volatile gint  n_failed;
+  volatile gsize bytes_transferred;
+
+  GMutex   progress_mutex;
+  GCond    progress_cond;
+  gboolean done;
+} Sync;
+
+static gint jobs = 16;
+static gboolean dry_run;
+static gboolean progress;
+static gchar *region;
+static gchar *host;
+
+static GOptionEntry entries[] = {
+  { "jobs", 'j', 0, G_OPTION_ARG_INT, &jobs, "Number of transfers to run at once", "N" },
+  { "dry-run", 'n', 0, G_OPTION_ARG_NONE, &dry_run, "Only print what would be transferred", NULL },
+  { "progress", 'p', 0, G_OPTION_ARG_NONE, &progress, "Print throughput every second", NULL },
+  { "region", 0, 0, G_OPTION_ARG_STRING, &region, "The region of the bucket, to use its endpoint", "REGION" },
+  { "host", 0, 0, G_OPTION_ARG_STRING, &host, "The S3 endpoint to use", "HOST" },
+  { NULL }
+};
+
+static void
+local_entry_clear (gpointer data)
+{
+  LocalEntry *entry = data;
+
+  g_free (entry->path);
+}
+
+static gint
+local_entry_compare (gconstpointer a,
+                     gconstpointer b)
+{
+  return strcmp (((const LocalEntry *)a)->path, ((const LocalEntry *)b)->path);
+}
+
+static void
+job_free (Job *job)
+{
+  g_free (job->path);
+  g_free (job->etag);
+  g_slice_free (Job, job);
+}
+
+static gboolean
+parse_s3_uri (const gchar  *uri,
+              gchar       **bucket,
+              gchar       **prefix)
+{
+  const gchar *slash;
+
+  if (!g_str_has_prefix (uri, "s3://"))
+    return FALSE;
+
+  uri += strlen ("s3://");
+
+  if ((slash = strchr (uri, '/')))
+    {
+      *bucket = g_strndup (uri, slash - uri);
+      slash += strspn (slash, "/");
+
+      /* Keys are matched below the prefix as if it were a directory */
+      if (*slash != '\0' && !g_str_has_suffix (slash, "/"))
+        *prefix = g_strconcat (slash, "/", NULL);
+      else
+        *prefix = g_strdup (slash);
+    }
+  else
+    {
+      *bucket = g_strdup (uri);
+      *prefix = g_strdup ("");
+    }
+
+  return **bucket != '\0';
+}
+
+/*
+ * Checks that @path, taken from an object key, stays below the local root
+ * once resolved against it.
+ */
+static gboolean
+is_safe_path (const gchar *path)
+{
+  g_auto(GStrv) parts = g_strsplit (path, "/", -1);
+  guint i;
+
+  for (i = 0; parts [i] != NULL; i++)
+    {
+      if (*parts [i] == '\0' ||
+          g_str_equal (parts [i], ".") ||
+          g_str_equal (parts [i], ".."))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gchar *
+format_rate (guint64 bytes,
+             gint64  usec)
+{
+  g_autofree gchar *size = NULL;
+
+  size = g_format_size (usec > 0 ? bytes * G_USEC_PER_SEC / usec : bytes);
+
+  return g_strdup_printf ("%s/s", size);
+}
+
+static gboolean
+walk_directory (GFile         *root,
+                GFile         *directory,
+                GArray        *local,
+                GCancellable  *cancellable,
+                GError       **error)
+{
+  g_autoptr(GFileEnumerator) enumerator = NULL;
+  g_autoptr(GError) local_error = NULL;
+  GFileInfo *info;
+
+  enumerator = g_file_enumerate_children (directory,
+                                          LOCAL_ATTRIBUTES,
+                                          G_FILE_QUERY_INFO_NONE,
+                                          cancellable,
+                                          error);
+
+  if (enumerator == NULL)
+    return FALSE;
+
+  while ((info = g_file_enumerator_next_file (enumerator, cancellable, &local_error)))
+    {
+      g_autoptr(GFile) child = g_file_get_child (directory, g_file_info_get_name (info));
+
+      switch (g_file_info_get_file_type (info))
+        {
+        case G_FILE_TYPE_DIRECTORY:
+          if (!walk_directory (root, child, local, cancellable, error))
+            {
+              g_object_unref (info);
+              return FALSE;
+            }
+          break;
+
+        case G_FILE_TYPE_REGULAR:
+          {
+            LocalEntry entry;
+
+            entry.path = g_file_get_relative_path (root, child);
+            entry.size = g_file_info_get_size (info);
+            entry.mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+            g_array_append_val (local, entry);
+          }
+          break;
+
+        case G_FILE_TYPE_UNKNOWN:
+        case G_FILE_TYPE_SYMBOLIC_LINK:
+        case G_FILE_TYPE_SPECIAL:
+        case G_FILE_TYPE_SHORTCUT:
+        case G_FILE_TYPE_MOUNTABLE:
+        default:
+          break;
+        }
+
+      g_object_unref (info);
+    }
+
+  if (local_error != NULL)
+    {
+      g_propagate_error (error, g_steal_pointer (&local_error));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*
+ * Returns the hex MD5 of @file, which is what S3 reports as the ETag of
+ * objects uploaded in a single part.
+ */
+static gchar *
+compute_md5 (GFile   *file,
+             GError **error)
+{
+  g_autoptr(GFileInputStream) stream = NULL;
+  g_autoptr(GChecksum) checksum = NULL;
+  g_autofree guint8 *buffer = NULL;
+  gssize n_read;
+
+  if (!(stream = g_file_read (file, NULL, error)))
+    return NULL;
+
+  checksum = g_checksum_new (G_CHECKSUM_MD5);
+  buffer = g_malloc (64 * 1024);
+
+  while ((n_read = g_input_stream_read (G_INPUT_STREAM (stream), buffer, 64 * 1024, NULL, error)) > 0)
+    g_checksum_update (checksum, buffer, n_read);
+
+  if (n_read < 0)
+    return NULL;
+
+  return g_strdup (g_checksum_get_string (checksum));
+}
+
+static gboolean
+etag_matches (const gchar *etag,
+              const gchar *md5)
+{
+  gsize len;
+
+  if (etag == NULL)
+    return FALSE;
+
+  if (*etag == '"')
+    etag++;
+
+  len = strlen (etag);
+  if (len > 0 && etag [len - 1] == '"')
+    len--;
+
+  /* Multipart ETags are not a digest of the contents */
+  return len == strlen (md5) && g_ascii_strncasecmp (etag, md5, len) == 0;
+}
+
+static gboolean
+sync_transfer (Sync    *sync,
+               Job     *job,
+               GFile   *file,
+               GError **error)
+{
+  g_autofree gchar *key = g_strconcat (sync->prefix, job->path, NULL);
+
+  if (sync->direction == DIRECTION_UPLOAD)
+    {
+      g_autoptr(GMappedFile) mapped = NULL;
+      g_autoptr(GBytes) bytes = NULL;
+      g_autofree gchar *local_path = g_file_get_path (file);
+
+      if (job->size > MAX_PUT_SIZE)
+        {
+          g_autofree gchar *limit = g_format_size (MAX_PUT_SIZE);
+
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_NOT_SUPPORTED,
+                       "Files larger than %s cannot be uploaded in a single request",
+                       limit);
+          return FALSE;
+        }
+
+      if (local_path == NULL)
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_NOT_SUPPORTED,
+                       "Only local files can be uploaded");
+          return FALSE;
+        }
+
+      /* Mapped rather than read, so jobs don't each hold a copy in memory */
+      if (!(mapped = g_mapped_file_new (local_path, FALSE, error)))
+        return FALSE;
+
+      bytes = g_mapped_file_get_bytes (mapped);
+
+      return aws_s3_client_write_bytes_sync (sync->client,
+                                             sync->bucket,
+                                             key,
+                                             bytes,
+                                             NULL,
+                                             error);
+    }
+  else
+    {
+      g_autoptr(GFile) parent = g_file_get_parent (file);
+      g_autoptr(GError) local_error = NULL;
+
+      if (!g_file_make_directory_with_parents (parent, NULL, &local_error) &&
+          !g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_EXISTS))
+        {
+          g_propagate_error (error, g_steal_pointer (&local_error));
+          return FALSE;
+        }
+
+      if (!aws_s3_client_download_sync (sync->client, sync->bucket, key, file, NULL, error))
+        return FALSE;
+
+      /* Matching times let the next run skip the file without hashing it */
+      return g_file_set_attribute_uint64 (file,
+                                          G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                          job->remote_mtime,
+                                          G_FILE_QUERY_INFO_NONE,
+                                          NULL,
+                                          error);
+    }
+}
+
+static void
+sync_worker (gpointer data,
+             gpointer user_data)
+{
+  Job *job = data;
+  Sync *sync = user_data;
+  g_autoptr(GFile) file = g_file_resolve_relative_path (sync->root, job->path);
+  g_autoptr(GError) error = NULL;
+
+  if (job->verify)
+    {
+      g_autofree gchar *md5 = NULL;
+
+      if (!(md5 = compute_md5 (file, &error)))
+        goto failure;
+
+      if (etag_matches (job->etag, md5))
+        {
+          if (sync->direction == DIRECTION_DOWNLOAD && !sync->dry_run)
+            g_file_set_attribute_uint64 (file,
+                                         G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                         job->remote_mtime,
+                                         G_FILE_QUERY_INFO_NONE,
+                                         NULL,
+                                         NULL);
+          g_atomic_int_inc (&sync->n_skipped);
+          job_free (job);
+          return;
+        }
+    }
+
+  g_print ("%s %s\n", sync->direction == DIRECTION_UPLOAD ? "upload" : "download", job->path);
+
+  if (!sync->dry_run && !sync_transfer (sync, job, file, &error))
+    goto failure;
+
+  g_atomic_int_inc (&sync->n_transferred);
+  g_atomic_pointer_add (&sync->bytes_transferred, job->size);
+  job_free (job);
+  return;
+
+failure:
+  g_printerr ("%s: %s\n", job->path, error->message);
+  g_atomic_int_inc (&sync->n_failed);
+  job_free (job);
+}
+
+static void
+sync_push (Sync        *sync,
+           GThreadPool *pool,
+           const gchar *path,
+           guint64      size,
+           gint64       remote_mtime,
+           const gchar *etag,
+           gboolean     verify)
+{
+  Job *job = g_slice_new0 (Job);
+
+  job->path = g_strdup (path);
+  job->size = size;
+  job->remote_mtime = remote_mtime;
+  job->etag = g_strdup (etag);
+  job->verify = verify;
+
+  g_thread_pool_push (pool, job, NULL);
+}
+
+/*
+ * Decides what to do with a file present on both sides. Sizes that
+ * differ always mean a transfer; otherwise the source must be newer, and
+ * then the contents are hashed against the ETag before transferring.
+ */
+static void
+sync_compare (Sync             *sync,
+              GThreadPool      *pool,
+              const LocalEntry *local,
+              AwsS3ObjectInfo  *remote)
+{
+  guint64 size = aws_s3_object_info_get_size (remote);
+  gint64 remote_mtime = aws_s3_object_info_get_last_modified (remote);
+  const gchar *etag = aws_s3_object_info_get_etag (remote);
+  gboolean newer;
+
+  if (sync->direction == DIRECTION_UPLOAD)
+    newer = local->mtime > remote_mtime;
+  else
+    newer = remote_mtime != local->mtime;
+
+  if (local->size != size)
+    sync_push (sync, pool, local->path, MAX (size, local->size), remote_mtime, etag, FALSE);
+  else if (newer)
+    sync_push (sync, pool, local->path, size, remote_mtime, etag, TRUE);
+  else
+    g_atomic_int_inc (&sync->n_skipped);
+}
+
+static gboolean
+sync_run (Sync          *sync,
+          GThreadPool   *pool,
+          GArray        *local,
+          GCancellable  *cancellable,
+          GError       **error)
+{
+  g_autofree gchar *token = NULL;
+  gsize prefix_len = strlen (sync->prefix);
+  guint l = 0;
+
+  do
+    {
+      g_autoptr(GPtrArray) page = NULL;
+      gchar *next_token = NULL;
+      guint i;
+
+      page = aws_s3_client_list_sync (sync->client,
+                                      sync->bucket,
+                                      *sync->prefix ? sync->prefix : NULL,
+                                      NULL,
+                                      0,
+                                      token,
+                                      &next_token,
+                                      cancellable,
+                                      error);
+
+      if (page == NULL)
+        return FALSE;
+
+      g_free (token);
+      token = next_token;
+
+      for (i = 0; i < page->len; i++)
+        {
+          AwsS3ObjectInfo *remote = g_ptr_array_index (page, i);
+          const gchar *path = aws_s3_object_info_get_key (remote) + prefix_len;
+          gint cmp = 1;
+
+          /* Directory placeholders have no local counterpart */
+          if (*path == '\0' || g_str_has_suffix (path, "/"))
+            continue;
+
+          /* Nor do keys that would resolve outside of the local root */
+          if (!is_safe_path (path))
+            {
+              if (sync->direction == DIRECTION_DOWNLOAD)
+                {
+                  g_printerr ("%s: Refusing to download a key outside of the destination\n", path);
+                  g_atomic_int_inc (&sync->n_failed);
+                }
+              continue;
+            }
+
+          /* Keys and local paths are both in byte order, so merge them */
+          for (; l < local->len; l++)
+            {
+              const LocalEntry *entry = &g_array_index (local, LocalEntry, l);
+
+              if ((cmp = strcmp (entry->path, path)) >= 0)
+                break;
+
+              if (sync->direction == DIRECTION_UPLOAD)
+                sync_push (sync, pool, entry->path, entry->size, 0, NULL, FALSE);
+            }
+
+          if (cmp == 0)
+            sync_compare (sync, pool, &g_array_index (local, LocalEntry, l++), remote);
+          else if (sync->direction == DIRECTION_DOWNLOAD)
+            sync_push (sync,
+                       pool,
+                       path,
+                       aws_s3_object_info_get_size (remote),
+                       aws_s3_object_info_get_last_modified (remote),
+                       aws_s3_object_info_get_etag (remote),
+                       FALSE);
+        }
+    }
+  while (token != NULL);
+
+  for (; l < local->len; l++)
+    {
+      const LocalEntry *entry = &g_array_index (local, LocalEntry, l);
+
+      if (sync->direction == DIRECTION_UPLOAD)
+        sync_push (sync, pool, entry->path, entry->size, 0, NULL, FALSE);
+    }
+
+  return TRUE;
+}
+
+static gpointer
+progress_thread (gpointer data)
+{
+  Sync *sync = data;
+  gint64 started = g_get_monotonic_time ();
+  gint64 deadline = started;
+
+  g_mutex_lock (&sync->progress_mutex);
+
+  while (!sync->done)
+    {
+      deadline += G_USEC_PER_SEC;
+
+      if (!g_cond_wait_until (&sync->progress_cond, &sync->progress_mutex, deadline))
+        {
+          g_autofree gchar *rate = NULL;
+          gsize bytes = (gsize)g_atomic_pointer_get (&sync->bytes_transferred);
+
+          rate = format_rate (bytes, g_get_monotonic_time () - started);
+          g_printerr ("%d transferred, %d skipped, %d failed, %s\n",
+                      g_atomic_int_get (&sync->n_transferred),
+                      g_atomic_int_get (&sync->n_skipped),
+                      g_atomic_int_get (&sync->n_failed),
+                      rate);
+        }
+    }
+
+  g_mutex_unlock (&sync->progress_mutex);
+
+  return NULL;
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_autoptr(GOptionContext) context = NULL;
+  g_autoptr(AwsCredentialsProvider) provider = NULL;
+  g_autoptr(AwsCredentials) credentials = NULL;
+  g_autoptr(GArray) local = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *size = NULL;
+  g_autofree gchar *rate = NULL;
+  g_autofree gchar *upload_bucket = NULL;
+  g_autofree gchar *upload_prefix = NULL;
+  g_autofree gchar *download_bucket = NULL;
+  g_autofree gchar *download_prefix = NULL;
+  GThread *reporter = NULL;
+  GThreadPool *pool;
+  const gchar *local_path;
+  Sync sync = { 0 };
+  gint64 started;
+  gint64 elapsed;
+  gboolean ret;
+
+  context = g_option_context_new ("SOURCE DESTINATION");
+  g_option_context_set_summary (context,
+                                "Copies files that differ between a local directory and an\n"
+                                "S3 prefix, given as s3://BUCKET/PREFIX, in either direction.");
+  g_option_context_add_main_entries (context, entries, NULL);
+
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  if (argc != 3 || jobs < 1)
+    {
+      g_autofree gchar *help = g_option_context_get_help (context, TRUE, NULL);
+
+      g_printerr ("%s", help);
+      return EXIT_FAILURE;
+    }
+
+  if (parse_s3_uri (argv [2], &upload_bucket, &upload_prefix) && !g_str_has_prefix (argv [1], "s3://"))
+    {
+      sync.direction = DIRECTION_UPLOAD;
+      sync.bucket = g_steal_pointer (&upload_bucket);
+      sync.prefix = g_steal_pointer (&upload_prefix);
+      local_path = argv [1];
+    }
+  else if (parse_s3_uri (argv [1], &download_bucket, &download_prefix) && !g_str_has_prefix (argv [2], "s3://"))
+    {
+      sync.direction = DIRECTION_DOWNLOAD;
+      sync.bucket = g_steal_pointer (&download_bucket);
+      sync.prefix = g_steal_pointer (&download_prefix);
+      local_path = argv [2];
+    }
+  else
+    {
+      g_printerr ("Exactly one of SOURCE and DESTINATION must be an s3:// URI\n");
+      return EXIT_FAILURE;
+    }
+
+  sync.root = g_file_new_for_commandline_arg (local_path);
+  sync.dry_run = dry_run;
+  g_mutex_init (&sync.progress_mutex);
+  g_cond_init (&sync.progress_cond);
+
+  /* Load up front so that no worker signs without credentials */
+  provider = aws_credentials_provider_chain_new_default ();
+
+  if (!(credentials = aws_credentials_provider_refresh_sync (provider, NULL, &error)))
+    {
+      g_printerr ("Failed to load credentials: %s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  /* Every job may hold a connection to the same host at once */
+  sync.client = g_object_new (AWS_TYPE_S3_CLIENT,
+                              "credentials-provider", provider,
+                              "max-conns", MAX (jobs, 10),
+                              "max-conns-per-host", jobs,
+                              NULL);
+
+  /* A regional endpoint avoids redirects, and is signed for that region */
+  if (region != NULL)
+    aws_s3_client_set_region (sync.client, region);
+  if (host != NULL)
+    aws_s3_client_set_host (sync.client, host);
+  else if (region != NULL)
+    {
+      g_autofree gchar *regional_host = g_strdup_printf ("s3.%s.amazonaws.com", region);
+
+      aws_s3_client_set_host (sync.client, regional_host);
+    }
+
+  local = g_array_new (FALSE, FALSE, sizeof (LocalEntry));
+  g_array_set_clear_func (local, local_entry_clear);
+
+  if (!walk_directory (sync.root, sync.root, local, NULL, &error))
+    {
+      /* Downloading into a directory that does not exist yet */
+      if (sync.direction == DIRECTION_UPLOAD ||
+          !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+        {
+          g_printerr ("%s: %s\n", local_path, error->message);
+          return EXIT_FAILURE;
+        }
+
+      g_clear_error (&error);
+    }
+
+  g_array_sort (local, local_entry_compare);
+
+  started = g_get_monotonic_time ();
+
+  if (progress)
+    reporter = g_thread_new ("aws-s3-sync-progress", progress_thread, &sync);
+
+  pool = g_thread_pool_new (sync_worker, &sync, jobs, FALSE, NULL);
+  ret = sync_run (&sync, pool, local, NULL, &error);
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  elapsed = g_get_monotonic_time () - started;
+
+  if (reporter != NULL)
+    {
+      g_mutex_lock (&sync.progress_mutex);
+      sync.done = TRUE;
+      g_cond_signal (&sync.progress_cond);
+      g_mutex_unlock (&sync.progress_mutex);
+      g_thread_join (reporter);
+    }
+
+  if (!ret)
+    g_printerr ("Failed to list s3://%s/%s: %s\n", sync.bucket, sync.prefix, error->message);
+
+  size = g_format_size (sync.bytes_transferred);
+  rate = format_rate (sync.bytes_transferred, elapsed);
+  g_print ("%d transferred (%s in %.1lf seconds, %s), %d unchanged, %d failed\n",
+           sync.n_transferred,
+           size,
+           elapsed / (gdouble)G_USEC_PER_SEC,
+           rate,
+           sync.n_skipped,
+           sync.n_failed);
+
+  g_clear_object (&sync.client);
+  g_clear_object (&sync.root);
+  g_free (sync.bucket);
+  g_free (sync.prefix);
+  g_mutex_clear (&sync.progress_mutex);
+  g_cond_clear (&sync.progress_cond);
+
+  return (ret && sync.n_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}